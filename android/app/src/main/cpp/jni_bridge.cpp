@@ -1,10 +1,20 @@
+#include "core/capability_table.h"
 #include "core/device.h"
+#include "core/discovery_cache.h"
+#include "core/eq_fit.h"
+#include "core/eq_response.h"
+#include "core/eq_slots.h"
+#include "core/state_json.h"
+#include "core/state_store.h"
 #include "core/types.h"
 #include "platform/android/bluetooth_spp_client_android.h"
+#include "platform/android/device_discovery_android.h"
 #include <android/log.h>
 #include <iostream>
 #include <jni.h>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector> // Added for std::vector
@@ -95,6 +105,18 @@ Java_com_example_freebuds_1flutter_MainActivity_nativeTestConnection(
 	return success;
 }
 
+// Name -> address resolution shared by every device, so a repeat connect skips
+// the bonded-device scan. Set up by the first createDevice(). Behind
+// g_discovery_mutex; once a connect has used the cache it is never replaced, so
+// the connect may keep using it after letting go of the lock.
+static std::unique_ptr<DeviceDiscoveryAndroid> g_discovery;
+static std::unique_ptr<DiscoveryCache> g_discovery_cache;
+static bool g_discovery_used = false;
+static std::mutex g_discovery_mutex;
+// One EQ slot manager per device, made on first use and dropped in freeDevice.
+static std::map<jlong, std::unique_ptr<EqSlots>> g_eq_slots;
+static std::mutex g_eq_slots_mutex;
+
 // Updated function name for Flutter package
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_example_freebuds_1flutter_MainActivity_createDevice(
@@ -108,6 +130,11 @@ Java_com_example_freebuds_1flutter_MainActivity_createDevice(
 		auto bt_client =
 			std::make_unique<BluetoothSppClientAndroid>(vm, bt_manager);
 		auto device = std::make_unique<Device>(std::move(bt_client));
+		std::lock_guard<std::mutex> lock(g_discovery_mutex);
+		if (!g_discovery) {
+			g_discovery = std::make_unique<DeviceDiscoveryAndroid>(vm, bt_manager);
+			g_discovery_cache = std::make_unique<DiscoveryCache>(*g_discovery);
+		}
 
 		LOGI("Device created successfully");
 		return reinterpret_cast<jlong>(device.release());
@@ -124,6 +151,10 @@ Java_com_example_freebuds_1flutter_MainActivity_freeDevice(
 	LOGI("freeDevice called");
 	if (device_ptr != 0) {
 		Device *device = reinterpret_cast<Device *>(device_ptr);
+		{
+			std::lock_guard<std::mutex> lock(g_eq_slots_mutex);
+			g_eq_slots.erase(device_ptr);
+		}
 		delete device;
 		LOGI("Device freed");
 	}
@@ -139,12 +170,47 @@ extern "C" JNIEXPORT jboolean JNICALL
 	std::string addr_str(nativeAddress);
 	env->ReleaseStringUTFChars(address, nativeAddress);
 	LOGI("nativeConnect called for address: %s", addr_str.c_str());
-	// Calling the C++ Device's connect method, which will delegate to Kotlin
-	bool result = get_device(device_ptr)->connect(addr_str, 1);
+	Device *device = get_device(device_ptr);
+	// A MAC address goes straight to Kotlin; a name is resolved through the cache
+	// so only the first connect (or one that fails) scans the bonded devices.
+	bool is_address = addr_str.size() == 17 && addr_str[2] == ':';
+	DiscoveryCache *cache = nullptr;
+	if (!is_address) {
+		std::lock_guard<std::mutex> lock(g_discovery_mutex);
+		cache = g_discovery_cache.get();
+		if (cache) g_discovery_used = true;
+	}
+	bool result;
+	if (!cache) {
+		result = device->connect(addr_str, 1);
+	} else {
+		result = cache->connect(addr_str, [device](const DiscoveredDevice &found, bool cached) {
+			LOGI("Connecting to %s%s", found.address.c_str(), cached ? " (cached)" : "");
+			return device->connect(found.address, found.channel ? found.channel : 1);
+		});
+	}
 	LOGI("nativeConnect result: %d", result);
 	return result;
 }
 
+// Keeps what nativeConnect() resolved names to in 'path' (in the app's files
+// dir), so the first connect after a restart is fast too. Call after
+// createDevice(); like the FFI bridge, it only takes effect before the first
+// connect by name.
+extern "C" JNIEXPORT void JNICALL
+	Java_com_example_freebuds_1flutter_MainActivity_nativeSetDiscoveryFile(
+	JNIEnv *env, jobject thiz, jstring path) {
+if (path == nullptr)
+return;
+const char *path_chars = env->GetStringUTFChars(path, nullptr);
+std::string path_str(path_chars);
+env->ReleaseStringUTFChars(path, path_chars);
+std::lock_guard<std::mutex> lock(g_discovery_mutex);
+if (!g_discovery || g_discovery_used || path_str.empty())
+return;
+g_discovery_cache = std::make_unique<DiscoveryCache>(*g_discovery, path_str);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_example_freebuds_1flutter_MainActivity_nativeDisconnect(
 	JNIEnv *env, jobject thiz, jlong device_ptr) {
@@ -818,6 +884,106 @@ LOGI("Calling delete_custom_equalizer with full payload for id: %d", id);
 return get_device(device_ptr)->delete_custom_equalizer(preset_to_delete);
 }
 
+static EqSlots *eq_slots(jlong device_ptr) {
+std::lock_guard<std::mutex> lock(g_eq_slots_mutex);
+auto &slots = g_eq_slots[device_ptr];
+if (!slots) slots = std::make_unique<EqSlots>(*get_device(device_ptr));
+return slots.get();
+}
+
+static bool curve_of(JNIEnv *env, jstring name, jintArray values, CustomEqPreset &curve) {
+if (env->GetArrayLength(values) != 10) {
+LOGE("Custom EQ must have 10 values, but got %d", env->GetArrayLength(values));
+return false;
+}
+const char *name_chars = env->GetStringUTFChars(name, nullptr);
+curve.name = std::string(name_chars);
+env->ReleaseStringUTFChars(name, name_chars);
+jint *value_elements = env->GetIntArrayElements(values, nullptr);
+for (int i = 0; i < 10; ++i) {
+curve.values.push_back(static_cast<int8_t>(value_elements[i]));
+}
+env->ReleaseIntArrayElements(values, value_elements, JNI_ABORT);
+return true;
+}
+
+// Makes a custom curve current through the slot manager: one byte on the wire if
+// the headset keeps it already. Returns the preset id it's under, -1 on failure.
+extern "C" JNIEXPORT jint JNICALL
+	Java_com_example_freebuds_1flutter_MainActivity_nativeSelectCustomEqualizer(
+	JNIEnv *env, jobject thiz, jlong device_ptr, jstring name, jintArray values) {
+CustomEqPreset curve;
+if (device_ptr == 0 || !get_device(device_ptr)->is_connected() || !curve_of(env, name, values, curve))
+return -1;
+auto id = eq_slots(device_ptr)->select(curve);
+return id ? *id : -1;
+}
+
+// Saves a curve ahead of its first use, keeping the current preset playing.
+extern "C" JNIEXPORT jint JNICALL
+	Java_com_example_freebuds_1flutter_MainActivity_nativeStageCustomEqualizer(
+	JNIEnv *env, jobject thiz, jlong device_ptr, jstring name, jintArray values) {
+CustomEqPreset curve;
+if (device_ptr == 0 || !get_device(device_ptr)->is_connected() || !curve_of(env, name, values, curve))
+return -1;
+EqSlots *slots = eq_slots(device_ptr);
+if (slots->stage({curve}) == 0)
+return -1;
+auto id = slots->find(curve);
+return id ? *id : -1;
+}
+
+// The response of a curve (10 values, tenths of a dB) at 'points' frequencies
+// from 20 Hz to 20 kHz, log-spaced, in dB, for drawing it. Needs no device.
+extern "C" JNIEXPORT jfloatArray JNICALL
+	Java_com_example_freebuds_1flutter_MainActivity_nativeGetEqResponse(
+	JNIEnv *env, jobject thiz, jintArray values, jint points) {
+static std::mutex mutex;
+static std::shared_ptr<const EqResponse> engine;
+if (points <= 0)
+return nullptr;
+std::shared_ptr<const EqResponse> e;
+{
+std::lock_guard<std::mutex> lock(mutex);
+if (!engine || engine->points() != static_cast<size_t>(points)) {
+EqResponseConfig config;
+config.points = static_cast<size_t>(points);
+engine = std::make_shared<const EqResponse>(config);
+}
+e = engine;
+}
+jsize len = env->GetArrayLength(values);
+jint *value_elements = env->GetIntArrayElements(values, nullptr);
+std::vector<int8_t> v(value_elements, value_elements + len);
+env->ReleaseIntArrayElements(values, value_elements, JNI_ABORT);
+
+std::vector<float> db(e->points());
+e->evaluate(v, db.data());
+jfloatArray result = env->NewFloatArray(points);
+env->SetFloatArrayRegion(result, 0, points, db.data());
+return result;
+}
+
+// The ten band values fitted to an AutoEQ CSV or GraphicEQ export, or null if
+// the text has no curve in it.
+extern "C" JNIEXPORT jintArray JNICALL
+	Java_com_example_freebuds_1flutter_MainActivity_nativeFitCustomEqualizer(
+	JNIEnv *env, jobject thiz, jstring text) {
+static const EqFitter fitter;
+const char *chars = env->GetStringUTFChars(text, nullptr);
+auto target = EqTarget::parse(chars);
+env->ReleaseStringUTFChars(text, chars);
+if (!target)
+return nullptr;
+EqFitResult result = fitter.fit(*target);
+jint values[EqResponse::BANDS];
+for (size_t k = 0; k < EqResponse::BANDS; ++k)
+values[k] = result.values[k];
+jintArray out = env->NewIntArray(EqResponse::BANDS);
+env->SetIntArrayRegion(out, 0, EqResponse::BANDS, values);
+return out;
+}
+
 extern "C" JNIEXPORT jobject JNICALL
 	Java_com_example_freebuds_1flutter_MainActivity_nativeGetDualConnectDevices(
 	JNIEnv *env, jobject thiz, jlong device_ptr) {
@@ -907,3 +1073,59 @@ FakePreset type =
 return get_device(device_ptr)->create_fake_preset(type,
 static_cast<uint8_t>(new_id));
 }
+
+// Fields changed after version 'since' (0 for all) as JSON, with the version to
+// pass next time. "pending" marks fields showing a write that isn't acked yet.
+extern "C" JNIEXPORT jstring JNICALL
+	Java_com_example_freebuds_1flutter_MainActivity_nativeGetStateChanges(
+	JNIEnv *env, jobject thiz, jlong device_ptr, jlong since) {
+if (device_ptr == 0)
+return env->NewStringUTF("{}");
+std::string json = delta_to_json(
+	get_device(device_ptr)->get_state_changes(static_cast<uint64_t>(since)));
+return env->NewStringUTF(json.c_str());
+}
+
+// Which commands each model answers, learned and kept in 'path' (in the app's
+// files dir). Shared by every device; the first call picks the file.
+static std::unique_ptr<CapabilityTable> g_capabilities;
+
+extern "C" JNIEXPORT void JNICALL
+	Java_com_example_freebuds_1flutter_MainActivity_nativeSetCapabilityFile(
+	JNIEnv *env, jobject thiz, jlong device_ptr, jstring path) {
+if (device_ptr == 0)
+return;
+if (!g_capabilities) {
+const char *path_chars = env->GetStringUTFChars(path, nullptr);
+g_capabilities = std::make_unique<CapabilityTable>(std::string(path_chars));
+env->ReleaseStringUTFChars(path, path_chars);
+}
+get_device(device_ptr)->set_capabilities(g_capabilities.get());
+}
+
+// Last-known state of every headset seen, kept in 'path' (in the app's files
+// dir), so the first screen has values before the connect; "restored" marks them
+// until the headset confirms them. Fills the cache from the state saved for
+// 'mac' (the last one saved if empty). Shared by every device; the first call
+// picks the file. Returns false if there was nothing to restore.
+static std::unique_ptr<StateStore> g_state_store;
+
+extern "C" JNIEXPORT jboolean JNICALL
+	Java_com_example_freebuds_1flutter_MainActivity_nativeSetStateFile(
+	JNIEnv *env, jobject thiz, jlong device_ptr, jstring path, jstring mac) {
+if (device_ptr == 0)
+return false;
+if (!g_state_store) {
+const char *path_chars = env->GetStringUTFChars(path, nullptr);
+g_state_store = std::make_unique<StateStore>(std::string(path_chars));
+env->ReleaseStringUTFChars(path, path_chars);
+}
+std::string mac_str;
+if (mac != nullptr) {
+const char *mac_chars = env->GetStringUTFChars(mac, nullptr);
+mac_str = mac_chars;
+env->ReleaseStringUTFChars(mac, mac_chars);
+}
+get_device(device_ptr)->set_state_store(g_state_store.get());
+return get_device(device_ptr)->restore_state(mac_str);
+}
@@ -1,6 +1,7 @@
 package com.example.freebuds_flutter
 
 import android.os.Bundle
+import java.io.File
 import io.flutter.embedding.android.FlutterActivity
 import io.flutter.embedding.engine.FlutterEngine
 import io.flutter.plugin.common.MethodChannel
@@ -57,6 +58,14 @@ class MainActivity: FlutterActivity() {
     private external fun nativeGetDualConnectDevices(devicePtr: Long): List<Map<String, Any>>?
     private external fun nativeDualConnectAction(devicePtr: Long, macAddress: String, actionCode: Int): Boolean
     private external fun createFakePreset(devicePtr: Long, presetType: Int, newId: Int): Boolean
+    private external fun nativeSelectCustomEqualizer(devicePtr: Long, name: String, values: IntArray): Int
+    private external fun nativeStageCustomEqualizer(devicePtr: Long, name: String, values: IntArray): Int
+    private external fun nativeGetEqResponse(values: IntArray, points: Int): FloatArray?
+    private external fun nativeFitCustomEqualizer(text: String): IntArray?
+    private external fun nativeGetStateChanges(devicePtr: Long, since: Long): String
+    private external fun nativeSetDiscoveryFile(path: String)
+    private external fun nativeSetCapabilityFile(devicePtr: Long, path: String)
+    private external fun nativeSetStateFile(devicePtr: Long, path: String, mac: String?): Boolean
 
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
@@ -73,6 +82,10 @@ class MainActivity: FlutterActivity() {
             if (devicePointer != 0L) {
                 useNativeLibrary = true
                 println("✅ Native C++ Device object created successfully. Pointer: $devicePointer")
+                // What the core learns about headsets is kept in the app's files dir.
+                nativeSetDiscoveryFile(File(filesDir, "discovery.tsv").path)
+                nativeSetCapabilityFile(devicePointer, File(filesDir, "capabilities.tsv").path)
+                nativeSetStateFile(devicePointer, File(filesDir, "device_state.bin").path, null)
             } else {
                 println("❌ Native createDevice returned a null pointer.")
             }
@@ -160,6 +173,38 @@ class MainActivity: FlutterActivity() {
                         setProperty(Triple(id, name, values), result) { args -> nativeDeleteCustomEqualizer(devicePointer, args.first, args.second, args.third) }
                     }
                 }
+                "selectCustomEq" -> {
+                    val name = call.argument<String>("name")
+                    val values = call.argument<ArrayList<Int>>("values")?.toIntArray()
+                    setSlot(name, values, result) { n, v -> nativeSelectCustomEqualizer(devicePointer, n, v) }
+                }
+                "stageCustomEq" -> {
+                    val name = call.argument<String>("name")
+                    val values = call.argument<ArrayList<Int>>("values")?.toIntArray()
+                    setSlot(name, values, result) { n, v -> nativeStageCustomEqualizer(devicePointer, n, v) }
+                }
+                "getEqResponse" -> {
+                    val values = call.argument<ArrayList<Int>>("values")?.toIntArray()
+                    val points = call.argument<Int>("points") ?: 512
+                    if (values == null) {
+                        result.error("INVALID_ARGS", "Missing values for the EQ response.", null)
+                    } else {
+                        compute(result) { nativeGetEqResponse(values, points) }
+                    }
+                }
+                "fitCustomEq" -> {
+                    val text = call.argument<String>("text")
+                    if (text == null) {
+                        result.error("INVALID_ARGS", "Missing text to fit.", null)
+                    } else {
+                        compute(result) { nativeFitCustomEqualizer(text) }
+                    }
+                }
+                "getStateChanges" -> {
+                    val since = call.argument<Number>("since")?.toLong() ?: 0L
+                    compute(result) { nativeGetStateChanges(devicePointer, since) }
+                }
+
                 "getDualConnectDevices" -> getProperty(result) { nativeGetDualConnectDevices(devicePointer) }
                 "dualConnectAction" -> {
                     val mac = call.argument<String>("mac")
@@ -271,6 +316,31 @@ class MainActivity: FlutterActivity() {
         }
     }
 
+    // For calls that don't need the headset (the cached state, curve maths).
+    private fun <T> compute(result: MethodChannel.Result, work: () -> T) {
+        CoroutineScope(Dispatchers.Default).launch {
+            val value = work()
+            withContext(Dispatchers.Main) {
+                result.success(value)
+            }
+        }
+    }
+
+    // Slot manager calls answer with the preset id the curve is under, -1 on failure.
+    private fun setSlot(name: String?, values: IntArray?, result: MethodChannel.Result, call: (String, IntArray) -> Int) {
+        if (name == null || values == null) {
+            result.error("INVALID_ARGS", "Missing name or values for the custom EQ.", null)
+            return
+        }
+        if (guardNotConnected(result)) return
+        CoroutineScope(Dispatchers.IO).launch {
+            val id = call(name, values)
+            withContext(Dispatchers.Main) {
+                result.success(id)
+            }
+        }
+    }
+
     private fun <T> setProperty(arg: T?, result: MethodChannel.Result, setter: (T) -> Boolean) {
         if (arg == null ||
             (arg is Pair<*, *> && (arg.first == null || arg.second == null)) ||
@@ -0,0 +1,111 @@
+// Round trips per user action on the common flows: a setting is written, and
+// once its ack is in, the page shows the result. Before, the page re-read the
+// field (or re-enumerated the dual-connect list); now the ack lands in the state
+// cache and a read with max_age is answered from there. Each flow starts from a
+// resynced device on the simulator; also checks that what the cache answers
+// matches a forced re-read.
+//
+//   bench_ack_harvest [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+// Issues the write and returns once it's been acked (or given up on).
+using Write = std::function<void(Device&, const RequestOptions&)>;
+// Reads back what the page shows, as JSON-ish text to compare.
+using Show = std::function<std::string(Device&, const RequestOptions&)>;
+
+struct Flow {
+	const char* name;
+	Write write;
+	Show show;
+};
+
+static std::string describe(const std::optional<AncStatus>& a) {
+	return a ? std::to_string(static_cast<int>(a->mode)) + "/" + std::to_string(static_cast<int>(a->level)) : "-";
+}
+
+static std::string describe(const std::optional<EqualizerInfo>& e) {
+	if (!e) return "-";
+	std::string s = std::to_string(e->current_preset_id) + ":";
+	for (const auto& p : e->custom_presets) s += std::to_string(p.id) + p.name + std::to_string(p.values.size()) + ",";
+	return s;
+}
+
+static std::string describe(const std::vector<DualConnectDevice>& list) {
+	std::string s;
+	for (const auto& d : list) s += d.mac_address + (d.is_connected ? "+" : "-") + (d.is_preferred ? "*" : "") + ",";
+	return s;
+}
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+
+	CustomEqPreset preset{11, "Bass", {30, 25, 15, 5, 0, 0, 0, 5, 10, 10}};
+	std::vector<Flow> flows = {
+		{"ANC level + status",
+		 [](Device& d, const RequestOptions& o) { d.set_anc_level(AncLevel::ULTRA, o); },
+		 [](Device& d, const RequestOptions& o) { return describe(d.get_anc_status(o)); }},
+		{"low latency + status",
+		 [](Device& d, const RequestOptions& o) { d.set_low_latency(true, o); },
+		 [](Device& d, const RequestOptions& o) { return std::to_string(d.get_low_latency_status(o).value_or(false)); }},
+		{"save EQ preset + EQ page",
+		 [&](Device& d, const RequestOptions& o) { d.create_or_update_custom_equalizer(preset, o); },
+		 [](Device& d, const RequestOptions& o) { return describe(d.get_equalizer_info(o)); }},
+		{"disconnect source + list",
+		 [](Device& d, const RequestOptions& o) { d.dual_connect_action("A1B2C3D4E5F6", 2, o); },
+		 [](Device& d, const RequestOptions& o) { return describe(d.get_dual_connect_devices(o)); }},
+		{"set preferred + list",
+		 [](Device& d, const RequestOptions& o) { d.set_dual_connect_preferred("112233445566", o); },
+		 [](Device& d, const RequestOptions& o) { return describe(d.get_dual_connect_devices(o)); }},
+	};
+
+	std::printf("%d rounds, 15 ms link\n", rounds);
+	std::printf("%-26s %12s %12s %12s %12s %8s\n", "flow", "reread_rt", "reread_ms", "harvest_rt", "harvest_ms", "agrees");
+	for (const auto& flow : flows) {
+		double frames[2] = {0, 0}, ms[2] = {0, 0};
+		bool agrees = true;
+		for (int r = 0; r < rounds; ++r) {
+			for (int harvest = 0; harvest < 2; ++harvest) {
+				auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config());
+				auto* sim = client.get();
+				Device device(std::move(client));
+				device.connect("00:00:00:00:00:00");
+				device.resync();
+
+				uint64_t sent_before = sim->frames_sent();
+				auto start = bench::Clock::now();
+				std::promise<RequestStatus> done;
+				RequestOptions write_options;
+				write_options.on_done = [&](RequestStatus status) { done.set_value(status); };
+				flow.write(device, write_options);
+				done.get_future().wait();
+
+				RequestOptions read_options;
+				if (harvest) read_options.max_age = std::chrono::seconds(30);
+				std::string shown = flow.show(device, read_options);
+				ms[harvest] += bench::elapsed_ms(start);
+				frames[harvest] += sim->frames_sent() - sent_before;
+
+				if (harvest) agrees &= shown == flow.show(device, RequestOptions{});
+			}
+		}
+		std::printf("%-26s %12.1f %12.1f %12.1f %12.1f %8s\n", flow.name, frames[0] / rounds, ms[0] / rounds,
+					frames[1] / rounds, ms[1] / rounds, agrees ? "yes" : "NO");
+	}
+	std::printf("(rt: frames sent per action)\n");
+	return 0;
+}
@@ -0,0 +1,67 @@
+// Tail latency of reads over a lossy link: the old fixed 2 s response timeout
+// without retries versus RTT-derived timeouts with retry and backoff.
+//
+//   bench_adaptive_timeout [reads] [loss_percent]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+struct Result {
+	std::vector<double> latencies_ms;
+	int failures = 0;
+	RttStats link;
+};
+
+static Result run(const TimeoutPolicy& policy, int reads, double loss_rate) {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	sim.jitter = std::chrono::milliseconds(5);
+	sim.loss_rate = loss_rate;
+	sim.seed = 7; // Same loss pattern for both policies
+
+	Device device(std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim));
+	device.set_timeout_policy(policy);
+	device.connect("00:00:00:00:00:00");
+
+	Result result;
+	result.latencies_ms.reserve(reads);
+	for (int i = 0; i < reads; ++i) {
+		auto start = bench::Clock::now();
+		if (!device.get_battery_info()) ++result.failures;
+		result.latencies_ms.push_back(bench::elapsed_ms(start));
+	}
+	result.link = device.get_link_rtt_stats();
+	return result;
+}
+
+static void print(const char* name, Result& r) {
+	auto& l = r.latencies_ms;
+	std::printf("%-10s %8.1f %8.1f %8.1f %8.1f %8.1f %9d %9u %8.1f\n", name, bench::percentile(l, 50), bench::percentile(l, 90),
+				bench::percentile(l, 99), bench::percentile(l, 99.9), bench::percentile(l, 100), r.failures, r.link.retries,
+				r.link.timeout_ms);
+}
+
+int main(int argc, char** argv) {
+	int reads = argc > 1 ? std::atoi(argv[1]) : 500;
+	double loss = (argc > 2 ? std::atof(argv[2]) : 5.0) / 100.0;
+
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+
+	std::printf("%d battery reads, %.1f%% response loss, 15 ms +- 5 ms link\n", reads, loss * 100);
+	std::printf("%-10s %8s %8s %8s %8s %8s %9s %9s %8s\n", "policy", "p50_ms", "p90_ms", "p99_ms", "p99.9_ms", "max_ms",
+				"failures", "retries", "rto_ms");
+
+	TimeoutPolicy fixed;
+	fixed.initial = fixed.min = fixed.max = std::chrono::milliseconds(2000);
+	fixed.max_retries = 0;
+	auto fixed_result = run(fixed, reads, loss);
+	print("fixed-2s", fixed_result);
+
+	auto adaptive_result = run(TimeoutPolicy{}, reads, loss);
+	print("adaptive", adaptive_result);
+	return 0;
+}
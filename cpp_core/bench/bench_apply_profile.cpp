@@ -0,0 +1,165 @@
+// Switching between two profiles that differ in all fifteen settings (ANC, EQ
+// preset, wear detection, low latency, sound quality, ten gestures): the setters
+// one at a time, each waiting for its ack as a UI going down a list would, against
+// Device::apply_profile, which writes the differences as one pipelined batch and
+// reads them back. Wall time is also given in link round trips (the simulated
+// 15 ms request-to-answer latency).
+//
+// Cases: every setting known, nothing known (apply_profile reads first), the
+// profile that's already there, and a profile the device can't take (swipe set
+// to an action it has no code for), which has to end with the device back where
+// it was.
+//
+//   bench_apply_profile [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+
+static const double RTT_MS = 15.0;
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+static DeviceProfile profile_a() {
+	DeviceProfile p;
+	p.anc = AncStatus{AncMode::CANCELLATION, AncLevel::ULTRA};
+	p.equalizer_preset = 2;
+	p.wear_detection = false;
+	p.low_latency = true;
+	p.sound_quality = SoundQualityPreference::PRIORITIZE_QUALITY;
+	GestureSettings& g = p.gestures;
+	g.double_tap_left = GestureAction::NEXT_TRACK;
+	g.double_tap_right = GestureAction::PREV_TRACK;
+	g.double_tap_incall = GestureAction::ANSWER_CALL;
+	g.triple_tap_left = GestureAction::PREV_TRACK;
+	g.triple_tap_right = GestureAction::NEXT_TRACK;
+	g.long_tap_left = GestureAction::SWITCH_ANC;
+	g.long_tap_right = GestureAction::SWITCH_ANC;
+	g.long_tap_anc_cycle_left = AncCycleMode::OFF_ON_AWARENESS;
+	g.long_tap_anc_cycle_right = AncCycleMode::ON_AWARENESS;
+	g.swipe_action = GestureAction::CHANGE_VOLUME;
+	return p;
+}
+
+static DeviceProfile profile_b() {
+	DeviceProfile p;
+	p.anc = AncStatus{AncMode::AWARENESS, AncLevel::VOICE_BOOST};
+	p.equalizer_preset = 3;
+	p.wear_detection = true;
+	p.low_latency = false;
+	p.sound_quality = SoundQualityPreference::PRIORITIZE_CONNECTION;
+	GestureSettings& g = p.gestures;
+	g.double_tap_left = GestureAction::PLAY_PAUSE;
+	g.double_tap_right = GestureAction::PLAY_PAUSE;
+	g.double_tap_incall = GestureAction::OFF;
+	g.triple_tap_left = GestureAction::OFF;
+	g.triple_tap_right = GestureAction::OFF;
+	g.long_tap_left = GestureAction::OFF;
+	g.long_tap_right = GestureAction::OFF;
+	g.long_tap_anc_cycle_left = AncCycleMode::OFF_ON;
+	g.long_tap_anc_cycle_right = AncCycleMode::OFF_AWARENESS;
+	g.swipe_action = GestureAction::OFF;
+	return p;
+}
+
+// The fifteen setters, each waiting for the one before it to be acked.
+static void set_one_by_one(Device& d, const DeviceProfile& p) {
+	std::vector<std::function<void(const RequestOptions&)>> setters = {
+		[&](const RequestOptions& o) { d.set_anc_level(p.anc->level, o); },
+		[&](const RequestOptions& o) { d.set_equalizer_preset(*p.equalizer_preset, o); },
+		[&](const RequestOptions& o) { d.set_wear_detection(*p.wear_detection, o); },
+		[&](const RequestOptions& o) { d.set_low_latency(*p.low_latency, o); },
+		[&](const RequestOptions& o) { d.set_sound_quality_preference(*p.sound_quality, o); },
+		[&](const RequestOptions& o) { d.set_double_tap_action(EarSide::LEFT, p.gestures.double_tap_left, o); },
+		[&](const RequestOptions& o) { d.set_double_tap_action(EarSide::RIGHT, p.gestures.double_tap_right, o); },
+		[&](const RequestOptions& o) { d.set_incall_double_tap_action(p.gestures.double_tap_incall, o); },
+		[&](const RequestOptions& o) { d.set_triple_tap_action(EarSide::LEFT, p.gestures.triple_tap_left, o); },
+		[&](const RequestOptions& o) { d.set_triple_tap_action(EarSide::RIGHT, p.gestures.triple_tap_right, o); },
+		[&](const RequestOptions& o) { d.set_long_tap_action(EarSide::LEFT, p.gestures.long_tap_left, o); },
+		[&](const RequestOptions& o) { d.set_long_tap_action(EarSide::RIGHT, p.gestures.long_tap_right, o); },
+		[&](const RequestOptions& o) { d.set_long_tap_anc_cycle(EarSide::LEFT, p.gestures.long_tap_anc_cycle_left, o); },
+		[&](const RequestOptions& o) { d.set_long_tap_anc_cycle(EarSide::RIGHT, p.gestures.long_tap_anc_cycle_right, o); },
+		[&](const RequestOptions& o) { d.set_swipe_action(p.gestures.swipe_action, o); },
+	};
+	for (const auto& set : setters) {
+		auto done = std::make_shared<std::promise<RequestStatus>>();
+		RequestOptions o;
+		o.on_done = [done](RequestStatus status) { done->set_value(status); };
+		set(o);
+		done->get_future().wait();
+	}
+}
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+	std::cerr.setstate(std::ios::badbit); // and the refused write
+
+	std::printf("%d rounds, 15 ms link, 15 settings\n", rounds);
+	std::printf("%-22s %8s %6s %7s %8s %8s %8s %8s %7s\n", "case", "p50_ms", "rtts", "frames", "read_ms", "write_ms", "verify_ms",
+				"undo_ms", "ok");
+
+	DeviceProfile refused = profile_b();
+	refused.gestures.swipe_action = GestureAction::SWITCH_ANC; // Swipe only takes volume or off
+
+	// 'from' is applied in an earlier session. 'known': resync before timing, so
+	// apply_profile has nothing to read first.
+	auto run = [&](const char* name, bool known, const DeviceProfile& from, const DeviceProfile& to, bool setters) {
+		std::vector<double> ms, read, write, verify, undo;
+		uint64_t frames = 0;
+		int ok = 0;
+		for (int r = 0; r < rounds; ++r) {
+			auto headset = std::make_shared<SimulatedHeadset>();
+			auto session = [&] {
+				auto device = std::make_unique<Device>(std::make_unique<SimulatedSppClient>(headset, sim_config()));
+				device->connect("00:00:00:00:00:00");
+				return device;
+			};
+			session()->apply_profile(from);
+
+			auto client = std::make_unique<SimulatedSppClient>(headset, sim_config());
+			auto* sim = client.get();
+			Device device(std::move(client));
+			device.connect("00:00:00:00:00:00");
+			if (known) device.resync();
+
+			uint64_t sent_before = sim->frames_sent();
+			auto start = bench::Clock::now();
+			ProfileReport report;
+			if (setters) set_one_by_one(device, to);
+			else report = device.apply_profile(to);
+			ms.push_back(bench::elapsed_ms(start));
+			frames += sim->frames_sent() - sent_before;
+			read.push_back(report.read_time.count() / 1000.0);
+			write.push_back(report.write_time.count() / 1000.0);
+			verify.push_back(report.verify_time.count() / 1000.0);
+			undo.push_back(report.rollback_time.count() / 1000.0);
+
+			// Where the headset ended up, asked afresh.
+			bool refused_case = &to == &refused;
+			bool there = session()->apply_profile(refused_case ? from : to).written == 0;
+			ok += refused_case ? (there && report.rolled_back && report.status == RequestStatus::REJECTED) : there;
+		}
+		std::printf("%-22s %8.1f %6.1f %7.1f %8.1f %8.1f %8.1f %8.1f %5d/%d\n", name, bench::percentile(ms, 50),
+					bench::percentile(ms, 50) / RTT_MS, static_cast<double>(frames) / rounds, bench::percentile(read, 50),
+					bench::percentile(write, 50), bench::percentile(verify, 50), bench::percentile(undo, 50), ok, rounds);
+	};
+
+	const DeviceProfile a = profile_a(), b = profile_b();
+	run("setters, one by one", true, a, b, true);
+	run("apply_profile", true, a, b, false);
+	run("apply_profile, cold", false, a, b, false);
+	run("already applied", true, b, b, false);
+	run("refused, rolled back", true, a, refused, false);
+	return 0;
+}
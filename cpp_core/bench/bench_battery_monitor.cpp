@@ -0,0 +1,151 @@
+// Radio frames spent keeping the battery display current over a simulated
+// 8-hour day (listening, a charge in the case, listening, idle), fixed-interval
+// polling versus the adaptive BatteryMonitor. Runs on a VirtualClock; the
+// headset pushes CMD_BATTERY_NOTIFY only when a charger comes or goes.
+//
+//   bench_battery_monitor [hours]
+
+#include "bench_util.h"
+#include "core/battery_monitor.h"
+#include "core/clock.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+
+// Fractional levels so slopes aren't tied to the 1% reporting grid.
+static BatteryInfo discharge_curve(double hours) {
+	double day = std::fmod(hours, 8.0);
+	BatteryInfo info;
+	double left, right, case_level;
+	if (day < 3.0) { // Listening, ANC on
+		left = 100 - 15 * day;
+		right = 100 - 17 * day;
+		case_level = 80;
+	} else if (day < 3.5) { // Back in the case
+		double t = day - 3.0;
+		left = std::min(100.0, 55 + 120 * t);
+		right = std::min(100.0, 49 + 120 * t);
+		case_level = 80 - 40 * t;
+		info.is_charging_left = info.is_charging_right = true;
+	} else if (day < 6.0) { // Listening again
+		double t = day - 3.5;
+		left = 100 - 12 * t;
+		right = 100 - 13 * t;
+		case_level = 60;
+	} else { // On the desk, idle
+		double t = day - 6.0;
+		left = 70 - 1 * t;
+		right = 67.5 - 1 * t;
+		case_level = 60;
+	}
+	info.left = static_cast<int>(left);
+	info.right = static_cast<int>(right);
+	info.case_level = static_cast<int>(case_level);
+	info.global = std::min(info.left, info.right);
+	return info;
+}
+
+static int worst_error(const BatteryInfo& shown, const BatteryInfo& truth) {
+	return std::max({std::abs(shown.left - truth.left), std::abs(shown.right - truth.right),
+					 std::abs(shown.case_level - truth.case_level)});
+}
+
+struct Run {
+	double frames_per_hour = 0;
+	double polls_per_hour = 0;
+	int max_error = 0;         // Percent, worst over the run
+	double stale_share = 0;    // Share of seconds the display was off by >= threshold
+};
+
+// Called once per simulated second; returns what the app would show and counts its polls.
+using Strategy = std::function<std::optional<BatteryInfo>(uint64_t& polls)>;
+
+static Run run(double hours, int threshold, const std::function<Strategy(Device&)>& make_strategy) {
+	VirtualClock clock;
+	auto headset = std::make_shared<SimulatedHeadset>();
+	auto client = std::make_unique<SimulatedSppClient>(headset, SimulatorConfig{}, clock);
+	auto* link = client.get();
+	Device device(std::move(client), io_executor(), clock);
+	device.connect("00:00:00:00:00:00");
+
+	BatteryInfo truth = discharge_curve(0);
+	headset->set_battery(truth);
+	Strategy strategy = make_strategy(device); // Declared after the Device, so it goes first
+
+	Run result;
+	uint64_t polls = 0;
+	uint64_t stale_seconds = 0;
+	auto start = clock.now();
+	int64_t seconds = static_cast<int64_t>(hours * 3600);
+	for (int64_t s = 0; s < seconds; ++s) {
+		auto at = start + std::chrono::seconds(s);
+		if (clock.now() < at) clock.advance_to(at);
+
+		BatteryInfo next = discharge_curve(s / 3600.0);
+		bool charger_changed = next.is_charging_left != truth.is_charging_left;
+		truth = next;
+		auto notification = headset->set_battery(truth);
+		if (charger_changed) link->inject(notification);
+
+		auto shown = strategy(polls);
+		int error = shown ? worst_error(*shown, truth) : 100;
+		result.max_error = std::max(result.max_error, error);
+		if (error >= threshold) ++stale_seconds;
+	}
+	result.frames_per_hour = (link->frames_sent() + link->frames_received()) / hours;
+	result.polls_per_hour = polls / hours;
+	result.stale_share = static_cast<double>(stale_seconds) / seconds;
+	return result;
+}
+
+static Run fixed_polling(double hours, int threshold, int period_s) {
+	return run(hours, threshold, [period_s](Device& device) -> Strategy {
+		return [&device, period_s, tick = int64_t(0)](uint64_t& polls) mutable {
+			device.poll_notifications(); // Notifications land in the state cache as well
+			if (tick++ % period_s == 0) {
+				++polls;
+				device.get_battery_info();
+			}
+			return device.get_state().battery.value;
+		};
+	});
+}
+
+static Run adaptive(double hours, int threshold) {
+	return run(hours, threshold, [threshold](Device& device) -> Strategy {
+		BatteryMonitorConfig config;
+		config.report_threshold = threshold;
+		auto monitor = std::make_shared<BatteryMonitor>(device, config);
+		return [monitor](uint64_t& polls) {
+			monitor->tick();
+			polls = monitor->stats().polls;
+			return monitor->latest();
+		};
+	});
+}
+
+static void report(const char* name, const Run& r, double baseline_frames) {
+	std::printf("%-22s %12.1f %11.1f %13.1f %10d %11.2f%%\n", name, r.polls_per_hour, r.frames_per_hour,
+				baseline_frames - r.frames_per_hour, r.max_error, 100.0 * r.stale_share);
+}
+
+int main(int argc, char** argv) {
+	double hours = argc > 1 ? std::atof(argv[1]) : 8.0;
+
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+	std::cerr.setstate(std::ios::badbit);
+
+	for (int threshold : {2, 5}) {
+		std::printf("%.0f h simulated, report threshold %d%%; saved = frames/h below 30 s polling\n", hours, threshold);
+		std::printf("%-22s %12s %11s %13s %10s %12s\n", "strategy", "polls/h", "frames/h", "saved/h", "max_err", "off>=thr");
+		Run baseline = fixed_polling(hours, threshold, 30);
+		report("fixed 30 s", baseline, baseline.frames_per_hour);
+		report("fixed 5 min", fixed_polling(hours, threshold, 300), baseline.frames_per_hour);
+		report("adaptive", adaptive(hours, threshold), baseline.frames_per_hour);
+		std::printf("\n");
+	}
+	return 0;
+}
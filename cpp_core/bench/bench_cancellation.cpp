@@ -0,0 +1,82 @@
+// How long disconnect() takes with a full write queue, and how quickly a read
+// blocked on a silent headset wakes up when its token is cancelled.
+//
+//   bench_cancellation [queued_writes] [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+int main(int argc, char** argv) {
+	int queued = argc > 1 ? std::atoi(argv[1]) : 200;
+	int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+
+	std::printf("%d queued writes per round, %d rounds, 15 ms link\n", queued, rounds);
+	std::printf("%-28s %10s %10s %12s\n", "case", "p50_ms", "max_ms", "frames_sent");
+
+	// Draining the queue is what disconnect used to amount to: every write still went out.
+	std::vector<double> drain_ms, disconnect_ms;
+	uint64_t drain_frames = 0, disconnect_frames = 0;
+	for (int r = 0; r < rounds; ++r) {
+		for (bool cancel : {false, true}) {
+			auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config());
+			auto* sim = client.get();
+			Device device(std::move(client));
+			device.connect("00:00:00:00:00:00");
+			for (int i = 0; i < queued; ++i) device.set_anc_mode(i % 2 ? AncMode::CANCELLATION : AncMode::NORMAL);
+
+			auto start = bench::Clock::now();
+			if (cancel) {
+				device.disconnect();
+				disconnect_ms.push_back(bench::elapsed_ms(start));
+				disconnect_frames += sim->frames_sent();
+			} else {
+				device.connect("00:00:00:00:00:00"); // Waits for the queue like the old disconnect did
+				drain_ms.push_back(bench::elapsed_ms(start));
+				drain_frames += sim->frames_sent();
+			}
+		}
+	}
+	std::printf("%-28s %10.1f %10.1f %12llu\n", "drain queue", bench::percentile(drain_ms, 50),
+				bench::percentile(drain_ms, 100), (unsigned long long)(drain_frames / rounds));
+	std::printf("%-28s %10.1f %10.1f %12llu\n", "disconnect (cancelling)", bench::percentile(disconnect_ms, 50),
+				bench::percentile(disconnect_ms, 100), (unsigned long long)(disconnect_frames / rounds));
+
+	// A read against a headset that never answers, cancelled from another thread after 50 ms.
+	std::vector<double> wake_ms;
+	for (int r = 0; r < rounds; ++r) {
+		SimulatorConfig silent = sim_config();
+		silent.loss_rate = 1.0;
+		Device device(std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), silent));
+		device.connect("00:00:00:00:00:00");
+
+		CancellationSource source;
+		RequestOptions options;
+		options.cancel = source.token();
+		bench::Clock::time_point cancelled_at;
+		std::thread canceller([&] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			cancelled_at = bench::Clock::now();
+			source.cancel();
+		});
+		device.get_battery_info(options);
+		auto woke_at = bench::Clock::now();
+		canceller.join();
+		wake_ms.push_back(std::chrono::duration<double, std::milli>(woke_at - cancelled_at).count());
+	}
+	std::printf("%-28s %10.2f %10.2f %12s\n", "read wake-up after cancel", bench::percentile(wake_ms, 50),
+				bench::percentile(wake_ms, 100), "-");
+	return 0;
+}
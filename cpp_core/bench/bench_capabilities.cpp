@@ -0,0 +1,68 @@
+// Full refresh of a model that doesn't answer the low latency and sound quality
+// reads, as every page open or reconnect does it. Without a capability table
+// each refresh waits out both commands' timeouts and retries; with one, the
+// first refreshes learn it and later ones skip them. The table is saved to a
+// file and a fresh process (a new table loading it) starts out fast.
+//
+//   bench_capabilities [refreshes]
+
+#include "bench_util.h"
+#include "core/capability_table.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include "protocol/huawei_commands.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+static std::shared_ptr<SimulatedHeadset> older_model() {
+	auto headset = std::make_shared<SimulatedHeadset>();
+	headset->drop_support(HuaweiCommands::CMD_LOW_LATENCY_READ);
+	headset->drop_support(HuaweiCommands::CMD_SOUND_QUALITY_READ);
+	return headset;
+}
+
+// One refresh on a new connection: frames sent and ms.
+static std::pair<uint64_t, double> refresh(CapabilityTable* table) {
+	auto client = std::make_unique<SimulatedSppClient>(older_model(), sim_config());
+	auto* sim = client.get();
+	Device device(std::move(client));
+	device.set_capabilities(table);
+	device.connect("00:00:00:00:00:00");
+	auto start = bench::Clock::now();
+	device.resync();
+	return {sim->frames_sent(), bench::elapsed_ms(start)};
+}
+
+int main(int argc, char** argv) {
+	int refreshes = argc > 1 ? std::atoi(argv[1]) : 4;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+	std::cerr.setstate(std::ios::badbit); // and every unanswered one
+
+	const std::string path = "bench_capabilities.tsv";
+	std::remove(path.c_str());
+
+	std::printf("15 ms link, model without low latency / sound quality reads\n");
+	std::printf("%-10s %16s %14s %16s %14s\n", "refresh", "no_table_frames", "no_table_ms", "table_frames", "table_ms");
+	{
+		CapabilityTable table(path);
+		for (int i = 0; i < refreshes; ++i) {
+			auto [plain_frames, plain_ms] = refresh(nullptr);
+			auto [frames, ms] = refresh(&table);
+			std::printf("%-10d %16llu %14.1f %16llu %14.1f\n", i + 1, static_cast<unsigned long long>(plain_frames), plain_ms,
+						static_cast<unsigned long long>(frames), ms);
+		}
+	}
+	CapabilityTable reloaded(path);
+	auto [frames, ms] = refresh(&reloaded);
+	std::printf("%-10s %16s %14s %16llu %14.1f\n", "reloaded", "-", "-", static_cast<unsigned long long>(frames), ms);
+	std::remove(path.c_str());
+	return 0;
+}
@@ -0,0 +1,93 @@
+// Scaling benchmark for DeviceManager: N simulated headsets, each doing a
+// closed loop of battery reads, all multiplexed over the reactor threads.
+//
+//   bench_device_manager [reactor_threads] [reads_per_device]
+
+#include "bench_util.h"
+#include "core/device_manager.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include "protocol/huawei_commands.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+struct DeviceLoop {
+	ConnectionId id = 0;
+	int remaining = 0;
+	bench::Clock::time_point sent_at;
+	std::vector<double> latencies_ms;
+};
+
+int main(int argc, char** argv) {
+	size_t reactor_threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 0;
+	int reads_per_device = argc > 2 ? std::atoi(argv[2]) : 20;
+
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(10);
+	sim.jitter = std::chrono::milliseconds(2);
+
+	std::printf("%8s %8s %10s %12s %12s %10s %10s %10s\n", "devices", "threads", "wall_ms", "cpu_ms/dev",
+				"rss_kb/dev", "p50_ms", "p99_ms", "timeouts");
+
+	for (size_t device_count : {1, 10, 100, 1000}) {
+		uint64_t rss_before = bench::resident_kb();
+		double cpu_before = bench::cpu_time_ms();
+
+		DeviceManagerConfig config;
+		config.reactor_threads = reactor_threads;
+		DeviceManager manager(config);
+
+		std::vector<DeviceLoop> loops(device_count);
+		for (size_t i = 0; i < device_count; ++i) {
+			sim.seed = static_cast<uint32_t>(i + 1);
+			auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim);
+			loops[i].id = manager.add_connection(std::move(client), "00:00:00:00:00:00");
+			loops[i].remaining = reads_per_device;
+			loops[i].latencies_ms.reserve(reads_per_device);
+		}
+
+		std::mutex done_mutex;
+		std::condition_variable done_cond;
+		size_t devices_done = 0;
+		std::atomic<uint64_t> timeouts{0};
+		auto request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_BATTERY_READ, {1, 2, 3});
+
+		// Each completion issues the device's next read from the reactor thread.
+		std::function<void(DeviceLoop&)> issue = [&](DeviceLoop& loop) {
+			loop.sent_at = bench::Clock::now();
+			manager.submit(loop.id, request, HuaweiCommands::CMD_BATTERY_READ,
+						   [&, &loop = loop](std::optional<HuaweiSppPacket> response) {
+							   if (!response) ++timeouts;
+							   loop.latencies_ms.push_back(bench::elapsed_ms(loop.sent_at));
+							   if (--loop.remaining > 0) {
+								   issue(loop);
+								   return;
+							   }
+							   std::lock_guard<std::mutex> lock(done_mutex);
+							   if (++devices_done == loops.size()) done_cond.notify_one();
+						   });
+		};
+
+		auto start = bench::Clock::now();
+		for (auto& loop : loops) issue(loop);
+		{
+			std::unique_lock<std::mutex> lock(done_mutex);
+			done_cond.wait(lock, [&] { return devices_done == loops.size(); });
+		}
+		double wall_ms = bench::elapsed_ms(start);
+		int threads = bench::thread_count();
+		double cpu_ms = bench::cpu_time_ms() - cpu_before;
+		uint64_t rss_after = bench::resident_kb();
+
+		std::vector<double> all;
+		for (auto& loop : loops) all.insert(all.end(), loop.latencies_ms.begin(), loop.latencies_ms.end());
+
+		std::printf("%8zu %8d %10.1f %12.3f %12.2f %10.2f %10.2f %10llu\n", device_count, threads, wall_ms,
+					cpu_ms / device_count, rss_after > rss_before ? double(rss_after - rss_before) / device_count : 0.0,
+					bench::percentile(all, 50), bench::percentile(all, 99), (unsigned long long)timeouts.load());
+	}
+	return 0;
+}
@@ -0,0 +1,95 @@
+// Connect-by-name latency through the DiscoveryCache, against a simulated
+// pairing list that takes 300 ms per lookup (roughly a WinRT enumeration).
+// The simulated connect only succeeds at the address the name is paired at now.
+//
+// Cases: discovery on every connect (as before), the first connect through the
+// cache, repeat connects, a cache reloaded from its file, the headset re-paired
+// at another address (the cached one fails, discovery finds the new one), and
+// the headset unpaired (the entry is dropped).
+//
+//   bench_discovery [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "core/discovery_cache.h"
+#include "platform/simulator/simulated_discovery.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+static const char* NAME = "HUAWEI FreeBuds 6i";
+static const char* CACHE_FILE = "bench_discovery.cache";
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+	std::cerr.setstate(std::ios::badbit); // and the failed lookups
+
+	SimulatedDiscovery discovery(std::chrono::milliseconds(300));
+	Device device(std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>()));
+	auto attempt = [&](const DiscoveredDevice& found, bool) {
+		auto paired = discovery.paired(NAME);
+		return paired && paired->address == found.address && device.connect(found.address);
+	};
+
+	std::printf("%d rounds, 300 ms discovery\n", rounds);
+	std::printf("%-22s %10s %10s %10s %10s\n", "case", "p50_ms", "max_ms", "lookups", "connected");
+	auto run = [&](const char* name, auto&& setup, auto&& connect) {
+		std::vector<double> ms;
+		uint64_t lookups = 0;
+		int connected = 0;
+		for (int r = 0; r < rounds; ++r) {
+			setup();
+			uint64_t before = discovery.lookups();
+			auto start = bench::Clock::now();
+			connected += connect();
+			ms.push_back(bench::elapsed_ms(start));
+			lookups += discovery.lookups() - before;
+			device.disconnect();
+		}
+		std::printf("%-22s %10.1f %10.1f %10.1f %7d/%d\n", name, bench::percentile(ms, 50), bench::percentile(ms, 100),
+					static_cast<double>(lookups) / rounds, connected, rounds);
+	};
+
+	std::remove(CACHE_FILE);
+	auto pair_home = [&] { discovery.pair(NAME, "00:11:22:33:44:55"); };
+	run("discovery every time", pair_home, [&] {
+		auto found = discovery.find_by_name(NAME);
+		return found && attempt(*found, false);
+	});
+
+	std::unique_ptr<DiscoveryCache> cache;
+	run("first connect", [&] {
+		pair_home();
+		std::remove(CACHE_FILE);
+		cache = std::make_unique<DiscoveryCache>(discovery, CACHE_FILE);
+	}, [&] { return cache->connect(NAME, attempt); });
+	run("repeat connect", pair_home, [&] { return cache->connect(NAME, attempt); });
+	run("reloaded from file", [&] {
+		pair_home();
+		cache = std::make_unique<DiscoveryCache>(discovery, CACHE_FILE);
+	}, [&] { return cache->connect(NAME, attempt); });
+
+	int address = 0;
+	run("re-paired elsewhere", [&] {
+		char mac[18];
+		std::snprintf(mac, sizeof(mac), "00:11:22:33:44:%02X", (0x60 + address++) & 0xFF);
+		discovery.pair(NAME, mac);
+	}, [&] { return cache->connect(NAME, attempt); });
+	run("unpaired", [&] {
+		pair_home();
+		cache->connect(NAME, attempt);
+		device.disconnect();
+		discovery.unpair(NAME);
+	}, [&] { return cache->connect(NAME, attempt); });
+
+	DiscoveryStats stats = cache->stats();
+	std::printf("cache: %llu hits, %llu discoveries, %llu fallbacks, %llu evictions; entry left: %s\n",
+				static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.discoveries),
+				static_cast<unsigned long long>(stats.fallbacks), static_cast<unsigned long long>(stats.evictions),
+				cache->entry(NAME) ? "yes" : "no");
+	std::remove(CACHE_FILE);
+	return 0;
+}
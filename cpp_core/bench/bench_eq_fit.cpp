@@ -0,0 +1,136 @@
+// Fitting headphone corrections to the ten bands: a database of AutoEQ-style
+// results (the usual 695-point 20 Hz..20 kHz grid, as CSV text), parsed and
+// fitted one thread at a time and then across every core. The targets are made
+// up of what corrections are made of (bass and treble shelves, a presence
+// region, narrow peaks and dips) at random, so some need more range than ±6 dB
+// and some detail no octave-wide band can follow. Fit error (RMS and worst point
+// in dB, levels matched) is given for the continuous solution rounded and
+// after the integer search, and for targets that are themselves a ten-band
+// curve, which should come back as the same values.
+//
+//   bench_eq_fit [targets]
+
+#include "bench_util.h"
+#include "core/eq_fit.h"
+#include "core/thread_pool.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <thread>
+
+static std::vector<double> autoeq_grid() {
+	std::vector<double> hz;
+	for (double f = 20; f <= 20000; f *= 1.01) hz.push_back(std::round(f * 100) / 100);
+	return hz;
+}
+
+// A peaking bump in dB: 'gain' at 'center', falling off over 'octaves'.
+static double bump(double hz, double center, double gain, double octaves) {
+	double x = std::log2(hz / center) / octaves;
+	return gain * std::exp(-x * x);
+}
+
+static double shelf(double hz, double corner, double gain, bool low) {
+	double x = std::log2(hz / corner) * 3;
+	double s = 1 / (1 + std::exp(low ? x : -x));
+	return gain * s;
+}
+
+static std::string make_csv(const std::vector<double>& hz, const std::vector<double>& db) {
+	std::ostringstream out;
+	out << "frequency,raw,error,smoothed,error_smoothed,equalization,parametric_eq,fixed_band_eq,equalized_raw\n";
+	for (size_t i = 0; i < hz.size(); ++i) {
+		out << hz[i] << ",0.0,0.0,0.0,0.0," << db[i] << ",0.0,0.0,0.0\n";
+	}
+	return out.str();
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000;
+	auto hz = autoeq_grid();
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<double> unit(0, 1);
+
+	// Half made-up corrections, half exact ten-band curves with known values.
+	std::vector<std::string> csv;
+	std::vector<std::vector<int8_t>> exact;
+	EqResponse truth(EqResponseConfig{hz.size(), hz.front(), hz.back()});
+	for (size_t t = 0; t < count; ++t) {
+		std::vector<double> db(hz.size());
+		if (t % 2 == 0) {
+			double bass = unit(rng) * 12 - 4, treble = unit(rng) * 10 - 6, presence = unit(rng) * 8 - 4;
+			double peak_hz = 2000 * std::pow(2.0, unit(rng) * 3), peak = unit(rng) * 10 - 5;
+			for (size_t i = 0; i < hz.size(); ++i) {
+				db[i] = shelf(hz[i], 120, bass, true) + shelf(hz[i], 7000, treble, false) + bump(hz[i], 3000, presence, 1.2) +
+						bump(hz[i], peak_hz, peak, 0.15);
+			}
+		} else {
+			std::vector<int8_t> values;
+			for (size_t k = 0; k < EqResponse::BANDS; ++k) values.push_back(static_cast<int8_t>(rng() % 121 - 60));
+			std::vector<float> response(hz.size());
+			truth.evaluate(values, response.data());
+			for (size_t i = 0; i < hz.size(); ++i) db[i] = response[i] + 3; // Another level
+			exact.push_back(values);
+		}
+		csv.push_back(make_csv(hz, db));
+	}
+
+	auto start = bench::Clock::now();
+	std::vector<EqTarget> targets;
+	for (const auto& text : csv) targets.push_back(*EqTarget::parse(text));
+	double parse_ms = bench::elapsed_ms(start);
+
+	EqFitter fitter;
+	EqFitConfig rounded_only;
+	rounded_only.refine_passes = 0;
+	rounded_only.relinearize = 0;
+	EqFitter rounding(rounded_only);
+
+	start = bench::Clock::now();
+	std::vector<EqFitResult> serial;
+	for (const auto& target : targets) serial.push_back(fitter.fit(target));
+	double serial_ms = bench::elapsed_ms(start);
+
+	ThreadPool pool;
+	start = bench::Clock::now();
+	auto parallel = fitter.fit_all(targets, pool);
+	double parallel_ms = bench::elapsed_ms(start);
+
+	std::vector<EqFitResult> rounded;
+	for (const auto& target : targets) rounded.push_back(rounding.fit(target));
+
+	auto report = [&](const char* name, const std::vector<EqFitResult>& results, size_t parity) {
+		std::vector<double> rms, worst;
+		for (size_t i = parity; i < results.size(); i += 2) {
+			rms.push_back(results[i].rms_db);
+			worst.push_back(results[i].max_db);
+		}
+		std::printf("%-34s %9.3f %9.3f %9.3f %9.3f\n", name, bench::percentile(rms, 50), bench::percentile(rms, 90),
+					bench::percentile(worst, 50), bench::percentile(worst, 90));
+	};
+
+	std::printf("%zu targets (%zu points each), %zu cores\n", count, hz.size(), pool.size());
+	std::printf("%-34s %9s %9s %9s %9s\n", "fit error (dB)", "rms_p50", "rms_p90", "max_p50", "max_p90");
+	report("corrections, rounded", rounded, 0);
+	report("corrections, integer search", serial, 0);
+	report("ten-band curves, rounded", rounded, 1);
+	report("ten-band curves, integer search", serial, 1);
+
+	size_t same = 0, recovered = 0, clipped = 0;
+	for (size_t i = 0; i < count; ++i) {
+		same += serial[i].values == parallel[i].values;
+		clipped += i % 2 == 0 && serial[i].clipped;
+		if (i % 2 == 1) recovered += std::equal(exact[i / 2].begin(), exact[i / 2].end(), serial[i].values.begin());
+	}
+	std::printf("ten-band curves recovered exactly: %zu/%zu; corrections needing full range: %zu/%zu\n", recovered, count / 2,
+				clipped, (count + 1) / 2);
+	std::printf("parallel = serial: %zu/%zu\n", same, count);
+
+	std::printf("%-34s %9s %12s\n", "step", "ms", "us_per_target");
+	std::printf("%-34s %9.1f %12.2f\n", "parse CSV", parse_ms, parse_ms * 1000 / count);
+	std::printf("%-34s %9.1f %12.2f\n", "fit, one thread", serial_ms, serial_ms * 1000 / count);
+	std::printf("%-34s %9.1f %12.2f\n", "fit_all, every core", parallel_ms, parallel_ms * 1000 / count);
+	return 0;
+}
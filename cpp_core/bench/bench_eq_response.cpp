@@ -0,0 +1,76 @@
+// Drawing custom EQ curves: the ten-band response on a 512-point log grid, as the
+// EQ editor needs every frame while a slider is dragged. Curves per second (and
+// microseconds per curve, and the share of a 60 fps frame) on each instruction set this CPU and build have, for
+// random curves with every band set. Each is checked against the response worked
+// out in double precision straight from the biquads (largest error in dB).
+//
+//   bench_eq_response [points] [curves]
+
+#include "bench_util.h"
+#include "core/eq_response.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// 20 log10 |H| of the cascade at 'hz', from the transfer functions.
+static double reference_db(const std::array<Biquad, EqResponse::BANDS>& bands, double hz, double sample_rate) {
+	std::complex<double> z1 = std::polar(1.0, -2 * 3.14159265358979323846 * hz / sample_rate);
+	std::complex<double> z2 = z1 * z1;
+	std::complex<double> h = 1.0;
+	for (const Biquad& q : bands) h *= (q.b0 + q.b1 * z1 + q.b2 * z2) / (1.0 + q.a1 * z1 + q.a2 * z2);
+	return 20 * std::log10(std::abs(h));
+}
+
+int main(int argc, char** argv) {
+	EqResponseConfig config;
+	if (argc > 1) config.points = std::strtoul(argv[1], nullptr, 10);
+	size_t count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+
+	EqResponse engine(config);
+	std::mt19937 rng(11);
+	std::vector<std::vector<int8_t>> curves(256);
+	for (auto& values : curves) {
+		for (size_t b = 0; b < EqResponse::BANDS; ++b) values.push_back(static_cast<int8_t>(rng() % 121 - 60));
+		if (values[0] == 0) values[0] = 1;
+	}
+
+	std::printf("%zu points, %zu curves, best here: %s\n", engine.points(), count, simd_level_name(engine.simd_level()));
+	std::printf("%-8s %14s %12s %10s %14s %12s\n", "isa", "curves_per_s", "us_per_curve", "vs_scalar", "frame_budget_%",
+				"max_err_db");
+
+	std::vector<float> db(engine.points());
+	double scalar_us = 0;
+	double checksum = 0; // Printed, so the timed work can't be optimized away
+	for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::NEON, SimdLevel::AVX2}) {
+		if (!EqResponse::supports(level)) continue; // Not on this CPU or in this build
+
+		double err = 0;
+		for (const auto& values : curves) {
+			engine.evaluate(values, db.data(), level);
+			auto bands = engine.biquads(values);
+			for (size_t i = 0; i < engine.points(); ++i) {
+				err = std::max(err, std::abs(db[i] - reference_db(bands, engine.frequencies()[i], config.sample_rate)));
+			}
+		}
+
+		std::vector<double> rounds;
+		for (int r = 0; r < 5; ++r) {
+			auto start = bench::Clock::now();
+			for (size_t i = 0; i < count; ++i) {
+				engine.evaluate(curves[i % curves.size()], db.data(), level);
+				checksum += db[i % db.size()];
+			}
+			rounds.push_back(bench::elapsed_ms(start));
+		}
+		double us = bench::percentile(rounds, 50) * 1000 / count;
+		if (level == SimdLevel::SCALAR) scalar_us = us;
+		std::printf("%-8s %14.0f %12.2f %9.1fx %14.3f %12.5f\n", simd_level_name(level), 1e6 / us, us, scalar_us / us,
+					us / (1e6 / 60) * 100, err);
+	}
+	std::printf("checksum %.1f\n", checksum);
+	return 0;
+}
@@ -0,0 +1,117 @@
+// Switching between custom EQ curves, the way the EQ page does it today against
+// EqSlots: saving the curve (ten bands and its name) every time and re-reading
+// the equalizer info to show it, versus a one-byte set_equalizer_preset for a
+// curve the headset keeps already. Per switch: latency, and bytes on the wire
+// each way (frames included), over the simulated 15 ms link.
+//
+// Cases: three curves after stage(); the same without staging (each curve saved
+// on first use); four curves over three slots in turn, so every switch evicts
+// (the worst case); and a random pick over those four, mostly the three latest.
+//
+//   bench_eq_slots [switches]
+
+#include "bench_util.h"
+#include "core/eq_slots.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <random>
+
+static std::vector<CustomEqPreset> curves() {
+	return {
+		{0, "Bass", {40, 30, 20, 10, 0, 0, 0, 0, 0, 0}},
+		{0, "Vocal", {-10, -5, 0, 10, 20, 20, 10, 0, -5, -10}},
+		{0, "Treble", {0, 0, 0, 0, 0, 10, 20, 30, 40, 40}},
+		{0, "Loudness", {30, 20, 0, -10, -10, -10, 0, 10, 20, 30}},
+	};
+}
+
+struct Result {
+	std::vector<double> ms;
+	double sent = 0, received = 0, frames = 0;
+	int ok = 0;
+};
+
+static void print(const char* name, Result& r, int switches) {
+	std::printf("%-26s %8.1f %8.1f %10.1f %10.1f %8.2f %5d/%d\n", name, bench::percentile(r.ms, 50), bench::percentile(r.ms, 99),
+				r.sent / switches, r.received / switches, r.frames / switches, r.ok, switches);
+}
+
+int main(int argc, char** argv) {
+	int switches = argc > 1 ? std::atoi(argv[1]) : 60;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+	std::printf("%d switches, 15 ms link (p50/p99 ms, bytes and frames per switch)\n", switches);
+	std::printf("%-26s %8s %8s %10s %10s %8s %7s\n", "case", "p50_ms", "p99_ms", "bytes_out", "bytes_in", "frames", "ok");
+
+	const auto all = curves();
+	// 'pick' chooses the curve of each switch; 'slots' runs it through EqSlots.
+	auto run = [&](const char* name, std::function<size_t(int)> pick, bool slots, bool staged) {
+		auto headset = std::make_shared<SimulatedHeadset>();
+		auto client = std::make_unique<SimulatedSppClient>(headset);
+		auto* sim = client.get();
+		Device device(std::move(client));
+		device.connect("00:00:00:00:00:00");
+		device.get_equalizer_info();
+		EqSlots eq(device);
+		if (staged) eq.stage({all[0], all[1], all[2]});
+
+		Result r;
+		for (int i = 0; i < switches; ++i) {
+			const CustomEqPreset& curve = all[pick(i)];
+			uint64_t sent = sim->bytes_sent(), received = sim->bytes_received(), frames = sim->frames_sent();
+			auto start = bench::Clock::now();
+			bool shown;
+			if (slots) {
+				auto id = eq.select(curve);
+				shown = id && device.snapshot()->equalizer.shown()->current_preset_id == *id;
+			} else {
+				// The EQ page: save over its one custom id, wait for the ack, re-read to show it.
+				auto done = std::make_shared<std::promise<RequestStatus>>();
+				RequestOptions o;
+				o.on_done = [done](RequestStatus status) { done->set_value(status); };
+				CustomEqPreset preset = curve;
+				preset.id = 254;
+				device.create_or_update_custom_equalizer(preset, o);
+				shown = done->get_future().get() == RequestStatus::OK;
+				auto info = device.get_equalizer_info();
+				shown = shown && info && info->current_preset_id == 254;
+			}
+			r.ms.push_back(bench::elapsed_ms(start));
+			r.sent += sim->bytes_sent() - sent;
+			r.received += sim->bytes_received() - received;
+			r.frames += sim->frames_sent() - frames;
+			r.ok += shown;
+		}
+		print(name, r, switches);
+		return eq.stats();
+	};
+
+	auto three = [](int i) { return static_cast<size_t>(i % 3); };
+	auto four = [](int i) { return static_cast<size_t>(i % 4); };
+	std::mt19937 rng(3);
+	std::vector<size_t> recent{0, 1, 2}; // The three latest, oldest first
+	auto local = [&](int) {
+		// One in ten switches goes to the curve that isn't among them.
+		size_t next = rng() % 10 == 0 ? 6 - recent[0] - recent[1] - recent[2] : recent[rng() % 3];
+		recent.erase(std::remove(recent.begin(), recent.end(), next), recent.end());
+		if (recent.size() == 3) recent.erase(recent.begin());
+		recent.push_back(next);
+		return next;
+	};
+
+	run("save + re-read (today)", three, false, false);
+	run("EqSlots, staged", three, true, true);
+	auto cold = run("EqSlots, not staged", three, true, false);
+	auto thrash = run("EqSlots, 4 curves round", four, true, false);
+	auto mixed = run("EqSlots, 4 curves mixed", local, true, false);
+	std::printf("uploads / evictions: not staged %llu/%llu, 4 curves round %llu/%llu, mixed %llu/%llu\n",
+				static_cast<unsigned long long>(cold.uploads), static_cast<unsigned long long>(cold.evictions),
+				static_cast<unsigned long long>(thrash.uploads), static_cast<unsigned long long>(thrash.evictions),
+				static_cast<unsigned long long>(mixed.uploads), static_cast<unsigned long long>(mixed.evictions));
+	return 0;
+}
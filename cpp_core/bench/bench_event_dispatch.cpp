@@ -0,0 +1,129 @@
+// Cost of fanning one pushed frame out to 1..64 subscribers: the RCU dispatcher
+// handing every subscriber the same shared event, against a mutex-guarded vector
+// of callbacks each given its own copy (what a naive handler list would do). The
+// last column repeats the RCU run while another thread keeps subscribing and
+// unsubscribing. Last, pushed dual-connect change events go through a whole
+// Device (reader, decoding, dispatch) from the simulator, which sends them with
+// only the address and new state.
+//
+//   bench_event_dispatch [events]
+
+#include "bench_util.h"
+#include "core/clock.h"
+#include "core/device.h"
+#include "core/device_events.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include "protocol/huawei_commands.h"
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+// A battery notification as Device::handle_notification would build it.
+static DeviceEvent make_event() {
+	DeviceEvent event;
+	event.type = DeviceEvents::BATTERY;
+	event.frame = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_BATTERY_NOTIFY, 2, {55, 60, 80});
+	event.frame.parameters[3] = {0, 0, 1};
+	BatteryInfo info;
+	info.left = 55;
+	info.right = 60;
+	info.case_level = 80;
+	info.is_charging_case = true;
+	event.battery = info;
+	return event;
+}
+
+// The baseline: every dispatch takes the lock and copies the event per subscriber.
+class LockedHandlers {
+ public:
+  void add(std::function<void(const DeviceEvent&)> handler) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_handlers.push_back(std::move(handler));
+  }
+  void dispatch(const DeviceEvent& event) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& handler : m_handlers) {
+      DeviceEvent copy = event;
+      handler(copy);
+    }
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::vector<std::function<void(const DeviceEvent&)>> m_handlers;
+};
+
+static volatile int g_sink = 0;
+
+// Frames pushed, polled and decoded by a Device, against events delivered with the device named.
+static void run_device(int events) {
+	VirtualClock clock;
+	auto headset = std::make_shared<SimulatedHeadset>();
+	auto client = std::make_unique<SimulatedSppClient>(headset, SimulatorConfig{}, clock);
+	auto* link = client.get();
+	Device device(std::move(client), io_executor(), clock);
+	device.connect("00:00:00:00:00:00");
+
+	int delivered = 0, named = 0;
+	device.subscribe(DeviceEvents::DUAL_CONNECT, [&](const std::shared_ptr<const DeviceEvent>& e) {
+		++delivered;
+		named += e->dual_connect && e->dual_connect->mac_address == "11:22:33:44:55:66";
+	});
+	auto start = bench::Clock::now();
+	for (int i = 0; i < events; ++i) {
+		link->inject(headset->set_dual_connect("11:22:33:44:55:66", i % 2 == 0));
+		device.poll_notifications();
+	}
+	double ns = bench::elapsed_ms(start) * 1e6 / events;
+	std::printf("dual-connect change events through a Device: %d/%d delivered, %d named the device, %.0f ns/event\n",
+				delivered, events, named, ns);
+}
+
+int main(int argc, char** argv) {
+	int events = argc > 1 ? std::atoi(argv[1]) : 200000;
+	std::cout.setstate(std::ios::badbit);
+
+	const DeviceEvent prototype = make_event();
+
+	std::printf("%d events per run\n", events);
+	std::printf("%12s %14s %14s %16s %14s\n", "subscribers", "rcu_ns/event", "locked_ns/event", "rcu+churn_ns", "churn_ops");
+	for (int subscribers : {1, 2, 4, 8, 16, 32, 64}) {
+		EventDispatcher dispatcher;
+		LockedHandlers locked;
+		for (int i = 0; i < subscribers; ++i) {
+			dispatcher.subscribe(DeviceEvents::BATTERY,
+								 [](const std::shared_ptr<const DeviceEvent>& e) { g_sink = g_sink + e->battery->left; });
+			locked.add([](const DeviceEvent& e) { g_sink = g_sink + e.battery->left; });
+		}
+
+		// One allocation per frame, as handle_notification does.
+		auto start = bench::Clock::now();
+		for (int i = 0; i < events; ++i) dispatcher.dispatch(std::make_shared<const DeviceEvent>(prototype));
+		double rcu_ns = bench::elapsed_ms(start) * 1e6 / events;
+
+		start = bench::Clock::now();
+		for (int i = 0; i < events; ++i) locked.dispatch(prototype);
+		double locked_ns = bench::elapsed_ms(start) * 1e6 / events;
+
+		std::atomic<bool> done{false};
+		uint64_t churn = 0;
+		std::thread churner([&] {
+			while (!done.load()) {
+				uint64_t id = dispatcher.subscribe(DeviceEvents::ANC, [](const std::shared_ptr<const DeviceEvent>&) {});
+				dispatcher.unsubscribe(id);
+				++churn;
+			}
+		});
+		start = bench::Clock::now();
+		for (int i = 0; i < events; ++i) dispatcher.dispatch(std::make_shared<const DeviceEvent>(prototype));
+		double churn_ns = bench::elapsed_ms(start) * 1e6 / events;
+		done = true;
+		churner.join();
+
+		std::printf("%12d %14.1f %14.1f %16.1f %14llu\n", subscribers, rcu_ns, locked_ns, churn_ns,
+					static_cast<unsigned long long>(churn));
+	}
+	std::cerr.setstate(std::ios::badbit);
+	run_device(events / 20);
+	return 0;
+}
@@ -0,0 +1,135 @@
+// Thread count, context switches and reconnect latency with the old
+// thread-per-CommandWriter model versus writers running as strands, on the
+// shared I/O pool (the default) and on a work-stealing pool sized to the cores,
+// where a write waiting for its ack holds up the other devices' writes.
+//
+//   bench_executor [devices] [writes_per_device] [reconnects_per_device]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "core/blocking_pool.h"
+#include "core/thread_pool.h"
+#include "core/thread_safe_queue.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include "protocol/huawei_commands.h"
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+// What CommandWriter used to be: one dedicated std::thread per connection,
+// spawned on every connect and joined on every reconnect.
+class LegacyWriter {
+ public:
+  explicit LegacyWriter(IBluetoothSPPClient& client) : m_client(client) {
+	  m_thread = std::thread([this] {
+		  std::function<void()> task;
+		  while (m_queue.wait_and_pop(task)) task();
+	  });
+  }
+  ~LegacyWriter() {
+	  m_queue.stop();
+	  if (m_thread.joinable()) m_thread.join();
+  }
+  void set_anc_mode(AncMode mode) {
+	  auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_ANC_WRITE, 1, {static_cast<uint8_t>(mode), 0xFF});
+	  m_queue.push([this, request] {
+		  if (m_client.send(request.to_bytes())) m_client.receive_all(); // Blocks until the link goes quiet
+	  });
+  }
+
+ private:
+  IBluetoothSPPClient& m_client;
+  ThreadSafeQueue<std::function<void()>> m_queue;
+  std::thread m_thread;
+};
+
+struct LegacyDevice {
+	std::unique_ptr<IBluetoothSPPClient> client;
+	std::unique_ptr<LegacyWriter> writer;
+	bool connect() {
+		if (!client->connect("00:00:00:00:00:00", 1)) return false;
+		writer = std::make_unique<LegacyWriter>(*client);
+		return true;
+	}
+};
+
+struct Result {
+	int threads = 0;
+	uint64_t context_switches = 0;
+	double write_ms = 0;
+	std::vector<double> reconnect_ms;
+};
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(2);
+	sim.receive_timeout = std::chrono::milliseconds(5);
+	return sim;
+}
+
+template<typename DeviceT, typename Connect, typename Write, typename Drain>
+static Result run(std::vector<DeviceT>& devices, int writes, int reconnects, Connect connect, Write write, Drain drain) {
+	Result result;
+	for (auto& d : devices) connect(d);
+
+	uint64_t cs_before = bench::context_switches();
+	auto start = bench::Clock::now();
+	for (int i = 0; i < writes; ++i) {
+		for (auto& d : devices) write(d, i);
+	}
+	result.threads = bench::thread_count();
+	for (auto& d : devices) drain(d);
+	result.write_ms = bench::elapsed_ms(start);
+	result.context_switches = bench::context_switches() - cs_before;
+
+	for (int r = 0; r < reconnects; ++r) {
+		for (auto& d : devices) {
+			auto t = bench::Clock::now();
+			connect(d);
+			result.reconnect_ms.push_back(bench::elapsed_ms(t));
+		}
+	}
+	return result;
+}
+
+static void print(const char* name, Result& r) {
+	std::printf("%-22s %8d %14llu %10.1f %14.3f %14.3f\n", name, r.threads, (unsigned long long)r.context_switches,
+				r.write_ms, bench::percentile(r.reconnect_ms, 50), bench::percentile(r.reconnect_ms, 99));
+}
+
+int main(int argc, char** argv) {
+	size_t device_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50;
+	int writes = argc > 2 ? std::atoi(argv[2]) : 10;
+	int reconnects = argc > 3 ? std::atoi(argv[3]) : 20;
+
+	std::printf("%zu devices, %d writes each, %d reconnects each\n", device_count, writes, reconnects);
+	std::printf("%-22s %8s %14s %10s %14s %14s\n", "model", "threads", "ctx_switches", "write_ms",
+				"reconnect_p50", "reconnect_p99");
+
+	{
+		std::vector<LegacyDevice> devices(device_count);
+		for (auto& d : devices) d.client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config());
+		auto result = run(devices, writes, reconnects,
+						  [](LegacyDevice& d) { d.connect(); },
+						  [](LegacyDevice& d, int i) { d.writer->set_anc_mode(i % 2 ? AncMode::CANCELLATION : AncMode::NORMAL); },
+						  [](LegacyDevice& d) { d.writer.reset(); });
+		print("thread-per-writer", result);
+	}
+
+	for (int cpu = 0; cpu < 2; ++cpu) {
+		// Fresh pools, so neither run counts the other's threads.
+		std::unique_ptr<IExecutor> executor;
+		if (cpu) executor = std::make_unique<ThreadPool>();
+		else executor = std::make_unique<BlockingPool>();
+		std::vector<std::unique_ptr<Device>> devices;
+		for (size_t i = 0; i < device_count; ++i) {
+			devices.push_back(std::make_unique<Device>(std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config()), *executor));
+		}
+		auto result = run(devices, writes, reconnects,
+						  [](std::unique_ptr<Device>& d) { d->connect("00:00:00:00:00:00"); },
+						  [](std::unique_ptr<Device>& d, int i) { d->set_anc_mode(i % 2 ? AncMode::CANCELLATION : AncMode::NORMAL); },
+						  [](std::unique_ptr<Device>& d) { d->connect("00:00:00:00:00:00"); }); // Reconnect waits for queued writes
+		print(cpu ? "cpu pool + strands" : "io pool + strands", result);
+	}
+	return 0;
+}
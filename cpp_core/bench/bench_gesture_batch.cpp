@@ -0,0 +1,106 @@
+// Frames and time to apply a full gesture layout (ten writes over five
+// commands): one frame per write as before, writes merged as they queue up
+// behind the one in flight, and everything inside a Device::WriteBatch. Timed
+// until the last write is acked; then checks that a forced read of the gestures
+// gives what it gives after one frame per write (some actions share a code, so
+// it doesn't read back as the layout itself).
+//
+//   bench_gesture_batch [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <optional>
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+static GestureSettings layout() {
+	GestureSettings g;
+	g.double_tap_left = GestureAction::NEXT_TRACK;
+	g.double_tap_right = GestureAction::PREV_TRACK;
+	g.double_tap_incall = GestureAction::ANSWER_CALL;
+	g.triple_tap_left = GestureAction::PREV_TRACK;
+	g.triple_tap_right = GestureAction::NEXT_TRACK;
+	g.long_tap_left = GestureAction::SWITCH_ANC;
+	g.long_tap_right = GestureAction::SWITCH_ANC;
+	g.long_tap_anc_cycle_left = AncCycleMode::OFF_ON_AWARENESS;
+	g.long_tap_anc_cycle_right = AncCycleMode::ON_AWARENESS;
+	g.swipe_action = GestureAction::CHANGE_VOLUME;
+	return g;
+}
+
+// Every setter in the layout, each given its own options.
+static void apply(Device& d, const GestureSettings& g, const std::function<RequestOptions()>& options) {
+	d.set_double_tap_action(EarSide::LEFT, g.double_tap_left, options());
+	d.set_double_tap_action(EarSide::RIGHT, g.double_tap_right, options());
+	d.set_incall_double_tap_action(g.double_tap_incall, options());
+	d.set_triple_tap_action(EarSide::LEFT, g.triple_tap_left, options());
+	d.set_triple_tap_action(EarSide::RIGHT, g.triple_tap_right, options());
+	d.set_long_tap_action(EarSide::LEFT, g.long_tap_left, options());
+	d.set_long_tap_action(EarSide::RIGHT, g.long_tap_right, options());
+	d.set_long_tap_anc_cycle(EarSide::LEFT, g.long_tap_anc_cycle_left, options());
+	d.set_long_tap_anc_cycle(EarSide::RIGHT, g.long_tap_anc_cycle_right, options());
+	d.set_swipe_action(g.swipe_action, options());
+}
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+
+	std::printf("%d rounds, 15 ms link, 10 writes\n", rounds);
+	std::printf("%-22s %10s %10s %12s %8s\n", "case", "p50_ms", "max_ms", "frames_sent", "same");
+	const GestureSettings wanted = layout();
+	std::optional<GestureSettings> reference;
+	for (int mode = 0; mode < 3; ++mode) {
+		std::vector<double> ms;
+		uint64_t frames = 0;
+		int applied = 0;
+		for (int r = 0; r < rounds; ++r) {
+			auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config());
+			auto* sim = client.get();
+			Device device(std::move(client));
+			device.connect("00:00:00:00:00:00");
+			device.resync();
+
+			std::vector<std::future<RequestStatus>> acks;
+			auto options = [&] {
+				auto done = std::make_shared<std::promise<RequestStatus>>();
+				acks.push_back(done->get_future());
+				RequestOptions o;
+				o.force = true;
+				o.on_done = [done](RequestStatus status) { done->set_value(status); };
+				// One frame per write: wait for the previous ack before the next write.
+				if (mode == 0 && acks.size() > 1) acks[acks.size() - 2].wait();
+				return o;
+			};
+
+			uint64_t sent_before = sim->frames_sent();
+			auto start = bench::Clock::now();
+			if (mode == 2) {
+				auto batch = device.batch_writes();
+				apply(device, wanted, options);
+			} else {
+				apply(device, wanted, options);
+			}
+			for (auto& ack : acks) ack.wait();
+			ms.push_back(bench::elapsed_ms(start));
+			frames += sim->frames_sent() - sent_before;
+			auto read_back = device.get_all_gesture_settings();
+			if (!reference) reference = read_back;
+			applied += read_back == reference;
+		}
+		static const char* names[] = {"one frame per write", "merged while queued", "WriteBatch"};
+		std::printf("%-22s %10.1f %10.1f %12.1f %5d/%d\n", names[mode], bench::percentile(ms, 50), bench::percentile(ms, 100),
+					static_cast<double>(frames) / rounds, applied, rounds);
+	}
+	return 0;
+}
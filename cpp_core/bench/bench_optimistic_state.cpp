@@ -0,0 +1,87 @@
+// How long after a toggle the UI shows the new value: a UI thread polls the
+// published state and sees it either when the write is acked (the confirmed
+// value) or as soon as it's queued (the pending overlay). The last case drops
+// the link first, so the write times out and the overlay is rolled back; it
+// times how long the wrong value stays up and checks the ROLLBACK event.
+//
+//   bench_optimistic_state [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+// Spins on the published state until 'shows' holds; returns ms since 'start'.
+template <typename Shows>
+static double until(Device& device, bench::Clock::time_point start, Shows&& shows) {
+	while (!shows(*device.snapshot())) std::this_thread::yield();
+	return bench::elapsed_ms(start);
+}
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+	std::cerr.setstate(std::ios::badbit); // and the timed-out write
+
+	std::printf("%d rounds, 15 ms link\n", rounds);
+	std::printf("%-24s %14s %14s %14s\n", "case", "confirmed_ms", "shown_ms", "rolled_back_ms");
+
+	std::vector<double> confirmed[2], shown[2], rolled_back;
+	int rollback_events = 0, restored = 0;
+	for (int r = 0; r < rounds; ++r) {
+		for (int c = 0; c < 3; ++c) {
+			auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config());
+			auto* sim = client.get();
+			Device device(std::move(client));
+			device.connect("00:00:00:00:00:00");
+			device.resync();
+			std::atomic<bool> rollback{false};
+			device.subscribe(DeviceEvents::ROLLBACK, [&](const std::shared_ptr<const DeviceEvent>&) { rollback = true; });
+
+			bool before = device.get_state().low_latency.value.value_or(false);
+			if (c == 2) sim->drop_link();
+			auto start = bench::Clock::now();
+			if (c == 1) {
+				AncLevel level = AncLevel::ULTRA;
+				device.set_anc_level(level);
+				shown[1].push_back(until(device, start, [&](const DeviceState& s) {
+					return s.anc.shown() && s.anc.shown()->level == level;
+				}));
+				confirmed[1].push_back(until(device, start, [&](const DeviceState& s) {
+					return !s.anc.pending && s.anc.value && s.anc.value->level == level;
+				}));
+				continue;
+			}
+			device.set_low_latency(!before);
+			double seen = until(device, start, [&](const DeviceState& s) { return s.low_latency.shown() == !before; });
+			if (c == 0) {
+				shown[0].push_back(seen);
+				confirmed[0].push_back(until(device, start, [&](const DeviceState& s) {
+					return !s.low_latency.pending && s.low_latency.value == !before;
+				}));
+			} else {
+				rolled_back.push_back(until(device, start, [&](const DeviceState& s) { return !s.low_latency.pending; }));
+				device.disconnect();
+				rollback_events += rollback;
+				restored += device.get_state().low_latency.shown() == before;
+			}
+		}
+	}
+	std::printf("%-24s %14.2f %14.3f %14s\n", "low latency toggle", bench::percentile(confirmed[0], 50),
+				bench::percentile(shown[0], 50), "-");
+	std::printf("%-24s %14.2f %14.3f %14s\n", "ANC level", bench::percentile(confirmed[1], 50), bench::percentile(shown[1], 50),
+				"-");
+	std::printf("%-24s %14s %14s %14.2f\n", "toggle, link dropped", "-", "-", bench::percentile(rolled_back, 50));
+	std::printf("(p50) rollback events: %d/%d, confirmed value restored: %d/%d\n", rollback_events, rounds, restored, rounds);
+	return 0;
+}
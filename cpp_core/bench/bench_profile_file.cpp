@@ -0,0 +1,131 @@
+// Loading a fleet's profile file: 10k profiles with every setting (ANC, EQ
+// preset and two custom presets, all gestures, toggles, preferred device).
+// Timed: writing it, opening and checking it (map, walk every record, check every
+// hash), finding a profile by name, and decoding them all. The check is set
+// against copying the same bytes once with memcpy, i.e. what the memory allows.
+// Then: every profile decodes to what was written, and a file with one byte
+// flipped is refused.
+//
+//   bench_profile_file [profiles] [rounds]
+
+#include "bench_util.h"
+#include "core/profile_file.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static const char* FILE_NAME = "bench_profiles.bin";
+
+static bool same(const DeviceProfile& a, const DeviceProfile& b) {
+	return a.anc == b.anc && a.equalizer_preset == b.equalizer_preset && a.custom_presets == b.custom_presets &&
+		   a.gestures == b.gestures && a.wear_detection == b.wear_detection && a.low_latency == b.low_latency &&
+		   a.sound_quality == b.sound_quality && a.dual_connect_enabled == b.dual_connect_enabled &&
+		   a.preferred_device == b.preferred_device;
+}
+
+static std::vector<NamedProfile> make_profiles(size_t count) {
+	std::mt19937 rng(7);
+	auto pick = [&](int n) { return static_cast<int>(rng() % n); };
+	std::vector<NamedProfile> profiles(count);
+	for (size_t i = 0; i < count; ++i) {
+		NamedProfile& named = profiles[i];
+		named.name = "site-" + std::to_string(i / 100) + "/desk-" + std::to_string(i);
+		DeviceProfile& p = named.profile;
+		p.anc = AncStatus{AncMode::CANCELLATION, static_cast<AncLevel>(pick(4))};
+		p.equalizer_preset = static_cast<uint8_t>(1 + pick(3));
+		for (uint8_t id : {uint8_t(7), uint8_t(8)}) {
+			CustomEqPreset preset{id, "Custom " + std::to_string(id), {}};
+			for (int band = 0; band < 10; ++band) preset.values.push_back(static_cast<int8_t>(pick(121) - 60));
+			p.custom_presets.push_back(preset);
+		}
+		GestureSettings& g = p.gestures;
+		g.double_tap_left = g.double_tap_right = static_cast<GestureAction>(pick(4));
+		g.double_tap_incall = GestureAction::ANSWER_CALL;
+		g.triple_tap_left = g.triple_tap_right = GestureAction::NEXT_TRACK;
+		g.long_tap_left = g.long_tap_right = GestureAction::SWITCH_ANC;
+		g.long_tap_anc_cycle_left = g.long_tap_anc_cycle_right = static_cast<AncCycleMode>(pick(4));
+		g.swipe_action = GestureAction::CHANGE_VOLUME;
+		p.wear_detection = pick(2) == 1;
+		p.low_latency = pick(2) == 1;
+		p.sound_quality = static_cast<SoundQualityPreference>(pick(2));
+		p.dual_connect_enabled = true;
+		char mac[13];
+		std::snprintf(mac, sizeof(mac), "0011223344%02X", pick(256));
+		p.preferred_device = std::string(mac);
+	}
+	return profiles;
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+	int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+	std::cerr.setstate(std::ios::badbit); // The damaged file is refused with a message
+
+	auto profiles = make_profiles(count);
+	auto start = bench::Clock::now();
+	if (!ProfileFile::write(FILE_NAME, profiles)) return 1;
+	double write_ms = bench::elapsed_ms(start);
+
+	std::vector<double> check, copy, find, decode;
+	size_t bytes = 0;
+	for (int r = 0; r < rounds; ++r) {
+		start = bench::Clock::now();
+		ProfileFile file(FILE_NAME);
+		check.push_back(bench::elapsed_ms(start));
+		if (!file.valid() || file.size() != count) return 1;
+		bytes = file.bytes();
+
+		// The same bytes, copied once: every page of the mapping is resident by now.
+		auto mapped = MappedFile::open(FILE_NAME);
+		std::vector<uint8_t> buffer(bytes);
+		start = bench::Clock::now();
+		std::memcpy(buffer.data(), mapped->data(), bytes);
+		copy.push_back(bench::elapsed_ms(start));
+
+		start = bench::Clock::now();
+		auto found = file.find(profiles.back().name);
+		find.push_back(bench::elapsed_ms(start));
+		if (!found) return 1;
+
+		start = bench::Clock::now();
+		size_t decoded = 0;
+		for (size_t i = 0; i < file.size(); ++i) decoded += file.profile(i).custom_presets.size();
+		decode.push_back(bench::elapsed_ms(start));
+		if (decoded != 2 * count) return 1;
+	}
+
+	double mb = bytes / 1e6;
+	std::printf("%zu profiles, %.2f MB, %.1f bytes each, %d rounds (p50)\n", count, mb, static_cast<double>(bytes) / count, rounds);
+	std::printf("%-26s %10s %10s\n", "step", "ms", "GB/s");
+	std::printf("%-26s %10.3f %10s\n", "write", write_ms, "-");
+	std::printf("%-26s %10.3f %10.2f\n", "open + check", bench::percentile(check, 50), mb / bench::percentile(check, 50));
+	std::printf("%-26s %10.3f %10.2f\n", "memcpy of the same bytes", bench::percentile(copy, 50), mb / bench::percentile(copy, 50));
+	std::printf("%-26s %10.3f %10s\n", "find last by name", bench::percentile(find, 50), "-");
+	std::printf("%-26s %10.3f %10s\n", "decode all", bench::percentile(decode, 50), "-");
+
+	ProfileFile file(FILE_NAME);
+	size_t round_trip = 0, hashes = 0;
+	for (size_t i = 0; i < file.size(); ++i) {
+		round_trip += file.name(i) == profiles[i].name && same(file.profile(i), profiles[i].profile);
+		hashes += file.hash(i) == ProfileFile::hash_of(profiles[i].profile);
+	}
+	std::printf("decoded as written: %zu/%zu, hashes match: %zu/%zu\n", round_trip, count, hashes, count);
+
+	std::vector<char> damaged;
+	{
+		std::ifstream in(FILE_NAME, std::ios::binary);
+		damaged.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	damaged[damaged.size() / 2] ^= 0x10;
+	{
+		std::ofstream out(FILE_NAME, std::ios::binary | std::ios::trunc);
+		out.write(damaged.data(), damaged.size());
+	}
+	std::printf("one byte flipped: %s\n", ProfileFile(FILE_NAME).valid() ? "accepted (!)" : "refused");
+	std::remove(FILE_NAME);
+	return 0;
+}
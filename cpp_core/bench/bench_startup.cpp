@@ -0,0 +1,115 @@
+// Time from process start to the first state the UI can draw (a battery level),
+// and to a fully confirmed state. Each round runs this binary again as a child,
+// timed from just before it's spawned: once with no state file, where the first
+// state is the first read after connecting, and once restoring from the file
+// saved by an earlier session, where it's whatever was saved (stale, marked
+// restored) and the device info isn't read again. Both connect with the warmup on.
+//
+//   bench_startup [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "core/state_store.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+static const char* STATE_FILE = "bench_startup.state";
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+static int64_t now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(bench::Clock::now().time_since_epoch()).count();
+}
+
+static double ms_since(int64_t ns) { return (now_ns() - ns) / 1e6; }
+
+template <typename Done>
+static void until(Device& device, Done&& done) {
+	auto start = bench::Clock::now();
+	while (!done(*device.snapshot()) && bench::elapsed_ms(start) < 10000) std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+// One startup, timed from 'spawned_ns'. Prints: first state since spawn, first
+// state since main(), all confirmed since spawn, frames sent.
+static int child(bool restore, int64_t spawned_ns) {
+	int64_t main_ns = now_ns();
+	std::unique_ptr<StateStore> store;
+	if (restore) store = std::make_unique<StateStore>(STATE_FILE);
+
+	auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config());
+	auto* sim = client.get();
+	Device device(std::move(client));
+	device.set_warmup(WarmupOptions{});
+	if (store) {
+		device.set_state_store(store.get());
+		device.restore_state();
+	} else {
+		device.connect("00:00:00:00:00:00");
+	}
+	until(device, [](const DeviceState& s) { return s.battery.value.has_value(); });
+	double first_ms = ms_since(spawned_ns), first_in_process_ms = ms_since(main_ns);
+
+	if (store) device.connect("00:00:00:00:00:00");
+	until(device, [](const DeviceState& s) { return s.stale_fields() == 0; });
+	double all_ms = ms_since(spawned_ns);
+	device.set_state_store(nullptr); // Keep the file as the parent saved it
+	std::printf("%f %f %f %llu\n", first_ms, first_in_process_ms, all_ms, static_cast<unsigned long long>(sim->frames_sent()));
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+	if (argc > 3 && std::string(argv[1]) == "--child") return child(std::string(argv[2]) == "restore", std::atoll(argv[3]));
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+
+	// An earlier session: connect, read everything, save on the way out.
+	{
+		std::remove(STATE_FILE);
+		StateStore store(STATE_FILE);
+		Device device(std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config()));
+		device.set_state_store(&store);
+		device.connect("00:00:00:00:00:00");
+		device.resync();
+		device.disconnect();
+	}
+
+	std::printf("%d rounds, 15 ms link, warmup on\n", rounds);
+	std::printf("%-12s %14s %20s %14s %12s\n", "case", "first_ms", "first_in_process_ms", "all_ms", "frames_sent");
+	for (const char* mode : {"cold", "restore"}) {
+		std::vector<double> first, first_in_process, all;
+		unsigned long long frames = 0;
+		for (int r = 0; r < rounds; ++r) {
+			std::string command = std::string("\"") + argv[0] + "\" --child " + mode + " " + std::to_string(now_ns());
+			FILE* out = popen(command.c_str(), "r");
+			if (!out) return 1;
+			double f = 0, fp = 0, a = 0;
+			unsigned long long n = 0;
+			if (std::fscanf(out, "%lf %lf %lf %llu", &f, &fp, &a, &n) == 4) {
+				first.push_back(f);
+				first_in_process.push_back(fp);
+				all.push_back(a);
+				frames += n;
+			}
+			pclose(out);
+		}
+		if (first.empty()) continue;
+		std::printf("%-12s %14.3f %20.3f %14.1f %12.1f\n", mode, bench::percentile(first, 50), bench::percentile(first_in_process, 50),
+					bench::percentile(all, 50), static_cast<double>(frames) / first.size());
+	}
+	std::remove(STATE_FILE);
+	return 0;
+}
@@ -0,0 +1,95 @@
+// What a bridge pays per refresh: every field re-read and confirmed (as resync
+// does), then either the whole state marshalled as JSON, or only the delta
+// since the version it last forwarded. Battery moves every few refreshes, ANC
+// and the dual-connect list now and then, the rest never. Also times diff()
+// between two snapshots on its own.
+//
+//   bench_state_diff [refreshes]
+
+#include "bench_util.h"
+#include "core/state_json.h"
+#include <cstdlib>
+
+static EqualizerInfo make_equalizer() {
+	EqualizerInfo eq;
+	eq.current_preset_id = 3;
+	eq.built_in_preset_ids = {1, 2, 3, 9};
+	for (uint8_t id = 10; id < 13; ++id) {
+		eq.custom_presets.push_back({id, "Custom " + std::to_string(id), {-6, -3, 0, 2, 4, 4, 2, 0, -2, -4}});
+	}
+	return eq;
+}
+
+static std::vector<DualConnectDevice> make_devices(bool phone_playing) {
+	return {
+		{"AA:BB:CC:DD:EE:01", "Pixel 8", true, phone_playing, true, true},
+		{"AA:BB:CC:DD:EE:02", "ThinkPad X1", true, !phone_playing, false, true},
+	};
+}
+
+int main(int argc, char** argv) {
+	int refreshes = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+	DeviceInfo info{"FreeBuds Pro 3", "T0018", "1.0.0.180", "ABC123456789", "L123", "R123"};
+	EqualizerInfo equalizer = make_equalizer();
+	GestureSettings gestures;
+	gestures.double_tap_left = GestureAction::PLAY_PAUSE;
+	gestures.double_tap_right = GestureAction::NEXT_TRACK;
+	gestures.swipe_action = GestureAction::CHANGE_VOLUME;
+
+	DeviceState state;
+	uint64_t forwarded = 0; // Version the bridge last sent on
+	size_t full_bytes = 0, delta_bytes = 0, changed_fields = 0;
+	double confirm_ms = 0, full_ms = 0, delta_ms = 0;
+	DeviceState previous;
+	double diff_ms = 0;
+	volatile uint32_t sink = 0;
+
+	for (int i = 0; i < refreshes; ++i) {
+		BatteryInfo battery;
+		battery.left = 100 - (i / 3) % 100;
+		battery.right = 100 - (i / 4) % 100;
+		battery.case_level = 80;
+		AncStatus anc{(i / 50) % 2 ? AncMode::CANCELLATION : AncMode::AWARENESS, AncLevel::NORMAL_CANCELLATION};
+
+		auto start = bench::Clock::now();
+		state.confirm(state.device_info, info);
+		state.confirm(state.battery, battery);
+		state.confirm(state.anc, anc);
+		state.confirm(state.wear_detection, true);
+		state.confirm(state.low_latency, false);
+		state.confirm(state.sound_quality, SoundQualityPreference::PRIORITIZE_QUALITY);
+		state.confirm(state.equalizer, equalizer);
+		state.confirm(state.gestures, gestures);
+		state.confirm(state.dual_connect, make_devices((i / 100) % 2 == 0));
+		confirm_ms += bench::elapsed_ms(start);
+
+		start = bench::Clock::now();
+		std::string full = state_to_json(state);
+		full_ms += bench::elapsed_ms(start);
+		full_bytes += full.size();
+
+		start = bench::Clock::now();
+		StateDelta delta = state.delta_since(forwarded);
+		std::string json = delta_to_json(delta);
+		delta_ms += bench::elapsed_ms(start);
+		delta_bytes += json.size();
+		forwarded = delta.version;
+		for (uint32_t m = delta.changed; m; m &= m - 1) ++changed_fields;
+
+		start = bench::Clock::now();
+		sink = sink + DeviceState::diff(previous, state);
+		diff_ms += bench::elapsed_ms(start);
+		previous = state;
+	}
+
+	std::printf("%d refreshes, %.2f fields changed per refresh\n", refreshes, static_cast<double>(changed_fields) / refreshes);
+	std::printf("%-22s %12s %14s\n", "", "us/refresh", "bytes/refresh");
+	std::printf("%-22s %12.3f %14s\n", "confirm 9 fields", confirm_ms * 1000.0 / refreshes, "-");
+	std::printf("%-22s %12.3f %14s\n", "diff two snapshots", diff_ms * 1000.0 / refreshes, "-");
+	std::printf("%-22s %12.3f %14.1f\n", "full state json", full_ms * 1000.0 / refreshes,
+				static_cast<double>(full_bytes) / refreshes);
+	std::printf("%-22s %12.3f %14.1f\n", "delta json", delta_ms * 1000.0 / refreshes,
+				static_cast<double>(delta_bytes) / refreshes);
+	return 0;
+}
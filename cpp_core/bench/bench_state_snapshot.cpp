@@ -0,0 +1,136 @@
+// Read latency of the device state from UI threads while the I/O thread keeps
+// updating it: the RcuCell the Device publishes through, against the mutex it
+// used to take. Readers look at a couple of fields per read; the writer
+// confirms a new battery level and publishes a fresh copy, as Device does.
+// Latencies are per read, timed over batches of BATCH reads.
+//
+//   bench_state_snapshot [milliseconds per run]
+
+#include "bench_util.h"
+#include "core/device_state.h"
+#include "core/rcu_cell.h"
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+static constexpr int BATCH = 16;
+
+static DeviceState make_state() {
+	DeviceState state;
+	state.confirm(state.device_info, DeviceInfo{"FreeBuds Pro 3", "T0018", "1.0.0.180", "ABC123456789", "L123", "R123"});
+	state.confirm(state.anc, AncStatus{AncMode::CANCELLATION, AncLevel::DYNAMIC});
+	EqualizerInfo eq;
+	eq.built_in_preset_ids = {1, 2, 3, 9};
+	eq.custom_presets.push_back({10, "Custom", {-6, -3, 0, 2, 4, 4, 2, 0, -2, -4}});
+	state.confirm(state.equalizer, eq);
+	state.confirm(state.dual_connect, std::vector<DualConnectDevice>{{"AA:BB:CC:DD:EE:01", "Pixel 8", true, true, true, true}});
+	return state;
+}
+
+struct Result {
+	double p50 = 0, p99 = 0, max = 0;
+	uint64_t updates = 0;
+};
+
+// 'read' returns something derived from the state so it can't be optimised away.
+template <typename Read, typename Update>
+static Result run(int readers, int updates_per_s, int ms, Read&& read, Update&& update) {
+	std::atomic<bool> done{false};
+	std::atomic<int> ready{0};
+	std::vector<std::vector<double>> samples(readers);
+	std::vector<std::thread> threads;
+	std::atomic<int> sink{0};
+	for (int r = 0; r < readers; ++r) {
+		threads.emplace_back([&, r] {
+			samples[r].reserve(1 << 20);
+			int local = 0;
+			++ready;
+			while (!done.load(std::memory_order_relaxed)) {
+				auto start = bench::Clock::now();
+				for (int i = 0; i < BATCH; ++i) local += read();
+				samples[r].push_back(std::chrono::duration<double, std::nano>(bench::Clock::now() - start).count() / BATCH);
+			}
+			sink += local;
+		});
+	}
+	while (ready.load() < readers) std::this_thread::yield();
+
+	Result result;
+	auto start = bench::Clock::now();
+	auto end = start + std::chrono::milliseconds(ms);
+	while (bench::Clock::now() < end) {
+		if (updates_per_s == 0) {
+			std::this_thread::sleep_until(end);
+			break;
+		}
+		update(static_cast<int>(result.updates % 100));
+		++result.updates;
+		if (updates_per_s > 0) {
+			std::this_thread::sleep_until(start + std::chrono::microseconds(result.updates * 1000000 / updates_per_s));
+		}
+	}
+	done = true;
+	for (auto& t : threads) t.join();
+
+	std::vector<double> all;
+	for (auto& s : samples) all.insert(all.end(), s.begin(), s.end());
+	result.p50 = bench::percentile(all, 50);
+	result.p99 = bench::percentile(all, 99);
+	result.max = all.empty() ? 0 : all.back();
+	return result;
+}
+
+int main(int argc, char** argv) {
+	int ms = argc > 1 ? std::atoi(argv[1]) : 500;
+
+	std::printf("%-8s %-9s %10s %10s %10s %12s   %10s %10s %10s %12s\n", "readers", "updates/s", "rcu_p50", "rcu_p99",
+				"rcu_max", "rcu_updates", "mtx_p50", "mtx_p99", "mtx_max", "mtx_updates");
+	for (int readers : {1, 2, 4}) {
+		// 0: no writer; -1: as fast as the writer can go.
+		for (int rate : {0, 1000, 100000, -1}) {
+			DeviceState base = make_state();
+
+			DeviceState rcu_working = base;
+			std::mutex rcu_writer;
+			RcuCell<DeviceState> cell(std::make_unique<const DeviceState>(base));
+			Result rcu = run(
+				readers, rate, ms,
+				[&] {
+					auto state = cell.read();
+					return state->battery.value ? state->battery.value->left : static_cast<int>(state->generation);
+				},
+				[&](int level) {
+					std::lock_guard<std::mutex> lock(rcu_writer);
+					BatteryInfo battery;
+					battery.left = level;
+					rcu_working.confirm(rcu_working.battery, battery);
+					cell.publish(std::make_unique<const DeviceState>(rcu_working));
+				});
+
+			DeviceState locked = base;
+			std::mutex mutex;
+			Result mtx = run(
+				readers, rate, ms,
+				[&] {
+					std::lock_guard<std::mutex> lock(mutex);
+					return locked.battery.value ? locked.battery.value->left : static_cast<int>(locked.generation);
+				},
+				[&](int level) {
+					std::lock_guard<std::mutex> lock(mutex);
+					BatteryInfo battery;
+					battery.left = level;
+					locked.confirm(locked.battery, battery);
+				});
+
+			char label[16];
+			if (rate < 0) std::snprintf(label, sizeof(label), "max");
+			else std::snprintf(label, sizeof(label), "%d", rate);
+			std::printf("%-8d %-9s %10.1f %10.1f %10.1f %12llu   %10.1f %10.1f %10.1f %12llu\n", readers, label, rcu.p50,
+						rcu.p99, rcu.max, static_cast<unsigned long long>(rcu.updates), mtx.p50, mtx.p99, mtx.max,
+						static_cast<unsigned long long>(mtx.updates));
+		}
+	}
+	std::printf("(ns per read)\n");
+	return 0;
+}
@@ -0,0 +1,109 @@
+// Recovery time after scripted link drops: how long the supervisor takes to
+// notice a silently dead link, reconnect and resync the stale state, compared
+// with re-reading everything after a plain reconnect.
+//
+//   bench_supervisor [drops]
+
+#include "bench_util.h"
+#include "core/connection_supervisor.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <bitset>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+static double full_read_ms(Device& device) {
+	auto start = bench::Clock::now();
+	device.get_device_info();
+	device.get_battery_info();
+	device.get_anc_status();
+	device.get_wear_detection_status();
+	device.get_low_latency_status();
+	device.get_sound_quality_preference();
+	device.get_equalizer_info();
+	device.get_all_gesture_settings();
+	device.get_dual_connect_devices();
+	return bench::elapsed_ms(start);
+}
+
+int main(int argc, char** argv) {
+	int drops = argc > 1 ? std::atoi(argv[1]) : 10;
+
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	sim.jitter = std::chrono::milliseconds(3);
+	sim.connect_time = std::chrono::milliseconds(30);
+	auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim);
+	auto* link = client.get();
+	Device device(std::move(client));
+	device.connect("00:00:00:00:00:00");
+
+	// Baseline: what a reconnect cost when the app had to read everything again.
+	double full_ms = full_read_ms(device);
+
+	SupervisorConfig config;
+	config.idle_interval = std::chrono::milliseconds(100);
+	ConnectionSupervisor supervisor(device, "00:00:00:00:00:00", 1, config);
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	uint64_t resyncs = 0;
+	supervisor.set_event_handler([&](LinkEvent event) {
+		if (event != LinkEvent::RESYNCED) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		++resyncs;
+		cond.notify_all();
+	});
+	supervisor.start();
+
+	std::vector<double> total_ms, detection_ms, recovery_ms, fields;
+	for (int i = 0; i < drops; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		if (i % 2) device.set_anc_mode(i % 4 == 1 ? AncMode::CANCELLATION : AncMode::NORMAL); // Leaves ANC stale
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		uint64_t before;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			before = resyncs;
+		}
+		bool out_of_range = i == drops - 1; // Last round: headset gone for a while, exercises the backoff
+		auto dropped_at = bench::Clock::now();
+		if (out_of_range) link->set_reachable(false);
+		link->drop_link();
+		if (out_of_range) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+			link->set_reachable(true);
+		}
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&] { return resyncs > before; });
+		}
+		if (out_of_range) continue; // Not part of the drop -> recovered numbers
+
+		total_ms.push_back(bench::elapsed_ms(dropped_at));
+		auto stats = supervisor.stats();
+		detection_ms.push_back(stats.last_detection_ms);
+		recovery_ms.push_back(stats.last_recovery_ms);
+		fields.push_back(static_cast<double>(std::bitset<32>(stats.last_resync_fields).count()));
+	}
+	auto stats = supervisor.stats();
+	supervisor.stop();
+
+	std::printf("%d scripted drops on a 15 ms link, 30 ms connect, probes after 100 ms idle\n", drops);
+	std::printf("%-36s %10s %10s\n", "", "p50", "max");
+	std::printf("%-36s %10.1f %10.1f\n", "drop -> resynced (ms)", bench::percentile(total_ms, 50), bench::percentile(total_ms, 100));
+	std::printf("%-36s %10.1f %10.1f\n", "last frame -> declared dead (ms)", bench::percentile(detection_ms, 50), bench::percentile(detection_ms, 100));
+	std::printf("%-36s %10.1f %10.1f\n", "reconnect + resync (ms)", bench::percentile(recovery_ms, 50), bench::percentile(recovery_ms, 100));
+	std::printf("%-36s %10.1f %10.1f\n", "fields resynced (of 9)", bench::percentile(fields, 50), bench::percentile(fields, 100));
+	std::printf("%-36s %10.1f\n", "full re-read after reconnect (ms)", full_ms);
+	std::printf("probes %llu (missed %llu), reconnect attempts %llu for %llu reconnects\n",
+				(unsigned long long)stats.probes_sent, (unsigned long long)stats.probes_missed,
+				(unsigned long long)stats.reconnect_attempts, (unsigned long long)stats.reconnects);
+	return 0;
+}
@@ -0,0 +1,99 @@
+// Footprint and throughput of the telemetry store: a week of 1 Hz samples per
+// metric (battery curves, ANC mode, dual-connect source, link RTT), compared
+// with keeping them as a vector of {time, value} structs, then range queries
+// with and without downsampling.
+//
+//   bench_telemetry [days] [queries]
+
+#include "bench_util.h"
+#include "core/telemetry_store.h"
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+struct Series {
+	const char* name;
+	MetricId metric;
+	std::vector<int64_t> values; // One per second
+};
+
+static std::vector<Series> make_week(int64_t seconds) {
+	std::mt19937 rng(3);
+	std::normal_distribution<double> jitter(0.0, 6.0);
+	std::vector<Series> all = {
+		{"battery_left", TelemetryMetrics::BATTERY_LEFT, {}},
+		{"battery_case", TelemetryMetrics::BATTERY_CASE, {}},
+		{"anc_mode", TelemetryMetrics::ANC_MODE, {}},
+		{"dual_connect", TelemetryMetrics::DUAL_CONNECT, {}},
+		{"link_rtt", TelemetryMetrics::LINK_RTT, {}},
+	};
+	for (auto& s : all) s.values.reserve(seconds);
+	for (int64_t t = 0; t < seconds; ++t) {
+		double hour = std::fmod(t / 3600.0, 24.0);
+		// Drains 15%/h for 5 h a day, otherwise charges back up in the case.
+		double left = hour < 5.0 ? 100 - 15 * hour : std::min(100.0, 25 + 60 * (hour - 5.0));
+		all[0].values.push_back(static_cast<int64_t>(left));
+		all[1].values.push_back(static_cast<int64_t>(90 - 2 * std::fmod(t / 86400.0, 1.0) * 30));
+		all[2].values.push_back((t / 1800) % 3);                  // Mode changes every half hour
+		all[3].values.push_back((t / 7200) % 2 ? 0xE5F6 : 0x5566); // Source switches every two hours
+		all[4].values.push_back(150 + static_cast<int64_t>(std::lround(std::abs(jitter(rng))))); // 15 ms +- jitter, 0.1 ms units
+	}
+	return all;
+}
+
+int main(int argc, char** argv) {
+	double days = argc > 1 ? std::atof(argv[1]) : 7.0;
+	int queries = argc > 2 ? std::atoi(argv[2]) : 2000;
+	int64_t seconds = static_cast<int64_t>(days * 86400);
+
+	auto week = make_week(seconds);
+
+	TelemetryConfig config;
+	config.memory_cap = 64 << 20; // Measure the footprint, don't evict
+	TelemetryStore store(config);
+
+	std::printf("%.1f days of 1 Hz samples per metric (%lld samples each)\n", days, static_cast<long long>(seconds));
+	std::printf("%-14s %12s %12s %14s %12s\n", "metric", "store_kb", "bytes/sample", "vector_kb", "append_ns");
+	for (const auto& series : week) {
+		size_t before = store.stats().memory_bytes;
+		auto start = bench::Clock::now();
+		for (int64_t t = 0; t < seconds; ++t) store.append(series.metric, t * 1000, series.values[t]);
+		double ns = std::chrono::duration<double, std::nano>(bench::Clock::now() - start).count() / seconds;
+		size_t bytes = store.stats().memory_bytes - before;
+		std::printf("%-14s %12.1f %12.3f %14.1f %12.1f\n", series.name, bytes / 1024.0, static_cast<double>(bytes) / seconds,
+					seconds * sizeof(TelemetrySample) / 1024.0, ns);
+	}
+	TelemetryStats stats = store.stats();
+	std::printf("total: %zu segments, %.1f KiB (%.1f KiB encoded)\n\n", stats.segments, stats.memory_bytes / 1024.0,
+				stats.encoded_bytes / 1024.0);
+
+	// Random windows of an hour to a full day, as a history chart would ask for them.
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<int64_t> window_s(3600, 86400);
+	std::printf("%-28s %12s %14s %14s\n", "query", "us/query", "points/query", "Msamples/s");
+	auto run_queries = [&](const char* name, MetricId metric, size_t max_points, Downsample mode) {
+		uint64_t points = 0, scanned = 0;
+		auto start = bench::Clock::now();
+		for (int i = 0; i < queries; ++i) {
+			int64_t length = window_s(rng);
+			int64_t from = std::uniform_int_distribution<int64_t>(0, std::max<int64_t>(0, seconds - length))(rng);
+			points += store.query(metric, from * 1000, (from + length) * 1000, max_points, mode).size();
+			scanned += length;
+		}
+		double ms = bench::elapsed_ms(start);
+		std::printf("%-28s %12.1f %14.1f %14.1f\n", name, ms * 1000.0 / queries, static_cast<double>(points) / queries,
+					scanned / (ms * 1000.0));
+	};
+	run_queries("battery raw", TelemetryMetrics::BATTERY_LEFT, 0, Downsample::LAST);
+	run_queries("battery 300 points, mean", TelemetryMetrics::BATTERY_LEFT, 300, Downsample::MEAN);
+	run_queries("rtt 300 points, max", TelemetryMetrics::LINK_RTT, 300, Downsample::MAX);
+
+	auto start = bench::Clock::now();
+	auto dwell = store.dwell_times(TelemetryMetrics::ANC_MODE, 0, seconds * 1000);
+	double dwell_ms = bench::elapsed_ms(start);
+	size_t switches = store.transitions(TelemetryMetrics::DUAL_CONNECT, 0, seconds * 1000);
+	std::printf("\nANC dwell over the whole range: %.2f ms;", dwell_ms);
+	for (const auto& [mode, ms] : dwell) std::printf(" mode %lld %.1f h", static_cast<long long>(mode), ms / 3.6e6);
+	std::printf("; %zu source switches\n", switches);
+	return 0;
+}
@@ -0,0 +1,147 @@
+// Scheduling, cancelling and firing 1M timers on the hierarchical timer wheel
+// versus an ordered multimap (what a naive deadline queue would be), driven by
+// a manual VirtualClock so the run takes as long as the bookkeeping does.
+// Also counts heap allocations on the arm/cancel/re-arm paths.
+//
+//   bench_timer_wheel [timers] [max_delay_ms]
+
+#include "bench_util.h"
+#include "core/clock.h"
+#include "core/timer_wheel.h"
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+
+static std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(size_t size) {
+	++g_allocations;
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+struct Result {
+	double schedule_ns = 0;  // Per arm
+	double cancel_ns = 0;    // Per cancel
+	double reschedule_ns = 0;
+	double fire_ms = 0;      // Advancing through every deadline
+	uint64_t allocations = 0; // During arm + cancel + re-arm
+	size_t fired = 0;
+	size_t early = 0; // Fired before their deadline; must be 0
+};
+
+static double ns_per(bench::Clock::time_point since, size_t ops) {
+	return std::chrono::duration<double, std::nano>(bench::Clock::now() - since).count() / std::max<size_t>(ops, 1);
+}
+
+static Result run_wheel(const std::vector<int>& delays, int max_delay) {
+	VirtualClock clock(false);
+	TimerWheel wheel(clock);
+	std::vector<std::chrono::milliseconds> due(delays.size());
+	auto timers = std::make_unique<Timer[]>(delays.size());
+
+	Result result;
+	for (size_t i = 0; i < delays.size(); ++i) {
+		timers[i].set_callback([&result, &clock, &due, i] {
+			++result.fired;
+			if (std::chrono::duration_cast<std::chrono::milliseconds>(clock.elapsed()) < due[i]) ++result.early;
+		});
+	}
+
+	uint64_t allocations = g_allocations;
+	auto start = bench::Clock::now();
+	for (size_t i = 0; i < delays.size(); ++i) {
+		due[i] = std::chrono::milliseconds(delays[i]);
+		wheel.schedule(timers[i], due[i]);
+	}
+	result.schedule_ns = ns_per(start, delays.size());
+
+	start = bench::Clock::now();
+	for (size_t i = 0; i < delays.size(); i += 2) wheel.cancel(timers[i]);
+	result.cancel_ns = ns_per(start, delays.size() / 2);
+
+	// Push a quarter of the survivors back by up to max_delay again.
+	start = bench::Clock::now();
+	size_t rescheduled = 0;
+	for (size_t i = 1; i < delays.size(); i += 4, ++rescheduled) {
+		due[i] = std::chrono::milliseconds(delays[i] + delays[i - 1]);
+		wheel.schedule(timers[i], due[i]);
+	}
+	result.reschedule_ns = ns_per(start, rescheduled);
+	result.allocations = g_allocations - allocations;
+
+	start = bench::Clock::now();
+	for (int ms = 0; ms <= 2 * max_delay; ++ms) {
+		clock.advance(std::chrono::milliseconds(1));
+		wheel.advance();
+	}
+	result.fire_ms = bench::elapsed_ms(start);
+	return result;
+}
+
+static Result run_multimap(const std::vector<int>& delays, int max_delay) {
+	std::multimap<int64_t, size_t> queue;
+	std::vector<std::multimap<int64_t, size_t>::iterator> handles(delays.size());
+	std::vector<int64_t> due(delays.size());
+
+	Result result;
+	uint64_t allocations = g_allocations;
+	auto start = bench::Clock::now();
+	for (size_t i = 0; i < delays.size(); ++i) {
+		due[i] = delays[i];
+		handles[i] = queue.emplace(due[i], i);
+	}
+	result.schedule_ns = ns_per(start, delays.size());
+
+	start = bench::Clock::now();
+	for (size_t i = 0; i < delays.size(); i += 2) queue.erase(handles[i]);
+	result.cancel_ns = ns_per(start, delays.size() / 2);
+
+	start = bench::Clock::now();
+	size_t rescheduled = 0;
+	for (size_t i = 1; i < delays.size(); i += 4, ++rescheduled) {
+		queue.erase(handles[i]);
+		due[i] = delays[i] + delays[i - 1];
+		handles[i] = queue.emplace(due[i], i);
+	}
+	result.reschedule_ns = ns_per(start, rescheduled);
+	result.allocations = g_allocations - allocations;
+
+	start = bench::Clock::now();
+	for (int64_t now = 0; now <= 2 * max_delay; ++now) {
+		while (!queue.empty() && queue.begin()->first <= now) {
+			if (now < due[queue.begin()->second]) ++result.early;
+			queue.erase(queue.begin());
+			++result.fired;
+		}
+	}
+	result.fire_ms = bench::elapsed_ms(start);
+	return result;
+}
+
+static void report(const char* name, const Result& r) {
+	std::printf("%-10s %12.1f %12.1f %14.1f %10.1f %12llu %9zu %7zu\n", name, r.schedule_ns, r.cancel_ns, r.reschedule_ns,
+				r.fire_ms, static_cast<unsigned long long>(r.allocations), r.fired, r.early);
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+	int max_delay = argc > 2 ? std::atoi(argv[2]) : 60000;
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> delay(1, max_delay);
+	std::vector<int> delays(count);
+	for (auto& d : delays) d = delay(rng);
+
+	std::printf("%zu timers, deadlines 1-%d ms; cancel 1/2, re-arm 1/4, then fire the rest\n", count, max_delay);
+	std::printf("%-10s %12s %12s %14s %10s %12s %9s %7s\n", "queue", "arm_ns", "cancel_ns", "re-arm_ns", "fire_ms",
+				"allocations", "fired", "early");
+	report("wheel", run_wheel(delays, max_delay));
+	report("multimap", run_multimap(delays, max_delay));
+	return 0;
+}
@@ -0,0 +1,89 @@
+// cpp_core/bench/bench_util.h
+// Small process-level probes shared by the benchmarks.
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsed_ms(Clock::time_point since) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+// User + system CPU time of the whole process, in milliseconds.
+inline double cpu_time_ms() {
+#if defined(_WIN32)
+	FILETIME created, exited, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+	auto to_ms = [](FILETIME t) { return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 10000.0; };
+	return to_ms(kernel) + to_ms(user);
+#else
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0
+		+ usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+#endif
+}
+
+// Voluntary + involuntary context switches so far (0 where the OS doesn't tell us).
+inline uint64_t context_switches() {
+#if defined(_WIN32)
+	return 0;
+#else
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw);
+#endif
+}
+
+// Resident set size in KiB (0 where unavailable).
+inline uint64_t resident_kb() {
+#if defined(__linux__)
+	std::ifstream statm("/proc/self/statm");
+	uint64_t pages = 0, resident = 0;
+	statm >> pages >> resident;
+	return resident * 4;
+#else
+	return 0;
+#endif
+}
+
+// Live threads in this process (0 where unavailable).
+inline int thread_count() {
+#if defined(__linux__)
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.rfind("Threads:", 0) == 0) return std::stoi(line.substr(8));
+	}
+#endif
+	return 0;
+}
+
+// p in [0, 100]; sorts 'samples'.
+inline double percentile(std::vector<double>& samples, double p) {
+	if (samples.empty()) return 0.0;
+	std::sort(samples.begin(), samples.end());
+	size_t index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+	return samples[std::min(index, samples.size() - 1)];
+}
+
+} // namespace bench
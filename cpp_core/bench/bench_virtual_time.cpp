@@ -0,0 +1,73 @@
+// Timeout and retry scenarios on a VirtualClock: how much wall time they take
+// compared with the time they simulate, and whether two runs agree exactly.
+// (This one measures the virtual clock itself; every other benchmark runs on
+// the real steady clock.)
+//
+//   bench_virtual_time [reads]
+
+#include "bench_util.h"
+#include "core/clock.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+struct Run {
+	double wall_ms = 0;
+	double virtual_ms = 0;
+	int failures = 0;
+	std::vector<int64_t> latencies_us; // Virtual, per read
+};
+
+static Run run(const TimeoutPolicy& policy, double loss_rate, int reads) {
+	VirtualClock clock;
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	sim.jitter = std::chrono::milliseconds(5);
+	sim.loss_rate = loss_rate;
+	sim.seed = 7;
+
+	Device device(std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim, clock),
+				  io_executor(), clock);
+	device.set_timeout_policy(policy);
+	device.connect("00:00:00:00:00:00");
+
+	Run result;
+	auto wall_start = bench::Clock::now();
+	auto virtual_start = clock.now();
+	for (int i = 0; i < reads; ++i) {
+		auto start = clock.now();
+		if (!device.get_battery_info()) ++result.failures;
+		result.latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(clock.now() - start).count());
+	}
+	result.wall_ms = bench::elapsed_ms(wall_start);
+	result.virtual_ms = std::chrono::duration<double, std::milli>(clock.now() - virtual_start).count();
+	return result;
+}
+
+static void report(const char* name, const TimeoutPolicy& policy, double loss_rate, int reads) {
+	Run first = run(policy, loss_rate, reads);
+	Run second = run(policy, loss_rate, reads);
+	std::printf("%-24s %10.1f %12.1f %10.0fx %9d %14s\n", name, first.wall_ms, first.virtual_ms,
+				first.virtual_ms / std::max(first.wall_ms, 0.001), first.failures,
+				first.latencies_us == second.latencies_us ? "identical" : "DIFFERENT");
+}
+
+int main(int argc, char** argv) {
+	int reads = argc > 1 ? std::atoi(argv[1]) : 500;
+
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+
+	std::printf("%d battery reads per scenario on a VirtualClock, 15 ms +- 5 ms link\n", reads);
+	std::printf("%-24s %10s %12s %11s %9s %14s\n", "scenario", "wall_ms", "virtual_ms", "speedup", "failures", "second run");
+
+	TimeoutPolicy fixed;
+	fixed.initial = fixed.min = fixed.max = std::chrono::milliseconds(2000);
+	fixed.max_retries = 0;
+	report("fixed 2 s, 5% loss", fixed, 0.05, reads);
+	report("adaptive, 5% loss", TimeoutPolicy{}, 0.05, reads);
+	report("adaptive, 50% loss", TimeoutPolicy{}, 0.5, reads);
+	report("adaptive, silent", TimeoutPolicy{}, 1.0, reads / 10);
+	return 0;
+}
@@ -0,0 +1,84 @@
+// Time from connect() to a filled state cache. Without a warmup the first
+// screen asks for battery and ANC itself and resync() reads the rest one request
+// at a time; with one, the reads start in the background as soon as the link is
+// up, a few on air at once, battery and ANC first. The last column times a forced
+// read the caller issues right after connecting, against the same read on an
+// idle link: the warmup should stay out of its way.
+//
+//   bench_warmup [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+static constexpr uint32_t HOT = StateFields::BATTERY | StateFields::ANC;
+
+// Polls the published state until none of 'fields' is stale; ms since 'start'.
+static double until_filled(Device& device, bench::Clock::time_point start, uint32_t fields) {
+	while (device.snapshot()->stale_fields() & fields) {
+		if (bench::elapsed_ms(start) > 10000) break; // Give up rather than hang
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	return bench::elapsed_ms(start);
+}
+
+static double timed_read(Device& device) {
+	RequestOptions forced;
+	forced.force = true;
+	auto start = bench::Clock::now();
+	device.get_low_latency_status(forced);
+	return bench::elapsed_ms(start);
+}
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+
+	std::printf("%d rounds, 15 ms link\n", rounds);
+	std::printf("%-20s %12s %12s %12s %14s\n", "case", "hot_ms", "all_ms", "frames_sent", "user_read_ms");
+	for (int warm = 0; warm < 2; ++warm) {
+		std::vector<double> hot, all, user;
+		uint64_t frames = 0;
+		for (int r = 0; r < rounds; ++r) {
+			for (int with_read = 0; with_read < 2; ++with_read) {
+				auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config());
+				auto* sim = client.get();
+				Device device(std::move(client));
+				if (warm) device.set_warmup(WarmupOptions{});
+
+				auto start = bench::Clock::now();
+				device.connect("00:00:00:00:00:00");
+				if (with_read) {
+					// Right after connecting, with or without the warmup running.
+					user.push_back(timed_read(device));
+					until_filled(device, start, StateFields::ALL);
+					continue;
+				}
+				if (!warm) {
+					device.get_battery_info();
+					device.get_anc_status();
+					hot.push_back(bench::elapsed_ms(start));
+					device.resync();
+					all.push_back(until_filled(device, start, StateFields::ALL));
+				} else {
+					hot.push_back(until_filled(device, start, HOT));
+					all.push_back(until_filled(device, start, StateFields::ALL));
+				}
+				frames += sim->frames_sent();
+			}
+		}
+		std::printf("%-20s %12.1f %12.1f %12.1f %14.1f\n", warm ? "warmup" : "getters + resync", bench::percentile(hot, 50),
+					bench::percentile(all, 50), static_cast<double>(frames) / rounds, bench::percentile(user, 50));
+	}
+	return 0;
+}
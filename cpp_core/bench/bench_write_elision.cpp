@@ -0,0 +1,84 @@
+// Time to re-apply a settings profile the headset already has (what a widget
+// rebuild or re-selecting the active profile does), with every write sent as
+// before (RequestOptions::force) and with no-op writes elided against the
+// confirmed state. A third case changes one setting. The profile is what the
+// simulated headset reports after a resync; each apply is timed until the
+// write queue has drained.
+//
+//   bench_write_elision [rounds]
+
+#include "bench_util.h"
+#include "core/device.h"
+#include "platform/simulator/simulated_spp_client.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+static SimulatorConfig sim_config() {
+	SimulatorConfig sim;
+	sim.latency = std::chrono::milliseconds(15);
+	return sim;
+}
+
+// Writes every setting in 'state' back to the device.
+static void apply(Device& device, const DeviceState& state, const RequestOptions& options) {
+	if (state.anc.value) {
+		device.set_anc_mode(state.anc.value->mode, options);
+		device.set_anc_level(state.anc.value->level, options);
+	}
+	if (state.wear_detection.value) device.set_wear_detection(*state.wear_detection.value, options);
+	if (state.low_latency.value) device.set_low_latency(*state.low_latency.value, options);
+	if (state.sound_quality.value) device.set_sound_quality_preference(*state.sound_quality.value, options);
+	if (const auto& g = state.gestures.value) {
+		device.set_double_tap_action(EarSide::LEFT, g->double_tap_left, options);
+		device.set_double_tap_action(EarSide::RIGHT, g->double_tap_right, options);
+		device.set_triple_tap_action(EarSide::LEFT, g->triple_tap_left, options);
+		device.set_triple_tap_action(EarSide::RIGHT, g->triple_tap_right, options);
+		device.set_long_tap_action(EarSide::LEFT, g->long_tap_left, options);
+		device.set_long_tap_action(EarSide::RIGHT, g->long_tap_right, options);
+		device.set_swipe_action(g->swipe_action, options);
+	}
+	if (state.equalizer.value) device.set_equalizer_preset(state.equalizer.value->current_preset_id, options);
+}
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+	std::cout.setstate(std::ios::badbit); // Device logs every request to stdout
+
+	std::printf("%d rounds, 15 ms link\n", rounds);
+	std::printf("%-26s %10s %10s %12s %12s\n", "case", "p50_ms", "max_ms", "frames_sent", "elided");
+
+	struct Case {
+		const char* name;
+		bool force;
+		bool change_one;
+	};
+	for (Case c : {Case{"unchanged, all sent", true, false}, Case{"unchanged, elided", false, false},
+				   Case{"one changed, elided", false, true}}) {
+		std::vector<double> ms;
+		uint64_t frames = 0, elided = 0;
+		for (int r = 0; r < rounds; ++r) {
+			auto client = std::make_unique<SimulatedSppClient>(std::make_shared<SimulatedHeadset>(), sim_config());
+			auto* sim = client.get();
+			Device device(std::move(client));
+			device.connect("00:00:00:00:00:00");
+			device.resync();
+			DeviceState profile = device.get_state();
+			if (c.change_one) profile.low_latency.value = !profile.low_latency.value.value_or(false);
+
+			RequestOptions options;
+			options.force = c.force;
+			uint64_t sent_before = sim->frames_sent();
+			WriteStats before = device.get_write_stats();
+			auto start = bench::Clock::now();
+			apply(device, profile, options);
+			device.connect("00:00:00:00:00:00"); // Waits for the queued writes
+			ms.push_back(bench::elapsed_ms(start));
+			frames += sim->frames_sent() - sent_before;
+			elided += device.get_write_stats().elided - before.elided;
+		}
+		std::printf("%-26s %10.1f %10.1f %12.1f %12.1f\n", c.name, bench::percentile(ms, 50), bench::percentile(ms, 100),
+					static_cast<double>(frames) / rounds, static_cast<double>(elided) / rounds);
+	}
+	return 0;
+}
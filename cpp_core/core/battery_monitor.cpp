@@ -0,0 +1,162 @@
+#include "battery_monitor.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static std::array<int, 3> levels_of(const BatteryInfo& info) { return {info.left, info.right, info.case_level}; }
+
+static bool same_charging(const BatteryInfo& a, const BatteryInfo& b) {
+	return a.is_charging_left == b.is_charging_left && a.is_charging_right == b.is_charging_right &&
+		   a.is_charging_case == b.is_charging_case;
+}
+
+BatteryMonitor::BatteryMonitor(Device& device, BatteryMonitorConfig config)
+	: m_device(device), m_config(config), m_next_poll(device.clock().now()) {
+	m_subscription = m_device.subscribe(DeviceEvents::BATTERY, [this](const std::shared_ptr<const DeviceEvent>& event) {
+		on_sample(*event->battery, true);
+	});
+}
+
+BatteryMonitor::~BatteryMonitor() {
+	stop();
+	m_device.unsubscribe(m_subscription);
+}
+
+void BatteryMonitor::start() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_running) return;
+	m_running = true;
+	m_stop = CancellationSource();
+	m_thread = std::thread(&BatteryMonitor::run, this);
+}
+
+void BatteryMonitor::stop() {
+	CancellationSource stopping;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+		m_cond.notify_all();
+		stopping = m_stop;
+	}
+	stopping.cancel(); // Wakes a poll that's waiting for its answer
+	if (m_thread.joinable()) m_thread.join();
+}
+
+bool BatteryMonitor::tick() {
+	m_device.poll_notifications(); // May push the next poll out
+	if (m_device.clock().now() < next_poll()) return false;
+	return poll();
+}
+
+IClock::time_point BatteryMonitor::next_poll() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_next_poll;
+}
+
+std::optional<BatteryInfo> BatteryMonitor::latest() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_latest;
+}
+
+BatteryMonitorStats BatteryMonitor::stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+// --- Sampling ---
+
+bool BatteryMonitor::poll() {
+	RequestOptions options;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		options.cancel = m_stop.token();
+	}
+	auto info = m_device.get_battery_info(options);
+	if (!info) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_stats.polls;
+		++m_stats.failed_polls;
+		m_next_poll = m_device.clock().now() + m_config.min_interval;
+		return true;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_stats.polls;
+	}
+	on_sample(*info, false);
+	return true;
+}
+
+void BatteryMonitor::on_sample(const BatteryInfo& info, bool notification) {
+	auto now = m_device.clock().now();
+	std::optional<BatteryInfo> report;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (notification) ++m_stats.notifications;
+
+		// A charger coming or going turns the slope around: start over.
+		if (m_latest && !same_charging(*m_latest, info)) m_history.clear();
+		m_history.push_back(Sample{now, levels_of(info)});
+		while (m_history.size() > 2 && now - m_history[1].at >= m_config.slope_window) m_history.pop_front();
+		m_latest = info;
+
+		bool moved = !m_reported || !same_charging(*m_reported, info);
+		if (!moved) {
+			auto reported = levels_of(*m_reported);
+			auto current = levels_of(info);
+			for (size_t i = 0; i < current.size(); ++i) {
+				moved |= std::abs(current[i] - reported[i]) >= m_config.report_threshold;
+			}
+		}
+		if (moved) {
+			m_reported = info;
+			++m_stats.reports;
+			report = info;
+		}
+		schedule_next();
+	}
+	if (report && m_report_handler) m_report_handler(*report);
+}
+
+// Called with m_mutex held, right after a sample.
+void BatteryMonitor::schedule_next() {
+	const Sample& first = m_history.front();
+	const Sample& last = m_history.back();
+	double window = std::chrono::duration<double>(last.at - first.at).count();
+
+	auto interval = m_config.initial_interval;
+	m_stats.slope_per_hour = {};
+	if (m_history.size() >= 2 && window > 0.0) {
+		// Levels are whole percents, so a change of d over the window could really be
+		// anything below d + 1. Planning with that bound means an unchanged level
+		// backs off gradually (the window keeps growing) instead of jumping to
+		// max_interval after one quiet sample.
+		double fastest = 0.0;
+		for (size_t i = 0; i < last.levels.size(); ++i) {
+			int change = last.levels[i] - first.levels[i];
+			m_stats.slope_per_hour[i] = change / window * 3600.0;
+			fastest = std::max(fastest, (std::abs(change) + 1) / window);
+		}
+		double seconds = m_config.safety_factor * m_config.report_threshold / fastest;
+		interval = std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000.0));
+	}
+	interval = std::clamp(interval, m_config.min_interval, m_config.max_interval);
+	m_stats.interval = interval;
+	m_next_poll = last.at + interval;
+}
+
+// --- Monitor thread ---
+
+void BatteryMonitor::run() {
+	while (true) {
+		tick();
+		auto wake = std::min(next_poll(), m_device.clock().now() + m_config.notification_interval);
+		if (!sleep_until(wake)) return;
+	}
+}
+
+bool BatteryMonitor::sleep_until(IClock::time_point until) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_running && m_device.clock().wait_until(lock, m_cond, until) == std::cv_status::no_timeout) {}
+	return m_running;
+}
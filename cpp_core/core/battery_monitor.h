@@ -0,0 +1,106 @@
+// cpp_core/core/battery_monitor.h
+
+#pragma once
+
+#include "core/cancellation.h"
+#include "core/device.h"
+#include "core/types.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+struct BatteryMonitorConfig {
+  // Smallest change (in percent, on any of left/right/case) the app cares about.
+  int report_threshold = 2;
+  // Poll when the predicted change since the last sample reaches this share of the threshold.
+  double safety_factor = 0.5;
+  // Poll interval while the slope is unknown (just started, or a charger came or went).
+  std::chrono::milliseconds initial_interval{30000};
+  std::chrono::milliseconds min_interval{10000};
+  // Upper bound once the levels hold still.
+  std::chrono::milliseconds max_interval{600000};
+  // How far back the slope estimate looks.
+  std::chrono::milliseconds slope_window{600000};
+  // How often the monitor thread picks up notifications between polls (local reads only).
+  std::chrono::milliseconds notification_interval{100};
+};
+
+struct BatteryMonitorStats {
+  uint64_t polls = 0;
+  uint64_t failed_polls = 0;
+  uint64_t notifications = 0;
+  uint64_t reports = 0;
+  std::chrono::milliseconds interval{0}; // Until the poll after the last sample
+  // Estimated level change per hour for left, right and case; 0 while unknown.
+  std::array<double, 3> slope_per_hour{};
+};
+
+// Keeps one Device's battery levels current with as few radio round trips as
+// possible. CMD_BATTERY_NOTIFY frames count as free samples; explicit
+// CMD_BATTERY_READ polls are only scheduled for when the discharge (or charge)
+// slope observed so far says a level could have moved by report_threshold.
+// A steady battery is polled every few minutes, a charger change at once.
+//
+// Either start() the monitor's own thread, or call tick() from a loop the host
+// already has (next_poll() says when it must run next). Not both.
+class BatteryMonitor {
+ public:
+  using ReportHandler = std::function<void(const BatteryInfo&)>;
+
+  explicit BatteryMonitor(Device& device, BatteryMonitorConfig config = {});
+  ~BatteryMonitor();
+
+  BatteryMonitor(const BatteryMonitor&) = delete;
+  BatteryMonitor& operator=(const BatteryMonitor&) = delete;
+
+  // Called when a level moved by report_threshold since the last report, or a
+  // charging flag flipped. Runs on the polling thread or whichever thread read the
+  // notification. Set before start().
+  void set_report_handler(ReportHandler handler) { m_report_handler = std::move(handler); }
+
+  void start();
+  void stop();
+
+  // Picks up notifications and polls if a poll is due. Returns true if it polled.
+  bool tick();
+  IClock::time_point next_poll() const;
+
+  // The last sample, polled or pushed.
+  std::optional<BatteryInfo> latest() const;
+  BatteryMonitorStats stats() const;
+
+ private:
+  struct Sample {
+    IClock::time_point at;
+    std::array<int, 3> levels; // Left, right, case
+  };
+
+  void run();
+  bool poll();
+  void on_sample(const BatteryInfo& info, bool notification);
+  void schedule_next();
+  bool sleep_until(IClock::time_point until);
+
+  Device& m_device;
+  BatteryMonitorConfig m_config;
+  ReportHandler m_report_handler;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<Sample> m_history; // Since the last charger change, trimmed to slope_window
+  std::optional<BatteryInfo> m_latest;
+  std::optional<BatteryInfo> m_reported;
+  IClock::time_point m_next_poll;
+  BatteryMonitorStats m_stats;
+
+  bool m_running = false;
+  CancellationSource m_stop; // Replaced by start(), so only touched under m_mutex
+  std::thread m_thread;
+  uint64_t m_subscription = 0;
+};
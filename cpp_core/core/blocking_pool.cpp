@@ -0,0 +1,68 @@
+#include "blocking_pool.h"
+#include <algorithm>
+
+BlockingPool::BlockingPool(size_t max_threads, std::chrono::milliseconds idle_exit)
+	: m_max_threads(std::max<size_t>(1, max_threads)), m_idle_exit(idle_exit) {}
+
+BlockingPool::~BlockingPool() {
+	std::list<std::thread> exited;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stopping = true;
+		m_cond.notify_all();
+		m_cond.wait(lock, [this] { return m_running.empty(); });
+		exited.swap(m_exited);
+	}
+	for (auto& thread : exited) thread.join();
+}
+
+void BlockingPool::post(std::function<void()> task) {
+	std::list<std::thread> exited;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+		exited.swap(m_exited);
+		if (m_tasks.size() > m_idle && m_running.size() < m_max_threads) {
+			// Everybody idle already has a task to pick up: this one gets its own thread.
+			auto self = m_running.emplace(m_running.end());
+			*self = std::thread(&BlockingPool::run, this, self);
+		} else {
+			m_cond.notify_one();
+		}
+	}
+	// They left run() already, so this doesn't wait on anybody's task.
+	for (auto& thread : exited) thread.join();
+}
+
+size_t BlockingPool::threads() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_running.size();
+}
+
+void BlockingPool::run(std::list<std::thread>::iterator self) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		if (!m_tasks.empty()) {
+			auto task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			lock.unlock();
+			task();
+			task = nullptr; // Whatever it captured goes away outside the lock too
+			lock.lock();
+			continue;
+		}
+		if (m_stopping) break;
+		++m_idle;
+		bool woken = m_cond.wait_for(lock, m_idle_exit, [this] { return !m_tasks.empty() || m_stopping; });
+		--m_idle;
+		if (!woken) break;
+	}
+	m_exited.splice(m_exited.end(), m_running, self);
+	m_cond.notify_all(); // The destructor waits for m_running to empty
+}
+
+IExecutor& io_executor() {
+	// Leaked for the same reason as default_executor().
+	static BlockingPool* pool = new BlockingPool();
+	return *pool;
+}
@@ -0,0 +1,42 @@
+// cpp_core/core/blocking_pool.h
+
+#pragma once
+
+#include "core/executor.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+
+// Pool for tasks that block on a link: a write waiting for its ack, the warmup.
+// A posted task never waits for a busy thread to free up; if no thread is idle
+// another one is started (up to 'max_threads'), so one slow headset can't hold
+// up the others the way it would on a pool sized to the cores. Threads that sat
+// idle for 'idle_exit' go away again. Tasks run in posting order.
+class BlockingPool : public IExecutor {
+ public:
+  explicit BlockingPool(size_t max_threads = 64, std::chrono::milliseconds idle_exit = std::chrono::seconds(30));
+  // Runs what is still queued, then joins every thread.
+  ~BlockingPool();
+
+  BlockingPool(const BlockingPool&) = delete;
+  BlockingPool& operator=(const BlockingPool&) = delete;
+
+  void post(std::function<void()> task) override;
+  size_t threads() const;
+
+ private:
+  void run(std::list<std::thread>::iterator self);
+
+  const size_t m_max_threads;
+  const std::chrono::milliseconds m_idle_exit;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<std::function<void()>> m_tasks;
+  std::list<std::thread> m_running;
+  std::list<std::thread> m_exited; // Joined by the next post() or the destructor
+  size_t m_idle = 0;
+  bool m_stopping = false;
+};
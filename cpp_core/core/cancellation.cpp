@@ -0,0 +1,35 @@
+#include "cancellation.h"
+#include <vector>
+
+uint64_t CancellationToken::subscribe(std::function<void()> callback) const {
+	if (!m_state) return 0;
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		if (!m_state->cancelled.load(std::memory_order_relaxed)) {
+			uint64_t id = m_state->next_id++;
+			m_state->callbacks.emplace(id, std::move(callback));
+			return id;
+		}
+	}
+	callback(); // Too late to wait for it, it already happened
+	return 0;
+}
+
+void CancellationToken::unsubscribe(uint64_t id) const {
+	if (!m_state || id == 0) return;
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	m_state->callbacks.erase(id);
+}
+
+bool CancellationSource::cancel() {
+	std::vector<std::function<void()>> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		if (m_state->cancelled.exchange(true, std::memory_order_acq_rel)) return false;
+		for (auto& [id, callback] : m_state->callbacks) callbacks.push_back(std::move(callback));
+		m_state->callbacks.clear();
+	}
+	// Outside the lock: callbacks usually take the waiter's own mutex to wake it up.
+	for (auto& callback : callbacks) callback();
+	return true;
+}
@@ -0,0 +1,53 @@
+// cpp_core/core/cancellation.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Read side of a cancellation flag, handed to whatever does the waiting.
+// A default-constructed token is never cancelled and costs nothing.
+class CancellationToken {
+ public:
+  CancellationToken() = default;
+
+  bool is_cancelled() const { return m_state && m_state->cancelled.load(std::memory_order_acquire); }
+  bool can_be_cancelled() const { return m_state != nullptr; }
+
+  // Runs 'callback' once when the token gets cancelled, on the cancelling thread
+  // (or right here if it already is). Returns 0 if the token can't be cancelled.
+  uint64_t subscribe(std::function<void()> callback) const;
+  // Doesn't wait for a callback that is already running.
+  void unsubscribe(uint64_t id) const;
+
+ private:
+  friend class CancellationSource;
+  struct State {
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    std::map<uint64_t, std::function<void()>> callbacks;
+    uint64_t next_id = 1;
+  };
+  explicit CancellationToken(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+
+  std::shared_ptr<State> m_state;
+};
+
+// Owner side: whoever may want to abort (a closing UI page, disconnect()) keeps
+// the source and hands out tokens.
+class CancellationSource {
+ public:
+  CancellationSource() : m_state(std::make_shared<CancellationToken::State>()) {}
+
+  CancellationToken token() const { return CancellationToken(m_state); }
+  bool is_cancelled() const { return m_state->cancelled.load(std::memory_order_acquire); }
+  // Returns false if it was already cancelled.
+  bool cancel();
+
+ private:
+  std::shared_ptr<CancellationToken::State> m_state;
+};
@@ -0,0 +1,129 @@
+#include "capability_table.h"
+#include "core/mapped_file.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static int64_t now_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+CapabilityTable::CapabilityTable(std::string path) : m_path(std::move(path)) {
+	if (!m_path.empty()) load();
+}
+
+std::string CapabilityTable::key_for(const DeviceInfo& info) {
+	if (info.model.empty() && info.firmware_version.empty()) return {};
+	// Tabs and newlines would break the file format; the device controls these strings.
+	std::string key = info.model + "|" + info.sub_model + "|" + info.firmware_version;
+	for (char& c : key) {
+		if (static_cast<unsigned char>(c) < 0x20) c = ' ';
+	}
+	return key;
+}
+
+CommandSupport CapabilityTable::support(const std::string& key, uint16_t command_id) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto model = m_models.find(key);
+	if (model == m_models.end()) return CommandSupport::UNKNOWN;
+	auto it = model->second.find(command_id);
+	if (it == model->second.end()) return CommandSupport::UNKNOWN;
+	Entry& entry = it->second;
+	int64_t now = now_ms();
+	if (entry.support == CommandSupport::UNSUPPORTED &&
+		now - entry.missed_at_ms >= std::chrono::duration_cast<std::chrono::milliseconds>(RECHECK_AFTER).count()) {
+		// Worth asking again, once: whoever asks next waits another RECHECK_AFTER
+		// unless this one gets an answer.
+		entry.missed_at_ms = now;
+		save_locked();
+		return CommandSupport::UNKNOWN;
+	}
+	return entry.support;
+}
+
+void CapabilityTable::record_answer(const std::string& key, uint16_t command_id) {
+	if (key.empty()) return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Entry& entry = m_models[key][command_id];
+	entry.misses = 0;
+	if (entry.support == CommandSupport::SUPPORTED) return;
+	entry.support = CommandSupport::SUPPORTED;
+	save_locked();
+}
+
+void CapabilityTable::record_miss(const std::string& key, uint16_t command_id) {
+	if (key.empty()) return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Entry& entry = m_models[key][command_id];
+	// A command that has answered before is just having a bad moment.
+	if (entry.support != CommandSupport::UNKNOWN || ++entry.misses < MISSES_TO_GIVE_UP) return;
+	entry.support = CommandSupport::UNSUPPORTED;
+	entry.missed_at_ms = now_ms();
+	std::cout << "[Capabilities] " << key << " doesn't answer command 0x" << std::hex << command_id << std::dec
+			  << "; not asking again for a while." << std::endl;
+	save_locked();
+}
+
+void CapabilityTable::forget(const std::string& key) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_models.erase(key)) save_locked();
+}
+
+std::map<uint16_t, CommandSupport> CapabilityTable::commands(const std::string& key) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<uint16_t, CommandSupport> result;
+	auto model = m_models.find(key);
+	if (model == m_models.end()) return result;
+	for (const auto& [id, entry] : model->second) result[id] = entry.support;
+	return result;
+}
+
+// --- Persistence ---
+
+bool CapabilityTable::save() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return save_locked();
+}
+
+bool CapabilityTable::save_locked() const {
+	if (m_path.empty()) return false;
+	// Written whole and renamed over the old file, so a crash midway keeps what was learned.
+	std::ostringstream out;
+	for (const auto& [key, model] : m_models) {
+		for (const auto& [id, entry] : model) {
+			if (entry.support == CommandSupport::UNKNOWN) continue;
+			out << key << '\t' << std::hex << id << std::dec << '\t';
+			if (entry.support == CommandSupport::SUPPORTED) {
+				out << "S\n";
+			} else {
+				out << "U\t" << entry.missed_at_ms << '\n';
+			}
+		}
+	}
+	std::string text = out.str();
+	if (!replace_file(m_path, std::vector<uint8_t>(text.begin(), text.end()))) {
+		std::cerr << "[Capabilities] Can't write " << m_path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool CapabilityTable::load() {
+	std::ifstream in(m_path);
+	if (!in) return false; // Nothing learned yet
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		std::string key, id, support, missed_at;
+		if (!std::getline(fields, key, '\t') || !std::getline(fields, id, '\t') || !std::getline(fields, support, '\t')) continue;
+		std::getline(fields, missed_at); // Lines from before rechecks have none: due for one now
+		unsigned long command_id = std::strtoul(id.c_str(), nullptr, 16);
+		if (key.empty() || command_id > 0xFFFF || (support != "S" && support != "U")) continue; // Skip damaged lines
+		Entry& entry = m_models[key][static_cast<uint16_t>(command_id)];
+		entry.support = support == "S" ? CommandSupport::SUPPORTED : CommandSupport::UNSUPPORTED;
+		entry.missed_at_ms = std::strtoll(missed_at.c_str(), nullptr, 10);
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+// cpp_core/core/capability_table.h
+
+#pragma once
+
+#include "core/types.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+enum class CommandSupport {
+  UNKNOWN,
+  SUPPORTED,
+  UNSUPPORTED // Never answered while the link was up; not sent again until RECHECK_AFTER
+};
+
+// Which read commands each model and firmware answers, learned from the reads
+// themselves. Older buds stay silent on commands they don't know (low latency,
+// sound quality), so every refresh used to sit out the full timeout and its
+// retries on them. Once a command has gone unanswered MISSES_TO_GIVE_UP times in
+// a row on a link that was otherwise talking, it is marked unsupported for that
+// model/firmware and the Device fails it right away without going on air. Two
+// unlucky refreshes shouldn't hide a feature for good, so RECHECK_AFTER later
+// support() says UNKNOWN once (and starts the wait over) and that read goes on
+// air: an answer marks it supported again. A firmware update is a new key.
+//
+// With a path, what was learned is loaded on construction and written back on
+// every change (changes are rare: a few per model, ever). Thread-safe, and meant
+// to be shared by every Device in the process.
+class CapabilityTable {
+ public:
+  static constexpr int MISSES_TO_GIVE_UP = 2;
+  static constexpr std::chrono::hours RECHECK_AFTER{24};
+
+  explicit CapabilityTable(std::string path = {});
+
+  CapabilityTable(const CapabilityTable&) = delete;
+  CapabilityTable& operator=(const CapabilityTable&) = delete;
+
+  // Model, sub-model and firmware; empty until the device info has been read.
+  static std::string key_for(const DeviceInfo& info);
+
+  // Not const: handing out a recheck is remembered.
+  CommandSupport support(const std::string& key, uint16_t command_id);
+  void record_answer(const std::string& key, uint16_t command_id);
+  // A request that went unanswered through all its attempts.
+  void record_miss(const std::string& key, uint16_t command_id);
+  // Drops what was learned for 'key' (e.g. to probe everything again).
+  void forget(const std::string& key);
+
+  std::map<uint16_t, CommandSupport> commands(const std::string& key) const;
+
+  // One line per known command: key, command id (hex), S or U, and for U when it
+  // was last missed (system clock ms), tab-separated.
+  bool save() const;
+  bool load();
+
+ private:
+  struct Entry {
+    CommandSupport support = CommandSupport::UNKNOWN;
+    int misses = 0; // In a row; not persisted
+    int64_t missed_at_ms = 0; // System clock, when it was marked UNSUPPORTED or last rechecked
+  };
+  // Called with m_mutex held.
+  bool save_locked() const;
+
+  mutable std::mutex m_mutex;
+  std::string m_path;
+  std::map<std::string, std::map<uint16_t, Entry>> m_models;
+};
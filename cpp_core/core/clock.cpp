@@ -0,0 +1,69 @@
+#include "clock.h"
+#include <thread>
+
+// --- SteadyClock ---
+
+void SteadyClock::sleep_until(time_point until) { std::this_thread::sleep_until(until); }
+
+std::cv_status SteadyClock::wait_until(std::unique_lock<std::mutex>& lock, std::condition_variable& cond, time_point until) {
+	return cond.wait_until(lock, until);
+}
+
+IClock& steady_clock() {
+	static SteadyClock clock;
+	return clock;
+}
+
+// --- VirtualClock ---
+
+// How long a manual-mode wait blocks in real time before looking at the virtual clock again.
+static constexpr std::chrono::milliseconds MANUAL_WAIT_SLICE{1};
+
+VirtualClock::VirtualClock(bool auto_advance)
+	: m_start(std::chrono::steady_clock::now()), m_now(m_start.time_since_epoch().count()), m_auto_advance(auto_advance) {}
+
+IClock::time_point VirtualClock::now() const { return time_point(duration(m_now.load(std::memory_order_acquire))); }
+
+IClock::duration VirtualClock::elapsed() const { return now() - m_start; }
+
+void VirtualClock::advance(duration d) {
+	if (d.count() <= 0) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_now.fetch_add(d.count(), std::memory_order_acq_rel);
+	}
+	m_advanced.notify_all();
+}
+
+void VirtualClock::advance_to(time_point t) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// Never backwards: another thread may already have moved past 't'.
+		int64_t target = t.time_since_epoch().count();
+		int64_t current = m_now.load(std::memory_order_acquire);
+		while (current < target && !m_now.compare_exchange_weak(current, target, std::memory_order_acq_rel)) {}
+	}
+	m_advanced.notify_all();
+}
+
+void VirtualClock::sleep_until(time_point until) {
+	if (m_auto_advance) {
+		advance_to(until);
+		return;
+	}
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_advanced.wait(lock, [&] { return now() >= until; });
+}
+
+std::cv_status VirtualClock::wait_until(std::unique_lock<std::mutex>& lock, std::condition_variable& cond, time_point until) {
+	if (now() >= until) return std::cv_status::timeout;
+	if (m_auto_advance) {
+		// The caller checked its condition before waiting; nothing else is going to
+		// happen on this thread before the deadline, so skip straight to it.
+		advance_to(until);
+		return std::cv_status::timeout;
+	}
+	// advance() doesn't know about 'cond', so look at the clock again every slice.
+	cond.wait_for(lock, MANUAL_WAIT_SLICE);
+	return now() >= until ? std::cv_status::timeout : std::cv_status::no_timeout;
+}
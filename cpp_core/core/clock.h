@@ -0,0 +1,74 @@
+// cpp_core/core/clock.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Where the core gets "now" from and how it waits for a point in time. Every
+// timeout, sleep and deadline goes through one of these, so timing-heavy paths
+// (retries, keepalives, backoff) can run against virtual time.
+//
+// Time points are steady_clock ones in both implementations; with a VirtualClock
+// they simply don't track the wall.
+class IClock {
+ public:
+  using time_point = std::chrono::steady_clock::time_point;
+  using duration = std::chrono::steady_clock::duration;
+
+  virtual ~IClock() = default;
+
+  virtual time_point now() const = 0;
+  virtual void sleep_until(time_point until) = 0;
+  // Like cond.wait_until(lock, until): returns std::cv_status::timeout once 'until'
+  // has passed on this clock. May wake spuriously, so callers loop on their condition.
+  virtual std::cv_status wait_until(std::unique_lock<std::mutex>& lock, std::condition_variable& cond, time_point until) = 0;
+
+  void sleep_for(duration d) { sleep_until(now() + d); }
+};
+
+// The real thing. What everything uses unless told otherwise.
+class SteadyClock : public IClock {
+ public:
+  time_point now() const override { return std::chrono::steady_clock::now(); }
+  void sleep_until(time_point until) override;
+  std::cv_status wait_until(std::unique_lock<std::mutex>& lock, std::condition_variable& cond, time_point until) override;
+};
+
+IClock& steady_clock();
+
+// Time that only moves when told to.
+//
+// With auto_advance (the default) a wait or sleep that would block jumps the
+// clock straight to its deadline instead, so a 2 s timeout costs nothing and
+// a scenario driven from one thread plays out the same way every run. That
+// includes the simulator: its latencies are measured on the same clock.
+// Auto-advance is meant for single-threaded scenarios; with several threads
+// waiting at once, whoever waits first drags the clock along for everyone.
+//
+// Without auto_advance, waits block (in short real-time slices) until another
+// thread calls advance() past their deadline.
+class VirtualClock : public IClock {
+ public:
+  explicit VirtualClock(bool auto_advance = true);
+
+  time_point now() const override;
+  void sleep_until(time_point until) override;
+  std::cv_status wait_until(std::unique_lock<std::mutex>& lock, std::condition_variable& cond, time_point until) override;
+
+  void advance(duration d);
+  void advance_to(time_point t);
+  // How far the clock has moved since construction.
+  duration elapsed() const;
+
+ private:
+  const time_point m_start;
+  std::atomic<int64_t> m_now; // Ticks of steady_clock::duration
+  bool m_auto_advance;
+
+  std::mutex m_mutex;
+  std::condition_variable m_advanced;
+};
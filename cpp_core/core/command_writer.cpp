@@ -2,6 +2,9 @@
 #include "protocol/huawei_commands.h"
 #include "protocol/huawei_packet.h"
 #include "core/debug_log.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <iostream>
 #include <stdexcept>
 
@@ -48,53 +51,199 @@ std::pair<uint8_t, uint8_t> anc_level_to_int(AncLevel level) {
     }
 }
 
-CommandWriter::CommandWriter(IBluetoothSPPClient& client) : m_client(client), m_running(true) {
-	m_worker_thread = std::thread(&CommandWriter::process_queue, this); // Start the worker thread upon construction
-}
+CommandWriter::CommandWriter(Link& link, RttTable& rtt, IExecutor& executor) : m_link(link), m_rtt(rtt), m_strand(executor) {}
 
 CommandWriter::~CommandWriter() {
-	m_command_queue.stop(); // Signal the queue to stop and wake up the worker thread
-	// Wait for the worker thread to finish its current task and exit
-	if (m_worker_thread.joinable()) {
-		m_worker_thread.join();
+	// Let already queued writes go out, same as joining the old worker thread did.
+	// (disconnect() calls cancel_pending() first, so there this is quick.)
+	m_strand.wait_idle();
+}
+
+size_t CommandWriter::cancel_pending() {
+	// Writes that already left the strand queue but haven't been sent yet see the new generation and bail.
+	m_generation.fetch_add(1, std::memory_order_acq_rel);
+	std::list<std::shared_ptr<Frame>> dropped;
+	{
+		std::lock_guard<std::mutex> lock(m_queue_mutex);
+		dropped.swap(m_queued);
+		m_held.clear();
+	}
+	m_strand.discard_pending();
+	size_t writes = 0;
+	for (const auto& frame : dropped) {
+		for (const auto& caller : frame->callers) {
+			if (caller.options.on_done) caller.options.on_done(RequestStatus::CANCELLED);
+			++writes;
+		}
 	}
+	if (writes > 0) std::cout << "[CommandWriter] Dropped " << writes << " queued write(s)." << std::endl;
+	return writes;
 }
 
-void CommandWriter::process_queue() {
-	std::function<void()> task;
-	// This loop will block on wait_and_pop until a task is available or the queue is stopped.
-	while (m_command_queue.wait_and_pop(task)) {
-		task();
+// Arguments the protocol has no encoding for never go out, but the caller still hears about it.
+void CommandWriter::refuse(const RequestOptions& options) {
+	if (options.on_done) options.on_done(RequestStatus::REJECTED);
+}
+
+void CommandWriter::begin_batch() {
+	std::lock_guard<std::mutex> lock(m_queue_mutex);
+	++m_batch_depth;
+}
+
+void CommandWriter::end_batch() {
+	std::vector<std::shared_ptr<Frame>> held;
+	{
+		std::lock_guard<std::mutex> lock(m_queue_mutex);
+		if (--m_batch_depth > 0) return;
+		held.swap(m_held);
+	}
+	if (!held.empty()) m_strand.post([this, held] { send_frames(held); });
+}
+
+void CommandWriter::send_and_log(const HuaweiSppPacket& request, const std::string& description, const RequestOptions& options,
+								 bool mergeable) {
+	uint64_t generation = m_generation.load(std::memory_order_acquire);
+	std::vector<uint8_t> params;
+	for (const auto& [key, value] : request.parameters) params.push_back(key);
+	std::shared_ptr<Frame> frame;
+	{
+		std::lock_guard<std::mutex> lock(m_queue_mutex);
+		// Only the last queued frame for this command may take it, so writes to one
+		// command still go out in the order they were made.
+		auto last = std::find_if(m_queued.rbegin(), m_queued.rend(),
+								 [&](const auto& f) { return f->request.command_id == request.command_id; });
+		if (mergeable && last != m_queued.rend() && (*last)->mergeable && (*last)->generation == generation &&
+			std::none_of(params.begin(), params.end(), [&](uint8_t key) { return (*last)->request.parameters.count(key); })) {
+			Frame& into = **last;
+			into.request.parameters.insert(request.parameters.begin(), request.parameters.end());
+			into.description += " + " + description;
+			into.callers.push_back(Frame::Caller{std::move(params), options});
+			return;
+		}
+		frame = std::make_shared<Frame>(Frame{request, description, generation, mergeable, {Frame::Caller{std::move(params), options}}});
+		m_queued.push_back(frame);
+		if (m_batch_depth > 0) {
+			m_held.push_back(frame);
+			return;
+		}
 	}
+	m_strand.post([this, frame] { send_frame(frame); });
+}
+
+void CommandWriter::send_frame(const std::shared_ptr<Frame>& frame) {
+	auto out = take(frame);
+	if (!out) return;
+	std::cout << ">>> [Worker Thread] Sending " << out->frame->description << " request..." << std::endl;
+	out->sent_at = m_link.clock().now();
+	// The device acks a write with a frame of the same command. This holds a pool
+	// thread, so we only wait for that ack instead of for the link to go quiet.
+	report(*out, m_link.transact(out->request, out->request.command_id, out->deadline, out->cancel));
 }
 
-void CommandWriter::send_and_log(const HuaweiSppPacket& request, const std::string& description) {
-	m_command_queue.push([this, request, description] {
-	 std::cout << ">>> [Worker Thread] Sending " << description << " request..." << std::endl;
-	      if (m_client.send(request.to_bytes())) {
-			  std::cout << "<<< [Worker Thread] Command sent successfully." << std::endl;
-			  // The response consumption should also happen on the worker thread.
-			  m_client.receive_all();
-		  } else {
-			  std::cerr << "!!! [Worker Thread] Failed to send " << description << " request." << std::endl;
-		  }
-	});
+void CommandWriter::send_frames(const std::vector<std::shared_ptr<Frame>>& frames) {
+	std::deque<std::pair<Outgoing, Link::Pending>> on_air;
+	auto land = [&] {
+		auto& [out, pending] = on_air.front();
+		report(out, m_link.finish(pending, out.deadline, out.cancel));
+		on_air.pop_front();
+	};
+	for (const auto& frame : frames) {
+		auto out = take(frame);
+		if (!out) continue;
+		uint16_t id = out->request.command_id;
+		while (std::any_of(on_air.begin(), on_air.end(), [&](const auto& f) { return f.first.request.command_id == id; })) land();
+		std::cout << ">>> [Worker Thread] Sending " << out->frame->description << " request (pipelined)..." << std::endl;
+		out->sent_at = m_link.clock().now();
+		auto pending = m_link.start(out->request, id, out->cancel);
+		on_air.emplace_back(std::move(*out), pending);
+	}
+	while (!on_air.empty()) land();
+}
+
+std::optional<CommandWriter::Outgoing> CommandWriter::take(const std::shared_ptr<Frame>& frame) {
+	{
+		// From here on nothing joins it. Gone already if cancel_pending() dropped it.
+		std::lock_guard<std::mutex> lock(m_queue_mutex);
+		auto it = std::find(m_queued.begin(), m_queued.end(), frame);
+		if (it == m_queued.end()) return std::nullopt;
+		m_queued.erase(it);
+	}
+	auto now = m_link.clock().now();
+	bool stale = frame->generation != m_generation.load(std::memory_order_acquire);
+	// Callers that gave up while queued drop out, and their parameters with them.
+	Outgoing out{frame, frame->request, {}, now + m_rtt.timeout_for(frame->request.command_id), {}, {}, false};
+	for (const auto& caller : frame->callers) {
+		if (stale || caller.options.expired(now)) {
+			for (uint8_t key : caller.params) out.request.parameters.erase(key);
+			if (caller.options.on_done) caller.options.on_done(RequestStatus::CANCELLED);
+		} else {
+			out.callers.push_back(&caller);
+		}
+	}
+	if (out.callers.empty()) {
+		std::cout << "--- [Worker Thread] Skipping cancelled " << frame->description << " request." << std::endl;
+		return std::nullopt;
+	}
+	for (const auto* caller : out.callers) {
+		if (caller->options.deadline && *caller->options.deadline < out.deadline) {
+			out.deadline = *caller->options.deadline;
+			out.caller_deadline = true;
+		}
+	}
+	// Once it's on air a merged frame is everybody's; only a lone caller can abandon the wait.
+	if (out.callers.size() == 1) out.cancel = out.callers[0]->options.cancel;
+	return out;
+}
+
+void CommandWriter::report(const Outgoing& out, LinkResult result) {
+	uint16_t id = out.request.command_id;
+	if (result.status == RequestStatus::OK) {
+		// Pipelined acks are taken in order, so this includes waiting behind the ones before it.
+		m_rtt.add_sample(id, std::chrono::duration_cast<std::chrono::microseconds>(m_link.clock().now() - out.sent_at));
+		// A refused write is acked with its error code in ERROR_PARAM.
+		auto error = result.packet->get_param(ERROR_PARAM);
+		if (error && std::any_of(error->begin(), error->end(), [](uint8_t b) { return b != 0; })) {
+			result.status = RequestStatus::REJECTED;
+		}
+	}
+	const std::string& description = out.frame->description;
+	switch (result.status) {
+		case RequestStatus::OK:
+			std::cout << "<<< [Worker Thread] Command acknowledged." << std::endl;
+			break;
+		case RequestStatus::REJECTED:
+			std::cerr << "!!! [Worker Thread] Device refused " << description << " request." << std::endl;
+			break;
+		case RequestStatus::TIMED_OUT:
+			if (!out.caller_deadline) m_rtt.record_timeout(id); // Hitting the caller's deadline isn't the link's fault
+			std::cerr << "!!! [Worker Thread] No ack for " << description << " request." << std::endl;
+			break;
+		case RequestStatus::CANCELLED:
+			std::cout << "--- [Worker Thread] " << description << " request cancelled while waiting for ack." << std::endl;
+			break;
+		case RequestStatus::DISCONNECTED:
+			std::cerr << "!!! [Worker Thread] Failed to send " << description << " request." << std::endl;
+			break;
+	}
+	for (const auto* caller : out.callers) {
+		if (caller->options.on_done) caller->options.on_done(result.status);
+	}
 }
 
 // --- ANC / Config ---
-void CommandWriter::set_anc_mode(AncMode mode) {
-    if (mode == AncMode::UNKNOWN) return;
+void CommandWriter::set_anc_mode(AncMode mode, const RequestOptions& options) {
+    if (mode == AncMode::UNKNOWN) return refuse(options);
     uint8_t mode_val = static_cast<uint8_t>(mode);
 
     std::vector<uint8_t> payload = {mode_val, 0xFF};
 
     auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_ANC_WRITE, 1, payload);
-    send_and_log(request, "Set ANC Mode");
+    send_and_log(request, "Set ANC Mode", options);
 }
 
 // This method sets the specific level within a mode.
-void CommandWriter::set_anc_level(AncLevel level) {
-    if (level == AncLevel::UNKNOWN) return;
+void CommandWriter::set_anc_level(AncLevel level, const RequestOptions& options) {
+    if (level == AncLevel::UNKNOWN) return refuse(options);
 
     // The Python driver shows that for setting a level, the payload must be [mode, level].
     // We get the {mode, level} pair from our helper.
@@ -114,47 +263,47 @@ void CommandWriter::set_anc_level(AncLevel level) {
     std::cout << "Sending ANC level packet with payload: ["
               << static_cast<int>(payload[0]) << ", "
               << static_cast<int>(payload[1]) << "]" << std::endl;
-    send_and_log(request, "Set ANC Level");
+    send_and_log(request, "Set ANC Level", options);
 }
 
-void CommandWriter::set_wear_detection(bool enable) {
+void CommandWriter::set_wear_detection(bool enable, const RequestOptions& options) {
     auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_AUTO_PAUSE_WRITE, 1, {static_cast<uint8_t>(enable ? 1 : 0)});
-    send_and_log(request, "Set Wear Detection");
+    send_and_log(request, "Set Wear Detection", options);
 
 }
 
-void CommandWriter::set_low_latency(bool enable) {
+void CommandWriter::set_low_latency(bool enable, const RequestOptions& options) {
     auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_LOW_LATENCY_WRITE, 1, {static_cast<uint8_t>(enable ? 1 : 0)});
-    send_and_log(request, "Set Low Latency");
+    send_and_log(request, "Set Low Latency", options);
 }
 
-void CommandWriter::set_sound_quality_preference(bool prioritize_quality) {
+void CommandWriter::set_sound_quality_preference(bool prioritize_quality, const RequestOptions& options) {
     uint8_t value = prioritize_quality ? 1 : 0;
     auto request = HuaweiSppPacket::create_write_request(
             HuaweiCommands::CMD_SOUND_QUALITY_WRITE, 1, {value}
     );
-    send_and_log(request, "Set Sound Quality Preference");
+    send_and_log(request, "Set Sound Quality Preference", options);
 }
 
 // --- Gestures ---
-void CommandWriter::set_double_tap_action(EarSide side, GestureAction action) {
-    if (action == GestureAction::UNKNOWN || side == EarSide::BOTH) return;
+void CommandWriter::set_double_tap_action(EarSide side, GestureAction action, const RequestOptions& options) {
+    if (action == GestureAction::UNKNOWN || side == EarSide::BOTH) return refuse(options);
     uint8_t param_id = (side == EarSide::LEFT) ? 1 : 2;
     int8_t action_code = static_cast<int8_t>(gesture_action_to_int(action));
     auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_DUAL_TAP_WRITE, param_id, {static_cast<uint8_t>(action_code)});
-    send_and_log(request, "Set Double Tap");
+    send_and_log(request, "Set Double Tap", options, true);
 }
 
-void CommandWriter::set_triple_tap_action(EarSide side, GestureAction action) {
-    if (action == GestureAction::UNKNOWN || side == EarSide::BOTH) return;
+void CommandWriter::set_triple_tap_action(EarSide side, GestureAction action, const RequestOptions& options) {
+    if (action == GestureAction::UNKNOWN || side == EarSide::BOTH) return refuse(options);
     uint8_t param_id = (side == EarSide::LEFT) ? 1 : 2;
     int8_t action_code = static_cast<int8_t>(gesture_action_to_int(action));
     auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_TRIPLE_TAP_WRITE, param_id, {static_cast<uint8_t>(action_code)});
-    send_and_log(request, "Set Triple Tap");
+    send_and_log(request, "Set Triple Tap", options, true);
 }
 
-void CommandWriter::set_swipe_action(GestureAction action) {
-    if (action != GestureAction::CHANGE_VOLUME && action != GestureAction::OFF) return;
+void CommandWriter::set_swipe_action(GestureAction action, const RequestOptions& options) {
+    if (action != GestureAction::CHANGE_VOLUME && action != GestureAction::OFF) return refuse(options);
     int8_t action_code = (action == GestureAction::CHANGE_VOLUME)
                          ? static_cast<int8_t>(gesture_action_to_int(GestureAction::CHANGE_VOLUME))
                          : static_cast<int8_t>(gesture_action_to_int(GestureAction::OFF));
@@ -162,44 +311,44 @@ void CommandWriter::set_swipe_action(GestureAction action) {
     auto request = HuaweiSppPacket(bytes_to_u16(HuaweiCommands::CMD_SWIPE_WRITE[0], HuaweiCommands::CMD_SWIPE_WRITE[1]));
     request.parameters[1] = { static_cast<uint8_t>(action_code) };
     request.parameters[2] = { static_cast<uint8_t>(action_code) };
-    send_and_log(request, "Set Swipe Action");
+    send_and_log(request, "Set Swipe Action", options);
 }
 
-void CommandWriter::set_long_tap_action(EarSide side, GestureAction action) {
-    if (action != GestureAction::SWITCH_ANC && action != GestureAction::OFF) return;
+void CommandWriter::set_long_tap_action(EarSide side, GestureAction action, const RequestOptions& options) {
+    if (action != GestureAction::SWITCH_ANC && action != GestureAction::OFF) return refuse(options);
     uint8_t param_id = (side == EarSide::LEFT) ? 1 : 2;
     int8_t action_code = static_cast<int8_t>(gesture_action_to_int(action));
     auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_LONG_TAP_SPLIT_WRITE_BASE, param_id, {static_cast<uint8_t>(action_code)});
-    send_and_log(request, "Set Long Tap Action");
+    send_and_log(request, "Set Long Tap Action", options, true);
 }
 
-void CommandWriter::set_long_tap_anc_cycle(EarSide side, AncCycleMode cycle_mode) {
-    if (cycle_mode == AncCycleMode::UNKNOWN) return;
+void CommandWriter::set_long_tap_anc_cycle(EarSide side, AncCycleMode cycle_mode, const RequestOptions& options) {
+    if (cycle_mode == AncCycleMode::UNKNOWN) return refuse(options);
     uint8_t param_id = (side == EarSide::LEFT) ? 1 : 2;
     uint8_t cycle_code = static_cast<uint8_t>(anc_cycle_to_int(cycle_mode));
     auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_LONG_TAP_SPLIT_WRITE_ANC, param_id, {cycle_code});
-    send_and_log(request, "Set Long Tap ANC Cycle");
+    send_and_log(request, "Set Long Tap ANC Cycle", options, true);
 }
 
-void CommandWriter::set_incall_double_tap_action(GestureAction action) {
-    if (action != GestureAction::ANSWER_CALL && action != GestureAction::OFF) return;
+void CommandWriter::set_incall_double_tap_action(GestureAction action, const RequestOptions& options) {
+    if (action != GestureAction::ANSWER_CALL && action != GestureAction::OFF) return refuse(options);
     int8_t action_code = static_cast<int8_t>(gesture_action_to_int(action));
     auto request = HuaweiSppPacket::create_write_request(HuaweiCommands::CMD_DUAL_TAP_WRITE, 4, {static_cast<uint8_t>(action_code)});
-    send_and_log(request, "Set In-Call Double Tap");
+    send_and_log(request, "Set In-Call Double Tap", options, true);
 }
 
 // --- Equalizer ---
-void CommandWriter::set_equalizer_preset(uint8_t preset_id) {
+void CommandWriter::set_equalizer_preset(uint8_t preset_id, const RequestOptions& options) {
     auto request = HuaweiSppPacket::create_write_request(
             HuaweiCommands::CMD_EQUALIZER_WRITE, 1, {preset_id}
     );
-    send_and_log(request, "Set Built-in Equalizer Preset");
+    send_and_log(request, "Set Built-in Equalizer Preset", options);
 }
 
-void CommandWriter::create_or_update_custom_equalizer(const CustomEqPreset& preset) {
+void CommandWriter::create_or_update_custom_equalizer(const CustomEqPreset& preset, const RequestOptions& options) {
     if (preset.values.size() != 10) {
         std::cerr << "Custom EQ preset must have exactly 10 values." << std::endl;
-        return;
+        return refuse(options);
     }
     std::vector<uint8_t> values_as_uint;
     values_as_uint.reserve(preset.values.size());
@@ -212,13 +361,13 @@ void CommandWriter::create_or_update_custom_equalizer(const CustomEqPreset& pres
     request.parameters[3] = values_as_uint;
     request.parameters[4] = std::vector<uint8_t>(preset.name.begin(), preset.name.end());
     request.parameters[5] = { 1 };
-    send_and_log(request, "Create/Update Custom Equalizer");
+    send_and_log(request, "Create/Update Custom Equalizer", options);
 }
 
-void CommandWriter::delete_custom_equalizer(const CustomEqPreset& preset) {
+void CommandWriter::delete_custom_equalizer(const CustomEqPreset& preset, const RequestOptions& options) {
     if (preset.values.size() != 10) {
         std::cerr << "Cannot delete EQ preset with invalid values." << std::endl;
-        return;
+        return refuse(options);
     }
     std::vector<uint8_t> values_as_uint;
     values_as_uint.reserve(preset.values.size());
@@ -235,10 +384,10 @@ void CommandWriter::delete_custom_equalizer(const CustomEqPreset& preset) {
     // The ONLY difference from create_or_update is this action code: '2' means DELETE.
     request.parameters[5] = { 2 };
 
-    send_and_log(request, "Delete Custom Equalizer (Correct Payload)");
+    send_and_log(request, "Delete Custom Equalizer (Correct Payload)", options);
 }
 
-void CommandWriter::create_fake_preset(FakePreset preset_type, uint8_t new_id) {
+void CommandWriter::create_fake_preset(FakePreset preset_type, uint8_t new_id, const RequestOptions& options) {
     CustomEqPreset preset;
     preset.id = new_id;
 
@@ -249,23 +398,23 @@ void CommandWriter::create_fake_preset(FakePreset preset_type, uint8_t new_id) {
         preset.name = "Hi-Fi Live";
         preset.values = {-5, 20, 30, 10, 0, 0, -25, -10, 10, 0};
     } else {
-        return;
+        return refuse(options);
     }
 
     std::cout << "Creating '" << preset.name << "' as a custom preset with ID " << (int)new_id << "..." << std::endl;
-    return create_or_update_custom_equalizer(preset);
+    return create_or_update_custom_equalizer(preset, options);
 }
 
 // --- Dual-Connect Methods ---
-void CommandWriter::set_dual_connect_enabled(bool enable) {
+void CommandWriter::set_dual_connect_enabled(bool enable, const RequestOptions& options) {
     auto request = HuaweiSppPacket::create_write_request(
             HuaweiCommands::CMD_DUAL_CONNECT_ENABLED_WRITE, 1, {static_cast<uint8_t>(enable ? 1 : 0)}
     );
-    send_and_log(request, "Set Dual-Connect Enabled");
+    send_and_log(request, "Set Dual-Connect Enabled", options);
 }
 
-void CommandWriter::set_dual_connect_preferred(const std::string& mac_address) {
-    if (mac_address.length() != 12) return;
+void CommandWriter::set_dual_connect_preferred(const std::string& mac_address, const RequestOptions& options) {
+    if (mac_address.length() != 12) return refuse(options);
     std::vector<uint8_t> mac_bytes;
     for(size_t i = 0; i < mac_address.length(); i += 2) {
         mac_bytes.push_back(static_cast<uint8_t>(std::stoul(mac_address.substr(i, 2), nullptr, 16)));
@@ -273,11 +422,11 @@ void CommandWriter::set_dual_connect_preferred(const std::string& mac_address) {
     auto request = HuaweiSppPacket::create_write_request(
             HuaweiCommands::CMD_DUAL_CONNECT_PREFERRED_WRITE, 1, mac_bytes
     );
-    send_and_log(request, "Set Preferred Device");
+    send_and_log(request, "Set Preferred Device", options);
 }
 
-void CommandWriter::dual_connect_action(const std::string& mac_address, uint8_t action_code) {
-    if (mac_address.length() != 12) return;
+void CommandWriter::dual_connect_action(const std::string& mac_address, uint8_t action_code, const RequestOptions& options) {
+    if (mac_address.length() != 12) return refuse(options);
     std::vector<uint8_t> mac_bytes;
     for(size_t i = 0; i < mac_address.length(); i += 2) {
         mac_bytes.push_back(static_cast<uint8_t>(std::stoul(mac_address.substr(i, 2), nullptr, 16)));
@@ -285,5 +434,5 @@ void CommandWriter::dual_connect_action(const std::string& mac_address, uint8_t
     auto request = HuaweiSppPacket::create_write_request(
             HuaweiCommands::CMD_DUAL_CONNECT_EXECUTE, action_code, mac_bytes
     );
-    send_and_log(request, "Dual-Connect Action");
+    send_and_log(request, "Dual-Connect Action", options);
 }
\ No newline at end of file
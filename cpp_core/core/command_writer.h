@@ -1,54 +1,129 @@
 // cpp_core/core/command_writer.h
 
 #pragma once
-#include "platform/bluetooth_interface.h"
+#include "core/link.h"
+#include "core/request_options.h"
+#include "core/rtt_estimator.h"
 #include "protocol/huawei_packet.h"
 #include "core/types.h"
-#include "core/thread_safe_queue.h"
+#include "core/executor.h"
+#include "core/strand.h"
 #include <string>
 #include <vector>
 #include <map>
-#include <thread>
+#include <chrono>
 #include <functional>
 #include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+// Wire code of a gesture; several actions share one. Throws for UNKNOWN.
+int gesture_action_to_int(GestureAction action);
 
 class CommandWriter {
  public:
-  CommandWriter(IBluetoothSPPClient& client);
+  // Writes run as tasks on 'executor', serialized per writer through a strand. A
+  // task holds its thread until the ack is in, so 'executor' must not be a
+  // fixed-size pool shared with other work. How long it waits comes from 'rtt'
+  // (the connection's table, shared with the reads), and every ack is fed back
+  // into it as a sample.
+  CommandWriter(Link& link, RttTable& rtt, IExecutor& executor = io_executor());
   ~CommandWriter();
 
+  // Every write takes an optional deadline and cancellation token: a write whose
+  // token fired or whose deadline passed while it was queued is never sent.
+  // options.on_done hears how each write ended (the ack, an error code, no answer).
+
+  // Drops everything still queued and makes writes that are about to start skip
+  // themselves. Returns how many were dropped.
+  size_t cancel_pending();
+
+  // Gesture writes for the same command with different parameters (left and right
+  // double tap, ...) that are queued at the same time go out as one frame with
+  // all their TLVs, and the one ack goes to each caller's on_done. Writes only
+  // queue up while an earlier one is waiting for its ack; between begin_batch()
+  // and end_batch() (they nest) nothing is sent, so a whole layout merges.
+  // Device::WriteBatch does the pairing.
+  //
+  // The frames a batch held back are pipelined: they go out back to back and the
+  // acks are taken in order, so the batch costs about one round trip instead of
+  // one per frame. A second frame for a command that's still waiting for its ack
+  // waits for that ack first (an ack carries nothing to tell two of them apart).
+  void begin_batch();
+  void end_batch();
+
   // --- Sound Settings ---
-  void set_anc_mode(AncMode mode);
-  void set_anc_level(AncLevel level);
-  void set_wear_detection(bool enable);
-  void set_low_latency(bool enable);
-  void set_sound_quality_preference(bool prioritize_quality);
-  void create_fake_preset(FakePreset preset, uint8_t new_id);
+  void set_anc_mode(AncMode mode, const RequestOptions& options = {});
+  void set_anc_level(AncLevel level, const RequestOptions& options = {});
+  void set_wear_detection(bool enable, const RequestOptions& options = {});
+  void set_low_latency(bool enable, const RequestOptions& options = {});
+  void set_sound_quality_preference(bool prioritize_quality, const RequestOptions& options = {});
+  void create_fake_preset(FakePreset preset, uint8_t new_id, const RequestOptions& options = {});
 
   // --- Gesture Methods ---
-  void set_double_tap_action(EarSide side, GestureAction action);
-  void set_triple_tap_action(EarSide side, GestureAction action);
-  void set_swipe_action(GestureAction action);
-  void set_long_tap_action(EarSide side, GestureAction action);
-  void set_long_tap_anc_cycle(EarSide side, AncCycleMode cycle_mode);
-  void set_incall_double_tap_action(GestureAction action);
+  void set_double_tap_action(EarSide side, GestureAction action, const RequestOptions& options = {});
+  void set_triple_tap_action(EarSide side, GestureAction action, const RequestOptions& options = {});
+  void set_swipe_action(GestureAction action, const RequestOptions& options = {});
+  void set_long_tap_action(EarSide side, GestureAction action, const RequestOptions& options = {});
+  void set_long_tap_anc_cycle(EarSide side, AncCycleMode cycle_mode, const RequestOptions& options = {});
+  void set_incall_double_tap_action(GestureAction action, const RequestOptions& options = {});
 
   // --- Equalizer Methods ---
-  void set_equalizer_preset(uint8_t preset_id);
-  void create_or_update_custom_equalizer(const CustomEqPreset& preset);
-  void delete_custom_equalizer(const CustomEqPreset& preset);
+  void set_equalizer_preset(uint8_t preset_id, const RequestOptions& options = {});
+  void create_or_update_custom_equalizer(const CustomEqPreset& preset, const RequestOptions& options = {});
+  void delete_custom_equalizer(const CustomEqPreset& preset, const RequestOptions& options = {});
 
   // --- Dual-Connect Methods ---
-  void set_dual_connect_enabled(bool enable);
-  void set_dual_connect_preferred(const std::string& mac_address);
-  void dual_connect_action(const std::string& mac_address, uint8_t action_code);
+  void set_dual_connect_enabled(bool enable, const RequestOptions& options = {});
+  void set_dual_connect_preferred(const std::string& mac_address, const RequestOptions& options = {});
+  void dual_connect_action(const std::string& mac_address, uint8_t action_code, const RequestOptions& options = {});
 
  private:
-  void send_and_log(const HuaweiSppPacket& request, const std::string& description);
-
-  void process_queue();
-  ThreadSafeQueue<std::function<void()>> m_command_queue;
-  std::thread m_worker_thread;
-  std::atomic<bool> m_running;
-  IBluetoothSPPClient& m_client;
-};
\ No newline at end of file
+  // One frame waiting in the strand, with every write merged into it.
+  struct Frame {
+    struct Caller {
+      std::vector<uint8_t> params; // Its TLVs in 'request'
+      RequestOptions options;
+    };
+    HuaweiSppPacket request;
+    std::string description;
+    uint64_t generation;
+    bool mergeable;
+    std::vector<Caller> callers;
+  };
+
+  // 'mergeable': may share a frame with other writes to the same command (disjoint parameters).
+  void send_and_log(const HuaweiSppPacket& request, const std::string& description, const RequestOptions& options,
+                    bool mergeable = false);
+  // A frame taken off the queue, with the callers that still want it.
+  struct Outgoing {
+    std::shared_ptr<Frame> frame;
+    HuaweiSppPacket request;
+    std::vector<const Frame::Caller*> callers;
+    Link::Clock::time_point deadline;
+    CancellationToken cancel;
+    Link::Clock::time_point sent_at;
+    bool caller_deadline = false; // A caller's deadline cut the RTO short
+  };
+
+  void send_frame(const std::shared_ptr<Frame>& frame);
+  void send_frames(const std::vector<std::shared_ptr<Frame>>& frames);
+  std::optional<Outgoing> take(const std::shared_ptr<Frame>& frame);
+  void report(const Outgoing& out, LinkResult result);
+  void refuse(const RequestOptions& options);
+
+  // Parameter carrying the error code in the answer to a refused request.
+  static constexpr uint8_t ERROR_PARAM = 127;
+
+  Link& m_link;
+  RttTable& m_rtt;
+  std::atomic<uint64_t> m_generation{0};
+  std::mutex m_queue_mutex;
+  std::list<std::shared_ptr<Frame>> m_queued; // Posted or held back, not started yet
+  std::vector<std::shared_ptr<Frame>> m_held; // To post at end_batch()
+  int m_batch_depth = 0;
+  Strand m_strand;
+};
+
@@ -0,0 +1,156 @@
+#include "connection_supervisor.h"
+#include <algorithm>
+#include <iostream>
+
+ConnectionSupervisor::ConnectionSupervisor(Device& device, std::string address, int port, SupervisorConfig config)
+	: m_device(device), m_address(std::move(address)), m_port(port), m_config(config) {}
+
+ConnectionSupervisor::~ConnectionSupervisor() { stop(); }
+
+void ConnectionSupervisor::start() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_running) return;
+	lock.unlock();
+	if (m_thread.joinable()) m_thread.join(); // Gave up on its own earlier
+	lock.lock();
+	m_running = true;
+	m_stop = CancellationSource();
+	m_thread = std::thread(&ConnectionSupervisor::run, this);
+}
+
+void ConnectionSupervisor::stop() {
+	CancellationSource stopping;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+		m_cond.notify_all();
+		stopping = m_stop;
+	}
+	stopping.cancel(); // Wakes a probe or resync read that's in flight
+	if (m_thread.joinable()) m_thread.join();
+}
+
+SupervisorStats ConnectionSupervisor::stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+// --- Supervisor thread ---
+
+void ConnectionSupervisor::run() {
+	uint32_t missed = 0;
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_running) return;
+		}
+
+		if (!m_device.is_connected()) {
+			// The socket told us itself (recv returned 0, or nobody connected yet).
+			recover(m_device.last_activity());
+			missed = 0;
+			continue;
+		}
+
+		// Any frame counts as a sign of life, so a busy link is never probed.
+		auto last_heard = m_device.last_activity();
+		if (missed == 0 && m_device.clock().now() - last_heard < m_config.idle_interval) {
+			if (!sleep_until(last_heard + m_config.idle_interval)) return;
+			continue;
+		}
+
+		RequestOptions options;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			options.cancel = m_stop.token();
+		}
+		RequestStatus status = m_device.probe(options);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			++m_stats.probes_sent;
+			if (status == RequestStatus::TIMED_OUT) ++m_stats.probes_missed;
+		}
+
+		if (status == RequestStatus::OK || m_device.last_activity() > last_heard) {
+			missed = 0;
+		} else if (status == RequestStatus::TIMED_OUT && ++missed >= missed_probes_allowed()) {
+			recover(last_heard);
+			missed = 0;
+		} else if (status == RequestStatus::DISCONNECTED) {
+			recover(last_heard);
+			missed = 0;
+		}
+	}
+}
+
+// A tight RTO means probes are cheap and a single miss says little, so we allow
+// more of them; on a slow link each miss already took a long time.
+uint32_t ConnectionSupervisor::missed_probes_allowed() const {
+	auto rto = std::max<int64_t>(1, m_device.probe_timeout().count());
+	auto probes = static_cast<uint32_t>((m_config.dead_after.count() + rto - 1) / rto);
+	return std::clamp(probes, m_config.min_missed_probes, m_config.max_missed_probes);
+}
+
+void ConnectionSupervisor::recover(Clock::time_point last_heard) {
+	auto lost_at = m_device.clock().now();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_stats.links_lost;
+		m_stats.last_detection_ms = std::chrono::duration<double, std::milli>(lost_at - last_heard).count();
+	}
+	std::cerr << "[SUPERVISOR] Link to " << m_address << " is dead, reconnecting..." << std::endl;
+	m_device.disconnect(); // Fails whatever is still waiting on the old link right away
+	emit(LinkEvent::LINK_LOST);
+
+	auto backoff = m_config.reconnect_initial_backoff;
+	for (uint32_t attempt = 1;; ++attempt) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_running) return;
+			++m_stats.reconnect_attempts;
+		}
+		if (m_device.connect(m_address, m_port)) break;
+
+		if (m_config.max_reconnect_attempts != 0 && attempt >= m_config.max_reconnect_attempts) {
+			std::cerr << "[SUPERVISOR] Giving up on " << m_address << " after " << attempt << " attempts." << std::endl;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_running = false;
+			}
+			emit(LinkEvent::RECONNECT_FAILED);
+			return;
+		}
+		if (!sleep_until(m_device.clock().now() + backoff)) return;
+		backoff = std::min(backoff * 2, m_config.reconnect_max_backoff);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_stats.reconnects;
+	}
+	emit(LinkEvent::RECONNECTED);
+
+	// Only what may have changed: volatile fields and anything written since it was last read.
+	RequestOptions options;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		options.cancel = m_stop.token();
+	}
+	uint32_t fields = m_device.resync(options);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.last_resync_fields = fields;
+		m_stats.last_recovery_ms = std::chrono::duration<double, std::milli>(m_device.clock().now() - lost_at).count();
+	}
+	std::cout << "[SUPERVISOR] Link to " << m_address << " recovered." << std::endl;
+	emit(LinkEvent::RESYNCED);
+}
+
+bool ConnectionSupervisor::sleep_until(Clock::time_point until) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_running && m_device.clock().wait_until(lock, m_cond, until) == std::cv_status::no_timeout) {}
+	return m_running;
+}
+
+void ConnectionSupervisor::emit(LinkEvent event) {
+	if (m_event_handler) m_event_handler(event);
+}
@@ -0,0 +1,99 @@
+// cpp_core/core/connection_supervisor.h
+
+#pragma once
+
+#include "core/cancellation.h"
+#include "core/device.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct SupervisorConfig {
+  // Send a keepalive probe once nothing has come in from the headset for this long.
+  std::chrono::milliseconds idle_interval{1000};
+  // How long probes may go unanswered before the link is declared dead. The number
+  // of missed probes that takes follows from the probe timeout (the link's RTO),
+  // clamped to [min_missed_probes, max_missed_probes].
+  std::chrono::milliseconds dead_after{300};
+  uint32_t min_missed_probes = 2;
+  uint32_t max_missed_probes = 5;
+  // Reconnect backoff, doubling per failed attempt.
+  std::chrono::milliseconds reconnect_initial_backoff{50};
+  std::chrono::milliseconds reconnect_max_backoff{5000};
+  // 0 keeps trying until stop().
+  uint32_t max_reconnect_attempts = 0;
+};
+
+enum class LinkEvent {
+  LINK_LOST,
+  RECONNECTED,
+  RECONNECT_FAILED, // Gave up after max_reconnect_attempts
+  RESYNCED
+};
+
+struct SupervisorStats {
+  uint64_t probes_sent = 0;
+  uint64_t probes_missed = 0;
+  uint64_t links_lost = 0;
+  uint64_t reconnect_attempts = 0;
+  uint64_t reconnects = 0;
+  uint32_t last_resync_fields = 0; // StateFields mask refreshed after the last reconnect
+  // Last frame received -> link declared dead.
+  double last_detection_ms = 0.0;
+  // Link declared dead -> reconnected and resynced.
+  double last_recovery_ms = 0.0;
+};
+
+// Keeps one Device's link alive. Sends cheap keepalive probes (battery reads)
+// while the link is idle, declares it dead after enough of them go unanswered,
+// reconnects with backoff and then re-reads only the state that went stale.
+//
+// Runs on its own thread, which spends nearly all its time asleep; probes and
+// reconnects block (they are synchronous Device calls), so they don't belong on
+// the shared pool.
+class ConnectionSupervisor {
+ public:
+  using EventHandler = std::function<void(LinkEvent)>;
+
+  ConnectionSupervisor(Device& device, std::string address, int port = 1, SupervisorConfig config = {});
+  ~ConnectionSupervisor();
+
+  ConnectionSupervisor(const ConnectionSupervisor&) = delete;
+  ConnectionSupervisor& operator=(const ConnectionSupervisor&) = delete;
+
+  // Called on the supervisor thread. Set before start().
+  void set_event_handler(EventHandler handler) { m_event_handler = std::move(handler); }
+
+  void start();
+  // Interrupts a probe, reconnect backoff or resync in progress and joins the thread.
+  void stop();
+
+  SupervisorStats stats() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  void run();
+  uint32_t missed_probes_allowed() const;
+  void recover(Clock::time_point last_heard);
+  // Sleeps until 'until' or stop(); returns false if stopping.
+  bool sleep_until(Clock::time_point until);
+  void emit(LinkEvent event);
+
+  Device& m_device;
+  std::string m_address;
+  int m_port;
+  SupervisorConfig m_config;
+  EventHandler m_event_handler;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond;
+  bool m_running = false;
+  CancellationSource m_stop; // Replaced by start(), so only touched under m_mutex
+  SupervisorStats m_stats;
+  std::thread m_thread;
+};
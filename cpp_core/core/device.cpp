@@ -1,5 +1,6 @@
 #include "device.h"
 #include "core/command_writer.h"
+#include "core/link.h"
 #include "protocol/huawei_commands.h"
 #include <iostream>
 #include <stdexcept>
@@ -7,6 +8,9 @@
 #include <iomanip> // For std::setw, etc. in MAC address formatting
 #include <sstream> // For std::stringstream
 #include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <deque>
 
 // =================================================================
 // Helpers
@@ -15,6 +19,17 @@
 // Helper to get a string from a vector of bytes
 std::string to_str(const std::vector<uint8_t> &vec) { return std::string(vec.begin(), vec.end()); }
 
+// Helper to read an on/off parameter (1 = on)
+static std::optional<bool> flag_param(const HuaweiSppPacket &packet, uint8_t param) {
+	auto p = packet.get_param(param);
+	if (!p || p->empty()) return std::nullopt;
+	return (*p)[0] == 1;
+}
+
+static SoundQualityPreference sound_quality_of(bool prioritize_quality) {
+	return prioritize_quality ? SoundQualityPreference::PRIORITIZE_QUALITY : SoundQualityPreference::PRIORITIZE_CONNECTION;
+}
+
 // Helper to map integer codes to GestureAction enum
 GestureAction int_to_gesture_action(int code) {
 	switch (static_cast<int8_t>(code)) {
@@ -60,210 +75,1196 @@ AncLevel int_to_anc_level(uint8_t mode_code, uint8_t level_code) {
 // Device Class Implementation
 // =================================================================
 
-Device::Device(std::unique_ptr<IBluetoothSPPClient> bt_client)
-	: m_client(std::move(bt_client)) {}
+Device::Device(std::unique_ptr<IBluetoothSPPClient> bt_client, IExecutor& executor, IClock& clock)
+	: m_client(std::move(bt_client)), m_executor(executor), m_clock(clock), m_link(std::make_unique<Link>(*m_client, clock)) {
+	m_link->set_unsolicited_handler([this](const HuaweiSppPacket& packet) { handle_notification(packet); });
+}
 
-Device::~Device() = default;
+// Queued writes call back into the state cache when acked: let them finish
+// before the members they touch go away.
+Device::~Device() {
+	save_state();
+	std::shared_ptr<CommandWriter> writer;
+	{
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		writer.swap(m_writer);
+		if (m_warmup_cancel) m_warmup_cancel->cancel(); // m_background waits for it to notice
+	}
+}
 
 bool Device::connect(const std::string &address, int port) {
+	// Finish (or fail) writes queued on the old connection before touching the link.
+	std::shared_ptr<CommandWriter> old_writer;
+	{
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		old_writer.swap(m_writer);
+		if (m_warmup_cancel) m_warmup_cancel->cancel();
+	}
+	old_writer.reset();
 	if (m_client->connect(address, port)) {
-		m_writer = std::make_unique<CommandWriter>(*m_client);
+		m_link->reset();
+		// Battery and the paired-device list moved on while we were away.
+		update_state([](DeviceState& s) { s.invalidate(StateFields::VOLATILE); });
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		m_writer = std::make_shared<CommandWriter>(*m_link, m_rtt, m_executor);
+		m_address = address;
+		if (m_warmup) {
+			m_warmup_cancel = std::make_shared<CancellationSource>();
+			m_background.post([this, warmup = *m_warmup, cancel = m_warmup_cancel->token()] { warm_up(warmup, cancel); });
+		}
 		return true;
 	}
 	return false;
 }
 
-void Device::disconnect() { m_client->disconnect(); }
+void Device::disconnect() {
+	cancel_pending();
+	save_state();
+	m_client->disconnect();
+}
+
+void Device::cancel_pending() {
+	{
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		if (m_warmup_cancel) m_warmup_cancel->cancel();
+	}
+	if (auto w = writer()) w->cancel_pending();
+	m_link->cancel_all();
+}
+
 bool Device::is_connected() const { return m_client->is_connected(); }
 
 // --- Write API Delegation (Complete) ---
-void Device::set_anc_mode(AncMode m) { if (m_writer) m_writer->set_anc_mode(m); }
-void Device::set_anc_level(AncLevel level) { if (m_writer) m_writer->set_anc_level(level); }
-void Device::set_wear_detection(bool e) { if (m_writer) m_writer->set_wear_detection(e); }
-void Device::set_low_latency(bool e) { if (m_writer) m_writer->set_low_latency(e); }
-void Device::set_sound_quality_preference(SoundQualityPreference p) {
-		if (m_writer) m_writer->set_sound_quality_preference(p == SoundQualityPreference::PRIORITIZE_QUALITY);
-	}
-void Device::set_double_tap_action(EarSide s, GestureAction a) { if (m_writer) m_writer->set_double_tap_action(s, a); }
-void Device::set_triple_tap_action(EarSide s, GestureAction a) { if (m_writer) m_writer->set_triple_tap_action(s, a); }
-void Device::set_swipe_action(GestureAction a) { if (m_writer) m_writer->set_swipe_action(a); }
-void Device::set_long_tap_action(EarSide s, GestureAction a) { if (m_writer) m_writer->set_long_tap_action(s, a); }
-void Device::set_long_tap_anc_cycle(EarSide s, AncCycleMode m) { if (m_writer) m_writer->set_long_tap_anc_cycle(s, m); }
-void Device::set_incall_double_tap_action(GestureAction a) { if (m_writer) m_writer->set_incall_double_tap_action(a); }
-void Device::set_equalizer_preset(uint8_t id) { if (m_writer) m_writer->set_equalizer_preset(id); }
-void Device::create_or_update_custom_equalizer(const CustomEqPreset &p) { if (m_writer) m_writer->create_or_update_custom_equalizer(p); }
-void Device::delete_custom_equalizer(const CustomEqPreset &p) { if (m_writer) m_writer->delete_custom_equalizer(p); }
-void Device::create_fake_preset(FakePreset p, uint8_t id) { if (m_writer) m_writer->create_fake_preset(p, id); }
-void Device::set_dual_connect_enabled(bool e) { if (m_writer) m_writer->set_dual_connect_enabled(e); }
-void Device::set_dual_connect_preferred(const std::string &mac) { if (m_writer) m_writer->set_dual_connect_preferred(mac); }
-void Device::dual_connect_action(const std::string &mac, uint8_t code) { if (m_writer) m_writer->dual_connect_action(mac, code); }
+std::shared_ptr<CommandWriter> Device::writer() const {
+	std::lock_guard<std::mutex> lock(m_writer_mutex);
+	return m_writer;
+}
+
+template <typename T, typename Next, typename F>
+void Device::write(uint32_t touched_field, CachedField<T> DeviceState::*field, const RequestOptions& options, Next&& next,
+				   F&& request) {
+	std::function<std::optional<T>(const std::optional<T>&)> outcome(std::forward<Next>(next));
+	if (!options.force) {
+		// A write that would leave the confirmed value as it is needn't go out.
+		auto state = snapshot();
+		const CachedField<T>& cached = (*state).*field;
+		if (!cached.stale() && outcome(cached.value) == cached.value) {
+			++m_writes_elided;
+			if (options.on_done) options.on_done(RequestStatus::OK);
+			return;
+		}
+	}
+	write(touched_field, options, std::forward<F>(request),
+		  // Applied to what's shown, so a write queued behind another builds on that one.
+		  [field, outcome](DeviceState& s, uint64_t stamp) { s.expect(s.*field, outcome((s.*field).shown()), stamp); },
+		  [this, touched_field, field, outcome](uint64_t stamp, RequestStatus status) {
+			  settle(touched_field, field, stamp, status, outcome);
+		  });
+}
+
+template <typename F>
+void Device::write(uint32_t touched_fields, const RequestOptions& options, F&& request,
+				   std::function<void(DeviceState&, uint64_t)> on_send, std::function<void(uint64_t, RequestStatus)> on_result) {
+	auto w = writer();
+	if (!w) {
+		if (options.on_done) options.on_done(RequestStatus::DISCONNECTED);
+		return;
+	}
+	++m_writes_sent;
+	++m_foreground;
+	uint64_t stamp = 0;
+	update_state([&](DeviceState& s) {
+		stamp = s.invalidate(touched_fields);
+		if (on_send) on_send(s, stamp);
+	});
+	RequestOptions sent = options;
+	sent.on_done = [this, stamp, on_result = std::move(on_result), done = options.on_done](RequestStatus status) {
+		foreground_done();
+		if (on_result) on_result(stamp, status);
+		if (done) done(status);
+	};
+	request(*w, sent);
+}
+
+// Runs on the writer's thread once the write stamped 'stamp' is done. The ack itself
+// is an empty frame, so the new value is the write applied to what we had.
+template <typename T, typename Next>
+void Device::settle(uint32_t touched_field, CachedField<T> DeviceState::*field, uint64_t stamp, RequestStatus status,
+					const Next& next) {
+	std::optional<T> value;
+	bool rolled_back = false;
+	update_state([&](DeviceState& s) {
+		CachedField<T>& f = s.*field;
+		if (status != RequestStatus::OK) {
+			// What's pending includes this write; the field stays stale for a read to settle.
+			if (f.pending_at >= stamp) rolled_back = s.drop_pending(f);
+			return;
+		}
+		// Another write (or a reconnect) touched the field since: leave it stale for
+		// that one's ack or a read to settle.
+		bool latest = f.invalidated_at == stamp;
+		if (f.pending && f.pending_at == stamp) {
+			if (latest) value = f.pending;
+			s.drop_pending(f);
+		} else if (latest) {
+			value = next(f.value);
+		}
+		if (value) s.confirm(f, *value, m_clock.now());
+	});
+	if (value) record(*value);
+	if (rolled_back && m_events.wants(DeviceEvents::ROLLBACK)) {
+		auto event = std::make_shared<DeviceEvent>();
+		event->type = DeviceEvents::ROLLBACK;
+		event->rolled_back = touched_field;
+		m_events.dispatch(event);
+	}
+}
+
+// --- What each write leaves behind, given the value before it (nullopt: can't tell) ---
+namespace {
+AncMode mode_of(AncLevel level) {
+	switch (level) {
+		case AncLevel::COMFORTABLE:
+		case AncLevel::NORMAL_CANCELLATION:
+		case AncLevel::ULTRA:
+		case AncLevel::DYNAMIC: return AncMode::CANCELLATION;
+		case AncLevel::VOICE_BOOST:
+		case AncLevel::NORMAL_AWARENESS: return AncMode::AWARENESS;
+		default: return AncMode::UNKNOWN;
+	}
+}
+
+template <typename T>
+auto becomes(T value) {
+	return [value](const std::optional<T>&) { return std::optional<T>(value); };
+}
+
+template <typename M>
+auto gesture_becomes(M GestureSettings::*member, M value) {
+	return [member, value](const std::optional<GestureSettings>& g) -> std::optional<GestureSettings> {
+		if (!g) return std::nullopt;
+		GestureSettings next = *g;
+		next.*member = value;
+		return next;
+	};
+}
+
+template <typename M>
+M GestureSettings::*side_of(EarSide side, M GestureSettings::*left, M GestureSettings::*right) {
+	return side == EarSide::LEFT ? left : right;
+}
+
+// Cached addresses read "aa:bb:..", the write API takes "AABB..".
+std::string plain_mac(const std::string& mac) {
+	std::string plain;
+	for (char c : mac) {
+		if (c != ':') plain += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+	}
+	return plain;
+}
+
+bool same_mac(const std::string& cached, const std::string& mac) { return plain_mac(cached) == plain_mac(mac); }
+} // namespace
+
+void Device::set_anc_mode(AncMode m, const RequestOptions &o) {
+	// Leaving the mode alone keeps the level; a new mode brings the device's own pick of level.
+	write(StateFields::ANC, &DeviceState::anc, o, [m](const std::optional<AncStatus> &a) -> std::optional<AncStatus> {
+		if (a && a->mode == m) return a;
+		if (m == AncMode::NORMAL) return AncStatus{AncMode::NORMAL, AncLevel::UNKNOWN};
+		return std::nullopt;
+	}, [m](CommandWriter &w, const RequestOptions &ro) { w.set_anc_mode(m, ro); });
+}
+void Device::set_anc_level(AncLevel level, const RequestOptions &o) {
+	write(StateFields::ANC, &DeviceState::anc, o, becomes(AncStatus{mode_of(level), level}),
+		  [level](CommandWriter &w, const RequestOptions &ro) { w.set_anc_level(level, ro); });
+}
+void Device::set_wear_detection(bool e, const RequestOptions &o) {
+	write(StateFields::WEAR_DETECTION, &DeviceState::wear_detection, o, becomes(e), [e](CommandWriter &w, const RequestOptions &ro) { w.set_wear_detection(e, ro); });
+}
+void Device::set_low_latency(bool e, const RequestOptions &o) {
+	write(StateFields::LOW_LATENCY, &DeviceState::low_latency, o, becomes(e), [e](CommandWriter &w, const RequestOptions &ro) { w.set_low_latency(e, ro); });
+}
+void Device::set_sound_quality_preference(SoundQualityPreference p, const RequestOptions &o) {
+	write(StateFields::SOUND_QUALITY, &DeviceState::sound_quality, o, becomes(p),
+		  [p](CommandWriter &w, const RequestOptions &ro) { w.set_sound_quality_preference(p == SoundQualityPreference::PRIORITIZE_QUALITY, ro); });
+}
+void Device::set_double_tap_action(EarSide s, GestureAction a, const RequestOptions &o) {
+	write(StateFields::GESTURES, &DeviceState::gestures, o,
+		  gesture_becomes(side_of(s, &GestureSettings::double_tap_left, &GestureSettings::double_tap_right), a),
+		  [s, a](CommandWriter &w, const RequestOptions &ro) { w.set_double_tap_action(s, a, ro); });
+}
+void Device::set_triple_tap_action(EarSide s, GestureAction a, const RequestOptions &o) {
+	write(StateFields::GESTURES, &DeviceState::gestures, o,
+		  gesture_becomes(side_of(s, &GestureSettings::triple_tap_left, &GestureSettings::triple_tap_right), a),
+		  [s, a](CommandWriter &w, const RequestOptions &ro) { w.set_triple_tap_action(s, a, ro); });
+}
+void Device::set_swipe_action(GestureAction a, const RequestOptions &o) {
+	write(StateFields::GESTURES, &DeviceState::gestures, o, gesture_becomes(&GestureSettings::swipe_action, a),
+		  [a](CommandWriter &w, const RequestOptions &ro) { w.set_swipe_action(a, ro); });
+}
+void Device::set_long_tap_action(EarSide s, GestureAction a, const RequestOptions &o) {
+	write(StateFields::GESTURES, &DeviceState::gestures, o,
+		  gesture_becomes(side_of(s, &GestureSettings::long_tap_left, &GestureSettings::long_tap_right), a),
+		  [s, a](CommandWriter &w, const RequestOptions &ro) { w.set_long_tap_action(s, a, ro); });
+}
+void Device::set_long_tap_anc_cycle(EarSide s, AncCycleMode m, const RequestOptions &o) {
+	write(StateFields::GESTURES, &DeviceState::gestures, o,
+		  gesture_becomes(side_of(s, &GestureSettings::long_tap_anc_cycle_left, &GestureSettings::long_tap_anc_cycle_right), m),
+		  [s, m](CommandWriter &w, const RequestOptions &ro) { w.set_long_tap_anc_cycle(s, m, ro); });
+}
+void Device::set_incall_double_tap_action(GestureAction a, const RequestOptions &o) {
+	write(StateFields::GESTURES, &DeviceState::gestures, o, gesture_becomes(&GestureSettings::double_tap_incall, a),
+		  [a](CommandWriter &w, const RequestOptions &ro) { w.set_incall_double_tap_action(a, ro); });
+}
+void Device::set_equalizer_preset(uint8_t id, const RequestOptions &o) {
+	write(StateFields::EQUALIZER, &DeviceState::equalizer, o, [id](const std::optional<EqualizerInfo> &e) -> std::optional<EqualizerInfo> {
+		if (!e) return std::nullopt;
+		EqualizerInfo next = *e;
+		next.current_preset_id = id;
+		return next;
+	}, [id](CommandWriter &w, const RequestOptions &ro) { w.set_equalizer_preset(id, ro); });
+}
+void Device::create_or_update_custom_equalizer(const CustomEqPreset &p, const RequestOptions &o) {
+	// Saving a preset also makes it the current one.
+	write(StateFields::EQUALIZER, &DeviceState::equalizer, o, [p](const std::optional<EqualizerInfo> &e) -> std::optional<EqualizerInfo> {
+		if (!e) return std::nullopt;
+		EqualizerInfo next = *e;
+		auto it = std::find_if(next.custom_presets.begin(), next.custom_presets.end(), [&](const CustomEqPreset &c) { return c.id == p.id; });
+		if (it != next.custom_presets.end()) *it = p;
+		else next.custom_presets.push_back(p);
+		next.current_preset_id = p.id;
+		return next;
+	}, [p](CommandWriter &w, const RequestOptions &ro) { w.create_or_update_custom_equalizer(p, ro); });
+}
+void Device::delete_custom_equalizer(const CustomEqPreset &p, const RequestOptions &o) {
+	write(StateFields::EQUALIZER, &DeviceState::equalizer, o, [id = p.id](const std::optional<EqualizerInfo> &e) -> std::optional<EqualizerInfo> {
+		if (!e) return std::nullopt;
+		EqualizerInfo next = *e;
+		next.custom_presets.erase(std::remove_if(next.custom_presets.begin(), next.custom_presets.end(),
+												 [&](const CustomEqPreset &c) { return c.id == id; }),
+								  next.custom_presets.end());
+		return next;
+	}, [p](CommandWriter &w, const RequestOptions &ro) { w.delete_custom_equalizer(p, ro); });
+}
+// The preset's values live in the writer; re-read to see them.
+void Device::create_fake_preset(FakePreset p, uint8_t id, const RequestOptions &o) {
+	write(StateFields::EQUALIZER, o, [p, id](CommandWriter &w, const RequestOptions &ro) { w.create_fake_preset(p, id, ro); });
+}
+void Device::set_dual_connect_enabled(bool e, const RequestOptions &o) {
+	write(StateFields::DUAL_CONNECT, o, [e](CommandWriter &w, const RequestOptions &ro) { w.set_dual_connect_enabled(e, ro); });
+}
+void Device::set_dual_connect_preferred(const std::string &mac, const RequestOptions &o) {
+	write(StateFields::DUAL_CONNECT, &DeviceState::dual_connect, o, [mac](const std::optional<std::vector<DualConnectDevice>> &list) -> std::optional<std::vector<DualConnectDevice>> {
+		if (!list) return std::nullopt;
+		auto next = *list;
+		bool found = false;
+		for (auto &d : next) {
+			d.is_preferred = same_mac(d.mac_address, mac);
+			found |= d.is_preferred;
+		}
+		if (!found) return std::nullopt;
+		return next;
+	}, [mac](CommandWriter &w, const RequestOptions &ro) { w.set_dual_connect_preferred(mac, ro); });
+}
+// 1 connects, 2 disconnects, 3 unpairs. Always sent: the cached list can lag behind
+// what the phone did on its own (the change event only says *something* changed).
+void Device::dual_connect_action(const std::string &mac, uint8_t code, const RequestOptions &o) {
+	RequestOptions always = o;
+	always.force = true;
+	write(StateFields::DUAL_CONNECT, &DeviceState::dual_connect, always, [mac, code](const std::optional<std::vector<DualConnectDevice>> &list) -> std::optional<std::vector<DualConnectDevice>> {
+		if (!list || code < 1 || code > 3) return std::nullopt;
+		auto next = *list;
+		auto it = std::find_if(next.begin(), next.end(), [&](const DualConnectDevice &d) { return same_mac(d.mac_address, mac); });
+		if (it == next.end()) return std::nullopt;
+		if (code == 1) it->is_connected = true;
+		if (code == 2) it->is_connected = it->is_playing = false;
+		if (code == 3) next.erase(it);
+		return next;
+	}, [mac, code](CommandWriter &w, const RequestOptions &ro) { w.dual_connect_action(mac, code, ro); });
+}
+
+Device::WriteBatch::WriteBatch(std::shared_ptr<CommandWriter> writer) : m_writer(std::move(writer)) {
+	if (m_writer) m_writer->begin_batch();
+}
+Device::WriteBatch::WriteBatch(WriteBatch&& other) noexcept : m_writer(std::move(other.m_writer)) {}
+Device::WriteBatch::~WriteBatch() {
+	if (m_writer) m_writer->end_batch();
+}
+Device::WriteBatch Device::batch_writes() { return WriteBatch(writer()); }
+
+// --- Profiles ---
+uint32_t DeviceProfile::fields() const {
+	uint32_t fields = 0;
+	if (anc) fields |= StateFields::ANC;
+	if (equalizer_preset || !custom_presets.empty()) fields |= StateFields::EQUALIZER;
+	if (dual_connect_enabled || preferred_device) fields |= StateFields::DUAL_CONNECT;
+	if (wear_detection) fields |= StateFields::WEAR_DETECTION;
+	if (low_latency) fields |= StateFields::LOW_LATENCY;
+	if (sound_quality) fields |= StateFields::SOUND_QUALITY;
+	const GestureSettings& g = gestures;
+	for (GestureAction a : {g.double_tap_left, g.double_tap_right, g.double_tap_incall, g.triple_tap_left, g.triple_tap_right,
+							g.long_tap_left, g.long_tap_right, g.swipe_action}) {
+		if (a != GestureAction::UNKNOWN) fields |= StateFields::GESTURES;
+	}
+	if (g.long_tap_anc_cycle_left != AncCycleMode::UNKNOWN || g.long_tap_anc_cycle_right != AncCycleMode::UNKNOWN) {
+		fields |= StateFields::GESTURES;
+	}
+	return fields;
+}
+
+namespace {
+using ProfileSetter = std::function<void(Device&, const RequestOptions&)>;
+
+// One setting of a profile that differs from what the device has.
+struct ProfileWrite {
+	const char* name;
+	uint32_t field;
+	ProfileSetter apply;
+	ProfileSetter undo; // Empty if the old value isn't known
+};
+
+// A profile reads at most a dozen frames; all of them can be on air at once.
+constexpr size_t PROFILE_READ_WINDOW = 16;
+
+// Several actions share a wire code, so an action is as good as any other that
+// reads back the same.
+GestureAction as_read_back(GestureAction action) {
+	return action == GestureAction::UNKNOWN ? action : int_to_gesture_action(gesture_action_to_int(action));
+}
+bool same_setting(GestureAction a, GestureAction b) { return as_read_back(a) == as_read_back(b); }
+bool same_setting(AncCycleMode a, AncCycleMode b) { return a == b; }
+
+// No level asked for (or none in NORMAL): any will do.
+bool same_anc(const AncStatus& wanted, const std::optional<AncStatus>& has) {
+	if (!has || has->mode != wanted.mode) return false;
+	return wanted.mode == AncMode::NORMAL || wanted.level == AncLevel::UNKNOWN || has->level == wanted.level;
+}
+
+void set_anc(Device& device, const AncStatus& anc, const RequestOptions& options) {
+	if (anc.mode == AncMode::NORMAL || anc.level == AncLevel::UNKNOWN) device.set_anc_mode(anc.mode, options);
+	else device.set_anc_level(anc.level, options);
+}
+
+template <typename V, typename Set>
+void plan(std::vector<ProfileWrite>& writes, const char* name, uint32_t field, bool same, const V& to, const std::optional<V>& from,
+		  Set set) {
+	if (same) return;
+	ProfileSetter undo;
+	if (from) undo = [set, value = *from](Device& d, const RequestOptions& o) { set(d, value, o); };
+	writes.push_back({name, field, [set, to](Device& d, const RequestOptions& o) { set(d, to, o); }, std::move(undo)});
+}
+
+template <typename M, typename Set>
+void plan_gesture(std::vector<ProfileWrite>& writes, const char* name, M GestureSettings::*member, const DeviceProfile& profile,
+				  const std::optional<GestureSettings>& before, Set set) {
+	M to = profile.gestures.*member;
+	if (to == M::UNKNOWN) return;
+	std::optional<M> from;
+	if (before && (*before).*member != M::UNKNOWN) from = (*before).*member;
+	plan(writes, name, StateFields::GESTURES, from && same_setting(to, *from), to, from, set);
+}
+
+// The writes that take 'state' to 'profile'; nothing for what's there already.
+// The dual-connect switch isn't in the state, so it comes separately.
+std::vector<ProfileWrite> plan_profile(const DeviceProfile& profile, const DeviceState& state,
+									   const std::optional<bool>& dual_connect_enabled) {
+	std::vector<ProfileWrite> writes;
+	if (profile.anc) {
+		plan(writes, "anc", StateFields::ANC, same_anc(*profile.anc, state.anc.value), *profile.anc, state.anc.value, set_anc);
+	}
+	const auto& eq = state.equalizer.value;
+	for (const CustomEqPreset& preset : profile.custom_presets) {
+		std::optional<CustomEqPreset> from;
+		if (eq) {
+			auto it = std::find_if(eq->custom_presets.begin(), eq->custom_presets.end(),
+								   [&](const CustomEqPreset& c) { return c.id == preset.id; });
+			if (it != eq->custom_presets.end()) from = *it;
+		}
+		plan(writes, "custom_preset", StateFields::EQUALIZER, from == preset, preset, from,
+			 [](Device& d, const CustomEqPreset& p, const RequestOptions& o) { d.create_or_update_custom_equalizer(p, o); });
+		// A preset the device didn't have is undone by deleting it.
+		if (eq && !from) writes.back().undo = [preset](Device& d, const RequestOptions& o) { d.delete_custom_equalizer(preset, o); };
+	}
+	if (profile.equalizer_preset) {
+		std::optional<uint8_t> from;
+		if (state.equalizer.value) from = state.equalizer.value->current_preset_id;
+		plan(writes, "equalizer_preset", StateFields::EQUALIZER, from == profile.equalizer_preset, *profile.equalizer_preset, from,
+			 [](Device& d, uint8_t id, const RequestOptions& o) { d.set_equalizer_preset(id, o); });
+	}
+	if (profile.wear_detection) {
+		plan(writes, "wear_detection", StateFields::WEAR_DETECTION, state.wear_detection.value == profile.wear_detection,
+			 *profile.wear_detection, state.wear_detection.value,
+			 [](Device& d, bool on, const RequestOptions& o) { d.set_wear_detection(on, o); });
+	}
+	if (profile.low_latency) {
+		plan(writes, "low_latency", StateFields::LOW_LATENCY, state.low_latency.value == profile.low_latency, *profile.low_latency,
+			 state.low_latency.value, [](Device& d, bool on, const RequestOptions& o) { d.set_low_latency(on, o); });
+	}
+	if (profile.sound_quality) {
+		plan(writes, "sound_quality", StateFields::SOUND_QUALITY, state.sound_quality.value == profile.sound_quality,
+			 *profile.sound_quality, state.sound_quality.value,
+			 [](Device& d, SoundQualityPreference p, const RequestOptions& o) { d.set_sound_quality_preference(p, o); });
+	}
+	if (profile.dual_connect_enabled) {
+		plan(writes, "dual_connect_enabled", StateFields::DUAL_CONNECT, dual_connect_enabled == profile.dual_connect_enabled,
+			 *profile.dual_connect_enabled, dual_connect_enabled,
+			 [](Device& d, bool on, const RequestOptions& o) { d.set_dual_connect_enabled(on, o); });
+	}
+	if (profile.preferred_device) {
+		std::optional<std::string> from;
+		if (state.dual_connect.value) {
+			for (const auto& source : *state.dual_connect.value) {
+				if (source.is_preferred) from = plain_mac(source.mac_address);
+			}
+		}
+		plan(writes, "preferred_device", StateFields::DUAL_CONNECT, from && same_mac(*from, *profile.preferred_device),
+			 *profile.preferred_device, from,
+			 [](Device& d, const std::string& mac, const RequestOptions& o) { d.set_dual_connect_preferred(mac, o); });
+	}
+
+	const auto& g = state.gestures.value;
+	plan_gesture(writes, "double_tap_left", &GestureSettings::double_tap_left, profile, g,
+				 [](Device& d, GestureAction a, const RequestOptions& o) { d.set_double_tap_action(EarSide::LEFT, a, o); });
+	plan_gesture(writes, "double_tap_right", &GestureSettings::double_tap_right, profile, g,
+				 [](Device& d, GestureAction a, const RequestOptions& o) { d.set_double_tap_action(EarSide::RIGHT, a, o); });
+	// Answering a call reads back as VOICE_ASSISTANT (same code), which the in-call setter doesn't take.
+	plan_gesture(writes, "double_tap_incall", &GestureSettings::double_tap_incall, profile, g,
+				 [](Device& d, GestureAction a, const RequestOptions& o) {
+					 d.set_incall_double_tap_action(a == GestureAction::VOICE_ASSISTANT ? GestureAction::ANSWER_CALL : a, o);
+				 });
+	plan_gesture(writes, "triple_tap_left", &GestureSettings::triple_tap_left, profile, g,
+				 [](Device& d, GestureAction a, const RequestOptions& o) { d.set_triple_tap_action(EarSide::LEFT, a, o); });
+	plan_gesture(writes, "triple_tap_right", &GestureSettings::triple_tap_right, profile, g,
+				 [](Device& d, GestureAction a, const RequestOptions& o) { d.set_triple_tap_action(EarSide::RIGHT, a, o); });
+	plan_gesture(writes, "long_tap_left", &GestureSettings::long_tap_left, profile, g,
+				 [](Device& d, GestureAction a, const RequestOptions& o) { d.set_long_tap_action(EarSide::LEFT, a, o); });
+	plan_gesture(writes, "long_tap_right", &GestureSettings::long_tap_right, profile, g,
+				 [](Device& d, GestureAction a, const RequestOptions& o) { d.set_long_tap_action(EarSide::RIGHT, a, o); });
+	plan_gesture(writes, "long_tap_anc_cycle_left", &GestureSettings::long_tap_anc_cycle_left, profile, g,
+				 [](Device& d, AncCycleMode m, const RequestOptions& o) { d.set_long_tap_anc_cycle(EarSide::LEFT, m, o); });
+	plan_gesture(writes, "long_tap_anc_cycle_right", &GestureSettings::long_tap_anc_cycle_right, profile, g,
+				 [](Device& d, AncCycleMode m, const RequestOptions& o) { d.set_long_tap_anc_cycle(EarSide::RIGHT, m, o); });
+	plan_gesture(writes, "swipe_action", &GestureSettings::swipe_action, profile, g,
+				 [](Device& d, GestureAction a, const RequestOptions& o) { d.set_swipe_action(a, o); });
+	return writes;
+}
+
+uint32_t fields_of(const std::vector<ProfileWrite>& writes) {
+	uint32_t fields = 0;
+	for (const auto& w : writes) fields |= w.field;
+	return fields;
+}
+
+// Makes every write (or its undo) in one batch, so they go out pipelined, and waits
+// for all the acks. Adds a step per write; returns how the first that failed ended.
+RequestStatus write_all(Device& device, const std::vector<ProfileWrite>& writes, bool rollback, const RequestOptions& options,
+						std::vector<ProfileStep>& steps) {
+	struct Acks {
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t left = 0;
+	};
+	auto acks = std::make_shared<Acks>();
+	size_t first = steps.size();
+	for (const auto& w : writes) {
+		if (!rollback || w.undo) steps.push_back(ProfileStep{w.name, w.field, rollback});
+	}
+	acks->left = steps.size() - first;
+
+	IClock& clock = device.clock();
+	auto sent_at = clock.now();
+	{
+		auto batch = device.batch_writes();
+		ProfileStep* step = steps.data() + first;
+		for (const auto& w : writes) {
+			if (rollback && !w.undo) continue;
+			RequestOptions o;
+			o.force = true; // Whatever was there already isn't in 'writes'
+			o.deadline = options.deadline;
+			o.cancel = options.cancel;
+			o.on_done = [acks, step = step++, &clock, sent_at](RequestStatus status) {
+				std::lock_guard<std::mutex> lock(acks->mutex);
+				step->status = status;
+				step->latency = std::chrono::duration_cast<std::chrono::microseconds>(clock.now() - sent_at);
+				if (--acks->left == 0) acks->done.notify_all();
+			};
+			(rollback ? w.undo : w.apply)(device, o);
+		}
+	}
+	std::unique_lock<std::mutex> lock(acks->mutex);
+	acks->done.wait(lock, [&] { return acks->left == 0; });
+	for (size_t i = first; i < steps.size(); ++i) {
+		if (steps[i].status != RequestStatus::OK) return steps[i].status;
+	}
+	return RequestStatus::OK;
+}
+} // namespace
+
+ProfileReport Device::apply_profile(const DeviceProfile& profile, const RequestOptions& options) {
+	ProfileReport report;
+	auto started = m_clock.now();
+	auto phase_started = started;
+	auto lap = [&] {
+		auto now = m_clock.now();
+		auto took = std::chrono::duration_cast<std::chrono::microseconds>(now - phase_started);
+		phase_started = now;
+		return took;
+	};
+	auto failed = [&] { return options.cancel.is_cancelled() ? RequestStatus::CANCELLED : RequestStatus::TIMED_OUT; };
+	// The warmup holds back while this runs.
+	++m_foreground;
+	struct Done {
+		Device* device;
+		~Done() { device->foreground_done(); }
+	} done{this};
+
+	// What the device has now, both for the diff and to go back to.
+	uint32_t touched = profile.fields();
+	uint32_t unknown = touched & snapshot()->stale_fields();
+	bool known = read_fields(unknown, 0, PROFILE_READ_WINDOW, nullptr, options.cancel) == unknown;
+	RequestOptions read_options;
+	read_options.cancel = options.cancel;
+	std::optional<bool> dual_connect_enabled;
+	if (known && profile.dual_connect_enabled) {
+		dual_connect_enabled = get_dual_connect_enabled(read_options);
+		known = dual_connect_enabled.has_value();
+	}
+	report.read_time = lap();
+	if (!known) {
+		report.status = failed();
+	} else {
+		auto writes = plan_profile(profile, *snapshot(), dual_connect_enabled);
+		report.written = fields_of(writes);
+		report.unchanged = touched & ~report.written;
+		report.status = write_all(*this, writes, false, options, report.steps);
+		report.write_time = lap();
+		if (report.status == RequestStatus::OK && !writes.empty()) {
+			// The acks already put the written values in the cache; this asks the device.
+			uint32_t verified = read_fields(report.written, 0, PROFILE_READ_WINDOW, nullptr, options.cancel);
+			if (profile.dual_connect_enabled && (report.written & StateFields::DUAL_CONNECT)) {
+				dual_connect_enabled = get_dual_connect_enabled(read_options);
+				if (!dual_connect_enabled) verified &= ~StateFields::DUAL_CONNECT;
+			}
+			report.mismatched = fields_of(plan_profile(profile, *snapshot(), dual_connect_enabled)) & verified;
+			if (verified != report.written) report.status = failed();
+			else if (report.mismatched) report.status = RequestStatus::REJECTED;
+			report.verify_time = lap();
+		}
+		if (report.status != RequestStatus::OK && !writes.empty()) {
+			// Not under the caller's token or deadline: those may be what ended the apply.
+			bool undoable = std::all_of(writes.begin(), writes.end(), [](const ProfileWrite& w) { return static_cast<bool>(w.undo); });
+			report.rolled_back = write_all(*this, writes, true, {}, report.steps) == RequestStatus::OK && undoable;
+			report.rollback_time = lap();
+			std::cerr << "[DEVICE] Profile apply failed (status " << static_cast<int>(report.status) << "), "
+					  << (report.rolled_back ? "rolled back" : "rollback incomplete") << std::endl;
+		}
+	}
+	report.total_time = std::chrono::duration_cast<std::chrono::microseconds>(m_clock.now() - started);
+	if (report.written) save_state();
+	std::cout << "[DEVICE] Profile: wrote 0x" << std::hex << report.written << ", unchanged 0x" << report.unchanged << std::dec << " in "
+			  << report.total_time.count() / 1000 << " ms" << std::endl;
+	return report;
+}
+
+// --- Link timing ---
+void Device::set_timeout_policy(const TimeoutPolicy &policy) { m_rtt.set_policy(policy); }
+RttStats Device::get_link_rtt_stats() const { return m_rtt.link_stats(); }
+std::map<uint16_t, RttStats> Device::get_command_rtt_stats() const { return m_rtt.command_stats(); }
+WriteStats Device::get_write_stats() const { return WriteStats{m_writes_sent.load(), m_writes_elided.load()}; }
 
 // --- Read API (Complete) ---
-std::optional<DeviceInfo> Device::get_device_info() {
+template <typename T>
+std::optional<T> Device::cached(CachedField<T> DeviceState::*field, const RequestOptions& options) const {
+	if (!options.max_age) return std::nullopt;
+	auto state = snapshot();
+	const CachedField<T>& f = (*state).*field;
+	if (f.pending) return f.pending;
+	if (f.stale() || m_clock.now() - f.confirmed_time > *options.max_age) return std::nullopt;
+	return f.value;
+}
+
+template <typename T>
+void Device::confirm(CachedField<T> DeviceState::*field, T value) {
+	record(value);
+	update_state([&](DeviceState& s) { s.confirm(s.*field, std::move(value), m_clock.now()); });
+}
+
+// Writers take turns on m_state and publish a copy of the result; readers only
+// ever look at the published copies.
+template <typename F>
+void Device::update_state(F&& update) {
+	std::lock_guard<std::mutex> lock(m_state_mutex);
+	update(m_state);
+	m_published.publish(std::make_unique<const DeviceState>(m_state));
+}
+
+std::optional<DeviceInfo> Device::get_device_info(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::device_info, options)) return hit;
 	auto request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_DEVICE_INFO_READ,
 														{7, 9, 10, 15, 24});
-	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_DEVICE_INFO_READ)) {
-		return parse_device_info(*response);
+	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_DEVICE_INFO_READ, options)) {
+		auto info = parse_device_info(*response);
+		confirm(&DeviceState::device_info, info);
+		return info;
 	}
 	return std::nullopt;
 }
 
-std::optional<BatteryInfo> Device::get_battery_info() {
+std::optional<BatteryInfo> Device::get_battery_info(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::battery, options)) return hit;
 	auto
 		request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_BATTERY_READ, {1, 2, 3});
-	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_BATTERY_READ)) {
-		return parse_battery_info(*response);
+	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_BATTERY_READ, options)) {
+		auto info = parse_battery_info(*response);
+		confirm(&DeviceState::battery, info);
+		return info;
 	}
 	return std::nullopt;
 }
 
-std::optional<GestureSettings> Device::get_all_gesture_settings() {
+std::optional<GestureSettings> Device::get_all_gesture_settings(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::gestures, options)) return hit;
 	GestureSettings settings;
-	if (auto r =
-		send_and_get_response(HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_DUAL_TAP_READ,
-																   {1, 2, 4}),
-							  HuaweiCommands::CMD_DUAL_TAP_READ))
-		populate_gesture_settings(settings, *r);
-	if (auto r =
-		send_and_get_response(HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_TRIPLE_TAP_READ,
-																   {1, 2}),
-							  HuaweiCommands::CMD_TRIPLE_TAP_READ))
-		populate_gesture_settings(settings, *r);
-	if (auto r =
-		send_and_get_response(HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_LONG_TAP_SPLIT_READ_BASE,
-																   {1, 2}),
-							  HuaweiCommands::CMD_LONG_TAP_SPLIT_READ_BASE))
-		populate_gesture_settings(settings, *r);
-	if (auto r =
-		send_and_get_response(HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_LONG_TAP_SPLIT_READ_ANC,
-																   {1, 2}),
-							  HuaweiCommands::CMD_LONG_TAP_SPLIT_READ_ANC))
-		populate_gesture_settings(settings, *r);
-	if (auto r =
-		send_and_get_response(HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_SWIPE_READ,
-																   {1}),
-							  HuaweiCommands::CMD_SWIPE_READ))
-		populate_gesture_settings(settings, *r);
+	// Every gesture has its own read; a value is only worth keeping if they all answered.
+	bool answered = true;
+	auto read = [&](std::array<uint8_t, 2> command, const std::vector<uint8_t>& params) {
+		if (!answered) return;
+		auto r = send_and_get_response(HuaweiSppPacket::create_read_request(command, params), command, options);
+		if (r) populate_gesture_settings(settings, *r);
+		answered = r.has_value();
+	};
+	read(HuaweiCommands::CMD_DUAL_TAP_READ, {1, 2, 4});
+	read(HuaweiCommands::CMD_TRIPLE_TAP_READ, {1, 2});
+	read(HuaweiCommands::CMD_LONG_TAP_SPLIT_READ_BASE, {1, 2});
+	read(HuaweiCommands::CMD_LONG_TAP_SPLIT_READ_ANC, {1, 2});
+	read(HuaweiCommands::CMD_SWIPE_READ, {1});
+	if (!answered || options.cancel.is_cancelled()) return std::nullopt; // Half-filled settings are worse than none
+	confirm(&DeviceState::gestures, settings);
 	return settings;
 }
 
-std::vector<DualConnectDevice> Device::get_dual_connect_devices() {
+std::vector<DualConnectDevice> Device::get_dual_connect_devices(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::dual_connect, options)) return *hit;
 	std::vector<DualConnectDevice> devices;
 	auto request =
 		HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_DUAL_CONNECT_ENUMERATE, {1});
-	// Enumerate returns multiple packets, so we can't use the helper
-	if (m_client->send(request.to_bytes())) {
-		for (const auto &bytes : m_client->receive_all()) {
-			if (auto packet = HuaweiSppPacket::from_bytes(bytes)) {
-				if (packet->command_id
-					== bytes_to_u16(HuaweiCommands::CMD_DUAL_CONNECT_ENUMERATE[0],
-									HuaweiCommands::CMD_DUAL_CONNECT_ENUMERATE[1])) {
-					devices.push_back(parse_dual_connect_device(*packet));
-				}
-			}
-		}
+	// Enumerate returns one packet per paired device: take the first through the
+	// helper (timeout + retries), then keep collecting until the device goes quiet.
+	uint16_t enumerate_id = bytes_to_u16(HuaweiCommands::CMD_DUAL_CONNECT_ENUMERATE[0],
+										 HuaweiCommands::CMD_DUAL_CONNECT_ENUMERATE[1]);
+	auto packet = send_and_get_response(request, HuaweiCommands::CMD_DUAL_CONNECT_ENUMERATE, options);
+	while (packet) {
+		devices.push_back(parse_dual_connect_device(*packet));
+		auto quiet_until = m_clock.now() + m_rtt.timeout_for(enumerate_id);
+		if (options.deadline) quiet_until = std::min(quiet_until, *options.deadline);
+		packet = m_link->wait_for(enumerate_id, quiet_until, options.cancel).packet;
 	}
+	if (!devices.empty()) confirm(&DeviceState::dual_connect, devices);
 	return devices;
 }
 
-std::optional<EqualizerInfo> Device::get_equalizer_info() {
+std::optional<EqualizerInfo> Device::get_equalizer_info(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::equalizer, options)) return hit;
 	auto request =
 		HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_EQUALIZER_READ, {2, 3, 8});
-	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_EQUALIZER_READ)) {
+	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_EQUALIZER_READ, options)) {
 		EqualizerInfo info;
 		populate_equalizer_info(info, *response);
+		confirm(&DeviceState::equalizer, info);
 		return info;
 	}
 	return std::nullopt;
 }
 
-std::optional<AncStatus> Device::get_anc_status() {
+std::optional<AncStatus> Device::get_anc_status(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::anc, options)) return hit;
 	auto request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_ANC_READ, {1});
-	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_ANC_READ)) {
-		return parse_anc_status(*response);
+	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_ANC_READ, options)) {
+		auto status = parse_anc_status(*response);
+		confirm(&DeviceState::anc, status);
+		return status;
 	}
 	return std::nullopt;
 }
 
-std::optional<bool> Device::get_wear_detection_status() {
+std::optional<bool> Device::get_wear_detection_status(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::wear_detection, options)) return hit;
 	auto request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_AUTO_PAUSE_READ, {1});
-	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_AUTO_PAUSE_READ)) {
-		if (auto p = response->get_param(1); p && !p->empty()) {
-			return (*p)[0] == 1;
+	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_AUTO_PAUSE_READ, options)) {
+		if (auto on = flag_param(*response, 1)) {
+			confirm(&DeviceState::wear_detection, *on);
+			return on;
 		}
 	}
 	return std::nullopt;
 }
 
-std::optional<bool> Device::get_low_latency_status() {
+std::optional<bool> Device::get_low_latency_status(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::low_latency, options)) return hit;
 	auto request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_LOW_LATENCY_READ, {2});
-	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_LOW_LATENCY_READ)) {
-		if (auto p = response->get_param(2); p && !p->empty()) {
-			return (*p)[0] == 1;
+	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_LOW_LATENCY_READ, options)) {
+		if (auto on = flag_param(*response, 2)) {
+			confirm(&DeviceState::low_latency, *on);
+			return on;
 		}
 	}
 	return std::nullopt;
 }
 
-std::optional<SoundQualityPreference> Device::get_sound_quality_preference() {
+std::optional<bool> Device::get_dual_connect_enabled(const RequestOptions& options) {
+	auto request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_DUAL_CONNECT_ENABLED_READ, {1});
+	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_DUAL_CONNECT_ENABLED_READ, options)) {
+		return flag_param(*response, 1);
+	}
+	return std::nullopt;
+}
+
+std::optional<SoundQualityPreference> Device::get_sound_quality_preference(const RequestOptions& options) {
+	if (auto hit = cached(&DeviceState::sound_quality, options)) return hit;
 	auto
 		request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_SOUND_QUALITY_READ, {1});
-	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_SOUND_QUALITY_READ)) {
-		if (auto p = response->get_param(2); p && !p->empty()) {
-			return (*p)[0] == 1 ? SoundQualityPreference::PRIORITIZE_QUALITY
-								: SoundQualityPreference::PRIORITIZE_CONNECTION;
+	if (auto response = send_and_get_response(request, HuaweiCommands::CMD_SOUND_QUALITY_READ, options)) {
+		if (auto quality = flag_param(*response, 2)) {
+			auto pref = sound_quality_of(*quality);
+			confirm(&DeviceState::sound_quality, pref);
+			return pref;
 		}
 	}
 	return std::nullopt;
 }
 
+// --- Cached state & link health ---
+Device::StateSnapshot Device::snapshot() const { return m_published.read(); }
+
+DeviceState Device::get_state() const { return *snapshot(); }
+
+StateDelta Device::get_state_changes(uint64_t since) const { return snapshot()->delta_since(since); }
+
+uint32_t Device::resync(const RequestOptions& options) {
+	uint32_t stale = snapshot()->stale_fields();
+	std::cout << "[DEVICE] Resyncing stale fields 0x" << std::hex << stale << std::dec << std::endl;
+
+	// Each getter confirms its field in the cache on success.
+	uint32_t refreshed = 0;
+	auto refresh = [&](uint32_t bit, auto&& read) {
+		if ((stale & bit) && !options.expired(m_clock.now()) && read()) refreshed |= bit;
+	};
+	refresh(StateFields::DEVICE_INFO, [&] { return get_device_info(options).has_value(); });
+	refresh(StateFields::BATTERY, [&] { return get_battery_info(options).has_value(); });
+	refresh(StateFields::ANC, [&] { return get_anc_status(options).has_value(); });
+	refresh(StateFields::WEAR_DETECTION, [&] { return get_wear_detection_status(options).has_value(); });
+	refresh(StateFields::LOW_LATENCY, [&] { return get_low_latency_status(options).has_value(); });
+	refresh(StateFields::SOUND_QUALITY, [&] { return get_sound_quality_preference(options).has_value(); });
+	refresh(StateFields::EQUALIZER, [&] { return get_equalizer_info(options).has_value(); });
+	refresh(StateFields::GESTURES, [&] { return get_all_gesture_settings(options).has_value(); });
+	refresh(StateFields::DUAL_CONNECT, [&] { return !get_dual_connect_devices(options).empty(); });
+	if (refreshed) save_state();
+	return refreshed;
+}
+
+RequestStatus Device::probe(const RequestOptions& options) {
+	uint16_t battery_id = bytes_to_u16(HuaweiCommands::CMD_BATTERY_READ[0], HuaweiCommands::CMD_BATTERY_READ[1]);
+	auto request = HuaweiSppPacket::create_read_request(HuaweiCommands::CMD_BATTERY_READ, {1, 2, 3});
+
+	auto sent_at = m_clock.now();
+	auto deadline = sent_at + m_rtt.timeout_for(battery_id);
+	if (options.deadline) deadline = std::min(deadline, *options.deadline);
+
+	auto result = m_link->transact(request, battery_id, deadline, options.cancel);
+	if (result) {
+		auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(m_clock.now() - sent_at);
+		m_rtt.add_sample(battery_id, rtt);
+		record_rtt(rtt);
+		confirm(&DeviceState::battery, parse_battery_info(*result.packet));
+	} else if (result.status == RequestStatus::TIMED_OUT) {
+		m_rtt.record_timeout(battery_id);
+	}
+	return result.status;
+}
+
+std::chrono::milliseconds Device::probe_timeout() const {
+	return m_rtt.timeout_for(bytes_to_u16(HuaweiCommands::CMD_BATTERY_READ[0], HuaweiCommands::CMD_BATTERY_READ[1]));
+}
+
+std::chrono::steady_clock::time_point Device::last_activity() const { return m_link->last_receive(); }
+
+// --- Last-known state ---
+bool Device::restore_state(const std::string& mac) {
+	StateStore* store = m_state_store;
+	if (!store) return false;
+	auto saved = store->find(mac);
+	if (!saved) return false;
+	uint32_t restored = 0;
+	update_state([&](DeviceState& s) { restored = s.restore(saved->state, saved->fields, StateFields::STATIC); });
+	std::cout << "[DEVICE] Restored fields 0x" << std::hex << restored << std::dec << " of " << saved->mac << " saved at "
+			  << saved->saved_at_ms << std::endl;
+	// Nothing new to save until something is confirmed.
+	if (restored) m_saved_version = snapshot()->generation;
+	return restored != 0;
+}
+
+bool Device::save_state() {
+	StateStore* store = m_state_store;
+	if (!store) return false;
+	auto state = snapshot();
+	if (!state->changes_since(m_saved_version)) return true;
+	std::string mac;
+	{
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		mac = m_address;
+	}
+	if (!store->save(mac, *state)) return false;
+	m_saved_version = state->generation;
+	return true;
+}
+
+// --- Warmup ---
+namespace {
+struct WarmupRead {
+	uint32_t field;
+	std::array<uint8_t, 2> command;
+	std::vector<uint8_t> params;
+};
+
+// The requests the getters send, one field at a time; gestures take five.
+const std::vector<WarmupRead>& warmup_reads() {
+	static const std::vector<WarmupRead> reads = {
+		{StateFields::DEVICE_INFO, HuaweiCommands::CMD_DEVICE_INFO_READ, {7, 9, 10, 15, 24}},
+		{StateFields::BATTERY, HuaweiCommands::CMD_BATTERY_READ, {1, 2, 3}},
+		{StateFields::ANC, HuaweiCommands::CMD_ANC_READ, {1}},
+		{StateFields::WEAR_DETECTION, HuaweiCommands::CMD_AUTO_PAUSE_READ, {1}},
+		{StateFields::LOW_LATENCY, HuaweiCommands::CMD_LOW_LATENCY_READ, {2}},
+		{StateFields::SOUND_QUALITY, HuaweiCommands::CMD_SOUND_QUALITY_READ, {1}},
+		{StateFields::EQUALIZER, HuaweiCommands::CMD_EQUALIZER_READ, {2, 3, 8}},
+		{StateFields::GESTURES, HuaweiCommands::CMD_DUAL_TAP_READ, {1, 2, 4}},
+		{StateFields::GESTURES, HuaweiCommands::CMD_TRIPLE_TAP_READ, {1, 2}},
+		{StateFields::GESTURES, HuaweiCommands::CMD_LONG_TAP_SPLIT_READ_BASE, {1, 2}},
+		{StateFields::GESTURES, HuaweiCommands::CMD_LONG_TAP_SPLIT_READ_ANC, {1, 2}},
+		{StateFields::GESTURES, HuaweiCommands::CMD_SWIPE_READ, {1}},
+		{StateFields::DUAL_CONNECT, HuaweiCommands::CMD_DUAL_CONNECT_ENUMERATE, {1}},
+	};
+	return reads;
+}
+
+uint16_t id_of(const std::array<uint8_t, 2>& command) { return bytes_to_u16(command[0], command[1]); }
+} // namespace
+
+void Device::set_warmup(std::optional<WarmupOptions> warmup) {
+	std::lock_guard<std::mutex> lock(m_writer_mutex);
+	m_warmup = warmup;
+}
+
+void Device::foreground_done() {
+	if (--m_foreground > 0) return;
+	std::function<void()> parked;
+	{
+		std::lock_guard<std::mutex> lock(m_foreground_mutex);
+		parked.swap(m_parked_warmup);
+	}
+	if (parked) m_background.post(std::move(parked));
+}
+
+// Runs on m_background after a connect. Single attempts: what doesn't come back
+// stays stale for resync() or the UI's own read.
+void Device::warm_up(const WarmupOptions& warmup, const CancellationToken& cancel) {
+	WarmupRun run{warmup, cancel, m_clock.now()};
+	run.wanted = run.left = warmup.fields & snapshot()->stale_fields();
+	resume_warmup(std::move(run));
+}
+
+// Yielding doesn't wait on the thread: the caller's write may need a thread of the
+// same executor to finish. What's left is parked until foreground_done() wakes it.
+void Device::resume_warmup(WarmupRun run) {
+	uint32_t yielded = 0;
+	run.warmed |= read_fields(run.left, run.options.hot, run.options.window, &yielded, run.cancel);
+	if (yielded && !run.cancel.is_cancelled()) {
+		run.left = yielded;
+		std::lock_guard<std::mutex> lock(m_foreground_mutex);
+		auto resume = [this, run] { resume_warmup(run); };
+		// Went idle since read_fields() looked: nobody is left to wake us.
+		if (m_foreground == 0) m_background.post(resume);
+		else m_parked_warmup = resume;
+		return;
+	}
+	if (run.warmed) save_state();
+	std::cout << "[DEVICE] Warmup filled 0x" << std::hex << run.warmed << " of 0x" << run.wanted << std::dec << " in "
+			  << std::chrono::duration_cast<std::chrono::milliseconds>(m_clock.now() - run.started).count() << " ms"
+			  << (run.cancel.is_cancelled() ? " (stopped)" : "") << std::endl;
+}
+
+// Keeps up to 'window' reads on air and takes the answers in the order they were
+// sent (the headset answers in order); a field goes into the cache once all its
+// reads are in.
+uint32_t Device::read_fields(uint32_t fields, uint32_t first, size_t window, uint32_t* yielded, const CancellationToken& cancel) {
+	CapabilityTable* capabilities = m_capabilities;
+	std::string model;
+	if (capabilities) {
+		if (const auto& info = snapshot()->device_info.value) model = CapabilityTable::key_for(*info);
+	}
+	std::vector<const WarmupRead*> queue;
+	std::map<uint32_t, int> outstanding; // Reads per field not answered yet
+	for (uint32_t pass : {first, ~first}) {
+		for (const auto& read : warmup_reads()) {
+			if (!(read.field & fields & pass)) continue;
+			if (capabilities && capabilities->support(model, id_of(read.command)) == CommandSupport::UNSUPPORTED) {
+				fields &= ~read.field;
+				continue;
+			}
+			queue.push_back(&read);
+			++outstanding[read.field];
+		}
+	}
+
+	struct InFlight {
+		const WarmupRead* read;
+		Link::Pending pending;
+		Link::Clock::time_point sent_at;
+	};
+	std::deque<InFlight> in_flight;
+	std::map<uint32_t, std::vector<HuaweiSppPacket>> answers;
+	uint32_t failed = 0, filled = 0;
+	size_t next = 0;
+	window = std::max<size_t>(1, window);
+	while (!cancel.is_cancelled()) {
+		// Top the window up, unless yielding and the caller has something on air: theirs goes first.
+		while (next < queue.size() && in_flight.size() < window && !(yielded && m_foreground > 0)) {
+			const WarmupRead* read = queue[next++];
+			auto request = HuaweiSppPacket::create_read_request(read->command, read->params);
+			in_flight.push_back({read, m_link->start(request, id_of(read->command), cancel), m_clock.now()});
+		}
+		if (in_flight.empty()) {
+			if (next == queue.size()) break;
+			// Held back for the caller with nothing of ours on air: hand back what's left.
+			for (const auto& [field, count] : outstanding) {
+				if (count > 0 && !(failed & field)) *yielded |= field;
+			}
+			break;
+		}
+
+		InFlight front = in_flight.front();
+		in_flight.pop_front();
+		uint16_t id = id_of(front.read->command);
+		auto result = m_link->finish(front.pending, m_clock.now() + m_rtt.timeout_for(id), cancel);
+		if (result.status == RequestStatus::CANCELLED || result.status == RequestStatus::DISCONNECTED) break;
+		uint32_t field = front.read->field;
+		if (result) {
+			// Answers come back in order, so this is the frame's own round trip give or take
+			// the time spent on the one before it; the quiet wait after DUAL_CONNECT needs it.
+			auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(m_clock.now() - front.sent_at);
+			m_rtt.add_sample(id, rtt);
+			record_rtt(rtt);
+			answers[field].push_back(std::move(*result.packet));
+			if (capabilities) capabilities->record_answer(model, id);
+		} else {
+			failed |= field;
+		}
+		if (--outstanding[field] == 0 && !(failed & field) && apply_warmup_answers(field, answers[field], cancel)) filled |= field;
+	}
+	// Whatever is still on air was started, so it has to be finished.
+	for (const auto& f : in_flight) m_link->finish(f.pending, m_clock.now(), cancel);
+	return filled;
+}
+
+// Same parsing as the getters. Returns false if the answers didn't make a value.
+bool Device::apply_warmup_answers(uint32_t field, const std::vector<HuaweiSppPacket>& answers, const CancellationToken& cancel) {
+	const HuaweiSppPacket& first = answers.front();
+	switch (field) {
+		case StateFields::DEVICE_INFO: confirm(&DeviceState::device_info, parse_device_info(first)); return true;
+		case StateFields::BATTERY: confirm(&DeviceState::battery, parse_battery_info(first)); return true;
+		case StateFields::ANC: confirm(&DeviceState::anc, parse_anc_status(first)); return true;
+		case StateFields::WEAR_DETECTION: {
+			auto on = flag_param(first, 1);
+			if (on) confirm(&DeviceState::wear_detection, *on);
+			return on.has_value();
+		}
+		case StateFields::LOW_LATENCY: {
+			auto on = flag_param(first, 2);
+			if (on) confirm(&DeviceState::low_latency, *on);
+			return on.has_value();
+		}
+		case StateFields::SOUND_QUALITY: {
+			auto quality = flag_param(first, 2);
+			if (quality) confirm(&DeviceState::sound_quality, sound_quality_of(*quality));
+			return quality.has_value();
+		}
+		case StateFields::EQUALIZER: {
+			EqualizerInfo info;
+			populate_equalizer_info(info, first);
+			confirm(&DeviceState::equalizer, info);
+			return true;
+		}
+		case StateFields::GESTURES: {
+			GestureSettings settings;
+			for (const auto& answer : answers) populate_gesture_settings(settings, answer);
+			confirm(&DeviceState::gestures, settings);
+			return true;
+		}
+		case StateFields::DUAL_CONNECT: {
+			// One frame per paired device; the rest follow the first (see get_dual_connect_devices).
+			std::vector<DualConnectDevice> devices{parse_dual_connect_device(first)};
+			uint16_t enumerate_id = first.command_id;
+			while (auto more = m_link->wait_for(enumerate_id, m_clock.now() + m_rtt.timeout_for(enumerate_id), cancel).packet) {
+				devices.push_back(parse_dual_connect_device(*more));
+			}
+			confirm(&DeviceState::dual_connect, devices);
+			return true;
+		}
+		default: return false;
+	}
+}
+
+// --- Notifications ---
+void Device::poll_notifications() { m_link->poll(); }
+
+uint64_t Device::subscribe(uint32_t events, EventCallback callback) { return m_events.subscribe(events, std::move(callback)); }
+
+void Device::unsubscribe(uint64_t id) { m_events.unsubscribe(id); }
+
+// Runs on the thread that read the frame (see Link::set_unsolicited_handler).
+// The state cache is updated whether or not anybody is subscribed.
+void Device::handle_notification(const HuaweiSppPacket& packet) {
+	auto is = [&](const std::array<uint8_t, 2>& cmd) { return packet.command_id == bytes_to_u16(cmd[0], cmd[1]); };
+
+	auto event = std::make_shared<DeviceEvent>();
+	if (is(HuaweiCommands::CMD_BATTERY_NOTIFY)) {
+		// Same parameters as the answer to CMD_BATTERY_READ.
+		event->type = DeviceEvents::BATTERY;
+		event->battery = parse_battery_info(packet);
+		confirm(&DeviceState::battery, *event->battery);
+	} else if (is(HuaweiCommands::CMD_ANC_NOTIFY)) {
+		// Shared by the ANC button and the wear sensor: param 1 as in CMD_ANC_READ, param 8 in-ear.
+		event->type = DeviceEvents::ANC;
+		if (auto p = packet.get_param(1); p && p->size() == 2) {
+			event->anc = parse_anc_status(packet);
+			confirm(&DeviceState::anc, *event->anc);
+		}
+		if (auto p = packet.get_param(8); p && !p->empty()) event->in_ear = (*p)[0] == 1;
+	} else if (is(HuaweiCommands::CMD_DUAL_CONNECT_CHANGE_EVENT)) {
+		event->type = DeviceEvents::DUAL_CONNECT;
+		if (packet.get_param(4)) event->dual_connect = parse_dual_connect_device(packet);
+		// Only says something changed; re-read for the full list
+		update_state([](DeviceState& s) { s.invalidate(StateFields::DUAL_CONNECT); });
+	}
+
+	if (!m_events.wants(event->type | DeviceEvents::RAW)) return;
+	event->frame = packet;
+	m_events.dispatch(event);
+}
+
+// --- Telemetry ---
+static int64_t telemetry_time(IClock& clock) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(clock.now().time_since_epoch()).count();
+}
+
+void Device::record(const BatteryInfo& info) {
+	TelemetryStore* store = m_telemetry;
+	if (!store) return;
+	int64_t now = telemetry_time(m_clock);
+	store->append(TelemetryMetrics::BATTERY_LEFT, now, info.left);
+	store->append(TelemetryMetrics::BATTERY_RIGHT, now, info.right);
+	store->append(TelemetryMetrics::BATTERY_CASE, now, info.case_level);
+}
+
+void Device::record(const AncStatus& status) {
+	if (TelemetryStore* store = m_telemetry) store->append(TelemetryMetrics::ANC_MODE, telemetry_time(m_clock), static_cast<int64_t>(status.mode));
+}
+
+void Device::record(const std::vector<DualConnectDevice>& devices) {
+	TelemetryStore* store = m_telemetry;
+	if (!store) return;
+	// The source that's playing, else the first one connected.
+	auto source = std::find_if(devices.begin(), devices.end(), [](const DualConnectDevice& d) { return d.is_playing; });
+	if (source == devices.end()) {
+		source = std::find_if(devices.begin(), devices.end(), [](const DualConnectDevice& d) { return d.is_connected; });
+	}
+	int64_t tag = 0;
+	if (source != devices.end() && source->mac_address.size() >= 5) {
+		const std::string& mac = source->mac_address;
+		tag = std::strtol((mac.substr(mac.size() - 5, 2) + mac.substr(mac.size() - 2)).c_str(), nullptr, 16);
+	}
+	store->append(TelemetryMetrics::DUAL_CONNECT, telemetry_time(m_clock), tag);
+}
+
+void Device::record_rtt(std::chrono::microseconds rtt) {
+	if (TelemetryStore* store = m_telemetry) store->append(TelemetryMetrics::LINK_RTT, telemetry_time(m_clock), rtt.count() / 100);
+}
+
 // --- Private Helpers ---
-std::optional<HuaweiSppPacket> Device::send_and_get_response(const HuaweiSppPacket& request, const std::array<uint8_t, 2>& expected_response_cmd) {
+std::optional<HuaweiSppPacket> Device::send_and_get_response(const HuaweiSppPacket& request, const std::array<uint8_t, 2>& expected_response_cmd,
+															 const RequestOptions& options, bool idempotent) {
 	// We expect the response to have the same command ID as the request.
 	uint16_t expected_id = bytes_to_u16(expected_response_cmd[0], expected_response_cmd[1]);
 
-	std::cout << "[DEVICE] Sending request for command 0x" << std::hex << request.command_id << " and waiting for response 0x" << expected_id << std::dec << std::endl;
+	++m_foreground;
+	struct Done {
+		Device* device;
+		~Done() { device->foreground_done(); }
+	} done{this};
 
-	if (!m_client->send(request.to_bytes())) {
-		std::cerr << "[DEVICE] ERROR: m_client->send() returned false." << std::endl;
-		return std::nullopt;
+	CapabilityTable* capabilities = m_capabilities;
+	std::string model;
+	if (capabilities) {
+		if (const auto& info = snapshot()->device_info.value) model = CapabilityTable::key_for(*info);
+		if (!options.force && capabilities->support(model, expected_id) == CommandSupport::UNSUPPORTED) {
+			std::cout << "[DEVICE] Command 0x" << std::hex << expected_id << std::dec << " isn't supported by " << model
+					  << ", not sending." << std::endl;
+			return std::nullopt;
+		}
 	}
+	bool link_alive = m_clock.now() - m_link->last_receive() < LINK_ALIVE_WINDOW;
+	TimeoutPolicy policy = m_rtt.policy();
+	int attempts = 1 + (idempotent ? std::max(0, policy.max_retries) : 0);
+
+	// The timeout comes from the RTT estimate for this command instead of a fixed 2 s,
+	// so a lost frame costs about one RTO and a slow link gets more patience.
+	auto timeout = m_rtt.timeout_for(expected_id);
+
+	for (int attempt = 0; attempt < attempts; ++attempt) {
+		auto sent_at = m_clock.now();
+		if (options.expired(sent_at)) break;
+
+		// The caller's deadline wins over the RTO; hitting it is not the link's fault.
+		auto attempt_deadline = sent_at + timeout;
+		bool caller_deadline = options.deadline && *options.deadline < attempt_deadline;
+		if (caller_deadline) attempt_deadline = *options.deadline;
 
-	// Instead of polling once, we now have a dedicated loop with a timeout.
-	// This gives the system time to clear out old notifications and receive the correct packet.
-	const int timeout_ms = 2000; // 2-second timeout.
-	auto start_time = std::chrono::steady_clock::now();
-
-	while (std::chrono::steady_clock::now() - start_time < std::chrono::milliseconds(timeout_ms)) {
-		// The receive_all() function itself has a short internal timeout.
-		// We call it repeatedly.
-		auto responses_bytes = m_client->receive_all();
-
-		if (!responses_bytes.empty()) {
-			std::cout << "[DEVICE] Received " << responses_bytes.size() << " packet(s) from client." << std::endl;
-		}
-
-		// Now, iterate through all the packets we just received.
-		for (const auto& bytes : responses_bytes) {
-			if (auto packet = HuaweiSppPacket::from_bytes(bytes)) {
-				// Check if this packet is the one we are looking for.
-				if (packet->command_id == expected_id) {
-					std::cout << "[DEVICE] SUCCESS: Found matching response packet for command 0x" << std::hex << expected_id << std::dec << std::endl;
-					return packet; // Success! Return the correct packet.
-				} else {
-					// This is a valid packet, but not the one we want.
-					// It's likely a notification. We log it and ignore it.
-					std::cout << "[DEVICE] Ignoring unrelated packet for command 0x" << std::hex << packet->command_id << std::dec << std::endl;
-				}
+		std::cout << "[DEVICE] Sending request for command 0x" << std::hex << request.command_id << " and waiting for response 0x" << expected_id << std::dec
+				  << " (attempt " << attempt + 1 << ", timeout " << timeout.count() << "ms)" << std::endl;
+
+		auto result = m_link->transact(request, expected_id, attempt_deadline, options.cancel);
+		if (result) {
+			// Karn's rule: an answer to a retransmitted request is ambiguous, don't sample it.
+			if (attempt == 0) {
+				auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(m_clock.now() - sent_at);
+				m_rtt.add_sample(expected_id, rtt);
+				record_rtt(rtt);
 			}
+			std::cout << "[DEVICE] SUCCESS: Found matching response packet for command 0x" << std::hex << expected_id << std::dec << std::endl;
+			if (capabilities) capabilities->record_answer(model, expected_id);
+			return std::move(result.packet);
+		}
+
+		if (result.status == RequestStatus::CANCELLED) {
+			std::cout << "[DEVICE] Request for command 0x" << std::hex << expected_id << std::dec << " cancelled." << std::endl;
+			return std::nullopt;
+		}
+		if (result.status == RequestStatus::DISCONNECTED) {
+			std::cerr << "[DEVICE] ERROR: Link is down, giving up on command 0x" << std::hex << expected_id << std::dec << std::endl;
+			return std::nullopt;
+		}
+		if (caller_deadline) break;
+
+		m_rtt.record_timeout(expected_id);
+		if (attempt + 1 < attempts) {
+			m_rtt.record_retry(expected_id);
+			timeout = std::min(timeout * 2, std::chrono::milliseconds(policy.max)); // Exponential backoff
+		} else if (capabilities && link_alive) {
+			// Every attempt went unanswered by a headset that was talking a moment ago.
+			capabilities->record_miss(model, expected_id);
 		}
-		// If we didn't find our packet, sleep for a very short duration
-		// to prevent a busy-wait loop that hogs the CPU.
-		std::this_thread::sleep_for(std::chrono::milliseconds(50));
 	}
 
-	// If we exit the loop, it means the 2-second timeout was reached.
-	std::cerr << "[DEVICE] ERROR: Timed out after " << timeout_ms << "ms waiting for response to command 0x" << std::hex << expected_id << std::dec << std::endl;
+	std::cerr << "[DEVICE] ERROR: No response to command 0x" << std::hex << expected_id << std::dec << std::endl;
 	return std::nullopt;
 }
 
@@ -336,12 +1337,12 @@ DualConnectDevice Device::parse_dual_connect_device(const HuaweiSppPacket &packe
 		}
 		device.mac_address = mac_ss.str();
 	}
-	if (auto p = packet.get_param(5); !p->empty()) {
+	if (auto p = packet.get_param(5); p && !p->empty()) {
 		device.is_connected = ((*p)[0] > 0);
 		device.is_playing = ((*p)[0] == 9);
 	}
-	if (auto p = packet.get_param(7); !p->empty()) device.is_preferred = ((*p)[0] == 1);
-	if (auto p = packet.get_param(8); !p->empty()) device.can_auto_connect = ((*p)[0] == 1);
+	if (auto p = packet.get_param(7); p && !p->empty()) device.is_preferred = ((*p)[0] == 1);
+	if (auto p = packet.get_param(8); p && !p->empty()) device.can_auto_connect = ((*p)[0] == 1);
 	return device;
 }
 
@@ -352,7 +1353,7 @@ void Device::populate_equalizer_info(EqualizerInfo &info, const HuaweiSppPacket
 
 	if (auto p = packet.get_param(2); !p->empty()) info.current_preset_id = (*p)[0];
 	if (auto p = packet.get_param(3)) info.built_in_preset_ids = *p;
-	if (auto p = packet.get_param(8); !p->empty()) {
+	if (auto p = packet.get_param(8); p && !p->empty()) {
 		const auto &blob = *p;
 		size_t pos = 0;
 		while (pos < blob.size()) {
@@ -3,58 +3,326 @@
 #include "platform/bluetooth_interface.h"
 #include "protocol/huawei_packet.h"
 #include "core/types.h"
+#include "core/capability_table.h"
+#include "core/clock.h"
+#include "core/device_events.h"
+#include "core/device_state.h"
+#include "core/executor.h"
+#include "core/rcu_cell.h"
+#include "core/request_options.h"
+#include "core/rtt_estimator.h"
+#include "core/state_store.h"
+#include "core/strand.h"
+#include "core/telemetry_store.h"
+#include <atomic>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <chrono>
 #include <vector>
 #include <string>
 
 class CommandWriter;
+class Link;
+
+struct WriteStats {
+  uint64_t sent = 0;
+  uint64_t elided = 0; // Skipped: the device had confirmed that value already
+};
+
+struct WarmupOptions {
+  // What to read after connecting (StateFields bits; only what's stale is read),
+  // and which of those go first: what the first screen shows.
+  uint32_t fields = StateFields::ALL;
+  uint32_t hot = StateFields::BATTERY | StateFields::ANC;
+  // Requests on air at once. Kept small so a user request never queues behind many.
+  size_t window = 4;
+};
+
+// Settings to switch to in one go (Device::apply_profile). What's left empty, and
+// gestures left UNKNOWN, stay as they are.
+struct DeviceProfile {
+  std::optional<AncStatus> anc; // Level UNKNOWN: the mode, at whatever level the device picks
+  std::optional<uint8_t> equalizer_preset;
+  // Saved before equalizer_preset is set; saving one also makes it the current preset.
+  std::vector<CustomEqPreset> custom_presets;
+  GestureSettings gestures;
+  std::optional<bool> wear_detection;
+  std::optional<bool> low_latency;
+  std::optional<SoundQualityPreference> sound_quality;
+  std::optional<bool> dual_connect_enabled;
+  std::optional<std::string> preferred_device; // Dual-connect source, "AABBCCDDEEFF"
+
+  uint32_t fields() const; // StateFields bits it sets
+};
+
+// One write of a profile apply (or of its rollback) and how it went.
+struct ProfileStep {
+  std::string name; // The setting, e.g. "double_tap_left"
+  uint32_t field = 0;
+  bool rollback = false;
+  RequestStatus status = RequestStatus::TIMED_OUT;
+  std::chrono::microseconds latency{0}; // From the batch going out to this write's ack
+};
+
+struct ProfileReport {
+  // OK once everything was written and read back as asked. REJECTED if the device
+  // acked but reads back something else; otherwise how the first failed read or write ended.
+  RequestStatus status = RequestStatus::OK;
+  uint32_t written = 0;    // Fields with at least one write
+  uint32_t unchanged = 0;  // Fields that already read as the profile has them
+  uint32_t mismatched = 0; // Written, but read back different
+  bool rolled_back = false; // Every write was undone, acked
+  std::vector<ProfileStep> steps;
+  std::chrono::microseconds read_time{0}, write_time{0}, verify_time{0}, rollback_time{0}, total_time{0};
+};
 
 class Device {
 public:
-    Device(std::unique_ptr<IBluetoothSPPClient> bt_client);
+    // Background work (the command writer, the warmup) runs on 'executor'. It waits on the
+    // headset, so a host passing its own should give it threads that may block.
+    // All timeouts and deadlines are measured on 'clock'.
+    Device(std::unique_ptr<IBluetoothSPPClient> bt_client, IExecutor& executor = io_executor(), IClock& clock = steady_clock());
     ~Device();
 
     bool connect(const std::string& address, int port = 1);
+    // Cancels queued writes and wakes blocked reads before closing the socket,
+    // so it returns in bounded time even with a full write queue.
     void disconnect();
+    // Same, without closing the link (e.g. the page that issued the requests went away).
+    void cancel_pending();
     bool is_connected() const;
 
+    // Every read and write takes optional RequestOptions: an absolute deadline and a
+    // cancellation token. A cancelled read returns std::nullopt right away. A read
+    // with max_age may be answered from the state cache, pending writes included.
+
     // --- Read API ---
-    std::optional<DeviceInfo> get_device_info();
-    std::optional<BatteryInfo> get_battery_info();
-    std::optional<GestureSettings> get_all_gesture_settings();
-    std::vector<DualConnectDevice> get_dual_connect_devices();
-    std::optional<EqualizerInfo> get_equalizer_info();
-    std::optional<AncStatus> get_anc_status();
-    std::optional<bool> get_wear_detection_status();
-    std::optional<bool> get_low_latency_status();
-    std::optional<SoundQualityPreference> get_sound_quality_preference();
+    std::optional<DeviceInfo> get_device_info(const RequestOptions& options = {});
+    std::optional<BatteryInfo> get_battery_info(const RequestOptions& options = {});
+    std::optional<GestureSettings> get_all_gesture_settings(const RequestOptions& options = {});
+    std::vector<DualConnectDevice> get_dual_connect_devices(const RequestOptions& options = {});
+    std::optional<EqualizerInfo> get_equalizer_info(const RequestOptions& options = {});
+    std::optional<AncStatus> get_anc_status(const RequestOptions& options = {});
+    std::optional<bool> get_wear_detection_status(const RequestOptions& options = {});
+    std::optional<bool> get_low_latency_status(const RequestOptions& options = {});
+    std::optional<SoundQualityPreference> get_sound_quality_preference(const RequestOptions& options = {});
+    // Not kept in DeviceState: always asks the device.
+    std::optional<bool> get_dual_connect_enabled(const RequestOptions& options = {});
 
     // --- Write API ---
-    void set_anc_mode(AncMode mode);
-    void set_anc_level(AncLevel level);
-    void set_wear_detection(bool enable);
-    void set_low_latency(bool enable);
-    void set_sound_quality_preference(SoundQualityPreference pref);
-    void set_double_tap_action(EarSide side, GestureAction action);
-    void set_triple_tap_action(EarSide side, GestureAction action);
-    void set_swipe_action(GestureAction action);
-    void set_long_tap_action(EarSide side, GestureAction action);
-    void set_long_tap_anc_cycle(EarSide side, AncCycleMode cycle_mode);
-    void set_incall_double_tap_action(GestureAction action);
-    void set_equalizer_preset(uint8_t preset_id);
-    void create_or_update_custom_equalizer(const CustomEqPreset& preset);
-    void delete_custom_equalizer(const CustomEqPreset& preset);
-    void create_fake_preset(FakePreset preset, uint8_t new_id);
-    void set_dual_connect_enabled(bool enable);
-    void set_dual_connect_preferred(const std::string& mac_address);
-    void dual_connect_action(const std::string& mac_address, uint8_t action_code);
+    // A write whose value the device has already confirmed (and nothing has made
+    // stale since) is skipped without going on air; RequestOptions::force sends it anyway.
+    // When the device acks a write, the value written goes into the state cache as
+    // confirmed, so there's no need to read it back.
+    // Until then the state shows it as pending (CachedField::pending, pending_fields()),
+    // so the UI can reflect a toggle right away. If the write fails or times out the
+    // field goes back to the confirmed value and subscribers to DeviceEvents::ROLLBACK hear of it.
+    void set_anc_mode(AncMode mode, const RequestOptions& options = {});
+    void set_anc_level(AncLevel level, const RequestOptions& options = {});
+    void set_wear_detection(bool enable, const RequestOptions& options = {});
+    void set_low_latency(bool enable, const RequestOptions& options = {});
+    void set_sound_quality_preference(SoundQualityPreference pref, const RequestOptions& options = {});
+    void set_double_tap_action(EarSide side, GestureAction action, const RequestOptions& options = {});
+    void set_triple_tap_action(EarSide side, GestureAction action, const RequestOptions& options = {});
+    void set_swipe_action(GestureAction action, const RequestOptions& options = {});
+    void set_long_tap_action(EarSide side, GestureAction action, const RequestOptions& options = {});
+    void set_long_tap_anc_cycle(EarSide side, AncCycleMode cycle_mode, const RequestOptions& options = {});
+    void set_incall_double_tap_action(GestureAction action, const RequestOptions& options = {});
+    void set_equalizer_preset(uint8_t preset_id, const RequestOptions& options = {});
+    void create_or_update_custom_equalizer(const CustomEqPreset& preset, const RequestOptions& options = {});
+    void delete_custom_equalizer(const CustomEqPreset& preset, const RequestOptions& options = {});
+    void create_fake_preset(FakePreset preset, uint8_t new_id, const RequestOptions& options = {});
+    void set_dual_connect_enabled(bool enable, const RequestOptions& options = {});
+    void set_dual_connect_preferred(const std::string& mac_address, const RequestOptions& options = {});
+    void dual_connect_action(const std::string& mac_address, uint8_t action_code, const RequestOptions& options = {});
+
+    // Gesture writes to the same command with different parameters (left and right
+    // double tap, ...) go out as one frame when they're queued together. Writes made
+    // while a WriteBatch is alive are held back and sent when it goes away, so
+    // applying a whole layout takes one frame per command. Batches nest.
+    class WriteBatch {
+    public:
+        explicit WriteBatch(std::shared_ptr<CommandWriter> writer);
+        WriteBatch(WriteBatch&& other) noexcept;
+        WriteBatch(const WriteBatch&) = delete;
+        WriteBatch& operator=(const WriteBatch&) = delete;
+        WriteBatch& operator=(WriteBatch&&) = delete;
+        ~WriteBatch();
+
+    private:
+        std::shared_ptr<CommandWriter> m_writer;
+    };
+    WriteBatch batch_writes();
+
+    // --- Profiles ---
+    // Switches to 'profile' as one transaction: reads the fields it touches that
+    // aren't known, writes only the settings that differ (in one pipelined batch),
+    // reads those fields back and compares. If a write fails or a setting doesn't
+    // read back as written, the settings written are put back to what they were
+    // before (and the report says so). Blocks until done; about one round trip for
+    // the writes and one for the check. options.cancel stops it, options.deadline
+    // applies to the writes.
+    ProfileReport apply_profile(const DeviceProfile& profile, const RequestOptions& options = {});
+
+    // --- Notifications ---
+    // Frames the headset pushes on its own are only read while somebody is reading;
+    // call this while idle to pick them up (a local read, nothing goes on air).
+    void poll_notifications();
+    // Calls 'callback' for every pushed frame matching 'events' (DeviceEvents bits), on
+    // whichever thread read it. Decoded once; all subscribers share the same event.
+    // Safe to call from inside a callback. Returns an id for unsubscribe().
+    uint64_t subscribe(uint32_t events, EventCallback callback);
+    // Waits for a callback running on another thread to return.
+    void unsubscribe(uint64_t id);
+
+    // --- Telemetry ---
+    // Battery levels, ANC mode, the dual-connect source and link RTTs go into 'store'
+    // as they are read or pushed, stamped with clock().now(). nullptr stops recording;
+    // the store must outlive the Device or be detached first.
+    void set_telemetry(TelemetryStore* store) { m_telemetry = store; }
+
+    // --- Warmup ---
+    // With a warmup set, every successful connect() starts reading the stale fields
+    // in the background right away, pipelined 'window' deep and hot fields first,
+    // so the first screen finds the state cache filled instead of asking one getter
+    // at a time. The burst holds back while any read or write of the caller's is in
+    // flight, and stops on disconnect() or cancel_pending(). Off by default.
+    void set_warmup(std::optional<WarmupOptions> warmup);
+
+    // --- Capabilities ---
+    // Reads the connected model doesn't answer (see CapabilityTable) fail right away
+    // instead of waiting out their timeouts; RequestOptions::force asks anyway.
+    // nullptr stops using it; the table must outlive the Device or be detached first.
+    void set_capabilities(CapabilityTable* table) { m_capabilities = table; }
+
+    // --- Last-known state ---
+    // With a store set, the confirmed state is saved there after a resync or warmup,
+    // on disconnect() and when the Device goes away (only if something changed).
+    // restore_state() fills the empty fields of the cache from the newest record
+    // for 'mac' (for any headset if empty), so the UI has something to draw before
+    // the connect; those values stay stale, and "restored" in the state JSON, until
+    // the headset confirms them. The device info (model, firmware, serial numbers)
+    // is trusted as it is and not read again. Returns false if nothing was restored.
+    // nullptr stops using it; the store must outlive the Device or be detached first.
+    void set_state_store(StateStore* store) { m_state_store = store; }
+    bool restore_state(const std::string& mac = {});
+    bool save_state();
+
+    // --- Cached state & link health ---
+    // Every successful read lands in the state cache; writes mark what they touch as stale.
+    // Reading it never takes a lock: snapshot() pins the latest published state
+    // (one atomic increment) and it stays consistent while updates keep coming.
+    // Let go of it soon; get_state() is the same thing copied out.
+    using StateSnapshot = RcuCell<DeviceState>::ReadGuard;
+    StateSnapshot snapshot() const;
+    DeviceState get_state() const;
+    // Versioned view for bridges: the fields whose value changed after 'since'
+    // (a version from an earlier call, 0 for everything) and the current version.
+    StateDelta get_state_changes(uint64_t since) const;
+    // Re-reads the fields that are stale (changed since last read, or volatile after a reconnect).
+    // Returns the mask of fields refreshed.
+    uint32_t resync(const RequestOptions& options = {});
+    // One keepalive round trip (a battery read): single attempt, RTT-derived timeout, no retries.
+    RequestStatus probe(const RequestOptions& options = {});
+    std::chrono::milliseconds probe_timeout() const;
+    // When the last frame came in from the headset.
+    std::chrono::steady_clock::time_point last_activity() const;
+    IClock& clock() const { return m_clock; }
+
+    // --- Link timing ---
+    // Response timeouts follow a smoothed RTT estimate per command class; reads that
+    // time out are retried with exponential backoff.
+    void set_timeout_policy(const TimeoutPolicy& policy);
+    RttStats get_link_rtt_stats() const;
+    std::map<uint16_t, RttStats> get_command_rtt_stats() const;
+    WriteStats get_write_stats() const;
 
 private:
     std::unique_ptr<IBluetoothSPPClient> m_client;
-    std::unique_ptr<CommandWriter> m_writer;
+    IExecutor& m_executor;
+    IClock& m_clock;
+    std::unique_ptr<Link> m_link;
+    // Shared so a write racing a reconnect (e.g. from the supervisor thread) keeps its writer alive.
+    std::shared_ptr<CommandWriter> m_writer;
+    mutable std::mutex m_writer_mutex;
+    RttTable m_rtt;
+    DeviceState m_state; // Writers' working copy, behind m_state_mutex
+    mutable std::mutex m_state_mutex;
+    RcuCell<DeviceState> m_published;
+    EventDispatcher m_events;
+    std::atomic<TelemetryStore*> m_telemetry{nullptr};
+    std::atomic<CapabilityTable*> m_capabilities{nullptr};
+    std::atomic<StateStore*> m_state_store{nullptr};
+    std::atomic<uint64_t> m_saved_version{0}; // State version last saved
+    std::string m_address;                    // Behind m_writer_mutex
+    // A silent command only counts against the model if the link answered something this recently.
+    static constexpr std::chrono::seconds LINK_ALIVE_WINDOW{10};
+    std::optional<WarmupOptions> m_warmup;              // Behind m_writer_mutex
+    std::shared_ptr<CancellationSource> m_warmup_cancel; // Same
+    // Reads and writes the caller has in flight; the warmup yields while there are any.
+    std::atomic<int> m_foreground{0};
+    std::mutex m_foreground_mutex;
+    // The rest of a warmup that yielded; foreground_done() posts it to m_background
+    // once m_foreground drops to 0. Behind m_foreground_mutex.
+    std::function<void()> m_parked_warmup;
+    std::atomic<uint64_t> m_writes_sent{0};
+    std::atomic<uint64_t> m_writes_elided{0};
+
+    std::shared_ptr<CommandWriter> writer() const;
+    // Hands the request to the current writer and marks 'touched_field' as stale.
+    // 'next' maps the field's value before the write to the value after it (nullopt
+    // if that can't be told): that's shown as pending right away and confirmed by
+    // the ack, and a write that wouldn't change the confirmed value is skipped unless forced.
+    template <typename T, typename Next, typename F>
+    void write(uint32_t touched_field, CachedField<T> DeviceState::*field, const RequestOptions& options, Next&& next, F&& request);
+    // Same for writes with nothing to compare against. 'on_send' runs in the same
+    // state update as the invalidation, 'on_result' once the write is done; both get its stamp.
+    template <typename F>
+    void write(uint32_t touched_fields, const RequestOptions& options, F&& request,
+               std::function<void(DeviceState&, uint64_t)> on_send = {},
+               std::function<void(uint64_t, RequestStatus)> on_result = {});
+    template <typename T, typename Next>
+    void settle(uint32_t touched_field, CachedField<T> DeviceState::*field, uint64_t stamp, RequestStatus status, const Next& next);
+    // The cached value if 'options' allows answering from the cache and it's fresh enough.
+    template <typename T>
+    std::optional<T> cached(CachedField<T> DeviceState::*field, const RequestOptions& options) const;
+    template <typename T>
+    void confirm(CachedField<T> DeviceState::*field, T value);
+    template <typename F>
+    void update_state(F&& update);
+    void handle_notification(const HuaweiSppPacket& packet);
+    struct WarmupRun {
+      WarmupOptions options;
+      CancellationToken cancel;
+      IClock::time_point started;
+      uint32_t wanted = 0;
+      uint32_t left = 0;   // Not read yet
+      uint32_t warmed = 0; // Filled so far
+    };
+    void warm_up(const WarmupOptions& warmup, const CancellationToken& cancel);
+    void resume_warmup(WarmupRun run);
+    // Reads 'fields' (StateFields bits) into the cache with up to 'window' requests on
+    // air, the 'first' ones first. With 'yielded' set it stops once nothing of its own
+    // is on air while the caller has a read or write in flight, and puts the fields it
+    // didn't get to there. Returns the fields that were filled.
+    uint32_t read_fields(uint32_t fields, uint32_t first, size_t window, uint32_t* yielded, const CancellationToken& cancel);
+    bool apply_warmup_answers(uint32_t field, const std::vector<HuaweiSppPacket>& answers, const CancellationToken& cancel);
+    void foreground_done();
 
-    std::optional<HuaweiSppPacket> send_and_get_response(const HuaweiSppPacket& request, const std::array<uint8_t, 2>& expected_response_cmd);
+    // What confirm() feeds into the telemetry store; nothing for the other fields.
+    template <typename T>
+    void record(const T&) {}
+    void record(const BatteryInfo& info);
+    void record(const AncStatus& status);
+    void record(const std::vector<DualConnectDevice>& devices);
+    void record_rtt(std::chrono::microseconds rtt);
+
+    // Reads are idempotent, so by default a timed-out request is sent again.
+    std::optional<HuaweiSppPacket> send_and_get_response(const HuaweiSppPacket& request, const std::array<uint8_t, 2>& expected_response_cmd,
+                                                         const RequestOptions& options, bool idempotent = true);
 
     DeviceInfo parse_device_info(const HuaweiSppPacket& packet);
     BatteryInfo parse_battery_info(const HuaweiSppPacket& packet);
@@ -62,4 +330,7 @@ private:
     DualConnectDevice parse_dual_connect_device(const HuaweiSppPacket& packet);
     void populate_equalizer_info(EqualizerInfo& info, const HuaweiSppPacket& packet);
     AncStatus parse_anc_status(const HuaweiSppPacket& packet);
+
+    // Runs the warmup; last, so it's torn down (and waited for) before everything it uses.
+    Strand m_background{m_executor};
 };
\ No newline at end of file
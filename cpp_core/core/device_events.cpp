@@ -0,0 +1,50 @@
+#include "device_events.h"
+#include <algorithm>
+
+// dispatch() calls on this thread's stack, so unsubscribe() knows when not to wait.
+static thread_local int t_dispatch_depth = 0;
+
+uint64_t EventDispatcher::subscribe(uint32_t events, EventCallback callback) {
+	std::lock_guard<std::mutex> lock(m_write_mutex);
+	auto next = std::make_unique<List>(m_list.latest());
+	uint64_t id = m_next_id++;
+	next->subscribers.push_back(Subscriber{id, events, std::move(callback)});
+	next->events |= events;
+	m_list.publish(std::move(next));
+	return id;
+}
+
+bool EventDispatcher::unsubscribe(uint64_t id) {
+	{
+		std::lock_guard<std::mutex> lock(m_write_mutex);
+		const List& current = m_list.latest();
+		auto it = std::find_if(current.subscribers.begin(), current.subscribers.end(),
+							   [id](const Subscriber& s) { return s.id == id; });
+		if (it == current.subscribers.end()) return false;
+
+		auto next = std::make_unique<List>();
+		for (const auto& s : current.subscribers) {
+			if (s.id == id) continue;
+			next->subscribers.push_back(s);
+			next->events |= s.events;
+		}
+		m_list.publish(std::move(next));
+	}
+	if (t_dispatch_depth == 0) m_list.synchronize();
+	return true;
+}
+
+bool EventDispatcher::wants(uint32_t events) const { return (m_list.read()->events & events) != 0; }
+
+size_t EventDispatcher::subscriber_count() const { return m_list.read()->subscribers.size(); }
+
+void EventDispatcher::dispatch(const std::shared_ptr<const DeviceEvent>& event) const {
+	auto list = m_list.read();
+	uint32_t mask = event->type == DeviceEvents::ROLLBACK ? event->type : event->type | DeviceEvents::RAW;
+	if (!(list->events & mask)) return;
+	++t_dispatch_depth;
+	for (const auto& s : list->subscribers) {
+		if (s.events & mask) s.callback(event);
+	}
+	--t_dispatch_depth;
+}
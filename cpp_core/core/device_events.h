@@ -0,0 +1,85 @@
+// cpp_core/core/device_events.h
+
+#pragma once
+
+#include "core/rcu_cell.h"
+#include "core/types.h"
+#include "protocol/huawei_packet.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Bits naming what a subscriber wants to hear about.
+namespace DeviceEvents {
+constexpr uint32_t BATTERY      = 1u << 0; // CMD_BATTERY_NOTIFY
+constexpr uint32_t ANC          = 1u << 1; // CMD_ANC_NOTIFY: ANC mode and/or in-ear state (same command)
+constexpr uint32_t DUAL_CONNECT = 1u << 2; // CMD_DUAL_CONNECT_CHANGE_EVENT
+constexpr uint32_t RAW          = 1u << 3; // Every frame the headset pushes, decoded or not
+// Not a frame: a write failed or timed out, and the fields it had shown as pending
+// went back to the confirmed value. Not included in RAW.
+constexpr uint32_t ROLLBACK     = 1u << 4;
+
+constexpr uint32_t ALL = (1u << 5) - 1;
+} // namespace DeviceEvents
+
+// One pushed frame and what we made of it. Built once and handed to every
+// subscriber as the same shared, immutable object; keep the pointer if you need
+// the event later.
+struct DeviceEvent {
+  uint32_t type = DeviceEvents::RAW; // The DeviceEvents bit of the decoded kind; RAW if none
+  HuaweiSppPacket frame{0};
+
+  std::optional<BatteryInfo> battery;
+  std::optional<AncStatus> anc;
+  std::optional<bool> in_ear;
+  std::optional<DualConnectDevice> dual_connect; // When the change event names a device
+  uint32_t rolled_back = 0; // StateFields bits, for ROLLBACK
+};
+
+using EventCallback = std::function<void(const std::shared_ptr<const DeviceEvent>&)>;
+
+// Subscriber list in an RcuCell. Subscribing and unsubscribing copy the list
+// and publish the copy under a writers-only mutex; dispatch() pins the current
+// list and walks it, so the I/O thread never takes a lock or waits for a
+// subscriber being added. A callback may subscribe or unsubscribe from inside
+// dispatch().
+class EventDispatcher {
+ public:
+  EventDispatcher() = default;
+
+  EventDispatcher(const EventDispatcher&) = delete;
+  EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+  // Returns an id for unsubscribe(), never 0.
+  uint64_t subscribe(uint32_t events, EventCallback callback);
+  // Once this returns, the callback isn't running on any thread and won't be called
+  // again, so whatever it captured may go. (Called from inside a callback it can't
+  // wait for itself; then only the "won't be called again" part holds.)
+  bool unsubscribe(uint64_t id);
+
+  // True if anybody subscribed to any of 'events'; lets the caller skip decoding.
+  bool wants(uint32_t events) const;
+
+  // Calls every subscriber whose mask matches event->type (or RAW, for pushed frames), on this thread.
+  void dispatch(const std::shared_ptr<const DeviceEvent>& event) const;
+
+  size_t subscriber_count() const;
+
+ private:
+  struct Subscriber {
+    uint64_t id;
+    uint32_t events;
+    EventCallback callback;
+  };
+  struct List {
+    std::vector<Subscriber> subscribers;
+    uint32_t events = 0; // Union of all masks
+  };
+
+  RcuCell<List> m_list;
+  std::mutex m_write_mutex;
+  uint64_t m_next_id = 1;
+};
@@ -0,0 +1,392 @@
+#include "device_manager.h"
+#include "protocol/frame_decoder.h"
+#include "core/strand.h"
+#include "core/timer_wheel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <list>
+#include <thread>
+#include <unordered_map>
+
+struct PendingRequest {
+	HuaweiSppPacket request{0};
+	uint16_t expected_id = 0;
+	ResponseCallback on_response;
+	IClock::time_point deadline;
+	Timer deadline_timer; // Armed by the reactor once the request leaves the inbox
+	bool sent = false;
+};
+
+// Requests never move once created: they are spliced from list to list
+// (inbox, write queue, pending) so their timers stay put while armed.
+using RequestList = std::list<PendingRequest>;
+
+struct DeviceManager::Connection {
+	ConnectionId id = 0;
+	std::unique_ptr<IBluetoothSPPClient> client;
+	FrameDecoder decoder;
+	std::unique_ptr<Strand> strand; // Parsing and callbacks for this connection, in order
+
+	// Filled by submit() from any thread, drained by the owning reactor.
+	std::mutex inbox_mutex;
+	RequestList inbox;
+
+	// Reactor-owned from here on.
+	RequestList write_queue;
+	std::unordered_map<uint16_t, RequestList> pending; // Keyed by expected response id
+	RequestList expired; // Timed out during the last advance(); freed outside the timer callbacks
+	size_t in_flight = 0;
+
+	std::atomic<bool> removed{false}; // Set under inbox_mutex, so submit() can trust it there
+	std::atomic<uint64_t> frames_sent{0};
+	std::atomic<uint64_t> frames_received{0};
+	std::atomic<uint64_t> requests_completed{0};
+	std::atomic<uint64_t> requests_timed_out{0};
+	std::atomic<uint64_t> notifications{0};
+	std::atomic<size_t> queued_requests{0};
+	std::atomic<size_t> pending_requests{0};
+};
+
+struct DeviceManager::Reactor {
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool wake = false;
+	bool running = true;
+	std::vector<std::shared_ptr<Connection>> connections;
+	std::vector<std::shared_ptr<Connection>> retired;
+	size_t next_start = 0; // Rotates so every connection gets to go first in turn
+	std::unique_ptr<TimerWheel> timers; // Request deadlines of this reactor's connections
+};
+
+DeviceManager::DeviceManager(DeviceManagerConfig config)
+	: m_config(config), m_executor(config.executor ? *config.executor : default_executor()),
+	  m_clock(config.clock ? *config.clock : steady_clock()) {
+	size_t count = m_config.reactor_threads;
+	if (count == 0) count = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t i = 0; i < count; ++i) {
+		m_reactors.push_back(std::make_unique<Reactor>());
+		m_reactors.back()->timers = std::make_unique<TimerWheel>(m_clock);
+	}
+	for (auto& reactor : m_reactors) {
+		reactor->thread = std::thread(&DeviceManager::run_reactor, this, std::ref(*reactor));
+	}
+}
+
+DeviceManager::~DeviceManager() {
+	for (auto& reactor : m_reactors) {
+		{
+			std::lock_guard<std::mutex> lock(reactor->mutex);
+			reactor->running = false;
+		}
+		reactor->cond.notify_one();
+	}
+	for (auto& reactor : m_reactors) {
+		if (reactor->thread.joinable()) reactor->thread.join();
+	}
+}
+
+ConnectionId DeviceManager::add_connection(std::unique_ptr<IBluetoothSPPClient> client, const std::string& address, int port) {
+	if (!client || !client->connect(address, port)) {
+		std::cerr << "[MANAGER] ERROR: Could not connect to " << address << std::endl;
+		return 0;
+	}
+
+	auto conn = std::make_shared<Connection>();
+	conn->client = std::move(client);
+	conn->strand = std::make_unique<Strand>(m_executor);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		conn->id = m_next_id++;
+		m_connections.push_back(conn);
+	}
+
+	Reactor& reactor = *m_reactors[conn->id % m_reactors.size()];
+	{
+		std::lock_guard<std::mutex> lock(reactor.mutex);
+		reactor.connections.push_back(conn);
+		reactor.wake = true;
+	}
+	reactor.cond.notify_one();
+	return conn->id;
+}
+
+void DeviceManager::remove_connection(ConnectionId id) {
+	std::shared_ptr<Connection> conn;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = std::find_if(m_connections.begin(), m_connections.end(),
+							   [id](const auto& c) { return c->id == id; });
+		if (it == m_connections.end()) return;
+		conn = *it;
+		m_connections.erase(it);
+	}
+	{
+		// Under the inbox lock: a submit() either gets in before this, and the teardown
+		// below fails its request, or sees 'removed' and never queues it.
+		std::lock_guard<std::mutex> lock(conn->inbox_mutex);
+		conn->removed = true;
+	}
+
+	// The reactor owns the client, so it also does the teardown.
+	Reactor& reactor = *m_reactors[id % m_reactors.size()];
+	{
+		std::lock_guard<std::mutex> lock(reactor.mutex);
+		reactor.connections.erase(std::remove(reactor.connections.begin(), reactor.connections.end(), conn),
+								  reactor.connections.end());
+		reactor.retired.push_back(conn);
+		reactor.wake = true;
+	}
+	reactor.cond.notify_one();
+}
+
+bool DeviceManager::submit(ConnectionId id, const HuaweiSppPacket& request, const std::array<uint8_t, 2>& expected_response_cmd,
+						   ResponseCallback on_response, std::chrono::milliseconds timeout) {
+	auto conn = find(id);
+	if (!conn || conn->removed) return false;
+
+	RequestList pending(1);
+	pending.front().request = request;
+	pending.front().expected_id = bytes_to_u16(expected_response_cmd[0], expected_response_cmd[1]);
+	pending.front().on_response = std::move(on_response);
+	pending.front().deadline = m_clock.now() + (timeout.count() > 0 ? timeout : m_config.default_timeout);
+	{
+		std::lock_guard<std::mutex> lock(conn->inbox_mutex);
+		if (conn->removed) return false; // Checked again: the teardown may already have drained the inbox
+		conn->inbox.splice(conn->inbox.end(), pending);
+	}
+	++conn->queued_requests;
+
+	Reactor& reactor = *m_reactors[id % m_reactors.size()];
+	{
+		std::lock_guard<std::mutex> lock(reactor.mutex);
+		reactor.wake = true;
+	}
+	reactor.cond.notify_one();
+	return true;
+}
+
+std::optional<HuaweiSppPacket> DeviceManager::request(ConnectionId id, const HuaweiSppPacket& request,
+													  const std::array<uint8_t, 2>& expected_response_cmd,
+													  std::chrono::milliseconds timeout) {
+	auto promise = std::make_shared<std::promise<std::optional<HuaweiSppPacket>>>();
+	auto future = promise->get_future();
+	if (!submit(id, request, expected_response_cmd,
+				[promise](std::optional<HuaweiSppPacket> response) { promise->set_value(std::move(response)); },
+				timeout)) {
+		return std::nullopt;
+	}
+	return future.get();
+}
+
+void DeviceManager::set_notification_handler(NotificationCallback handler) {
+	m_notification_handler = std::move(handler);
+}
+
+std::optional<ConnectionStats> DeviceManager::stats(ConnectionId id) const {
+	auto conn = find(id);
+	if (!conn) return std::nullopt;
+	ConnectionStats s;
+	s.frames_sent = conn->frames_sent;
+	s.frames_received = conn->frames_received;
+	s.requests_completed = conn->requests_completed;
+	s.requests_timed_out = conn->requests_timed_out;
+	s.notifications = conn->notifications;
+	s.queued_requests = conn->queued_requests;
+	s.pending_requests = conn->pending_requests;
+	return s;
+}
+
+TimerWheel::Load DeviceManager::timer_load() const {
+	TimerWheel::Load total;
+	for (const auto& reactor : m_reactors) {
+		TimerWheel::Load load = reactor->timers->load();
+		total.armed += load.armed;
+		for (size_t i = 0; i < total.per_level.size(); ++i) total.per_level[i] += load.per_level[i];
+		total.fired += load.fired;
+		total.cascaded += load.cascaded;
+		total.ticks += load.ticks;
+	}
+	return total;
+}
+
+size_t DeviceManager::connection_count() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_connections.size();
+}
+
+std::shared_ptr<DeviceManager::Connection> DeviceManager::find(ConnectionId id) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const auto& conn : m_connections) {
+		if (conn->id == id) return conn;
+	}
+	return nullptr;
+}
+
+// =================================================================
+// Reactor
+// =================================================================
+
+// Hands a result to the request's callback on the connection's strand.
+// Tasks never capture the Connection itself, so its strand is never destroyed from one of its own tasks.
+static void complete(Strand& strand, PendingRequest& request, std::optional<HuaweiSppPacket> response) {
+	if (!request.on_response) return;
+	strand.post([callback = std::move(request.on_response), response = std::move(response)]() mutable {
+		callback(std::move(response));
+	});
+}
+
+static void fail_all(Strand& strand, RequestList& requests) {
+	for (auto& r : requests) complete(strand, r, std::nullopt);
+	requests.clear();
+}
+
+void DeviceManager::run_reactor(Reactor& reactor) {
+	std::vector<std::shared_ptr<Connection>> connections;
+	std::vector<std::shared_ptr<Connection>> retired;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(reactor.mutex);
+			if (!reactor.running) break;
+			connections = reactor.connections;
+			retired.swap(reactor.retired);
+			reactor.wake = false;
+		}
+
+		// Tear down removed connections on the thread that owns their clients.
+		for (auto& conn : retired) {
+			RequestList inbox;
+			{
+				std::lock_guard<std::mutex> lock(conn->inbox_mutex);
+				inbox.swap(conn->inbox);
+			}
+			fail_all(*conn->strand, inbox);
+			fail_all(*conn->strand, conn->write_queue);
+			for (auto& [id, queue] : conn->pending) fail_all(*conn->strand, queue);
+			conn->pending.clear();
+			conn->client->disconnect();
+		}
+		retired.clear();
+
+		bool did_work = reactor.timers->advance() > 0;
+		if (!connections.empty()) {
+			size_t start = reactor.next_start++ % connections.size();
+			for (size_t i = 0; i < connections.size(); ++i) {
+				did_work |= service_connection(reactor, *connections[(start + i) % connections.size()]);
+			}
+		}
+		if (did_work) continue; // Somebody still has frames to move, go around again
+
+		std::unique_lock<std::mutex> lock(reactor.mutex);
+		reactor.cond.wait_for(lock, m_config.poll_interval, [&reactor] { return reactor.wake || !reactor.running; });
+	}
+
+	// Shutting down: nobody is going to answer these anymore.
+	std::lock_guard<std::mutex> lock(reactor.mutex);
+	for (auto& conn : reactor.connections) {
+		{
+			std::lock_guard<std::mutex> inbox_lock(conn->inbox_mutex);
+			fail_all(*conn->strand, conn->inbox);
+		}
+		fail_all(*conn->strand, conn->write_queue);
+		for (auto& [id, queue] : conn->pending) fail_all(*conn->strand, queue);
+		conn->client->disconnect();
+	}
+}
+
+bool DeviceManager::service_connection(Reactor& reactor, Connection& conn) {
+	bool did_work = false;
+	conn.expired.clear();
+
+	// --- Take over new requests and start their deadlines ---
+	auto first_new = conn.write_queue.end();
+	{
+		std::lock_guard<std::mutex> lock(conn.inbox_mutex);
+		if (!conn.inbox.empty()) {
+			first_new = conn.inbox.begin(); // Stays valid across the splice
+			conn.write_queue.splice(conn.write_queue.end(), conn.inbox);
+		}
+	}
+	for (auto it = first_new; it != conn.write_queue.end(); ++it) {
+		// Fits std::function's small buffer, so arming a request doesn't allocate.
+		it->deadline_timer.set_callback([&conn, it] {
+			RequestList& owner = it->sent ? conn.pending[it->expected_id] : conn.write_queue;
+			if (it->sent) {
+				--conn.in_flight;
+				--conn.pending_requests;
+			} else {
+				--conn.queued_requests;
+			}
+			++conn.requests_timed_out;
+			complete(*conn.strand, *it, std::nullopt);
+			conn.expired.splice(conn.expired.end(), owner, it); // Not destroyed here: we're inside its timer
+		});
+		reactor.timers->schedule_at(it->deadline_timer, it->deadline);
+	}
+
+	// --- Receive: frame whatever arrived and match it against pending requests ---
+	// Only the command id is peeked here; full parsing happens on the strand.
+	std::vector<uint8_t> bytes = conn.client->read_available();
+	if (!bytes.empty()) {
+		conn.decoder.feed(bytes);
+		std::vector<uint8_t> frame;
+		while (conn.decoder.next_frame(frame)) {
+			++conn.frames_received;
+			did_work = true;
+			if (frame.size() < 8) continue; // Header + command id + CRC at the very least
+			uint16_t command_id = bytes_to_u16(frame[4], frame[5]);
+
+			auto it = conn.pending.find(command_id);
+			if (it != conn.pending.end() && !it->second.empty()) {
+				PendingRequest& done = it->second.front();
+				reactor.timers->cancel(done.deadline_timer);
+				--conn.in_flight;
+				--conn.pending_requests;
+				++conn.requests_completed;
+				if (done.on_response) {
+					conn.strand->post([callback = std::move(done.on_response), frame = std::move(frame)] {
+						callback(HuaweiSppPacket::from_bytes(frame));
+					});
+				}
+				it->second.pop_front();
+			} else {
+				++conn.notifications;
+				if (m_notification_handler) {
+					conn.strand->post([this, id = conn.id, frame = std::move(frame)] {
+						if (auto packet = HuaweiSppPacket::from_bytes(frame)) m_notification_handler(id, *packet);
+					});
+				}
+			}
+			frame = {};
+		}
+	}
+
+	// --- Transmit, bounded by the per-turn budget and the in-flight window ---
+	// (Requests that run out of time are dropped by their deadline timers, queued or in flight.)
+	size_t budget = m_config.frames_per_turn;
+	while (budget > 0 && !conn.write_queue.empty() && conn.in_flight < m_config.max_in_flight) {
+		PendingRequest& next = conn.write_queue.front();
+		--conn.queued_requests;
+		--budget;
+		did_work = true;
+
+		if (!conn.client->send(next.request.to_bytes())) {
+			std::cerr << "[MANAGER] ERROR: send failed on connection " << conn.id << std::endl;
+			reactor.timers->cancel(next.deadline_timer);
+			complete(*conn.strand, next, std::nullopt);
+			conn.write_queue.pop_front();
+			continue;
+		}
+		++conn.frames_sent;
+		++conn.in_flight;
+		++conn.pending_requests;
+		next.sent = true;
+		RequestList& pending = conn.pending[next.expected_id];
+		pending.splice(pending.end(), conn.write_queue, conn.write_queue.begin());
+	}
+	return did_work;
+}
@@ -0,0 +1,108 @@
+// cpp_core/core/device_manager.h
+
+#pragma once
+#include "platform/bluetooth_interface.h"
+#include "protocol/huawei_packet.h"
+#include "core/clock.h"
+#include "core/executor.h"
+#include "core/timer_wheel.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+using ConnectionId = uint32_t;
+using ResponseCallback = std::function<void(std::optional<HuaweiSppPacket>)>;
+using NotificationCallback = std::function<void(ConnectionId, const HuaweiSppPacket&)>;
+
+struct DeviceManagerConfig {
+  // Number of reactor threads. 0 means one per core.
+  size_t reactor_threads = 1;
+  // Frames one connection may transmit per reactor turn before the next connection gets its go.
+  size_t frames_per_turn = 1;
+  // Requests awaiting a response per connection. 1 keeps the stop-and-wait behaviour the earbuds expect.
+  size_t max_in_flight = 1;
+  // How long an idle reactor sleeps before polling the links again.
+  std::chrono::milliseconds poll_interval{1};
+  std::chrono::milliseconds default_timeout{2000};
+  // Where parsing and callbacks run (per connection, in order). nullptr means default_executor().
+  IExecutor* executor = nullptr;
+  // What request deadlines are measured on. nullptr means the steady clock.
+  // (The reactors' idle poll stays in real time: it's a polling rate, not a timeout.)
+  IClock* clock = nullptr;
+};
+
+struct ConnectionStats {
+  uint64_t frames_sent = 0;
+  uint64_t frames_received = 0;
+  uint64_t requests_completed = 0;
+  uint64_t requests_timed_out = 0;
+  uint64_t notifications = 0;
+  size_t queued_requests = 0;
+  size_t pending_requests = 0;
+};
+
+// Multiplexes any number of headset connections over a small, fixed set of
+// reactor threads instead of one writer thread (plus a blocked caller) per Device.
+// Every connection gets its own frame decoder, write queue and pending-request
+// table; reactors visit their connections round-robin with a per-turn frame
+// budget so one busy headset can't starve the others. Reactors only move bytes;
+// parsing and callbacks are handed to the executor through a per-connection
+// strand, so a slow callback never stalls other links.
+class DeviceManager {
+ public:
+  explicit DeviceManager(DeviceManagerConfig config = {});
+  ~DeviceManager();
+
+  DeviceManager(const DeviceManager&) = delete;
+  DeviceManager& operator=(const DeviceManager&) = delete;
+
+  // Connects 'client' on the calling thread (RFCOMM connect blocks) and hands it
+  // to a reactor. Returns 0 if the connection could not be established.
+  ConnectionId add_connection(std::unique_ptr<IBluetoothSPPClient> client, const std::string& address, int port = 1);
+  void remove_connection(ConnectionId id);
+
+  // Queues 'request' for transmission. 'on_response' runs on the executor with
+  // the first frame matching 'expected_response_cmd', or std::nullopt on timeout
+  // or disconnect. A zero timeout means DeviceManagerConfig::default_timeout.
+  bool submit(ConnectionId id, const HuaweiSppPacket& request, const std::array<uint8_t, 2>& expected_response_cmd,
+              ResponseCallback on_response, std::chrono::milliseconds timeout = {});
+
+  // Blocking convenience wrapper around submit().
+  std::optional<HuaweiSppPacket> request(ConnectionId id, const HuaweiSppPacket& request,
+                                         const std::array<uint8_t, 2>& expected_response_cmd,
+                                         std::chrono::milliseconds timeout = {});
+
+  // Frames that don't answer a pending request (device-initiated notifications).
+  // Must be set before connections are added.
+  void set_notification_handler(NotificationCallback handler);
+
+  std::optional<ConnectionStats> stats(ConnectionId id) const;
+  size_t connection_count() const;
+  size_t reactor_count() const { return m_reactors.size(); }
+  // Request deadline timers across all reactors.
+  TimerWheel::Load timer_load() const;
+
+ private:
+  struct Connection;
+  struct Reactor;
+
+  void run_reactor(Reactor& reactor);
+  bool service_connection(Reactor& reactor, Connection& conn);
+  std::shared_ptr<Connection> find(ConnectionId id) const;
+
+  DeviceManagerConfig m_config;
+  IExecutor& m_executor;
+  IClock& m_clock;
+  NotificationCallback m_notification_handler;
+  std::vector<std::unique_ptr<Reactor>> m_reactors;
+
+  mutable std::mutex m_mutex;
+  std::vector<std::shared_ptr<Connection>> m_connections;
+  ConnectionId m_next_id = 1;
+};
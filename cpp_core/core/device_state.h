@@ -0,0 +1,219 @@
+// cpp_core/core/device_state.h
+
+#pragma once
+
+#include "core/types.h"
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Bits naming the fields of a DeviceState, for invalidation and resync masks.
+namespace StateFields {
+constexpr uint32_t DEVICE_INFO    = 1u << 0;
+constexpr uint32_t BATTERY        = 1u << 1;
+constexpr uint32_t ANC            = 1u << 2;
+constexpr uint32_t WEAR_DETECTION = 1u << 3;
+constexpr uint32_t LOW_LATENCY    = 1u << 4;
+constexpr uint32_t SOUND_QUALITY  = 1u << 5;
+constexpr uint32_t EQUALIZER      = 1u << 6;
+constexpr uint32_t GESTURES       = 1u << 7;
+constexpr uint32_t DUAL_CONNECT   = 1u << 8;
+
+constexpr uint32_t ALL = (1u << 9) - 1;
+// Fields that change on their own, so a new connection can't trust the cached value.
+constexpr uint32_t VOLATILE = BATTERY | DUAL_CONNECT;
+// Fields that don't change for a given headset, so a saved value is as good as a read.
+constexpr uint32_t STATIC = DEVICE_INFO;
+} // namespace StateFields
+
+// Last value the device reported for one field, stamped with the state generation
+// at which it was confirmed and at which we last did something that may have
+// changed it (a write, a new connection). The field is stale while the latter wins.
+// changed_at is when the value last actually changed (or went from pending to
+// settled); confirming the same value again leaves it alone.
+//
+// While a write is waiting for its ack, 'pending' holds what the field will be
+// once it lands, so the UI can show it right away; it's dropped when the write
+// is acked (then it's the new 'value') or fails.
+//
+// A 'restored' value came from an earlier session (see StateStore): it's shown,
+// but stays stale until the headset confirms it.
+template <typename T>
+struct CachedField {
+  std::optional<T> value;
+  uint64_t confirmed_at = 0;
+  uint64_t invalidated_at = 0;
+  uint64_t changed_at = 0;
+  std::chrono::steady_clock::time_point confirmed_time{}; // Clock time of confirmed_at
+  std::optional<T> pending;
+  uint64_t pending_at = 0; // Stamp of the latest write, which 'pending' includes
+  bool restored = false;
+
+  bool stale() const { return !value || restored || invalidated_at > confirmed_at; }
+  // What to show: the pending value if there is one, else the confirmed one.
+  const std::optional<T>& shown() const { return pending ? pending : value; }
+};
+
+struct StateDelta;
+
+// What we know about the headset, kept across reconnects so a dropped link
+// only costs re-reading what may have changed instead of everything.
+//
+// The generation doubles as the state's version: a bridge that last saw version
+// N asks delta_since(N) and forwards only the fields whose value moved since.
+struct DeviceState {
+  // Bumped on every confirm/invalidate; the stamps in the fields come from here.
+  uint64_t generation = 0;
+
+  CachedField<DeviceInfo> device_info;
+  CachedField<BatteryInfo> battery;
+  CachedField<AncStatus> anc;
+  CachedField<bool> wear_detection;
+  CachedField<bool> low_latency;
+  CachedField<SoundQualityPreference> sound_quality;
+  CachedField<EqualizerInfo> equalizer;
+  CachedField<GestureSettings> gestures;
+  CachedField<std::vector<DualConnectDevice>> dual_connect;
+
+  // Returns true if the value differs from the cached one (or only had been restored).
+  template <typename T>
+  bool confirm(CachedField<T>& field, T value, std::chrono::steady_clock::time_point now = {}) {
+    bool changed = !field.value || field.restored || *field.value != value;
+    field.restored = false;
+    field.value = std::move(value);
+    field.confirmed_at = ++generation;
+    field.confirmed_time = now;
+    if (changed) field.changed_at = generation;
+    return changed;
+  }
+
+  // Returns the stamp put on the fields.
+  uint64_t invalidate(uint32_t fields) {
+    uint64_t stamp = ++generation;
+    for_each_field([&](uint32_t bit, auto& field) {
+      if (fields & bit) field.invalidated_at = stamp;
+    }, *this);
+    return stamp;
+  }
+
+  // Shows 'value' in the field until the write stamped 'stamp' settles;
+  // nullopt (can't tell what the write does) shows the confirmed value.
+  template <typename T>
+  void expect(CachedField<T>& field, std::optional<T> value, uint64_t stamp) {
+    if (!value && !field.pending) return;
+    field.pending = std::move(value);
+    field.pending_at = stamp;
+    field.changed_at = stamp;
+  }
+
+  // Back to showing the confirmed value. Returns false if nothing was pending.
+  template <typename T>
+  bool drop_pending(CachedField<T>& field) {
+    if (!field.pending) return false;
+    field.pending.reset();
+    field.changed_at = ++generation;
+    return true;
+  }
+
+  // Fills the empty fields among 'fields' with the values in 'saved', from an
+  // earlier session. The 'trusted' ones count as confirmed, the others as restored.
+  // Returns the fields filled.
+  uint32_t restore(const DeviceState& saved, uint32_t fields, uint32_t trusted) {
+    uint32_t filled = 0;
+    uint64_t stamp = ++generation;
+    for_each_field([&](uint32_t bit, auto& field, const auto& from) {
+      if (!(fields & bit) || field.value || !from.value) return;
+      field.value = from.value;
+      field.changed_at = stamp;
+      if (trusted & bit) {
+        field.confirmed_at = stamp;
+      } else {
+        field.restored = true;
+      }
+      filled |= bit;
+    }, *this, saved);
+    return filled;
+  }
+
+  uint32_t stale_fields() const {
+    uint32_t stale = 0;
+    for_each_field([&](uint32_t bit, const auto& field) {
+      if (field.stale()) stale |= bit;
+    }, *this);
+    return stale;
+  }
+
+  // Fields showing a value that is still waiting for its ack.
+  uint32_t pending_fields() const {
+    uint32_t pending = 0;
+    for_each_field([&](uint32_t bit, const auto& field) {
+      if (field.pending) pending |= bit;
+    }, *this);
+    return pending;
+  }
+
+  // Fields showing a value from an earlier session that the headset hasn't confirmed yet.
+  uint32_t restored_fields() const {
+    uint32_t restored = 0;
+    for_each_field([&](uint32_t bit, const auto& field) {
+      if (field.restored) restored |= bit;
+    }, *this);
+    return restored;
+  }
+
+  // Fields whose value changed after 'version' (0: every field we have a value for).
+  uint32_t changes_since(uint64_t version) const {
+    uint32_t changed = 0;
+    for_each_field([&](uint32_t bit, const auto& field) {
+      if (field.changed_at > version) changed |= bit;
+    }, *this);
+    return changed;
+  }
+
+  // The changed fields and this version; the other fields are left empty.
+  inline StateDelta delta_since(uint64_t version) const;
+
+  // Fields whose shown values differ between two snapshots, whatever their versions.
+  static uint32_t diff(const DeviceState& a, const DeviceState& b) {
+    uint32_t changed = 0;
+    for_each_field([&](uint32_t bit, const auto& x, const auto& y) {
+      if (x.shown() != y.shown() || x.pending.has_value() != y.pending.has_value()) changed |= bit;
+    }, a, b);
+    return changed;
+  }
+
+ private:
+  // Calls f(bit, field of each state...) for every field, in bit order.
+  template <typename F, typename... Self>
+  static void for_each_field(F&& f, Self&... self) {
+    f(StateFields::DEVICE_INFO, self.device_info...);
+    f(StateFields::BATTERY, self.battery...);
+    f(StateFields::ANC, self.anc...);
+    f(StateFields::WEAR_DETECTION, self.wear_detection...);
+    f(StateFields::LOW_LATENCY, self.low_latency...);
+    f(StateFields::SOUND_QUALITY, self.sound_quality...);
+    f(StateFields::EQUALIZER, self.equalizer...);
+    f(StateFields::GESTURES, self.gestures...);
+    f(StateFields::DUAL_CONNECT, self.dual_connect...);
+  }
+};
+
+// What a bridge forwards after a refresh: the new version, which fields moved,
+// and their values (the rest of 'state' is left empty).
+struct StateDelta {
+  uint64_t version = 0;
+  uint32_t changed = 0;
+  DeviceState state;
+};
+
+StateDelta DeviceState::delta_since(uint64_t version) const {
+  StateDelta delta;
+  delta.version = generation;
+  delta.changed = changes_since(version);
+  delta.state.generation = generation;
+  for_each_field([&](uint32_t bit, const auto& from, auto& to) {
+    if (delta.changed & bit) to = from;
+  }, *this, delta.state);
+  return delta;
+}
@@ -0,0 +1,161 @@
+#include "discovery_cache.h"
+#include "core/mapped_file.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+bool same_place(const DiscoveredDevice& a, const DiscoveredDevice& b) {
+	return a.address == b.address && a.channel == b.channel;
+}
+
+// Tabs and newlines would break the file format; names come from the user's pairing list.
+std::string sanitized(std::string s) {
+	for (char& c : s) {
+		if (static_cast<unsigned char>(c) < 0x20) c = ' ';
+	}
+	return s;
+}
+
+} // namespace
+
+DiscoveryCache::DiscoveryCache(IDeviceDiscovery& discovery, std::string path)
+	: m_discovery(discovery), m_path(std::move(path)) {
+	if (!m_path.empty()) load();
+}
+
+bool DiscoveryCache::connect(const std::string& name, const Attempt& attempt) {
+	std::optional<DiscoveredDevice> cached;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find(name);
+		if (it != m_entries.end()) {
+			cached = it->second.device;
+			++m_stats.hits;
+		}
+	}
+	if (cached) {
+		std::cout << "[Discovery] " << name << " -> " << cached->address << " (cached)" << std::endl;
+		if (attempt(*cached, true)) {
+			record_success(name, *cached);
+			return true;
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_stats.fallbacks;
+	}
+
+	auto found = discover(name);
+	if (!found) {
+		std::cerr << "[Discovery] No paired device called " << name << std::endl;
+		return false;
+	}
+	// Discovery agrees with the cache: the headset is where we looked, it just didn't answer.
+	if (cached && same_place(*cached, *found)) return false;
+	if (cached) {
+		// The headset moved, so the old entry is wrong whether or not the retry works.
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_entries.erase(name);
+	}
+	std::cout << "[Discovery] " << name << " -> " << found->address << std::endl;
+	if (!attempt(*found, false)) return false;
+	record_success(name, *found);
+	return true;
+}
+
+std::optional<DiscoveredDevice> DiscoveryCache::resolve(const std::string& name) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find(name);
+		if (it != m_entries.end()) return it->second.device;
+	}
+	return discover(name);
+}
+
+std::optional<DiscoveredDevice> DiscoveryCache::discover(const std::string& name) {
+	// Slow (hundreds of ms on Windows), so not under the lock.
+	auto found = m_discovery.find_by_name(name);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_stats.discoveries;
+	if (!found && m_entries.erase(name)) {
+		++m_stats.evictions;
+		save_locked();
+	}
+	return found;
+}
+
+void DiscoveryCache::record_success(const std::string& name, const DiscoveredDevice& device) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	DiscoveryEntry& entry = m_entries[name];
+	bool moved = entry.successes == 0 || !same_place(entry.device, device);
+	entry.device = device;
+	entry.last_success_ms =
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	++entry.successes;
+	// Timestamps alone aren't worth a write on every connect.
+	if (moved) save_locked();
+}
+
+std::optional<DiscoveryEntry> DiscoveryCache::entry(const std::string& name) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(name);
+	if (it == m_entries.end()) return std::nullopt;
+	return it->second;
+}
+
+void DiscoveryCache::forget(const std::string& name) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_entries.erase(name)) save_locked();
+}
+
+DiscoveryStats DiscoveryCache::stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+// --- Persistence ---
+
+bool DiscoveryCache::save() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return save_locked();
+}
+
+bool DiscoveryCache::save_locked() const {
+	if (m_path.empty()) return false;
+	// Renamed over the old file once complete, so a crash midway leaves the last good one.
+	std::ostringstream out;
+	for (const auto& [name, entry] : m_entries) {
+		out << sanitized(name) << '\t' << sanitized(entry.device.address) << '\t' << entry.device.channel << '\t'
+			<< entry.last_success_ms << '\t' << entry.successes << '\n';
+	}
+	std::string text = out.str();
+	if (!replace_file(m_path, std::vector<uint8_t>(text.begin(), text.end()))) {
+		std::cerr << "[Discovery] Can't write " << m_path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool DiscoveryCache::load() {
+	std::ifstream in(m_path);
+	if (!in) return false; // Nothing learned yet
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		std::string name, address, channel, last_success, successes;
+		if (!std::getline(fields, name, '\t') || !std::getline(fields, address, '\t') ||
+			!std::getline(fields, channel, '\t') || !std::getline(fields, last_success, '\t') ||
+			!std::getline(fields, successes)) {
+			continue; // Skip damaged lines
+		}
+		if (name.empty() || address.empty()) continue;
+		DiscoveryEntry& entry = m_entries[name];
+		entry.device = DiscoveredDevice{name, address, std::atoi(channel.c_str())};
+		entry.last_success_ms = std::atoll(last_success.c_str());
+		entry.successes = static_cast<uint32_t>(std::strtoul(successes.c_str(), nullptr, 10));
+	}
+	return true;
+}
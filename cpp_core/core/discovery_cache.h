@@ -0,0 +1,73 @@
+// cpp_core/core/discovery_cache.h
+
+#pragma once
+
+#include "platform/device_discovery_interface.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+struct DiscoveryEntry {
+  DiscoveredDevice device;
+  int64_t last_success_ms = 0; // System clock
+  uint32_t successes = 0;
+};
+
+struct DiscoveryStats {
+  uint64_t hits = 0;        // Connects that went straight to the cached address
+  uint64_t discoveries = 0; // Calls into the platform's discovery
+  uint64_t fallbacks = 0;   // Cached address failed; discovered again
+  uint64_t evictions = 0;   // Entries dropped because discovery no longer found them
+};
+
+// Remembers which address (and RFCOMM channel) a headset name resolved to the
+// last time a connect went through, so a repeat connect skips the platform's
+// discovery entirely.
+//
+// A cached entry is only doubted when a connect to it fails. Then the cache asks
+// discovery again:
+//   - a different address or channel (re-paired, swapped): the connect is retried there;
+//   - the same one: the entry was right, the headset just didn't answer;
+//   - nothing: it's no longer paired, and the entry is dropped.
+//
+// With a path, entries are loaded on construction and written back whenever a
+// connect succeeds somewhere new. Thread-safe. The discovery must outlive the cache.
+class DiscoveryCache {
+ public:
+  explicit DiscoveryCache(IDeviceDiscovery& discovery, std::string path = {});
+
+  DiscoveryCache(const DiscoveryCache&) = delete;
+  DiscoveryCache& operator=(const DiscoveryCache&) = delete;
+
+  // 'attempt' connects to the device it's given; 'cached' is true on the fast path
+  // (a platform may skip its own refresh work then). Returns whether one of the
+  // attempts succeeded.
+  using Attempt = std::function<bool(const DiscoveredDevice& device, bool cached)>;
+  bool connect(const std::string& name, const Attempt& attempt);
+
+  // What a connect would try first, without trying it.
+  std::optional<DiscoveredDevice> resolve(const std::string& name);
+
+  std::optional<DiscoveryEntry> entry(const std::string& name) const;
+  void forget(const std::string& name);
+  DiscoveryStats stats() const;
+
+  // One line per name: name, address, channel, last success and successes, tab-separated.
+  bool save() const;
+  bool load();
+
+ private:
+  std::optional<DiscoveredDevice> discover(const std::string& name);
+  void record_success(const std::string& name, const DiscoveredDevice& device);
+  // Called with m_mutex held.
+  bool save_locked() const;
+
+  IDeviceDiscovery& m_discovery;
+  std::string m_path;
+  mutable std::mutex m_mutex;
+  std::map<std::string, DiscoveryEntry> m_entries;
+  DiscoveryStats m_stats;
+};
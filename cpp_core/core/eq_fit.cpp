@@ -0,0 +1,329 @@
+#include "eq_fit.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <cstdlib>
+#include <numeric>
+
+namespace {
+
+constexpr int MIN_VALUE = -60, MAX_VALUE = 60;
+constexpr size_t TARGETS_PER_TASK = 32;
+
+// A field of a line, as offsets into the text.
+struct Field {
+	size_t begin, end;
+};
+
+// The first 'most' fields of the line [begin, end).
+void split(const std::string& text, size_t begin, size_t end, size_t most, std::vector<Field>& fields) {
+	fields.clear();
+	for (size_t at = begin;; ++at) {
+		size_t comma = text.find(',', at);
+		if (comma == std::string::npos || comma > end) comma = end;
+		fields.push_back(Field{at, comma});
+		if (comma == end || fields.size() == most) return;
+		at = comma;
+	}
+}
+
+// A number straight off the text, ending at the comma (or whatever) after it.
+// Plain decimals of up to 15 digits, which is what these files hold, are read
+// here: the digits and the power of ten are both exact in a double, so one
+// division rounds the same way strtod does, at a tenth of the cost. Anything
+// else goes to strtod.
+bool number(const char* at, const char* limit, double& out, const char** rest = nullptr) {
+	static constexpr double POW10[] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+	const char* p = at;
+	while (p < limit && (*p == ' ' || *p == '\t')) ++p;
+	bool negative = p < limit && *p == '-';
+	if (p < limit && (*p == '-' || *p == '+')) ++p;
+	uint64_t digits = 0;
+	int count = 0, fraction = 0;
+	bool point = false;
+	for (; p < limit; ++p) {
+		if (*p >= '0' && *p <= '9') {
+			digits = digits * 10 + (*p - '0');
+			++count;
+			fraction += point;
+		} else if (*p == '.' && !point) {
+			point = true;
+		} else {
+			break;
+		}
+	}
+	bool plain = count > 0 && count <= 15 && (p == limit || (*p != 'e' && *p != 'E' && !std::isalnum(static_cast<unsigned char>(*p))));
+	if (plain) {
+		out = static_cast<double>(digits) / POW10[fraction];
+		if (negative) out = -out;
+		if (rest) *rest = p;
+		return true;
+	}
+	char* end = nullptr;
+	out = std::strtod(at, &end);
+	if (rest) *rest = end;
+	return end != at && end <= limit && std::isfinite(out);
+}
+
+std::string column_name(const std::string& text, Field f) {
+	std::string name;
+	for (size_t i = f.begin; i < f.end; ++i) {
+		char c = text[i];
+		if (!std::isspace(static_cast<unsigned char>(c)) && c != '"') name += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return name;
+}
+
+double mean(const std::vector<double>& v) { return v.empty() ? 0 : std::accumulate(v.begin(), v.end(), 0.0) / v.size(); }
+
+} // namespace
+
+// --- Targets ---
+
+std::optional<EqTarget> EqTarget::parse(const std::string& text, std::string name) {
+	EqTarget target;
+	target.name = std::move(name);
+	const char* s = text.c_str();
+	const char* limit = s + text.size();
+	auto add = [&](double hz, double db) {
+		if (hz <= 0) return;
+		target.hz.push_back(hz);
+		target.db.push_back(db);
+	};
+
+	auto graphic = text.find("GraphicEQ:");
+	if (graphic != std::string::npos) {
+		// "GraphicEQ: 20 -1.5; 21 -1.4; ..."
+		const char* at = s + graphic + 10;
+		double hz, db;
+		while (number(at, limit, hz, &at) && number(at, limit, db, &at)) {
+			add(hz, db);
+			while (at < limit && std::isspace(static_cast<unsigned char>(*at))) ++at;
+			if (at == limit || *at != ';') break;
+			++at;
+		}
+	} else {
+		size_t hz_column = 0, db_column = 1;
+		std::vector<Field> fields;
+		for (size_t begin = 0; begin < text.size();) {
+			size_t end = text.find('\n', begin);
+			if (end == std::string::npos) end = text.size();
+			split(text, begin, end, begin == 0 ? SIZE_MAX : std::max(hz_column, db_column) + 1, fields);
+			double hz, db;
+			if (begin == 0 && !number(s + fields[0].begin, s + fields[0].end, hz)) {
+				// A header: the AutoEQ results CSV has the correction under "equalization".
+				for (size_t i = 0; i < fields.size(); ++i) {
+					auto column = column_name(text, fields[i]);
+					if (column == "frequency" || column == "freq" || column == "hz") hz_column = i;
+					if (column == "equalization") db_column = i;
+				}
+			} else if (fields.size() > std::max(hz_column, db_column)) {
+				const Field &f = fields[hz_column], &g = fields[db_column];
+				if (number(s + f.begin, s + f.end, hz) && number(s + g.begin, s + g.end, db)) add(hz, db);
+			}
+			begin = end + 1;
+		}
+	}
+	if (target.hz.size() < 2) return std::nullopt;
+
+	// Sorted by frequency, for resampling in one sweep.
+	if (std::is_sorted(target.hz.begin(), target.hz.end())) return target;
+	std::vector<size_t> order(target.hz.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return target.hz[a] < target.hz[b]; });
+	EqTarget sorted{target.name, {}, {}};
+	for (size_t i : order) {
+		sorted.hz.push_back(target.hz[i]);
+		sorted.db.push_back(target.db[i]);
+	}
+	return sorted;
+}
+
+// --- Setup ---
+
+EqFitter::EqFitter(EqFitConfig config) : m_config(config), m_response(config.grid) {
+	// The bands' responses per unit of value, from a full boost and a full cut:
+	// a peaking filter's dB response is nearly, not quite, proportional to its gain.
+	size_t n = m_response.points();
+	std::vector<float> up(n), down(n);
+	for (size_t k = 0; k < EqResponse::BANDS; ++k) {
+		std::vector<int8_t> values(EqResponse::BANDS, 0);
+		values[k] = MAX_VALUE;
+		m_response.evaluate(values, up.data());
+		values[k] = MIN_VALUE;
+		m_response.evaluate(values, down.data());
+		auto& basis = m_basis[k];
+		basis.resize(n);
+		for (size_t i = 0; i < n; ++i) basis[i] = (up[i] - down[i]) / (MAX_VALUE - MIN_VALUE);
+		double m = mean(basis);
+		for (double& b : basis) b -= m; // Level doesn't count (see EqFitResult)
+	}
+	for (size_t i = 0; i < EqResponse::BANDS; ++i) {
+		for (size_t j = 0; j < EqResponse::BANDS; ++j) {
+			m_gram[i][j] = std::inner_product(m_basis[i].begin(), m_basis[i].end(), m_basis[j].begin(), 0.0);
+		}
+	}
+}
+
+// Linear in log frequency between the target's points.
+std::vector<double> EqFitter::resample(const EqTarget& target) const {
+	std::vector<double> out;
+	out.reserve(m_response.points());
+	size_t j = 0;
+	for (float f : m_response.frequencies()) {
+		double x = f;
+		if (x <= target.hz.front()) {
+			out.push_back(target.db.front());
+			continue;
+		}
+		if (x >= target.hz.back()) {
+			out.push_back(target.db.back());
+			continue;
+		}
+		while (target.hz[j + 1] < x) ++j;
+		double x0 = target.hz[j], x1 = target.hz[j + 1];
+		double t = x1 > x0 ? std::log(x / x0) / std::log(x1 / x0) : 0;
+		out.push_back(target.db[j] + t * (target.db[j + 1] - target.db[j]));
+	}
+	return out;
+}
+
+// --- Solving ---
+
+// Minimizes |sum g_k basis_k - target|^2 with every g_k in [-60, 60], given
+// h_k = basis_k . target: projected coordinate descent on the normal equations.
+EqFitter::Bands EqFitter::solve(const Bands& h, Bands g) const {
+	for (int pass = 0; pass < m_config.solve_passes; ++pass) {
+		double moved = 0;
+		for (size_t k = 0; k < EqResponse::BANDS; ++k) {
+			double rest = h[k];
+			for (size_t j = 0; j < EqResponse::BANDS; ++j) {
+				if (j != k) rest -= m_gram[k][j] * g[j];
+			}
+			double next = std::clamp(rest / m_gram[k][k], double(MIN_VALUE), double(MAX_VALUE));
+			moved = std::max(moved, std::abs(next - g[k]));
+			g[k] = next;
+		}
+		if (moved < 1e-3) break;
+	}
+	return g;
+}
+
+// Rounds, then moves single bands by one step while that lowers the error. The
+// error's change is read off the gradient, kept up to date in O(bands) a step.
+std::array<int, EqResponse::BANDS> EqFitter::refine(const Bands& h, const Bands& g) const {
+	std::array<int, EqResponse::BANDS> v{};
+	for (size_t k = 0; k < EqResponse::BANDS; ++k) v[k] = std::clamp(static_cast<int>(std::lround(g[k])), MIN_VALUE, MAX_VALUE);
+	Bands grad{}; // Gram * v - h
+	for (size_t k = 0; k < EqResponse::BANDS; ++k) {
+		grad[k] = -h[k];
+		for (size_t j = 0; j < EqResponse::BANDS; ++j) grad[k] += m_gram[k][j] * v[j];
+	}
+	for (int pass = 0; pass < m_config.refine_passes; ++pass) {
+		bool moved = false;
+		for (size_t k = 0; k < EqResponse::BANDS; ++k) {
+			for (int step : {-1, 1}) {
+				if (v[k] + step < MIN_VALUE || v[k] + step > MAX_VALUE) continue;
+				if (2 * step * grad[k] + m_gram[k][k] >= 0) continue;
+				v[k] += step;
+				for (size_t j = 0; j < EqResponse::BANDS; ++j) grad[j] += step * m_gram[j][k];
+				moved = true;
+				break;
+			}
+		}
+		if (!moved) break;
+	}
+	return v;
+}
+
+// The true response of 'values' against the target, levels matched.
+EqFitResult EqFitter::measure(const std::array<int, EqResponse::BANDS>& values, const std::vector<double>& target,
+							  std::vector<float>& response) const {
+	EqFitResult result;
+	std::vector<int8_t> v(values.begin(), values.end());
+	m_response.evaluate(v, response.data());
+	double level = 0;
+	for (size_t i = 0; i < target.size(); ++i) level += target[i] - response[i];
+	level /= target.size();
+	double sum = 0;
+	for (size_t i = 0; i < target.size(); ++i) {
+		double err = response[i] + level - target[i];
+		sum += err * err;
+		result.max_db = std::max(result.max_db, std::abs(err));
+	}
+	result.rms_db = std::sqrt(sum / target.size());
+	result.level_db = level;
+	for (size_t k = 0; k < EqResponse::BANDS; ++k) {
+		result.values[k] = static_cast<int8_t>(values[k]);
+		result.clipped |= values[k] == MIN_VALUE || values[k] == MAX_VALUE;
+	}
+	return result;
+}
+
+// --- Fitting ---
+
+EqFitResult EqFitter::fit(const EqTarget& target) const {
+	if (target.hz.size() < 2 || target.hz.size() != target.db.size()) return {};
+	std::vector<double> t = resample(target);
+	double level = mean(t);
+	for (double& x : t) x -= level;
+
+	auto correlate = [&](const std::vector<double>& with) {
+		Bands h{};
+		for (size_t k = 0; k < EqResponse::BANDS; ++k) h[k] = std::inner_product(m_basis[k].begin(), m_basis[k].end(), with.begin(), 0.0);
+		return h;
+	};
+	Bands h = correlate(t);
+	Bands g = solve(h, Bands{});
+	auto values = refine(h, g);
+	std::vector<float> response(t.size());
+	EqFitResult best = measure(values, t, response);
+
+	// Fit again to the target less what the sum of bands gets wrong about the
+	// response of the values just found.
+	std::vector<double> corrected(t.size());
+	for (int round = 0; round < m_config.relinearize; ++round) {
+		double mean_response = std::accumulate(response.begin(), response.end(), 0.0) / response.size();
+		for (size_t i = 0; i < t.size(); ++i) {
+			double linear = 0;
+			for (size_t k = 0; k < EqResponse::BANDS; ++k) linear += values[k] * m_basis[k][i];
+			corrected[i] = t[i] - (response[i] - mean_response - linear);
+		}
+		Bands start{};
+		for (size_t k = 0; k < EqResponse::BANDS; ++k) start[k] = values[k];
+		h = correlate(corrected);
+		values = refine(h, solve(h, start));
+		EqFitResult next = measure(values, t, response);
+		if (next.rms_db >= best.rms_db) break;
+		best = next;
+	}
+	best.level_db += level;
+	return best;
+}
+
+std::vector<EqFitResult> EqFitter::fit_all(const std::vector<EqTarget>& targets, IExecutor& executor) const {
+	std::vector<EqFitResult> results(targets.size());
+	struct Latch {
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t left = 0;
+	};
+	auto latch = std::make_shared<Latch>();
+	latch->left = (targets.size() + TARGETS_PER_TASK - 1) / TARGETS_PER_TASK;
+	if (latch->left == 0) return results;
+	for (size_t first = 0; first < targets.size(); first += TARGETS_PER_TASK) {
+		size_t last = std::min(first + TARGETS_PER_TASK, targets.size());
+		executor.post([this, &targets, &results, latch, first, last] {
+			for (size_t i = first; i < last; ++i) results[i] = fit(targets[i]);
+			std::lock_guard<std::mutex> lock(latch->mutex);
+			if (--latch->left == 0) latch->done.notify_all();
+		});
+	}
+	std::unique_lock<std::mutex> lock(latch->mutex);
+	latch->done.wait(lock, [&] { return latch->left == 0; });
+	return results;
+}
@@ -0,0 +1,81 @@
+// cpp_core/core/eq_fit.h
+
+#pragma once
+
+#include "core/eq_response.h"
+#include "core/executor.h"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A correction curve to fit: gain in dB at increasing frequencies.
+struct EqTarget {
+  std::string name;
+  std::vector<double> hz;
+  std::vector<double> db;
+
+  // Reads an AutoEQ-style export: a CSV with a header (the "frequency" and
+  // "equalization" columns if it names them, else the first two), a headerless
+  // two-column CSV, or a "GraphicEQ: hz db; hz db; ..." line. Nullopt if fewer
+  // than two points could be read.
+  static std::optional<EqTarget> parse(const std::string& text, std::string name = {});
+};
+
+struct EqFitConfig {
+  // Where the fit is measured. Targets are interpolated onto this grid (on a log
+  // frequency scale) and held flat past their ends.
+  EqResponseConfig grid{96, 20, 20000};
+  // Coordinate passes over the ten bands, continuous and then on integers.
+  int solve_passes = 60;
+  int refine_passes = 8;
+  // Times the fit is redone against the true (slightly nonlinear) response of
+  // the values found, instead of the sum of the single-band responses.
+  int relinearize = 1;
+};
+
+struct EqFitResult {
+  std::array<int8_t, EqResponse::BANDS> values{}; // As in CustomEqPreset::values
+  // The fitted curve's response against the target, both moved to the same mean
+  // level: overall loudness isn't something the bands should spend range on.
+  double rms_db = 0;
+  double max_db = 0;
+  double level_db = 0; // Where the target's level ended up relative to the curve's
+  bool clipped = false; // Some band is at -60 or 60
+};
+
+// Fits correction curves to the headset's ten fixed bands (values -60..60, in
+// tenths of a dB). The response of a curve is close to the sum of its bands'
+// responses, so the fit is a least-squares problem over ten box-constrained
+// unknowns: the single-band responses and their Gram matrix depend on the grid
+// only and are worked out once. Per target that leaves ten dot products over
+// the grid, coordinate descent on a 10x10 system, rounding and an integer
+// search around the rounded values, and one true evaluation (see EqResponse)
+// to measure the error, redone 'relinearize' times against the difference.
+//
+// A fitter is immutable after construction: fit() may run on many threads.
+class EqFitter {
+ public:
+  explicit EqFitter(EqFitConfig config = {});
+
+  EqFitResult fit(const EqTarget& target) const;
+  // Fits every target on 'executor', a share of them per task, and waits for all.
+  // Don't call it from a task on that executor.
+  std::vector<EqFitResult> fit_all(const std::vector<EqTarget>& targets, IExecutor& executor = default_executor()) const;
+
+ private:
+  using Bands = std::array<double, EqResponse::BANDS>;
+
+  std::vector<double> resample(const EqTarget& target) const;
+  Bands solve(const Bands& h, Bands g) const;
+  std::array<int, EqResponse::BANDS> refine(const Bands& h, const Bands& g) const;
+  EqFitResult measure(const std::array<int, EqResponse::BANDS>& values, const std::vector<double>& target,
+                      std::vector<float>& response) const;
+
+  EqFitConfig m_config;
+  EqResponse m_response;
+  // Response of each band per unit of value (a tenth of a dB), less its mean over the grid.
+  std::array<std::vector<double>, EqResponse::BANDS> m_basis;
+  std::array<Bands, EqResponse::BANDS> m_gram; // m_basis[i] . m_basis[j]
+};
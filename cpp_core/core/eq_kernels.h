@@ -0,0 +1,169 @@
+// cpp_core/core/eq_kernels.h
+
+#pragma once
+
+// The inner loop of EqResponse, once per instruction set. Not part of the
+// interface: only eq_response.cpp and eq_response_avx2.cpp include this.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPENFREEBUDS_EQ_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OPENFREEBUDS_EQ_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace eq_kernels {
+
+// Everything here is internal to each file that includes it: the AVX2 file's
+// copies are built for AVX2 and mustn't stand in for the others' at link time.
+namespace {
+
+// Per band, |H|^2 = P(phi) / Q(phi) with phi = sin^2(w/2), as
+// P0 + phi*(P1 + phi*P2) over Q0 + phi*(Q1 + phi*Q2).
+constexpr size_t COEFFS_PER_BAND = 6;
+
+constexpr float DB_PER_LN = 4.342944819f; // 10 / ln(10): power ratio to dB
+constexpr float LN2 = 0.693147181f;
+constexpr float SQRT2 = 1.414213562f;
+
+struct Scalar {
+  using V = float;
+  static constexpr size_t N = 1;
+  static V set(float v) { return v; }
+  static V load(const float* p) { return *p; }
+  static void store(float* p, V v) { *p = v; }
+  static V add(V a, V b) { return a + b; }
+  static V sub(V a, V b) { return a - b; }
+  static V mul(V a, V b) { return a * b; }
+  static V div(V a, V b) { return a / b; }
+  static V db(V x) { return 10.0f * std::log10(x); }
+};
+
+// ln(x) for positive normal x, from its exponent and mantissa: x = m * 2^e with m
+// in [sqrt(1/2), sqrt(2)), and ln(m) = 2 atanh((m-1)/(m+1)) to four terms.
+// Off by less than 1e-7 relative, far below what a drawn curve shows.
+template <typename Ops>
+typename Ops::V fast_db(typename Ops::V x) {
+  using V = typename Ops::V;
+  V e = Ops::exponent(x);
+  V m = Ops::mantissa(x);
+  V big = Ops::greater(m, Ops::set(SQRT2));
+  m = Ops::select(big, Ops::mul(m, Ops::set(0.5f)), m);
+  e = Ops::select(big, Ops::add(e, Ops::set(1.0f)), e);
+  V t = Ops::div(Ops::sub(m, Ops::set(1.0f)), Ops::add(m, Ops::set(1.0f)));
+  V t2 = Ops::mul(t, t);
+  V series = Ops::add(Ops::set(1.0f / 5), Ops::mul(t2, Ops::set(1.0f / 7)));
+  series = Ops::add(Ops::set(1.0f / 3), Ops::mul(t2, series));
+  series = Ops::add(Ops::set(1.0f), Ops::mul(t2, series));
+  V ln = Ops::add(Ops::mul(e, Ops::set(LN2)), Ops::mul(Ops::mul(Ops::set(2.0f), t), series));
+  return Ops::mul(ln, Ops::set(DB_PER_LN));
+}
+
+#ifdef OPENFREEBUDS_EQ_SSE2
+struct Sse2 {
+  using V = __m128;
+  static constexpr size_t N = 4;
+  static V set(float v) { return _mm_set1_ps(v); }
+  static V load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+  static V add(V a, V b) { return _mm_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm_div_ps(a, b); }
+  static V greater(V a, V b) { return _mm_cmpgt_ps(a, b); }
+  static V select(V mask, V t, V f) { return _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, f)); }
+  static V exponent(V x) {
+    __m128i biased = _mm_srli_epi32(_mm_castps_si128(x), 23);
+    return _mm_cvtepi32_ps(_mm_sub_epi32(biased, _mm_set1_epi32(127)));
+  }
+  static V mantissa(V x) {
+    __m128i bits = _mm_and_si128(_mm_castps_si128(x), _mm_set1_epi32(0x007fffff));
+    return _mm_castsi128_ps(_mm_or_si128(bits, _mm_set1_epi32(0x3f800000)));
+  }
+  static V db(V x) { return fast_db<Sse2>(x); }
+};
+#endif
+
+#ifdef OPENFREEBUDS_EQ_NEON
+struct Neon {
+  using V = float32x4_t;
+  static constexpr size_t N = 4;
+  static V set(float v) { return vdupq_n_f32(v); }
+  static V load(const float* p) { return vld1q_f32(p); }
+  static void store(float* p, V v) { vst1q_f32(p, v); }
+  static V add(V a, V b) { return vaddq_f32(a, b); }
+  static V sub(V a, V b) { return vsubq_f32(a, b); }
+  static V mul(V a, V b) { return vmulq_f32(a, b); }
+  static V div(V a, V b) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return vdivq_f32(a, b);
+#else
+    // ARMv7 has no vector divide: a reciprocal estimate and two Newton steps.
+    V r = vrecpeq_f32(b);
+    r = vmulq_f32(r, vrecpsq_f32(b, r));
+    r = vmulq_f32(r, vrecpsq_f32(b, r));
+    return vmulq_f32(a, r);
+#endif
+  }
+  static V greater(V a, V b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+  static V select(V mask, V t, V f) { return vbslq_f32(vreinterpretq_u32_f32(mask), t, f); }
+  static V exponent(V x) {
+    uint32x4_t biased = vshrq_n_u32(vreinterpretq_u32_f32(x), 23);
+    return vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(biased), vdupq_n_s32(127)));
+  }
+  static V mantissa(V x) {
+    uint32x4_t bits = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x007fffff));
+    return vreinterpretq_f32_u32(vorrq_u32(bits, vdupq_n_u32(0x3f800000)));
+  }
+  static V db(V x) { return fast_db<Neon>(x); }
+};
+#endif
+
+// The response in dB at the points in 'p'.
+template <typename Ops>
+typename Ops::V response_db(typename Ops::V p, const float* coeffs, size_t bands) {
+  using V = typename Ops::V;
+  V gain = Ops::set(1.0f);
+  for (size_t b = 0; b < bands; ++b) {
+    const float* c = coeffs + b * COEFFS_PER_BAND;
+    V num = Ops::add(Ops::set(c[0]), Ops::mul(p, Ops::add(Ops::set(c[1]), Ops::mul(p, Ops::set(c[2])))));
+    V den = Ops::add(Ops::set(c[3]), Ops::mul(p, Ops::add(Ops::set(c[4]), Ops::mul(p, Ops::set(c[5])))));
+    // Divided per band: the low bands' P and Q are tiny near DC and their
+    // product over ten bands would underflow.
+    gain = Ops::mul(gain, Ops::div(num, den));
+  }
+  return Ops::db(gain);
+}
+
+// Writes the response in dB at 'count' points into 'db'. The points left over
+// after the whole vectors go through one more vector, padded with the last
+// point, rather than through Scalar: the AVX2 file mustn't use anything (like
+// std::log10) that the other files also get an inline copy of, or the linker
+// may keep the AVX2 copy for everybody.
+template <typename Ops>
+void response(const float* phi, size_t count, const float* coeffs, size_t bands, float* db) {
+  size_t i = 0;
+  for (; i + Ops::N <= count; i += Ops::N) Ops::store(db + i, response_db<Ops>(Ops::load(phi + i), coeffs, bands));
+  if (i < count) {
+    float phi_tail[Ops::N], db_tail[Ops::N];
+    for (size_t k = 0; k < Ops::N; ++k) phi_tail[k] = phi[i + k < count ? i + k : count - 1];
+    Ops::store(db_tail, response_db<Ops>(Ops::load(phi_tail), coeffs, bands));
+    for (size_t k = 0; i + k < count; ++k) db[i + k] = db_tail[k];
+  }
+}
+
+} // namespace
+
+// In eq_response_avx2.cpp, the one file built for AVX2. False if it was built
+// without (a compiler or target that doesn't take the flag); then it does nothing.
+bool avx2_built();
+void avx2_response(const float* phi, size_t count, const float* coeffs, size_t bands, float* db);
+
+} // namespace eq_kernels
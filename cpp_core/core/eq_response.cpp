@@ -0,0 +1,146 @@
+#include "eq_response.h"
+#include "eq_kernels.h"
+#include <cmath>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+bool cpu_has_avx2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = info[2] & (1 << 27), fma = info[2] & (1 << 12);
+	__cpuidex(info, 7, 0);
+	bool avx2 = info[1] & (1 << 5);
+	// The OS has to save the YMM registers too.
+	return osxsave && fma && avx2 && (_xgetbv(0) & 6) == 6;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+	return false;
+#endif
+}
+
+} // namespace
+
+bool EqResponse::supports(SimdLevel level) {
+	switch (level) {
+		case SimdLevel::SCALAR: return true;
+#ifdef OPENFREEBUDS_EQ_SSE2
+		case SimdLevel::SSE2: return true;
+#endif
+#ifdef OPENFREEBUDS_EQ_NEON
+		case SimdLevel::NEON: return true;
+#endif
+		case SimdLevel::AVX2: {
+			static const bool avx2 = eq_kernels::avx2_built() && cpu_has_avx2();
+			return avx2;
+		}
+		default: return false;
+	}
+}
+
+const char* simd_level_name(SimdLevel level) {
+	switch (level) {
+		case SimdLevel::SCALAR: return "scalar";
+		case SimdLevel::SSE2: return "sse2";
+		case SimdLevel::AVX2: return "avx2";
+		case SimdLevel::NEON: return "neon";
+	}
+	return "unknown";
+}
+
+SimdLevel EqResponse::best_simd_level() {
+	for (SimdLevel level : {SimdLevel::AVX2, SimdLevel::SSE2, SimdLevel::NEON}) {
+		if (supports(level)) return level;
+	}
+	return SimdLevel::SCALAR;
+}
+
+// --- Grid ---
+
+const std::array<double, EqResponse::BANDS> EqResponse::BAND_HZ = {32, 64, 125, 250, 500, 1000, 2000, 4000, 8000, 16000};
+
+EqResponse::EqResponse(EqResponseConfig config) : m_config(config), m_level(best_simd_level()) {
+	size_t n = config.points;
+	m_hz.reserve(n);
+	m_phi.reserve(n);
+	double ratio = config.max_hz / config.min_hz;
+	for (size_t i = 0; i < n; ++i) {
+		double hz = config.min_hz * std::pow(ratio, n > 1 ? static_cast<double>(i) / (n - 1) : 0.0);
+		double half = std::sin(PI * hz / config.sample_rate); // sin(w/2)
+		m_hz.push_back(static_cast<float>(hz));
+		m_phi.push_back(static_cast<float>(half * half));
+	}
+}
+
+// --- Filters ---
+
+std::array<Biquad, EqResponse::BANDS> EqResponse::biquads(const std::vector<int8_t>& values) const {
+	std::array<Biquad, BANDS> bands{};
+	for (size_t b = 0; b < BANDS && b < values.size(); ++b) {
+		if (values[b] == 0) continue;
+		double a = std::pow(10.0, values[b] / 10.0 / 40.0); // 10^(dB/40); values are tenths of a dB
+		double w0 = 2 * PI * BAND_HZ[b] / m_config.sample_rate;
+		double alpha = std::sin(w0) / (2 * m_config.q);
+		double a0 = 1 + alpha / a;
+		Biquad& q = bands[b];
+		q.b0 = (1 + alpha * a) / a0;
+		q.b1 = -2 * std::cos(w0) / a0;
+		q.b2 = (1 - alpha * a) / a0;
+		q.a1 = q.b1;
+		q.a2 = (1 - alpha / a) / a0;
+	}
+	return bands;
+}
+
+// --- Evaluation ---
+
+void EqResponse::evaluate(const std::vector<int8_t>& values, float* db) const { evaluate(values, db, m_level); }
+
+std::vector<float> EqResponse::evaluate(const CustomEqPreset& preset) const {
+	std::vector<float> db(points());
+	evaluate(preset.values, db.data());
+	return db;
+}
+
+void EqResponse::evaluate(const std::vector<int8_t>& values, float* db, SimdLevel level) const {
+	// |H|^2 of each band as two quadratics in phi = sin^2(w/2) (RBJ cookbook),
+	// worked out in double: near DC the low bands' terms nearly cancel.
+	float coeffs[BANDS * eq_kernels::COEFFS_PER_BAND];
+	size_t bands = 0;
+	auto filters = biquads(values);
+	for (size_t b = 0; b < BANDS && b < values.size(); ++b) {
+		if (values[b] == 0) continue; // Flat
+		const Biquad& q = filters[b];
+		float* c = coeffs + bands++ * eq_kernels::COEFFS_PER_BAND;
+		double sum_b = q.b0 + q.b1 + q.b2, sum_a = 1 + q.a1 + q.a2;
+		c[0] = static_cast<float>(sum_b * sum_b);
+		c[1] = static_cast<float>(-4 * (q.b0 * q.b1 + 4 * q.b0 * q.b2 + q.b1 * q.b2));
+		c[2] = static_cast<float>(16 * q.b0 * q.b2);
+		c[3] = static_cast<float>(sum_a * sum_a);
+		c[4] = static_cast<float>(-4 * (q.a1 + 4 * q.a2 + q.a1 * q.a2));
+		c[5] = static_cast<float>(16 * q.a2);
+	}
+
+	const float* phi = m_phi.data();
+	size_t n = m_phi.size();
+	if (!supports(level)) level = SimdLevel::SCALAR;
+	switch (level) {
+		case SimdLevel::AVX2: eq_kernels::avx2_response(phi, n, coeffs, bands, db); break;
+#ifdef OPENFREEBUDS_EQ_SSE2
+		case SimdLevel::SSE2: eq_kernels::response<eq_kernels::Sse2>(phi, n, coeffs, bands, db); break;
+#endif
+#ifdef OPENFREEBUDS_EQ_NEON
+		case SimdLevel::NEON: eq_kernels::response<eq_kernels::Neon>(phi, n, coeffs, bands, db); break;
+#endif
+		default: eq_kernels::response<eq_kernels::Scalar>(phi, n, coeffs, bands, db); break;
+	}
+}
@@ -0,0 +1,51 @@
+// Built with AVX2 enabled (see CMakeLists.txt) and only called once the CPU is
+// known to have it: nothing else may live in this file.
+#include "eq_kernels.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+namespace eq_kernels {
+namespace {
+
+struct Avx2 {
+	using V = __m256;
+	static constexpr size_t N = 8;
+	static V set(float v) { return _mm256_set1_ps(v); }
+	static V load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+	static V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm256_div_ps(a, b); }
+	static V greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static V select(V mask, V t, V f) { return _mm256_blendv_ps(f, t, mask); }
+	static V exponent(V x) {
+		__m256i biased = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+		return _mm256_cvtepi32_ps(_mm256_sub_epi32(biased, _mm256_set1_epi32(127)));
+	}
+	static V mantissa(V x) {
+		__m256i bits = _mm256_and_si256(_mm256_castps_si256(x), _mm256_set1_epi32(0x007fffff));
+		return _mm256_castsi256_ps(_mm256_or_si256(bits, _mm256_set1_epi32(0x3f800000)));
+	}
+	static V db(V x) { return fast_db<Avx2>(x); }
+};
+
+} // namespace
+
+bool avx2_built() { return true; }
+
+void avx2_response(const float* phi, size_t count, const float* coeffs, size_t bands, float* db) {
+	response<Avx2>(phi, count, coeffs, bands, db);
+}
+
+} // namespace eq_kernels
+
+#else
+
+namespace eq_kernels {
+bool avx2_built() { return false; }
+void avx2_response(const float*, size_t, const float*, size_t, float*) {}
+} // namespace eq_kernels
+
+#endif
@@ -0,0 +1,237 @@
+#include "eq_slots.h"
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+
+namespace {
+
+using Send = std::function<void(const RequestOptions&)>;
+
+// Sends 'writes' as one batch and waits for every ack; the first status that
+// isn't OK is the answer.
+RequestStatus write_and_wait(Device& device, const std::vector<Send>& writes, const RequestOptions& options) {
+	struct Acks {
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t left = 0;
+		RequestStatus status = RequestStatus::OK;
+	};
+	auto acks = std::make_shared<Acks>();
+	acks->left = writes.size();
+	{
+		auto batch = device.batch_writes();
+		for (const auto& send : writes) {
+			RequestOptions o;
+			o.deadline = options.deadline;
+			o.cancel = options.cancel;
+			o.on_done = [acks](RequestStatus status) {
+				std::lock_guard<std::mutex> lock(acks->mutex);
+				if (acks->status == RequestStatus::OK) acks->status = status;
+				if (--acks->left == 0) acks->done.notify_all();
+			};
+			send(o);
+		}
+	}
+	std::unique_lock<std::mutex> lock(acks->mutex);
+	acks->done.wait(lock, [&] { return acks->left == 0; });
+	return acks->status;
+}
+
+CustomEqPreset under(uint8_t id, const CustomEqPreset& curve) {
+	CustomEqPreset preset = curve;
+	preset.id = id;
+	return preset;
+}
+
+} // namespace
+
+// --- Setup ---
+
+EqSlots::EqSlots(Device& device, EqSlotsConfig config) : m_device(device) {
+	for (uint8_t id : config.slot_ids) m_slots.emplace_back().id = id;
+}
+
+// FNV-1a over the bands, then the name. The id isn't content: the same curve
+// under another id is the same curve.
+uint64_t EqSlots::hash_of(const CustomEqPreset& curve) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	auto mix = [&](uint8_t byte) {
+		hash ^= byte;
+		hash *= 0x100000001b3ull;
+	};
+	mix(static_cast<uint8_t>(curve.values.size()));
+	for (int8_t v : curve.values) mix(static_cast<uint8_t>(v));
+	for (char c : curve.name) mix(static_cast<uint8_t>(c));
+	return hash;
+}
+
+EqSlotStats EqSlots::stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+std::optional<uint8_t> EqSlots::find(const CustomEqPreset& curve) const {
+	auto state = m_device.snapshot();
+	const auto& info = state->equalizer.shown();
+	if (!info) return std::nullopt;
+	return resident(*info, hash_of(curve));
+}
+
+// --- Residency ---
+
+// The cached equalizer state, read from the device first if the cache has none
+// or can't vouch for it (restored, or changed behind our back since).
+std::optional<EqualizerInfo> EqSlots::equalizer(const RequestOptions& options) {
+	{
+		auto state = m_device.snapshot();
+		const auto& field = state->equalizer;
+		if (field.pending) return field.pending;
+		if (!field.stale()) return field.value;
+	}
+	return m_device.get_equalizer_info(options);
+}
+
+// What the device holds is the truth: a slot someone else wrote or deleted
+// takes that content, and keeps its place in the LRU order.
+void EqSlots::sync(const EqualizerInfo& info) {
+	for (auto& slot : m_slots) {
+		auto it = std::find_if(info.custom_presets.begin(), info.custom_presets.end(),
+							   [&](const CustomEqPreset& p) { return p.id == slot.id; });
+		slot.hash = it == info.custom_presets.end() ? std::nullopt : std::optional<uint64_t>(hash_of(*it));
+	}
+}
+
+std::optional<uint8_t> EqSlots::resident(const EqualizerInfo& info, uint64_t hash) const {
+	for (const auto& preset : info.custom_presets) {
+		if (hash_of(preset) == hash) return preset.id;
+	}
+	return std::nullopt;
+}
+
+// An empty slot, else the least recently used one, skipping the ids in 'keep'.
+EqSlots::Slot* EqSlots::victim(const std::vector<uint8_t>& keep) {
+	Slot* best = nullptr;
+	for (auto& slot : m_slots) {
+		if (std::find(keep.begin(), keep.end(), slot.id) != keep.end()) continue;
+		if (!slot.hash) return &slot;
+		if (!best || slot.last_used < best->last_used) best = &slot;
+	}
+	return best;
+}
+
+void EqSlots::touch(uint8_t id) {
+	for (auto& slot : m_slots) {
+		if (slot.id == id) slot.last_used = ++m_tick;
+	}
+}
+
+// --- Switching ---
+
+std::optional<uint8_t> EqSlots::select(const CustomEqPreset& curve, const RequestOptions& options) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_stats.switches;
+	auto info = equalizer(options);
+	if (!info) {
+		++m_stats.failed;
+		std::cerr << "[EqSlots] Can't read the equalizer" << std::endl;
+		return std::nullopt;
+	}
+	sync(*info);
+
+	uint64_t hash = hash_of(curve);
+	if (auto id = resident(*info, hash)) {
+		// Elided by the Device if it's the current preset already.
+		auto status = write_and_wait(m_device, {[&](const RequestOptions& o) { m_device.set_equalizer_preset(*id, o); }}, options);
+		if (status != RequestStatus::OK) {
+			++m_stats.failed;
+			return std::nullopt;
+		}
+		++m_stats.hits;
+		touch(*id);
+		return id;
+	}
+
+	Slot* slot = victim({});
+	if (!slot) {
+		++m_stats.failed;
+		std::cerr << "[EqSlots] No slots to save the curve in" << std::endl;
+		return std::nullopt;
+	}
+	bool evicting = slot->hash.has_value();
+	auto preset = under(slot->id, curve);
+	// Saving makes it the current preset too.
+	auto status = write_and_wait(m_device, {[&](const RequestOptions& o) { m_device.create_or_update_custom_equalizer(preset, o); }}, options);
+	if (status != RequestStatus::OK) {
+		++m_stats.failed;
+		slot->hash.reset(); // Whatever is there now, it's not known
+		return std::nullopt;
+	}
+	++m_stats.uploads;
+	if (evicting) ++m_stats.evictions;
+	slot->hash = hash;
+	slot->last_used = ++m_tick;
+	return slot->id;
+}
+
+size_t EqSlots::stage(const std::vector<CustomEqPreset>& curves, const RequestOptions& options) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto info = equalizer(options);
+	if (!info) {
+		std::cerr << "[EqSlots] Can't read the equalizer" << std::endl;
+		return 0;
+	}
+	sync(*info);
+
+	// The current preset, and every curve of the call that's on the device already, stay.
+	std::vector<uint8_t> keep{info->current_preset_id};
+	std::vector<const CustomEqPreset*> missing;
+	size_t there = 0;
+	for (const auto& curve : curves) {
+		if (auto id = resident(*info, hash_of(curve))) {
+			keep.push_back(*id);
+			touch(*id);
+			++there;
+		} else {
+			missing.push_back(&curve);
+		}
+	}
+
+	std::vector<Send> writes;
+	std::vector<std::pair<Slot*, uint64_t>> filled;
+	uint64_t evictions = 0;
+	for (const CustomEqPreset* curve : missing) {
+		uint64_t hash = hash_of(*curve);
+		if (std::any_of(filled.begin(), filled.end(), [&](const auto& f) { return f.second == hash; })) continue;
+		Slot* slot = victim(keep);
+		if (!slot) break;
+		keep.push_back(slot->id);
+		if (slot->hash) ++evictions;
+		filled.emplace_back(slot, hash);
+		writes.push_back([this, preset = under(slot->id, *curve)](const RequestOptions& o) {
+			m_device.create_or_update_custom_equalizer(preset, o);
+		});
+	}
+	if (writes.empty()) return there;
+
+	// Each save switched to what it saved; back to what was playing, in the same batch.
+	uint8_t current = info->current_preset_id;
+	writes.push_back([this, current](const RequestOptions& o) { m_device.set_equalizer_preset(current, o); });
+	if (write_and_wait(m_device, writes, options) != RequestStatus::OK) {
+		++m_stats.failed;
+		for (auto& [slot, hash] : filled) slot->hash.reset();
+		std::cerr << "[EqSlots] Staging failed" << std::endl;
+		return there;
+	}
+	for (auto& [slot, hash] : filled) {
+		slot->hash = hash;
+		slot->last_used = ++m_tick;
+	}
+	m_stats.uploads += filled.size();
+	m_stats.evictions += evictions;
+	return there + std::count_if(missing.begin(), missing.end(), [&](const CustomEqPreset* curve) {
+			   uint64_t hash = hash_of(*curve);
+			   return std::any_of(filled.begin(), filled.end(), [&](const auto& f) { return f.second == hash; });
+		   });
+}
@@ -0,0 +1,82 @@
+// cpp_core/core/eq_slots.h
+
+#pragma once
+
+#include "core/device.h"
+#include "core/request_options.h"
+#include "core/types.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+struct EqSlotsConfig {
+  // Custom preset ids the manager may fill and overwrite. Presets under other ids
+  // (the user's own, the app's fake presets) are never written, though a curve
+  // already saved under one is switched to. Keep it no larger than the number of
+  // custom presets the model keeps.
+  std::vector<uint8_t> slot_ids{250, 251, 252};
+};
+
+struct EqSlotStats {
+  uint64_t switches = 0;  // select() calls
+  uint64_t hits = 0;      // The curve was on the device: one set_equalizer_preset
+  uint64_t uploads = 0;   // Saved into a slot, by select() or stage()
+  uint64_t evictions = 0; // Uploads over another curve
+  uint64_t failed = 0;
+};
+
+// Switches between custom EQ curves the cheap way. Saving a curve sends its ten
+// bands and name; switching to one the headset already keeps is a one-byte
+// set_equalizer_preset. The manager knows which curve each custom preset holds
+// by a hash of its content (bands and name), taken from the Device's state
+// cache, so there's no re-read after a switch. A curve that isn't on the device
+// is saved into a free slot, or over the least recently used one.
+//
+// stage() saves curves ahead of time (the ones the UI offers next) without
+// changing what's playing, so the switch to them later is a hit.
+//
+// Calls block until the device acked them, and one runs at a time. The Device
+// must outlive the manager.
+class EqSlots {
+ public:
+  explicit EqSlots(Device& device, EqSlotsConfig config = {});
+
+  EqSlots(const EqSlots&) = delete;
+  EqSlots& operator=(const EqSlots&) = delete;
+
+  // Makes 'curve' (its id is ignored) the current equalizer. Returns the preset
+  // id it's under, or nullopt if the device couldn't be read or refused a write.
+  std::optional<uint8_t> select(const CustomEqPreset& curve, const RequestOptions& options = {});
+  // Saves the curves that aren't on the device yet, all in one batch, and
+  // switches back to the current preset. Never evicts the current preset or
+  // another of 'curves'; those that don't fit are left out. Returns how many
+  // of 'curves' are on the device afterwards.
+  size_t stage(const std::vector<CustomEqPreset>& curves, const RequestOptions& options = {});
+
+  // Where 'curve' is on the device, as far as the state cache knows.
+  std::optional<uint8_t> find(const CustomEqPreset& curve) const;
+  EqSlotStats stats() const;
+
+  static uint64_t hash_of(const CustomEqPreset& curve);
+
+ private:
+  struct Slot {
+    uint8_t id = 0;
+    std::optional<uint64_t> hash; // Empty while the device has no preset there
+    uint64_t last_used = 0;
+  };
+
+  std::optional<EqualizerInfo> equalizer(const RequestOptions& options);
+  void sync(const EqualizerInfo& info);
+  std::optional<uint8_t> resident(const EqualizerInfo& info, uint64_t hash) const;
+  Slot* victim(const std::vector<uint8_t>& keep);
+  void touch(uint8_t id);
+
+  Device& m_device;
+  std::vector<Slot> m_slots; // Behind m_mutex
+  uint64_t m_tick = 0;
+  EqSlotStats m_stats;
+  mutable std::mutex m_mutex;
+};
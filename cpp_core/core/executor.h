@@ -0,0 +1,39 @@
+// cpp_core/core/executor.h
+
+#pragma once
+
+#include <functional>
+#include <utility>
+
+// Where the core runs its background work (writers, notification dispatch, parsing).
+// CPU work defaults to a shared work-stealing ThreadPool and work that blocks on a
+// link to a BlockingPool; hosts that already have an event loop or pool of their
+// own can plug it in through FunctionExecutor.
+class IExecutor {
+ public:
+  virtual ~IExecutor() = default;
+
+  // Runs 'task' at some later point on some thread. Must not block.
+  virtual void post(std::function<void()> task) = 0;
+  // Like post(), but behind the work already queued where it lands, for a task
+  // that re-posts itself to give the thread up. The default is post(), which is
+  // fair on any executor that runs tasks in order.
+  virtual void post_fair(std::function<void()> task) { post(std::move(task)); }
+};
+
+// Adapts a host-provided "post" function to IExecutor.
+class FunctionExecutor : public IExecutor {
+ public:
+  explicit FunctionExecutor(std::function<void(std::function<void()>)> post_fn) : m_post(std::move(post_fn)) {}
+  void post(std::function<void()> task) override { m_post(std::move(task)); }
+
+ private:
+  std::function<void(std::function<void()>)> m_post;
+};
+
+// Process-wide ThreadPool sized to the number of cores, for CPU work (parsing,
+// EQ fitting). Nothing that waits on a link belongs here. Created on first use.
+IExecutor& default_executor();
+// Process-wide BlockingPool for the writers and the warmup, which spend most of
+// their time waiting for the headset. Created on first use.
+IExecutor& io_executor();
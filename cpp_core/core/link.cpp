@@ -0,0 +1,197 @@
+#include "link.h"
+#include <algorithm>
+
+Link::Link(IBluetoothSPPClient& client, IClock& clock) : m_client(client), m_clock(clock), m_last_receive(clock.now()) {}
+
+LinkResult Link::transact(const HuaweiSppPacket& request, uint16_t expected_id, Clock::time_point deadline,
+						  const CancellationToken& cancel) {
+	if (cancel.is_cancelled()) return {RequestStatus::CANCELLED, std::nullopt};
+	std::list<Waiter>::iterator waiter;
+	{
+		// Register before sending so a fast answer can't slip past us.
+		std::lock_guard<std::mutex> lock(m_mutex);
+		drop_leftovers(expected_id); // Whatever is left of an earlier answer isn't ours
+		waiter = m_waiters.emplace(m_waiters.end());
+		waiter->command_id = expected_id;
+	}
+	if (!m_client.send(request.to_bytes())) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_waiters.erase(waiter);
+		return {RequestStatus::DISCONNECTED, std::nullopt};
+	}
+	return wait(waiter, deadline, cancel);
+}
+
+Link::Pending Link::start(const HuaweiSppPacket& request, uint16_t expected_id, const CancellationToken& cancel) {
+	if (cancel.is_cancelled()) return {0, RequestStatus::CANCELLED};
+	uint64_t ticket;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		drop_leftovers(expected_id);
+		ticket = m_next_ticket++;
+		Waiter& waiter = m_waiters.emplace_back();
+		waiter.command_id = expected_id;
+		waiter.ticket = ticket;
+	}
+	if (!m_client.send(request.to_bytes())) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_waiters.remove_if([&](const Waiter& w) { return w.ticket == ticket; });
+		return {0, RequestStatus::DISCONNECTED};
+	}
+	return {ticket, RequestStatus::OK};
+}
+
+LinkResult Link::finish(const Pending& pending, Clock::time_point deadline, const CancellationToken& cancel) {
+	if (pending.ticket == 0) return {pending.status, std::nullopt};
+	std::list<Waiter>::iterator waiter;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		waiter = std::find_if(m_waiters.begin(), m_waiters.end(), [&](const Waiter& w) { return w.ticket == pending.ticket; });
+		if (waiter == m_waiters.end()) return {RequestStatus::CANCELLED, std::nullopt};
+	}
+	return wait(waiter, deadline, cancel);
+}
+
+LinkResult Link::wait_for(uint16_t command_id, Clock::time_point deadline, const CancellationToken& cancel) {
+	std::list<Waiter>::iterator waiter;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto held = std::find_if(m_leftovers.begin(), m_leftovers.end(),
+								 [&](const HuaweiSppPacket& p) { return p.command_id == command_id; });
+		if (held != m_leftovers.end()) {
+			LinkResult result{RequestStatus::OK, std::move(*held)};
+			m_leftovers.erase(held);
+			return result;
+		}
+		waiter = m_waiters.emplace(m_waiters.end());
+		waiter->command_id = command_id;
+	}
+	return wait(waiter, deadline, cancel);
+}
+
+bool Link::send(const HuaweiSppPacket& packet) { return m_client.send(packet.to_bytes()); }
+
+void Link::set_unsolicited_handler(UnsolicitedHandler handler) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_unsolicited_handler = std::move(handler);
+}
+
+bool Link::poll() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_pumping) return false; // Whoever is reading routes notifications too
+	return pump(lock);
+}
+
+void Link::reset() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_decoder.reset();
+	m_leftovers.clear();
+	m_last_answered.reset();
+	m_last_receive = m_clock.now();
+}
+
+// Called with m_mutex held.
+void Link::drop_leftovers(uint16_t command_id) {
+	m_leftovers.erase(std::remove_if(m_leftovers.begin(), m_leftovers.end(),
+									 [&](const HuaweiSppPacket& p) { return p.command_id == command_id; }),
+					  m_leftovers.end());
+}
+
+Link::Clock::time_point Link::last_receive() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_last_receive;
+}
+
+void Link::cancel_all() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& waiter : m_waiters) {
+		if (waiter.done) continue;
+		waiter.status = RequestStatus::CANCELLED;
+		waiter.done = true;
+	}
+	m_cond.notify_all();
+}
+
+LinkResult Link::wait(std::list<Waiter>::iterator waiter, Clock::time_point deadline, const CancellationToken& cancel) {
+	// The callback takes our mutex before notifying, so the flag can't flip between
+	// our check and the wait below.
+	uint64_t subscription = cancel.subscribe([this] {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cond.notify_all();
+	});
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!waiter->done) {
+		auto now = m_clock.now();
+		if (cancel.is_cancelled()) {
+			waiter->status = RequestStatus::CANCELLED;
+			break;
+		}
+		if (!m_client.is_connected()) {
+			waiter->status = RequestStatus::DISCONNECTED;
+			break;
+		}
+		if (now >= deadline) break;
+
+		if (m_pumping) {
+			// Somebody else is reading; they wake us once they've routed what they got.
+			m_clock.wait_until(lock, m_cond, deadline);
+		} else if (!pump(lock)) {
+			m_clock.wait_until(lock, m_cond, std::min(deadline, now + POLL_INTERVAL));
+		}
+	}
+	LinkResult result{waiter->status, std::move(waiter->result)};
+	m_waiters.erase(waiter);
+	lock.unlock();
+	cancel.unsubscribe(subscription);
+	return result;
+}
+
+// Reads whatever is available and routes it. Called with 'lock' held; returns
+// false if there was nothing to read.
+bool Link::pump(std::unique_lock<std::mutex>& lock) {
+	m_pumping = true;
+	lock.unlock();
+	std::vector<uint8_t> bytes = m_client.read_available();
+	lock.lock();
+	m_pumping = false;
+
+	if (bytes.empty()) {
+		m_cond.notify_all(); // Let a follower take over the polling if we're about to leave
+		return false;
+	}
+
+	m_last_receive = m_clock.now();
+	m_decoder.feed(bytes);
+	std::vector<HuaweiSppPacket> unsolicited;
+	std::vector<uint8_t> frame;
+	while (m_decoder.next_frame(frame)) {
+		auto packet = HuaweiSppPacket::from_bytes(frame);
+		if (!packet) continue;
+
+		auto it = std::find_if(m_waiters.begin(), m_waiters.end(), [&](const Waiter& w) {
+			return !w.done && w.command_id == packet->command_id;
+		});
+		if (it != m_waiters.end()) {
+			m_last_answered = packet->command_id;
+			it->result = std::move(packet);
+			it->status = RequestStatus::OK;
+			it->done = true;
+		} else if (m_last_answered == packet->command_id) {
+			// The rest of a multi-frame answer, ahead of the wait_for() that picks it up.
+			if (m_leftovers.size() == MAX_LEFTOVERS) m_leftovers.pop_front();
+			m_leftovers.push_back(std::move(*packet));
+		} else {
+			unsolicited.push_back(std::move(*packet));
+		}
+	}
+	m_cond.notify_all();
+
+	if (!unsolicited.empty() && m_unsolicited_handler) {
+		UnsolicitedHandler handler = m_unsolicited_handler;
+		lock.unlock();
+		for (const auto& packet : unsolicited) handler(packet);
+		lock.lock();
+	}
+	return true;
+}
@@ -0,0 +1,117 @@
+// cpp_core/core/link.h
+
+#pragma once
+
+#include "core/cancellation.h"
+#include "core/clock.h"
+#include "core/request_options.h"
+#include "platform/bluetooth_interface.h"
+#include "protocol/frame_decoder.h"
+#include "protocol/huawei_packet.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+struct LinkResult {
+  RequestStatus status = RequestStatus::TIMED_OUT;
+  std::optional<HuaweiSppPacket> packet;
+
+  explicit operator bool() const { return status == RequestStatus::OK; }
+};
+
+// Framed request/response channel over one IBluetoothSPPClient.
+// The Device read path and the CommandWriter both talk through the same Link,
+// so there is exactly one decoder per socket and a response can't be swallowed
+// (or split in half) by whichever thread happened to read first.
+//
+// There is no dedicated reader thread: whoever is waiting drives the socket
+// (leader/follower). One waiter polls read_available(), routes each frame to the
+// oldest waiter for its command id and wakes everyone else up.
+class Link {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using UnsolicitedHandler = std::function<void(const HuaweiSppPacket&)>;
+
+  // Deadlines are points on 'clock'.
+  explicit Link(IBluetoothSPPClient& client, IClock& clock = steady_clock());
+
+  // Registers interest in 'expected_id', sends 'request' and waits for the answer.
+  // Nothing is sent if 'cancel' already fired; if it fires while waiting we return
+  // right away with RequestStatus::CANCELLED.
+  LinkResult transact(const HuaweiSppPacket& request, uint16_t expected_id, Clock::time_point deadline,
+                      const CancellationToken& cancel = {});
+
+  // transact() in two halves, for pipelining: start() registers interest and sends
+  // without waiting, finish() waits for that answer. Several requests may be
+  // outstanding; answers for the same command go to them in the order they were
+  // started. Every started request must be finished, or its answer is never freed.
+  struct Pending {
+    uint64_t ticket = 0; // 0 if it never went out; 'status' says why
+    RequestStatus status = RequestStatus::OK;
+  };
+  Pending start(const HuaweiSppPacket& request, uint16_t expected_id, const CancellationToken& cancel = {});
+  LinkResult finish(const Pending& pending, Clock::time_point deadline, const CancellationToken& cancel = {});
+
+  // Waits for the next frame with 'command_id' (for commands answered with several frames).
+  // Frames of the last answered command that came in before anyone waited for them
+  // (typically in the same read as the first one) are held for this.
+  LinkResult wait_for(uint16_t command_id, Clock::time_point deadline, const CancellationToken& cancel = {});
+
+  bool send(const HuaweiSppPacket& packet);
+
+  // Frames nobody is waiting for (device notifications). Called outside the Link's lock.
+  void set_unsolicited_handler(UnsolicitedHandler handler);
+
+  // Reads and routes whatever has arrived without waiting, so notifications get
+  // through while no request is in flight. A no-op if a waiter is already reading.
+  // Returns true if anything was read.
+  bool poll();
+
+  // Drops partial frames and frames nobody picked up, e.g. after a reconnect.
+  void reset();
+
+  // When the last frame arrived (or the link was reset), for idle detection.
+  Clock::time_point last_receive() const;
+
+  // Wakes every current waiter with RequestStatus::CANCELLED (disconnect, page closed).
+  void cancel_all();
+
+  IBluetoothSPPClient& client() { return m_client; }
+  IClock& clock() const { return m_clock; }
+
+ private:
+  struct Waiter {
+    uint16_t command_id = 0;
+    uint64_t ticket = 0; // For start()/finish()
+    std::optional<HuaweiSppPacket> result;
+    RequestStatus status = RequestStatus::TIMED_OUT;
+    bool done = false;
+  };
+
+  LinkResult wait(std::list<Waiter>::iterator waiter, Clock::time_point deadline, const CancellationToken& cancel);
+  bool pump(std::unique_lock<std::mutex>& lock);
+  void drop_leftovers(uint16_t command_id);
+
+  IBluetoothSPPClient& m_client;
+  IClock& m_clock;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond;
+  FrameDecoder m_decoder;
+  std::list<Waiter> m_waiters;
+  uint64_t m_next_ticket = 1;
+  bool m_pumping = false;
+  Clock::time_point m_last_receive;
+  UnsolicitedHandler m_unsolicited_handler;
+  std::optional<uint16_t> m_last_answered;
+  std::deque<HuaweiSppPacket> m_leftovers; // More frames for m_last_answered
+  static constexpr size_t MAX_LEFTOVERS = 16;
+
+  // How long the pumping waiter sleeps between polls when the link is idle.
+  static constexpr std::chrono::milliseconds POLL_INTERVAL{2};
+};
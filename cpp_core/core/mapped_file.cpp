@@ -0,0 +1,109 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --- Mapping ---
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+	std::unique_ptr<MappedFile> mapped(new MappedFile());
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+	mapped->m_file = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) return nullptr;
+	mapped->m_size = static_cast<size_t>(size.QuadPart);
+	mapped->m_view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapped->m_view) return nullptr;
+	mapped->m_data = static_cast<const uint8_t*>(MapViewOfFile(mapped->m_view, FILE_MAP_READ, 0, 0, 0));
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return nullptr;
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+		::close(fd);
+		return nullptr;
+	}
+	mapped->m_size = static_cast<size_t>(st.st_size);
+	void* data = ::mmap(nullptr, mapped->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // The mapping keeps the file
+	if (data == MAP_FAILED) return nullptr;
+	mapped->m_data = static_cast<const uint8_t*>(data);
+#endif
+	if (!mapped->m_data) return nullptr;
+	return mapped;
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_view) CloseHandle(m_view);
+	if (m_file) CloseHandle(m_file);
+#else
+	if (m_data) ::munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+}
+
+// --- Writing ---
+
+namespace {
+
+bool write_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	DWORD written = 0;
+	bool ok = WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr) && written == bytes.size() &&
+			  FlushFileBuffers(file);
+	CloseHandle(file);
+	return ok;
+#else
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return false;
+	size_t done = 0;
+	while (done < bytes.size()) {
+		ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+		if (n <= 0) break;
+		done += static_cast<size_t>(n);
+	}
+	// On disk before the rename makes it the file, or a crash could leave an empty one.
+	bool ok = done == bytes.size() && ::fsync(fd) == 0;
+	::close(fd);
+	return ok;
+#endif
+}
+
+bool rename_over(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+	if (::rename(from.c_str(), to.c_str()) != 0) return false;
+	// Makes the rename itself durable.
+	auto slash = to.find_last_of('/');
+	std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : to.substr(0, slash);
+	int fd = ::open(dir.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		::fsync(fd);
+		::close(fd);
+	}
+	return true;
+#endif
+}
+
+} // namespace
+
+bool replace_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+	std::string temp = path + ".tmp";
+	return write_file(temp, bytes) && rename_over(temp, path);
+}
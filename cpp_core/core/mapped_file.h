@@ -0,0 +1,39 @@
+// cpp_core/core/mapped_file.h
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A whole file mapped read-only (POSIX mmap, or a Windows file mapping). What's
+// read through data() comes straight from the page cache, nothing is copied.
+class MappedFile {
+ public:
+  // Null if the file doesn't exist, is empty or can't be mapped.
+  static std::unique_ptr<MappedFile> open(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+ private:
+  MappedFile() = default;
+
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+#ifdef _WIN32
+  void* m_file = nullptr; // HANDLEs
+  void* m_view = nullptr;
+#endif
+};
+
+// Writes 'bytes' next to 'path' and renames the result over it, flushed to disk
+// on the way, so a crash leaves either the old file or the new one. Windows won't
+// replace a mapped file: whatever maps 'path' has to let go of it first.
+bool replace_file(const std::string& path, const std::vector<uint8_t>& bytes);
@@ -0,0 +1,302 @@
+#include "profile_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// --- File layout ---
+// Header:  magic "OFBP" | version u16 | header size u16 | count u32 | reserved u32
+// Record:  size u32 (of what follows) | hash u64 | name size u8 | name | fields
+// Field:   tag u8 | length u16 | value
+namespace {
+
+constexpr uint8_t MAGIC[4] = {'O', 'F', 'B', 'P'};
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t RECORD_HEAD = 4 + 8 + 1; // Size, hash, name size
+constexpr size_t FIELD_HEAD = 1 + 2;      // Tag, length
+
+// Values are the enums' own numbers, like the state file; one this reader doesn't
+// know reads as UNKNOWN (left as it is).
+enum Tag : uint8_t {
+	TAG_ANC = 1,              // mode, level
+	TAG_EQUALIZER_PRESET = 2, // id
+	TAG_CUSTOM_PRESET = 3,    // id, value count, values (int8), name; one field per preset
+	TAG_GESTURES = 4,         // 10 actions, in GestureSettings order
+	TAG_WEAR_DETECTION = 5,   // 0/1
+	TAG_LOW_LATENCY = 6,      // 0/1
+	TAG_SOUND_QUALITY = 7,    // SoundQualityPreference
+	TAG_PREFERRED_DEVICE = 8, // 6 MAC bytes
+	TAG_DUAL_CONNECT = 9,     // 0/1, enabled
+};
+
+// Length a known tag must have; 0 for variable (checked when decoding).
+size_t fixed_length(uint8_t tag) {
+	switch (tag) {
+		case TAG_ANC: return 2;
+		case TAG_EQUALIZER_PRESET:
+		case TAG_WEAR_DETECTION:
+		case TAG_LOW_LATENCY:
+		case TAG_DUAL_CONNECT:
+		case TAG_SOUND_QUALITY: return 1;
+		case TAG_GESTURES: return 10;
+		case TAG_PREFERRED_DEVICE: return 6;
+		default: return 0;
+	}
+}
+
+void put_le(std::vector<uint8_t>& out, uint64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+uint64_t get_le(const uint8_t* in, size_t bytes) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(in[i]) << (8 * i);
+	return value;
+}
+
+uint64_t load_le64(const uint8_t* in) {
+	uint64_t value;
+	std::memcpy(&value, in, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap64(value);
+#endif
+	return value;
+}
+
+// FNV-1a over 64-bit words in four interleaved lanes, folded together with the
+// leftover bytes and mixed once at the end. Byte-at-a-time FNV-1a is one
+// multiply per byte in a single chain, which kept checking a file well below
+// memory speed; this is a quarter multiply per word per lane.
+uint64_t content_hash(const uint8_t* data, size_t size) {
+	constexpr uint64_t BASIS = 14695981039346656037ull;
+	constexpr uint64_t PRIME = 1099511628211ull;
+	uint64_t lanes[4] = {BASIS, BASIS + 1, BASIS + 2, BASIS + 3};
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		for (size_t lane = 0; lane < 4; ++lane) lanes[lane] = (lanes[lane] ^ load_le64(data + i + 8 * lane)) * PRIME;
+	}
+	uint64_t hash = BASIS ^ size;
+	for (uint64_t lane : lanes) hash = (hash ^ lane) * PRIME;
+	for (; i < size; ++i) hash = (hash ^ data[i]) * PRIME;
+	// A word's high bits only reach the high bits of the product; spread them down.
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// --- Encoding ---
+
+bool put_field(std::vector<uint8_t>& out, uint8_t tag, const std::vector<uint8_t>& value) {
+	if (value.size() > 0xFFFF) return false;
+	out.push_back(tag);
+	put_le(out, value.size(), 2);
+	out.insert(out.end(), value.begin(), value.end());
+	return true;
+}
+
+bool mac_bytes(const std::string& mac, std::vector<uint8_t>& out) {
+	if (mac.size() != 12) return false;
+	for (size_t i = 0; i < 12; i += 2) {
+		char digits[3] = {mac[i], mac[i + 1], '\0'};
+		char* end = nullptr;
+		unsigned long byte = std::strtoul(digits, &end, 16);
+		if (end != digits + 2) return false;
+		out.push_back(static_cast<uint8_t>(byte));
+	}
+	return true;
+}
+
+// The settings fields of a record, in tag order, so equal profiles encode (and hash) equally.
+bool encode_fields(const DeviceProfile& p, std::vector<uint8_t>& out) {
+	bool ok = true;
+	if (p.anc) ok &= put_field(out, TAG_ANC, {static_cast<uint8_t>(p.anc->mode), static_cast<uint8_t>(p.anc->level)});
+	if (p.equalizer_preset) ok &= put_field(out, TAG_EQUALIZER_PRESET, {*p.equalizer_preset});
+	for (const CustomEqPreset& preset : p.custom_presets) {
+		if (preset.values.size() > 0xFF) return false;
+		std::vector<uint8_t> value = {preset.id, static_cast<uint8_t>(preset.values.size())};
+		for (int8_t v : preset.values) value.push_back(static_cast<uint8_t>(v));
+		value.insert(value.end(), preset.name.begin(), preset.name.end());
+		ok &= put_field(out, TAG_CUSTOM_PRESET, value);
+	}
+	if (p.fields() & StateFields::GESTURES) {
+		const GestureSettings& g = p.gestures;
+		const int codes[] = {static_cast<int>(g.double_tap_left),         static_cast<int>(g.double_tap_right),
+							 static_cast<int>(g.double_tap_incall),       static_cast<int>(g.triple_tap_left),
+							 static_cast<int>(g.triple_tap_right),        static_cast<int>(g.long_tap_left),
+							 static_cast<int>(g.long_tap_right),          static_cast<int>(g.long_tap_anc_cycle_left),
+							 static_cast<int>(g.long_tap_anc_cycle_right), static_cast<int>(g.swipe_action)};
+		std::vector<uint8_t> value;
+		for (int code : codes) value.push_back(static_cast<uint8_t>(code));
+		ok &= put_field(out, TAG_GESTURES, value);
+	}
+	if (p.wear_detection) ok &= put_field(out, TAG_WEAR_DETECTION, {static_cast<uint8_t>(*p.wear_detection)});
+	if (p.low_latency) ok &= put_field(out, TAG_LOW_LATENCY, {static_cast<uint8_t>(*p.low_latency)});
+	if (p.sound_quality) ok &= put_field(out, TAG_SOUND_QUALITY, {static_cast<uint8_t>(*p.sound_quality)});
+	if (p.dual_connect_enabled) ok &= put_field(out, TAG_DUAL_CONNECT, {static_cast<uint8_t>(*p.dual_connect_enabled)});
+	if (p.preferred_device) {
+		std::vector<uint8_t> mac;
+		ok = ok && mac_bytes(*p.preferred_device, mac) && put_field(out, TAG_PREFERRED_DEVICE, mac);
+	}
+	return ok;
+}
+
+// --- Decoding ---
+
+template <typename E>
+E enum_of(uint8_t code) {
+	return static_cast<E>(std::min<uint8_t>(code, static_cast<uint8_t>(E::UNKNOWN)));
+}
+
+// Known tags only; check() made sure their lengths are right.
+void decode_field(DeviceProfile& p, uint8_t tag, const uint8_t* v, size_t length) {
+	switch (tag) {
+		case TAG_ANC: p.anc = AncStatus{enum_of<AncMode>(v[0]), enum_of<AncLevel>(v[1])}; break;
+		case TAG_EQUALIZER_PRESET: p.equalizer_preset = v[0]; break;
+		case TAG_CUSTOM_PRESET: {
+			CustomEqPreset preset;
+			preset.id = v[0];
+			preset.values.assign(reinterpret_cast<const int8_t*>(v + 2), reinterpret_cast<const int8_t*>(v + 2 + v[1]));
+			preset.name.assign(reinterpret_cast<const char*>(v + 2 + v[1]), length - 2 - v[1]);
+			p.custom_presets.push_back(std::move(preset));
+			break;
+		}
+		case TAG_GESTURES:
+			p.gestures = GestureSettings{enum_of<GestureAction>(v[0]), enum_of<GestureAction>(v[1]), enum_of<GestureAction>(v[2]),
+										 enum_of<GestureAction>(v[3]), enum_of<GestureAction>(v[4]), enum_of<GestureAction>(v[5]),
+										 enum_of<GestureAction>(v[6]), enum_of<AncCycleMode>(v[7]),  enum_of<AncCycleMode>(v[8]),
+										 enum_of<GestureAction>(v[9])};
+			break;
+		case TAG_WEAR_DETECTION: p.wear_detection = v[0] != 0; break;
+		case TAG_LOW_LATENCY: p.low_latency = v[0] != 0; break;
+		case TAG_SOUND_QUALITY:
+			p.sound_quality = v[0] ? SoundQualityPreference::PRIORITIZE_QUALITY : SoundQualityPreference::PRIORITIZE_CONNECTION;
+			break;
+		case TAG_DUAL_CONNECT: p.dual_connect_enabled = v[0] != 0; break;
+		case TAG_PREFERRED_DEVICE: {
+			char mac[13];
+			std::snprintf(mac, sizeof(mac), "%02X%02X%02X%02X%02X%02X", v[0], v[1], v[2], v[3], v[4], v[5]);
+			p.preferred_device = std::string(mac);
+			break;
+		}
+		default: break; // Written by a newer version
+	}
+}
+
+} // namespace
+
+// --- Loading ---
+
+ProfileFile::ProfileFile(const std::string& path) {
+	m_file = MappedFile::open(path);
+	if (m_file && !check(path)) {
+		m_file.reset();
+		m_records.clear();
+	}
+}
+
+ProfileFile::~ProfileFile() = default;
+
+bool ProfileFile::check(const std::string& path) {
+	const uint8_t* data = m_file->data();
+	size_t size = m_file->size();
+	auto refuse = [&](const char* why) {
+		std::cerr << "[ProfileFile] Refusing " << path << ": " << why << std::endl;
+		return false;
+	};
+	if (size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) return refuse("not a profile file");
+	if (get_le(data + 4, 2) != FORMAT_VERSION) return refuse("another format version");
+	size_t header_size = static_cast<size_t>(get_le(data + 6, 2));
+	size_t count = static_cast<size_t>(get_le(data + 8, 4));
+	if (header_size < HEADER_SIZE || header_size > size) return refuse("damaged header");
+
+	// Each record needs at least its head, so a damaged count can't make this allocate much.
+	if (count > (size - header_size) / RECORD_HEAD) return refuse("damaged header");
+	m_records.reserve(count);
+	size_t at = header_size;
+	for (size_t i = 0; i < count; ++i) {
+		if (size - at < RECORD_HEAD) return refuse("truncated");
+		size_t record_end = at + 4 + static_cast<size_t>(get_le(data + at, 4));
+		size_t fields = at + RECORD_HEAD + data[at + 12];
+		if (record_end > size || fields > record_end) return refuse("truncated");
+		if (content_hash(data + fields, record_end - fields) != get_le(data + at + 4, 8)) return refuse("hash mismatch");
+		for (size_t f = fields; f < record_end;) {
+			if (record_end - f < FIELD_HEAD) return refuse("damaged field");
+			uint8_t tag = data[f];
+			size_t length = static_cast<size_t>(get_le(data + f + 1, 2));
+			if (record_end - f - FIELD_HEAD < length) return refuse("damaged field");
+			size_t wanted = fixed_length(tag);
+			bool bad = (wanted && length != wanted) ||
+					   (tag == TAG_CUSTOM_PRESET && (length < 2 || length < 2u + data[f + FIELD_HEAD + 1]));
+			if (bad) return refuse("damaged field");
+			f += FIELD_HEAD + length;
+		}
+		m_records.push_back(at);
+		at = record_end;
+	}
+	return true;
+}
+
+// --- Reading ---
+
+std::string_view ProfileFile::name(size_t i) const {
+	const uint8_t* record = m_file->data() + m_records[i];
+	return std::string_view(reinterpret_cast<const char*>(record + RECORD_HEAD), record[12]);
+}
+
+uint64_t ProfileFile::hash(size_t i) const { return get_le(m_file->data() + m_records[i] + 4, 8); }
+
+DeviceProfile ProfileFile::profile(size_t i) const {
+	const uint8_t* record = m_file->data() + m_records[i];
+	const uint8_t* end = record + 4 + get_le(record, 4);
+	DeviceProfile profile;
+	for (const uint8_t* f = record + RECORD_HEAD + record[12]; f < end;) {
+		size_t length = static_cast<size_t>(get_le(f + 1, 2));
+		decode_field(profile, f[0], f + FIELD_HEAD, length);
+		f += FIELD_HEAD + length;
+	}
+	return profile;
+}
+
+std::optional<size_t> ProfileFile::find(std::string_view wanted) const {
+	for (size_t i = 0; i < m_records.size(); ++i) {
+		if (name(i) == wanted) return i;
+	}
+	return std::nullopt;
+}
+
+// --- Writing ---
+
+uint64_t ProfileFile::hash_of(const DeviceProfile& profile) {
+	std::vector<uint8_t> fields;
+	encode_fields(profile, fields);
+	return content_hash(fields.data(), fields.size());
+}
+
+bool ProfileFile::write(const std::string& path, const std::vector<NamedProfile>& profiles) {
+	std::vector<uint8_t> bytes(MAGIC, MAGIC + sizeof(MAGIC));
+	put_le(bytes, FORMAT_VERSION, 2);
+	put_le(bytes, HEADER_SIZE, 2);
+	put_le(bytes, profiles.size(), 4);
+	put_le(bytes, 0, 4);
+
+	std::vector<uint8_t> fields;
+	for (const NamedProfile& named : profiles) {
+		fields.clear();
+		if (named.name.size() > 0xFF || !encode_fields(named.profile, fields)) {
+			std::cerr << "[ProfileFile] Profile \"" << named.name << "\" doesn't fit the format" << std::endl;
+			return false;
+		}
+		put_le(bytes, 8 + 1 + named.name.size() + fields.size(), 4);
+		put_le(bytes, content_hash(fields.data(), fields.size()), 8);
+		bytes.push_back(static_cast<uint8_t>(named.name.size()));
+		bytes.insert(bytes.end(), named.name.begin(), named.name.end());
+		bytes.insert(bytes.end(), fields.begin(), fields.end());
+	}
+	if (!replace_file(path, bytes)) {
+		std::cerr << "[ProfileFile] Can't write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
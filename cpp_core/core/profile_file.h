@@ -0,0 +1,70 @@
+// cpp_core/core/profile_file.h
+
+#pragma once
+
+#include "core/device.h"
+#include "core/mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct NamedProfile {
+  std::string name;
+  DeviceProfile profile;
+};
+
+// A file of named settings profiles, for setting up many headsets the same way.
+//
+// All numbers are little-endian. A 16-byte header (magic, format version, header
+// size, record count) is followed by the records back to back. A record is its
+// size, a 64-bit content hash, the name, and then one tagged field (tag, length,
+// value) per setting the profile has (see profile_file.cpp). Readers skip tags
+// they don't know, so a newer writer can add settings without a version bump;
+// FORMAT_VERSION only changes when an old reader would get a file wrong.
+//
+// The hash covers the settings fields and not the name: two profiles with the
+// same settings hash the same whatever they're called, so a headset known to
+// have a profile's hash needn't be set up again.
+//
+// The file is memory-mapped and checked as a whole on construction (every size,
+// tag length and hash). Names and hashes are then read straight from the mapping
+// and a profile is only decoded when asked for. A file with another format
+// version or any damage is refused as a whole: half a fleet set up is worse than
+// none, and the file should be fixed where it was made.
+class ProfileFile {
+ public:
+  static constexpr uint16_t FORMAT_VERSION = 1;
+
+  explicit ProfileFile(const std::string& path);
+  ~ProfileFile();
+
+  ProfileFile(const ProfileFile&) = delete;
+  ProfileFile& operator=(const ProfileFile&) = delete;
+
+  // False if the file is missing or was refused; it's empty then.
+  bool valid() const { return m_file != nullptr; }
+  size_t size() const { return m_records.size(); }
+  size_t bytes() const { return m_file ? m_file->size() : 0; }
+
+  // Valid while the ProfileFile is.
+  std::string_view name(size_t i) const;
+  uint64_t hash(size_t i) const;
+  DeviceProfile profile(size_t i) const;
+  std::optional<size_t> find(std::string_view name) const;
+
+  // Replaces 'path' with 'profiles' (see replace_file). False if a name or a
+  // custom preset doesn't fit its field, or the file can't be written.
+  static bool write(const std::string& path, const std::vector<NamedProfile>& profiles);
+  // The hash a record of 'profile' carries.
+  static uint64_t hash_of(const DeviceProfile& profile);
+
+ private:
+  bool check(const std::string& path);
+
+  std::unique_ptr<MappedFile> m_file; // Null unless valid
+  std::vector<size_t> m_records;      // Offset of each record in the mapping
+};
@@ -0,0 +1,102 @@
+// cpp_core/core/rcu_cell.h
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// One immutable T published by read-copy-update. Readers pin the current value
+// with read(): one atomic increment on a counter of their own (no lock, no
+// syscall, never waits on a writer). Writers build the next value off to the
+// side and publish() it, which is a pointer swap; the replaced value is freed
+// by a later publish() once no reader is left on any counter, so writers never
+// wait on readers either.
+//
+// Writers must be serialized by the caller (its own mutex). A pinned value stays
+// valid and unchanged however many times it is replaced meanwhile; only keep the
+// guard for as long as you look at it, since it holds back reclamation.
+template <typename T>
+class RcuCell {
+  struct alignas(64) ReaderCount {
+    std::atomic<uint32_t> active{0};
+  };
+  static constexpr size_t READER_STRIPES = 8;
+
+ public:
+  // Keeps the value it was created on alive and unchanged.
+  class ReadGuard {
+   public:
+    explicit ReadGuard(const RcuCell& cell) : m_count(&cell.reader_count()) {
+      // Announce before loading (both seq_cst): a writer that swaps the pointer and
+      // then sees every counter at zero knows nobody still holds the old value.
+      m_count->active.fetch_add(1);
+      m_value = cell.m_current.load();
+    }
+    ReadGuard(ReadGuard&& other) noexcept : m_count(other.m_count), m_value(other.m_value) { other.m_count = nullptr; }
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+    ReadGuard& operator=(ReadGuard&&) = delete;
+    ~ReadGuard() {
+      if (m_count) m_count->active.fetch_sub(1, std::memory_order_release);
+    }
+
+    const T& operator*() const { return *m_value; }
+    const T* operator->() const { return m_value; }
+
+   private:
+    ReaderCount* m_count;
+    const T* m_value;
+  };
+
+  explicit RcuCell(std::unique_ptr<const T> initial = std::make_unique<const T>()) : m_owned(std::move(initial)) {
+    m_current.store(m_owned.get());
+  }
+  RcuCell(const RcuCell&) = delete;
+  RcuCell& operator=(const RcuCell&) = delete;
+
+  ReadGuard read() const { return ReadGuard(*this); }
+
+  // The latest published value, for building the next one. Writers only.
+  const T& latest() const { return *m_owned; }
+
+  void publish(std::unique_ptr<const T> next) {
+    m_current.store(next.get());
+    m_retired.push_back(std::move(m_owned));
+    m_owned = std::move(next);
+    // Free what was replaced if no reader is pinned right now; otherwise the
+    // next publish (or the destructor) gets it.
+    for (const auto& reader : m_readers) {
+      if (reader.active.load() != 0) return;
+    }
+    m_retired.clear();
+  }
+
+  // Grace period: returns once every reader that might still hold a replaced
+  // value has let go. Each counter only has to be seen at zero once, as later
+  // readers load the new pointer. Never call it while holding a guard.
+  void synchronize() const {
+    for (const auto& reader : m_readers) {
+      while (reader.active.load() != 0) std::this_thread::yield();
+    }
+  }
+
+ private:
+  // Threads spread round-robin over the counters, so readers on different cores
+  // mostly don't share a cache line.
+  ReaderCount& reader_count() const {
+    static std::atomic<size_t> next_stripe{0};
+    thread_local size_t stripe = next_stripe++ % READER_STRIPES;
+    return m_readers[stripe];
+  }
+
+  std::atomic<const T*> m_current;
+  mutable std::array<ReaderCount, READER_STRIPES> m_readers;
+
+  std::unique_ptr<const T> m_owned; // What m_current points to
+  std::vector<std::unique_ptr<const T>> m_retired;
+};
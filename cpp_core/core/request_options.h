@@ -0,0 +1,40 @@
+// cpp_core/core/request_options.h
+
+#pragma once
+
+#include "core/cancellation.h"
+#include <chrono>
+#include <functional>
+#include <optional>
+
+enum class RequestStatus {
+  OK,
+  TIMED_OUT,
+  CANCELLED,
+  DISCONNECTED,
+  REJECTED // The device answered with an error code, or the write had arguments it can't encode
+};
+
+// Per-call limits for reads and writes. The defaults (no deadline, no token)
+// keep the old behaviour: the request lives until its own timeouts run out.
+struct RequestOptions {
+  // Absolute point (on the Device's clock) after which the request is abandoned,
+  // whether it is still queued, waiting for an answer or between retries.
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  CancellationToken cancel;
+  // Writes: send even if the cached state says the device already has the value.
+  // Reads: ask even if the capability table says the model doesn't answer.
+  bool force = false;
+  // Writes only: called once the device acked the write (OK), refused it, or it was
+  // given up on; on the writer's thread, or right away for a write skipped as a
+  // no-op (OK). Writes dropped by cancel_pending() hear CANCELLED on its thread.
+  std::function<void(RequestStatus)> on_done;
+  // Reads only: answer from the state cache, without going on air, if the field was
+  // confirmed (by a read, a notification or a write ack) within this long and
+  // nothing has made it stale since.
+  std::optional<std::chrono::milliseconds> max_age;
+
+  bool expired(std::chrono::steady_clock::time_point now) const {
+    return cancel.is_cancelled() || (deadline && now >= *deadline);
+  }
+};
@@ -0,0 +1,87 @@
+#include "rtt_estimator.h"
+#include <algorithm>
+#include <cmath>
+
+// RFC 6298 constants: alpha = 1/8, beta = 1/4, K = 4, and the clock granularity G.
+static constexpr double ALPHA = 0.125;
+static constexpr double BETA = 0.25;
+static constexpr double K = 4.0;
+static constexpr double GRANULARITY_MS = 1.0;
+
+void RttEstimator::add_sample(std::chrono::microseconds rtt) {
+	double r = rtt.count() / 1000.0;
+	if (m_samples == 0) {
+		m_srtt_ms = r;
+		m_rttvar_ms = r / 2.0;
+	} else {
+		// RTTVAR first, it uses the old SRTT.
+		m_rttvar_ms = (1.0 - BETA) * m_rttvar_ms + BETA * std::fabs(m_srtt_ms - r);
+		m_srtt_ms = (1.0 - ALPHA) * m_srtt_ms + ALPHA * r;
+	}
+	++m_samples;
+}
+
+std::chrono::milliseconds RttEstimator::timeout(const TimeoutPolicy& policy) const {
+	if (m_samples == 0) return std::clamp(policy.initial, policy.min, policy.max);
+	double rto = m_srtt_ms + std::max(GRANULARITY_MS, K * m_rttvar_ms);
+	auto ms = std::chrono::milliseconds(static_cast<int64_t>(std::ceil(rto)));
+	return std::clamp(ms, policy.min, policy.max);
+}
+
+RttStats RttEstimator::stats(const TimeoutPolicy& policy) const {
+	RttStats s;
+	s.samples = m_samples;
+	s.srtt_ms = m_srtt_ms;
+	s.rttvar_ms = m_rttvar_ms;
+	s.timeout_ms = static_cast<double>(timeout(policy).count());
+	s.timeouts = m_timeouts;
+	s.retries = m_retries;
+	return s;
+}
+
+void RttTable::set_policy(const TimeoutPolicy& policy) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_policy = policy;
+}
+
+TimeoutPolicy RttTable::policy() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_policy;
+}
+
+std::chrono::milliseconds RttTable::timeout_for(uint16_t command_id) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_commands.find(command_id);
+	if (it != m_commands.end() && it->second.samples() >= MIN_CLASS_SAMPLES) return it->second.timeout(m_policy);
+	return m_link.timeout(m_policy);
+}
+
+void RttTable::add_sample(uint16_t command_id, std::chrono::microseconds rtt) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_link.add_sample(rtt);
+	m_commands[command_id].add_sample(rtt);
+}
+
+void RttTable::record_timeout(uint16_t command_id) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_link.record_timeout();
+	m_commands[command_id].record_timeout();
+}
+
+void RttTable::record_retry(uint16_t command_id) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_link.record_retry();
+	m_commands[command_id].record_retry();
+}
+
+RttStats RttTable::link_stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_link.stats(m_policy);
+}
+
+std::map<uint16_t, RttStats> RttTable::command_stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<uint16_t, RttStats> result;
+	for (const auto& [id, estimator] : m_commands) result[id] = estimator.stats(m_policy);
+	return result;
+}
@@ -0,0 +1,74 @@
+// cpp_core/core/rtt_estimator.h
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+// Bounds for the adaptive response timeouts.
+struct TimeoutPolicy {
+  // Used until the first RTT sample is in (RFC 6298 recommends 1 s).
+  std::chrono::milliseconds initial{1000};
+  std::chrono::milliseconds min{100};
+  std::chrono::milliseconds max{2000};
+  // Extra attempts for idempotent reads after a timeout; each one doubles the timeout.
+  int max_retries = 2;
+};
+
+struct RttStats {
+  uint32_t samples = 0;
+  double srtt_ms = 0.0;
+  double rttvar_ms = 0.0;
+  double timeout_ms = 0.0; // What the next request would wait, before backoff
+  uint32_t timeouts = 0;
+  uint32_t retries = 0;
+};
+
+// TCP-style smoothed RTT / RTT variance estimator (RFC 6298).
+class RttEstimator {
+ public:
+  void add_sample(std::chrono::microseconds rtt);
+  void record_timeout() { ++m_timeouts; }
+  void record_retry() { ++m_retries; }
+
+  uint32_t samples() const { return m_samples; }
+  // SRTT + 4 * RTTVAR, clamped to the policy bounds.
+  std::chrono::milliseconds timeout(const TimeoutPolicy& policy) const;
+  RttStats stats(const TimeoutPolicy& policy) const;
+
+ private:
+  double m_srtt_ms = 0.0;
+  double m_rttvar_ms = 0.0;
+  uint32_t m_samples = 0;
+  uint32_t m_timeouts = 0;
+  uint32_t m_retries = 0;
+};
+
+// RTT state of one connection: an estimator for the link as a whole plus one per
+// command class, since e.g. an EQ read answers noticeably slower than a battery read.
+// A command falls back to the link estimate until it has a few samples of its own.
+class RttTable {
+ public:
+  explicit RttTable(TimeoutPolicy policy = {}) : m_policy(policy) {}
+
+  void set_policy(const TimeoutPolicy& policy);
+  TimeoutPolicy policy() const;
+
+  std::chrono::milliseconds timeout_for(uint16_t command_id) const;
+  void add_sample(uint16_t command_id, std::chrono::microseconds rtt);
+  void record_timeout(uint16_t command_id);
+  void record_retry(uint16_t command_id);
+
+  RttStats link_stats() const;
+  std::map<uint16_t, RttStats> command_stats() const;
+
+ private:
+  static constexpr uint32_t MIN_CLASS_SAMPLES = 3;
+
+  mutable std::mutex m_mutex;
+  TimeoutPolicy m_policy;
+  RttEstimator m_link;
+  std::map<uint16_t, RttEstimator> m_commands;
+};
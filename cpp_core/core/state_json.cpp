@@ -0,0 +1,131 @@
+#include "state_json.h"
+#include <sstream>
+
+// --- Value writers ---
+
+static void write_string(std::ostringstream& ss, const std::string& s) {
+	ss << '"';
+	for (char c : s) {
+		unsigned char u = static_cast<unsigned char>(c);
+		if (c == '"' || c == '\\') {
+			ss << '\\' << c;
+		} else if (u < 0x20) {
+			static const char hex[] = "0123456789abcdef";
+			ss << "\\u00" << hex[u >> 4] << hex[u & 0xF];
+		} else {
+			ss << c;
+		}
+	}
+	ss << '"';
+}
+
+static const char* boolean(bool b) { return b ? "true" : "false"; }
+
+template <typename E>
+static int ordinal(E e) { return static_cast<int>(e); }
+
+static void write_value(std::ostringstream& ss, const DeviceInfo& i) {
+	ss << "{\"model\":";
+	write_string(ss, i.model);
+	ss << ",\"sub_model\":";
+	write_string(ss, i.sub_model);
+	ss << ",\"firmware_version\":";
+	write_string(ss, i.firmware_version);
+	ss << ",\"serial_number\":";
+	write_string(ss, i.serial_number);
+	ss << ",\"left_serial\":";
+	write_string(ss, i.left_serial);
+	ss << ",\"right_serial\":";
+	write_string(ss, i.right_serial);
+	ss << '}';
+}
+
+static void write_value(std::ostringstream& ss, const BatteryInfo& b) {
+	ss << "{\"left\":" << b.left << ",\"right\":" << b.right << ",\"case\":" << b.case_level << ",\"global\":" << b.global
+	   << ",\"charging_left\":" << boolean(b.is_charging_left) << ",\"charging_right\":" << boolean(b.is_charging_right)
+	   << ",\"charging_case\":" << boolean(b.is_charging_case) << '}';
+}
+
+static void write_value(std::ostringstream& ss, const AncStatus& a) {
+	ss << "{\"mode\":" << ordinal(a.mode) << ",\"level\":" << ordinal(a.level) << '}';
+}
+
+static void write_value(std::ostringstream& ss, bool b) { ss << boolean(b); }
+
+static void write_value(std::ostringstream& ss, SoundQualityPreference p) { ss << ordinal(p); }
+
+static void write_value(std::ostringstream& ss, const EqualizerInfo& e) {
+	ss << "{\"current_preset_id\":" << static_cast<int>(e.current_preset_id) << ",\"built_in_preset_ids\":[";
+	for (size_t i = 0; i < e.built_in_preset_ids.size(); ++i) ss << (i ? "," : "") << static_cast<int>(e.built_in_preset_ids[i]);
+	ss << "],\"custom_presets\":[";
+	for (size_t i = 0; i < e.custom_presets.size(); ++i) {
+		const CustomEqPreset& p = e.custom_presets[i];
+		ss << (i ? "," : "") << "{\"id\":" << static_cast<int>(p.id) << ",\"name\":";
+		write_string(ss, p.name);
+		ss << ",\"values\":[";
+		for (size_t j = 0; j < p.values.size(); ++j) ss << (j ? "," : "") << static_cast<int>(p.values[j]);
+		ss << "]}";
+	}
+	ss << "]}";
+}
+
+static void write_value(std::ostringstream& ss, const GestureSettings& g) {
+	ss << "{\"double_tap_left\":" << ordinal(g.double_tap_left) << ",\"double_tap_right\":" << ordinal(g.double_tap_right)
+	   << ",\"double_tap_incall\":" << ordinal(g.double_tap_incall) << ",\"triple_tap_left\":" << ordinal(g.triple_tap_left)
+	   << ",\"triple_tap_right\":" << ordinal(g.triple_tap_right) << ",\"long_tap_left\":" << ordinal(g.long_tap_left)
+	   << ",\"long_tap_right\":" << ordinal(g.long_tap_right)
+	   << ",\"long_tap_anc_cycle_left\":" << ordinal(g.long_tap_anc_cycle_left)
+	   << ",\"long_tap_anc_cycle_right\":" << ordinal(g.long_tap_anc_cycle_right)
+	   << ",\"swipe_action\":" << ordinal(g.swipe_action) << '}';
+}
+
+static void write_value(std::ostringstream& ss, const std::vector<DualConnectDevice>& devices) {
+	ss << '[';
+	for (size_t i = 0; i < devices.size(); ++i) {
+		const DualConnectDevice& d = devices[i];
+		ss << (i ? "," : "") << "{\"mac_address\":";
+		write_string(ss, d.mac_address);
+		ss << ",\"name\":";
+		write_string(ss, d.name);
+		ss << ",\"is_connected\":" << boolean(d.is_connected) << ",\"is_playing\":" << boolean(d.is_playing)
+		   << ",\"is_preferred\":" << boolean(d.is_preferred) << ",\"can_auto_connect\":" << boolean(d.can_auto_connect) << '}';
+	}
+	ss << ']';
+}
+
+// --- Documents ---
+
+static void write_fields(std::ostringstream& ss, const DeviceState& state, uint32_t fields) {
+	auto field = [&](uint32_t bit, const char* name, const auto& cached) {
+		if (!(fields & bit) || !cached.shown()) return;
+		ss << ",\"" << name << "\":";
+		write_value(ss, *cached.shown());
+	};
+	field(StateFields::DEVICE_INFO, "device_info", state.device_info);
+	field(StateFields::BATTERY, "battery", state.battery);
+	field(StateFields::ANC, "anc", state.anc);
+	field(StateFields::WEAR_DETECTION, "wear_detection", state.wear_detection);
+	field(StateFields::LOW_LATENCY, "low_latency", state.low_latency);
+	field(StateFields::SOUND_QUALITY, "sound_quality", state.sound_quality);
+	field(StateFields::EQUALIZER, "equalizer", state.equalizer);
+	field(StateFields::GESTURES, "gestures", state.gestures);
+	field(StateFields::DUAL_CONNECT, "dual_connect", state.dual_connect);
+}
+
+std::string state_to_json(const DeviceState& state, uint32_t fields) {
+	std::ostringstream ss;
+	ss << "{\"version\":" << state.generation << ",\"changed\":" << fields << ",\"pending\":" << (state.pending_fields() & fields)
+	   << ",\"restored\":" << (state.restored_fields() & fields);
+	write_fields(ss, state, fields);
+	ss << '}';
+	return ss.str();
+}
+
+std::string delta_to_json(const StateDelta& delta) {
+	std::ostringstream ss;
+	ss << "{\"version\":" << delta.version << ",\"changed\":" << delta.changed << ",\"pending\":" << (delta.state.pending_fields() & delta.changed)
+	   << ",\"restored\":" << (delta.state.restored_fields() & delta.changed);
+	write_fields(ss, delta.state, delta.changed);
+	ss << '}';
+	return ss.str();
+}
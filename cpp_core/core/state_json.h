@@ -0,0 +1,18 @@
+// cpp_core/core/state_json.h
+
+#pragma once
+
+#include "core/device_state.h"
+#include <cstdint>
+#include <string>
+
+// JSON for the bridges. Only the fields in 'fields' that have a value are
+// written, so a delta costs what changed rather than the whole state. Enums
+// go out as their ordinal. Fields with a write in flight show the pending value
+// and have their bit set in "pending" until it's acked or rolled back; values
+// loaded from the state file have theirs set in "restored" until the headset
+// confirms them.
+//
+//   {"version":12,"changed":2,"pending":0,"restored":0,"battery":{"left":55,...}}
+std::string state_to_json(const DeviceState& state, uint32_t fields = StateFields::ALL);
+std::string delta_to_json(const StateDelta& delta);
@@ -0,0 +1,415 @@
+#include "state_store.h"
+#include "core/mapped_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+// --- File layout ---
+// Header, then 'count' records. Everything is bytes: multi-byte numbers are
+// little-endian, strings NUL-padded in fixed slots, so a record is read with one
+// memcpy and the layout is the same for every compiler and platform.
+namespace {
+
+constexpr uint8_t MAGIC[4] = {'O', 'F', 'B', 'S'};
+
+template <size_t N>
+struct Text {
+	char bytes[N];
+};
+
+struct StoredPreset {
+	uint8_t id;
+	uint8_t value_count;
+	int8_t values[10];
+	Text<32> name;
+};
+
+struct StoredSource {
+	Text<18> mac; // "AA:BB:CC:DD:EE:FF"
+	Text<48> name;
+	uint8_t flags; // SOURCE_* bits
+};
+
+constexpr size_t MAX_BUILT_IN = 16;
+constexpr size_t MAX_CUSTOM = 8;
+constexpr size_t MAX_SOURCES = 8;
+
+constexpr uint8_t SOURCE_CONNECTED = 1 << 0;
+constexpr uint8_t SOURCE_PLAYING = 1 << 1;
+constexpr uint8_t SOURCE_PREFERRED = 1 << 2;
+constexpr uint8_t SOURCE_AUTO_CONNECT = 1 << 3;
+
+constexpr uint8_t CHARGING_CASE = 1 << 0;
+constexpr uint8_t CHARGING_LEFT = 1 << 1;
+constexpr uint8_t CHARGING_RIGHT = 1 << 2;
+
+struct Record {
+	uint8_t checksum[4]; // FNV-1a of everything after it
+	uint8_t saved_at_ms[8];
+	uint8_t fields[4];
+	Text<18> mac;
+	// DEVICE_INFO
+	Text<48> model, sub_model, firmware, serial, left_serial, right_serial;
+	// BATTERY: left, right, case, global, CHARGING_* bits
+	uint8_t battery[5];
+	uint8_t anc_mode, anc_level;
+	uint8_t wear_detection, low_latency, sound_quality;
+	// EQUALIZER
+	uint8_t eq_current;
+	uint8_t eq_built_in_count;
+	uint8_t eq_built_in[MAX_BUILT_IN];
+	uint8_t eq_custom_count;
+	StoredPreset eq_custom[MAX_CUSTOM];
+	// GESTURES, in GestureSettings order
+	uint8_t gestures[10];
+	// DUAL_CONNECT
+	uint8_t source_count;
+	StoredSource sources[MAX_SOURCES];
+};
+
+struct Header {
+	uint8_t magic[4];
+	uint8_t version[2];
+	uint8_t record_size[4];
+	uint8_t count[4];
+	uint8_t reserved[2];
+};
+
+static_assert(std::is_trivially_copyable<Record>::value && alignof(Record) == 1, "Record must be plain bytes");
+static_assert(alignof(Header) == 1 && sizeof(Header) == 16, "Header must be plain bytes");
+
+void put_le(uint8_t* out, uint64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint64_t get_le(const uint8_t* in, size_t bytes) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(in[i]) << (8 * i);
+	return value;
+}
+
+// False (and the slot left empty) if 's' doesn't fit with its terminator.
+template <size_t N>
+bool put_text(Text<N>& slot, const std::string& s) {
+	std::memset(slot.bytes, 0, N);
+	if (s.size() >= N) return false;
+	std::memcpy(slot.bytes, s.data(), s.size());
+	return true;
+}
+
+template <size_t N>
+std::string get_text(const Text<N>& slot) {
+	return std::string(slot.bytes, std::find(slot.bytes, slot.bytes + N, '\0'));
+}
+
+bool put_byte(uint8_t& out, int value) {
+	if (value < 0 || value > 0xFF) return false;
+	out = static_cast<uint8_t>(value);
+	return true;
+}
+
+uint32_t checksum(const Record& record) {
+	const auto* bytes = reinterpret_cast<const uint8_t*>(&record);
+	uint32_t hash = 2166136261u;
+	for (size_t i = sizeof(record.checksum); i < sizeof(Record); ++i) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+std::string key_of(const Record& record) {
+	std::string serial = get_text(record.serial);
+	return serial.empty() ? get_text(record.mac) : serial;
+}
+
+// --- Encoding ---
+
+bool encode_device_info(Record& r, const DeviceInfo& info) {
+	return put_text(r.model, info.model) && put_text(r.sub_model, info.sub_model) &&
+		   put_text(r.firmware, info.firmware_version) && put_text(r.serial, info.serial_number) &&
+		   put_text(r.left_serial, info.left_serial) && put_text(r.right_serial, info.right_serial);
+}
+
+bool encode_battery(Record& r, const BatteryInfo& b) {
+	r.battery[4] = (b.is_charging_case ? CHARGING_CASE : 0) | (b.is_charging_left ? CHARGING_LEFT : 0) |
+				   (b.is_charging_right ? CHARGING_RIGHT : 0);
+	return put_byte(r.battery[0], b.left) && put_byte(r.battery[1], b.right) && put_byte(r.battery[2], b.case_level) &&
+		   put_byte(r.battery[3], b.global);
+}
+
+bool encode_equalizer(Record& r, const EqualizerInfo& eq) {
+	if (eq.built_in_preset_ids.size() > MAX_BUILT_IN || eq.custom_presets.size() > MAX_CUSTOM) return false;
+	r.eq_current = eq.current_preset_id;
+	r.eq_built_in_count = static_cast<uint8_t>(eq.built_in_preset_ids.size());
+	std::copy(eq.built_in_preset_ids.begin(), eq.built_in_preset_ids.end(), r.eq_built_in);
+	r.eq_custom_count = static_cast<uint8_t>(eq.custom_presets.size());
+	for (size_t i = 0; i < eq.custom_presets.size(); ++i) {
+		const CustomEqPreset& preset = eq.custom_presets[i];
+		StoredPreset& slot = r.eq_custom[i];
+		if (preset.values.size() > sizeof(slot.values) || !put_text(slot.name, preset.name)) return false;
+		slot.id = preset.id;
+		slot.value_count = static_cast<uint8_t>(preset.values.size());
+		std::copy(preset.values.begin(), preset.values.end(), slot.values);
+	}
+	return true;
+}
+
+void encode_gestures(Record& r, const GestureSettings& g) {
+	const int codes[] = {static_cast<int>(g.double_tap_left),         static_cast<int>(g.double_tap_right),
+						 static_cast<int>(g.double_tap_incall),       static_cast<int>(g.triple_tap_left),
+						 static_cast<int>(g.triple_tap_right),        static_cast<int>(g.long_tap_left),
+						 static_cast<int>(g.long_tap_right),          static_cast<int>(g.long_tap_anc_cycle_left),
+						 static_cast<int>(g.long_tap_anc_cycle_right), static_cast<int>(g.swipe_action)};
+	for (size_t i = 0; i < 10; ++i) r.gestures[i] = static_cast<uint8_t>(codes[i]);
+}
+
+bool encode_sources(Record& r, const std::vector<DualConnectDevice>& devices) {
+	if (devices.size() > MAX_SOURCES) return false;
+	r.source_count = static_cast<uint8_t>(devices.size());
+	for (size_t i = 0; i < devices.size(); ++i) {
+		const DualConnectDevice& d = devices[i];
+		StoredSource& slot = r.sources[i];
+		if (!put_text(slot.mac, d.mac_address) || !put_text(slot.name, d.name)) return false;
+		slot.flags = (d.is_connected ? SOURCE_CONNECTED : 0) | (d.is_playing ? SOURCE_PLAYING : 0) |
+					 (d.is_preferred ? SOURCE_PREFERRED : 0) | (d.can_auto_connect ? SOURCE_AUTO_CONNECT : 0);
+	}
+	return true;
+}
+
+Record encode(const std::string& mac, const DeviceState& state) {
+	Record r;
+	std::memset(&r, 0, sizeof(r));
+	uint32_t fields = 0;
+	// Each field goes in only if the whole value fits; a half-written one would be worse than none.
+	auto add = [&](uint32_t bit, const auto& field, auto&& put) {
+		if (field.value && put(*field.value)) fields |= bit;
+	};
+	add(StateFields::DEVICE_INFO, state.device_info, [&](const DeviceInfo& v) { return encode_device_info(r, v); });
+	add(StateFields::BATTERY, state.battery, [&](const BatteryInfo& v) { return encode_battery(r, v); });
+	add(StateFields::ANC, state.anc, [&](const AncStatus& v) {
+		r.anc_mode = static_cast<uint8_t>(v.mode);
+		r.anc_level = static_cast<uint8_t>(v.level);
+		return true;
+	});
+	add(StateFields::WEAR_DETECTION, state.wear_detection, [&](bool v) {
+		r.wear_detection = v;
+		return true;
+	});
+	add(StateFields::LOW_LATENCY, state.low_latency, [&](bool v) {
+		r.low_latency = v;
+		return true;
+	});
+	add(StateFields::SOUND_QUALITY, state.sound_quality, [&](SoundQualityPreference v) {
+		r.sound_quality = static_cast<uint8_t>(v);
+		return true;
+	});
+	add(StateFields::EQUALIZER, state.equalizer, [&](const EqualizerInfo& v) { return encode_equalizer(r, v); });
+	add(StateFields::GESTURES, state.gestures, [&](const GestureSettings& v) {
+		encode_gestures(r, v);
+		return true;
+	});
+	add(StateFields::DUAL_CONNECT, state.dual_connect,
+		[&](const std::vector<DualConnectDevice>& v) { return encode_sources(r, v); });
+	if (!(fields & StateFields::DEVICE_INFO)) encode_device_info(r, {}); // Clear a partly written one
+	if (!(fields & StateFields::EQUALIZER)) r.eq_built_in_count = r.eq_custom_count = 0;
+	if (!(fields & StateFields::DUAL_CONNECT)) r.source_count = 0;
+
+	put_text(r.mac, mac);
+	auto now = std::chrono::system_clock::now().time_since_epoch();
+	put_le(r.saved_at_ms, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count()), 8);
+	put_le(r.fields, fields, 4);
+	put_le(r.checksum, checksum(r), 4);
+	return r;
+}
+
+// --- Decoding ---
+
+StoredState decode(const Record& r) {
+	StoredState out;
+	out.mac = get_text(r.mac);
+	out.saved_at_ms = static_cast<int64_t>(get_le(r.saved_at_ms, 8));
+	out.fields = static_cast<uint32_t>(get_le(r.fields, 4)) & StateFields::ALL;
+	DeviceState& s = out.state;
+	uint32_t fields = out.fields;
+
+	if (fields & StateFields::DEVICE_INFO) {
+		s.device_info.value = DeviceInfo{get_text(r.model),  get_text(r.sub_model),   get_text(r.firmware),
+										 get_text(r.serial), get_text(r.left_serial), get_text(r.right_serial)};
+	}
+	if (fields & StateFields::BATTERY) {
+		BatteryInfo b;
+		b.left = r.battery[0];
+		b.right = r.battery[1];
+		b.case_level = r.battery[2];
+		b.global = r.battery[3];
+		b.is_charging_case = r.battery[4] & CHARGING_CASE;
+		b.is_charging_left = r.battery[4] & CHARGING_LEFT;
+		b.is_charging_right = r.battery[4] & CHARGING_RIGHT;
+		s.battery.value = b;
+	}
+	if (fields & StateFields::ANC) {
+		s.anc.value = AncStatus{static_cast<AncMode>(std::min<uint8_t>(r.anc_mode, static_cast<uint8_t>(AncMode::UNKNOWN))),
+								static_cast<AncLevel>(std::min<uint8_t>(r.anc_level, static_cast<uint8_t>(AncLevel::UNKNOWN)))};
+	}
+	if (fields & StateFields::WEAR_DETECTION) s.wear_detection.value = r.wear_detection != 0;
+	if (fields & StateFields::LOW_LATENCY) s.low_latency.value = r.low_latency != 0;
+	if (fields & StateFields::SOUND_QUALITY) {
+		s.sound_quality.value = r.sound_quality ? SoundQualityPreference::PRIORITIZE_QUALITY : SoundQualityPreference::PRIORITIZE_CONNECTION;
+	}
+	if (fields & StateFields::EQUALIZER) {
+		EqualizerInfo eq;
+		eq.current_preset_id = r.eq_current;
+		eq.built_in_preset_ids.assign(r.eq_built_in, r.eq_built_in + std::min<size_t>(r.eq_built_in_count, MAX_BUILT_IN));
+		for (size_t i = 0; i < std::min<size_t>(r.eq_custom_count, MAX_CUSTOM); ++i) {
+			const StoredPreset& slot = r.eq_custom[i];
+			CustomEqPreset preset;
+			preset.id = slot.id;
+			preset.name = get_text(slot.name);
+			preset.values.assign(slot.values, slot.values + std::min<size_t>(slot.value_count, sizeof(slot.values)));
+			eq.custom_presets.push_back(std::move(preset));
+		}
+		s.equalizer.value = std::move(eq);
+	}
+	if (fields & StateFields::GESTURES) {
+		auto action = [&](size_t i) {
+			return static_cast<GestureAction>(std::min<uint8_t>(r.gestures[i], static_cast<uint8_t>(GestureAction::UNKNOWN)));
+		};
+		auto cycle = [&](size_t i) {
+			return static_cast<AncCycleMode>(std::min<uint8_t>(r.gestures[i], static_cast<uint8_t>(AncCycleMode::UNKNOWN)));
+		};
+		s.gestures.value = GestureSettings{action(0), action(1), action(2), action(3), action(4),
+										   action(5), action(6), cycle(7),  cycle(8),  action(9)};
+	}
+	if (fields & StateFields::DUAL_CONNECT) {
+		std::vector<DualConnectDevice> devices;
+		for (size_t i = 0; i < std::min<size_t>(r.source_count, MAX_SOURCES); ++i) {
+			const StoredSource& slot = r.sources[i];
+			devices.push_back(DualConnectDevice{get_text(slot.mac), get_text(slot.name), (slot.flags & SOURCE_CONNECTED) != 0,
+												(slot.flags & SOURCE_PLAYING) != 0, (slot.flags & SOURCE_PREFERRED) != 0,
+												(slot.flags & SOURCE_AUTO_CONNECT) != 0});
+		}
+		s.dual_connect.value = std::move(devices);
+	}
+	return out;
+}
+
+} // namespace
+
+// --- Mapping ---
+
+struct StateStore::Mapping {
+	std::unique_ptr<MappedFile> file;
+
+	size_t count() const { return static_cast<size_t>(get_le(reinterpret_cast<const Header*>(file->data())->count, 4)); }
+	const uint8_t* record(size_t i) const { return file->data() + sizeof(Header) + i * sizeof(Record); }
+};
+
+StateStore::StateStore(std::string path) : m_path(std::move(path)) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	map_locked();
+}
+
+StateStore::~StateStore() = default;
+
+bool StateStore::map_locked() {
+	m_mapping.reset();
+	auto file = MappedFile::open(m_path);
+	if (!file) return false; // Nothing saved yet
+	auto mapping = std::make_unique<Mapping>(Mapping{std::move(file)});
+	const uint8_t* data = mapping->file->data();
+	size_t size = mapping->file->size();
+	const auto* header = reinterpret_cast<const Header*>(data);
+	if (size < sizeof(Header) || std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		get_le(header->version, 2) != FORMAT_VERSION || get_le(header->record_size, 4) != sizeof(Record) ||
+		mapping->count() > (size - sizeof(Header)) / sizeof(Record)) { // Not count * size: that can wrap on 32 bits
+		std::cerr << "[StateStore] Ignoring " << m_path << ": not a version " << FORMAT_VERSION << " state file" << std::endl;
+		return false;
+	}
+	m_mapping = std::move(mapping);
+	return true;
+}
+
+// --- Lookups ---
+
+template <typename Match>
+std::optional<StoredState> StateStore::find_locked(Match&& match) const {
+	if (!m_mapping) return std::nullopt;
+	const uint8_t* newest = nullptr;
+	uint64_t newest_at = 0;
+	for (size_t i = 0; i < m_mapping->count(); ++i) {
+		Record record;
+		std::memcpy(&record, m_mapping->record(i), sizeof(Record));
+		if (get_le(record.checksum, 4) != checksum(record) || !match(record)) continue;
+		uint64_t saved_at = get_le(record.saved_at_ms, 8);
+		if (!newest || saved_at >= newest_at) {
+			newest = m_mapping->record(i);
+			newest_at = saved_at;
+		}
+	}
+	if (!newest) return std::nullopt;
+	Record record;
+	std::memcpy(&record, newest, sizeof(Record));
+	return decode(record);
+}
+
+std::optional<StoredState> StateStore::find(const std::string& mac) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return find_locked([&](const Record& r) { return mac.empty() || get_text(r.mac) == mac; });
+}
+
+std::optional<StoredState> StateStore::find_serial(const std::string& serial) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return find_locked([&](const Record& r) { return !serial.empty() && get_text(r.serial) == serial; });
+}
+
+size_t StateStore::size() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_mapping ? m_mapping->count() : 0;
+}
+
+// --- Saving ---
+
+bool StateStore::save(const std::string& mac, const DeviceState& state) {
+	Record fresh = encode(mac, state);
+	std::string key = key_of(fresh);
+	if (key.empty()) return false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<Record> records;
+	if (m_mapping) {
+		for (size_t i = 0; i < m_mapping->count(); ++i) {
+			Record record;
+			std::memcpy(&record, m_mapping->record(i), sizeof(Record));
+			if (get_le(record.checksum, 4) != checksum(record)) continue; // Drop damaged records
+			// Same headset: same serial, or saved before its serial was known.
+			if (key_of(record) == key || (get_text(record.serial).empty() && get_text(record.mac) == mac)) continue;
+			records.push_back(record);
+		}
+	}
+	records.push_back(fresh);
+	while (records.size() > MAX_DEVICES) {
+		records.erase(std::min_element(records.begin(), records.end(), [](const Record& a, const Record& b) {
+			return get_le(a.saved_at_ms, 8) < get_le(b.saved_at_ms, 8);
+		}));
+	}
+
+	std::vector<uint8_t> bytes(sizeof(Header) + records.size() * sizeof(Record));
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	put_le(header.version, FORMAT_VERSION, 2);
+	put_le(header.record_size, sizeof(Record), 4);
+	put_le(header.count, records.size(), 4);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	std::memcpy(bytes.data() + sizeof(header), records.data(), records.size() * sizeof(Record));
+
+	m_mapping.reset(); // Windows won't replace a mapped file
+	bool replaced = replace_file(m_path, bytes);
+	if (!replaced) std::cerr << "[StateStore] Can't write " << m_path << std::endl;
+	map_locked();
+	return replaced;
+}
@@ -0,0 +1,69 @@
+// cpp_core/core/state_store.h
+
+#pragma once
+
+#include "core/device_state.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+// One headset's state as it was last saved.
+struct StoredState {
+  std::string mac;
+  int64_t saved_at_ms = 0; // System clock
+  uint32_t fields = 0;     // StateFields bits that hold a value in 'state'
+  DeviceState state;       // Values only; no stamps
+};
+
+// Last-known state of every headset seen, one record per serial number, so the
+// UI can draw something the moment the app starts instead of waiting for the
+// connect and the reads.
+//
+// The file is a small header followed by fixed-size records with every string
+// and list in a fixed-size slot (see state_store.cpp). It is memory-mapped on
+// construction and records are decoded straight out of the mapping on find();
+// a file with another format version, or a record whose checksum doesn't match,
+// is ignored rather than half-read. A value that doesn't fit its slot (an overly
+// long name, more presets or paired devices than there are slots) leaves that
+// field out of the record.
+//
+// save() writes the whole file next to the old one and renames it over, so a
+// crash leaves either the old file or the new one. Thread-safe, and meant to be
+// shared by every Device in the process.
+class StateStore {
+ public:
+  static constexpr uint16_t FORMAT_VERSION = 1;
+  // Records beyond this drop the one saved longest ago.
+  static constexpr size_t MAX_DEVICES = 16;
+
+  explicit StateStore(std::string path);
+  ~StateStore();
+
+  StateStore(const StateStore&) = delete;
+  StateStore& operator=(const StateStore&) = delete;
+
+  // Most recently saved record for 'mac', or for any headset if it's empty.
+  std::optional<StoredState> find(const std::string& mac = {}) const;
+  std::optional<StoredState> find_serial(const std::string& serial) const;
+
+  // Saves the confirmed values of 'state' (the pending ones are left out), replacing
+  // the record with the same serial number. Keyed by 'mac' if the device info,
+  // and so the serial number, hasn't been read.
+  bool save(const std::string& mac, const DeviceState& state);
+
+  size_t size() const;
+
+ private:
+  struct Mapping;
+  // Called with m_mutex held.
+  bool map_locked();
+  template <typename Match>
+  std::optional<StoredState> find_locked(Match&& match) const;
+
+  mutable std::mutex m_mutex;
+  std::string m_path;
+  std::unique_ptr<Mapping> m_mapping; // Null while there's no valid file
+};
@@ -0,0 +1,56 @@
+#include "strand.h"
+
+// How many tasks one drain runs before yielding the pool thread to other strands.
+static constexpr int MAX_TASKS_PER_DRAIN = 16;
+
+Strand::Strand(IExecutor& executor) : m_executor(executor), m_state(std::make_shared<State>()) {}
+
+Strand::~Strand() { wait_idle(); }
+
+void Strand::post(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		m_state->tasks.push_back(std::move(task));
+		if (m_state->scheduled) return; // The running drain will pick it up
+		m_state->scheduled = true;
+	}
+	auto state = m_state;
+	IExecutor& executor = m_executor;
+	m_executor.post([&executor, state] { drain(executor, state); });
+}
+
+void Strand::drain(IExecutor& executor, const std::shared_ptr<State>& state) {
+	for (int i = 0; i < MAX_TASKS_PER_DRAIN; ++i) {
+		std::function<void()> task;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (state->tasks.empty()) {
+				state->scheduled = false;
+				state->idle.notify_all();
+				return;
+			}
+			task = std::move(state->tasks.front());
+			state->tasks.pop_front();
+		}
+		task();
+	}
+	// Still busy: go to the back of the executor's line instead of hogging the thread.
+	// A plain post() from a pool worker would land on top of its own LIFO deque and
+	// run again straight away.
+	executor.post_fair([&executor, state] { drain(executor, state); });
+}
+
+size_t Strand::discard_pending() {
+	std::deque<std::function<void()>> dropped;
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		dropped.swap(m_state->tasks);
+	}
+	// Destroyed out here in case a captured object's destructor posts back to us.
+	return dropped.size();
+}
+
+void Strand::wait_idle() {
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	m_state->idle.wait(lock, [this] { return !m_state->scheduled && m_state->tasks.empty(); });
+}
@@ -0,0 +1,44 @@
+// cpp_core/core/strand.h
+
+#pragma once
+
+#include "core/executor.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Serializes tasks on top of any executor.
+// Tasks posted to the same strand run one at a time and in posting order, even
+// when the underlying executor is a multi-threaded pool. This is what keeps the
+// writes (and the callbacks) of one connection in order without giving every
+// connection its own thread.
+class Strand : public IExecutor {
+ public:
+  explicit Strand(IExecutor& executor);
+  // Waits for everything already posted to finish.
+  ~Strand();
+
+  Strand(const Strand&) = delete;
+  Strand& operator=(const Strand&) = delete;
+
+  void post(std::function<void()> task) override;
+
+  // Drops tasks that haven't started yet; the one running (if any) finishes. Returns how many were dropped.
+  size_t discard_pending();
+
+  // Blocks until the queue is empty and nothing is running. Must not be called from a task of this strand.
+  void wait_idle();
+
+ private:
+  struct State {
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::deque<std::function<void()>> tasks;
+    bool scheduled = false;
+  };
+  static void drain(IExecutor& executor, const std::shared_ptr<State>& state);
+
+  IExecutor& m_executor;
+  std::shared_ptr<State> m_state;
+};
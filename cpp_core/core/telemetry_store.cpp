@@ -0,0 +1,298 @@
+#include "telemetry_store.h"
+#include <algorithm>
+#include <optional>
+
+// --- Encoding ---
+//
+// A record starts with a varint tag whose low two bits give its kind:
+//   STEP  timestamp delta unchanged, value delta = zigzag(tag >> 2)
+//   FULL  value delta = zigzag(tag >> 2), followed by zigzag varint delta-of-delta
+//   RUN   (tag >> 2) samples with unchanged timestamp delta and value
+//   WIDE  zigzag varint value delta, then zigzag varint delta-of-delta; for value
+//         deltas whose zigzag form doesn't fit in the 62 bits left in a tag
+// At a steady rate a sample whose value moved by less than 16 is one byte.
+// Value deltas wrap modulo 2^64, so any int64 round-trips.
+
+namespace {
+enum RecordKind : uint64_t { STEP = 0, FULL = 1, RUN = 2, WIDE = 3 };
+constexpr size_t MAX_VARINT = 10;
+
+uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+size_t put_varint(uint8_t* out, uint64_t v) {
+	size_t n = 0;
+	while (v >= 0x80) {
+		out[n++] = static_cast<uint8_t>(v) | 0x80;
+		v >>= 7;
+	}
+	out[n++] = static_cast<uint8_t>(v);
+	return n;
+}
+
+uint64_t get_varint(const uint8_t*& p) {
+	uint64_t v = 0;
+	for (int shift = 0;; shift += 7) {
+		uint8_t byte = *p++;
+		v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return v;
+	}
+}
+} // namespace
+
+struct TelemetryStore::Segment {
+	int64_t first_time = 0;
+	int64_t first_value = 0;
+	// Encoder state: the last sample and the timestamp delta that led to it.
+	int64_t last_time = 0;
+	int64_t last_value = 0;
+	int64_t last_delta = 0;
+	uint32_t count = 0;
+	uint64_t pending_run = 0; // Trailing run not written out yet; room for it is always reserved
+	size_t used = 0;
+	std::array<uint8_t, SEGMENT_BYTES> bytes;
+
+	// False when the sample doesn't fit; the caller starts a new segment.
+	bool append(int64_t time, int64_t value) {
+		if (count == 0) {
+			first_time = last_time = time;
+			first_value = last_value = value;
+			count = 1;
+			return true;
+		}
+		int64_t delta = time - last_time;
+		int64_t dod = delta - last_delta;
+		uint64_t dv = zigzag(static_cast<int64_t>(static_cast<uint64_t>(value) - static_cast<uint64_t>(last_value)));
+
+		if (dod == 0 && dv == 0) {
+			if (pending_run == 0 && used + MAX_VARINT > bytes.size()) return false;
+			++pending_run;
+		} else {
+			if (used + (pending_run ? MAX_VARINT : 0) + 2 * MAX_VARINT + 1 > bytes.size()) return false;
+			flush_run();
+			uint64_t tag = dv << 2;
+			if (dv >> 62) {
+				bytes[used++] = WIDE;
+				used += put_varint(&bytes[used], dv);
+				used += put_varint(&bytes[used], zigzag(dod));
+			} else if (dod == 0) {
+				used += put_varint(&bytes[used], tag | STEP);
+			} else {
+				used += put_varint(&bytes[used], tag | FULL);
+				used += put_varint(&bytes[used], zigzag(dod));
+			}
+		}
+		last_time = time;
+		last_value = value;
+		last_delta = delta;
+		++count;
+		return true;
+	}
+
+	void flush_run() {
+		if (pending_run == 0) return;
+		used += put_varint(&bytes[used], (pending_run << 2) | RUN);
+		pending_run = 0;
+	}
+
+	// Calls f(time, value) per sample until it returns false. Samples before 'from'
+	// are still passed on, but a run lying entirely before it is skipped in one go
+	// except for its last sample.
+	template <typename F>
+	bool decode(int64_t from, F&& f) const {
+		int64_t t = first_time;
+		int64_t v = first_value;
+		int64_t delta = 0;
+		if (!f(t, v)) return false;
+
+		auto emit_run = [&](uint64_t n) {
+			if (delta > 0 && t < from) {
+				// Run samples t + k * delta with k <= skip are all before 'from'.
+				uint64_t skip = std::min<uint64_t>(n, static_cast<uint64_t>((from - t - 1) / delta));
+				if (skip > 1) {
+					t += delta * static_cast<int64_t>(skip - 1);
+					n -= skip - 1;
+				}
+			}
+			for (uint64_t i = 0; i < n; ++i) {
+				t += delta;
+				if (!f(t, v)) return false;
+			}
+			return true;
+		};
+
+		const uint8_t* p = bytes.data();
+		const uint8_t* end = p + used;
+		while (p < end) {
+			uint64_t tag = get_varint(p);
+			uint64_t payload = tag >> 2;
+			if ((tag & 3) == RUN) {
+				if (!emit_run(payload)) return false;
+				continue;
+			}
+			uint64_t dv = payload;
+			if ((tag & 3) == WIDE) {
+				dv = get_varint(p);
+				delta += unzigzag(get_varint(p));
+			} else if ((tag & 3) == FULL) {
+				delta += unzigzag(get_varint(p));
+			}
+			t += delta;
+			v = static_cast<int64_t>(static_cast<uint64_t>(v) + static_cast<uint64_t>(unzigzag(dv)));
+			if (!f(t, v)) return false;
+		}
+		return emit_run(pending_run);
+	}
+};
+
+TelemetryStore::TelemetryStore(TelemetryConfig config) : m_config(config) {}
+
+TelemetryStore::~TelemetryStore() = default;
+
+void TelemetryStore::append(MetricId metric, int64_t time_ms, int64_t value) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Series& series = m_series[metric];
+	if (!series.segments.empty()) {
+		Segment& tail = *series.segments.back();
+		time_ms = std::max(time_ms, tail.last_time);
+		if (tail.append(time_ms, value)) return;
+		tail.flush_run();
+	}
+	series.segments.push_back(std::make_unique<Segment>());
+	++m_segment_count;
+	series.segments.back()->append(time_ms, value);
+	evict_to_cap();
+}
+
+// Drops the oldest closed segment across all metrics until we're under the cap.
+// The segment a metric is currently appending to is never dropped.
+void TelemetryStore::evict_to_cap() {
+	while (m_segment_count * sizeof(Segment) > m_config.memory_cap) {
+		Series* oldest = nullptr;
+		for (auto& [id, series] : m_series) {
+			if (series.segments.size() < 2) continue;
+			if (!oldest || series.segments.front()->first_time < oldest->segments.front()->first_time) oldest = &series;
+		}
+		if (!oldest) return;
+		oldest->segments.pop_front();
+		--m_segment_count;
+		++m_evicted;
+	}
+}
+
+template <typename F>
+void TelemetryStore::scan(MetricId metric, int64_t from_ms, int64_t to_ms, F&& f) const {
+	auto it = m_series.find(metric);
+	if (it == m_series.end()) return;
+
+	std::optional<TelemetrySample> before;
+	auto deliver = [&](int64_t t, int64_t v) {
+		if (t < from_ms) {
+			before = TelemetrySample{t, v};
+			return true;
+		}
+		if (before) {
+			if (!f(before->time_ms, before->value)) return false;
+			before.reset();
+		}
+		return t < to_ms && f(t, v);
+	};
+
+	for (const auto& segment : it->second.segments) {
+		if (segment->last_time < from_ms) {
+			before = TelemetrySample{segment->last_time, segment->last_value}; // Nothing in range, just the tail
+			continue;
+		}
+		if (segment->first_time >= to_ms) break;
+		if (!segment->decode(from_ms, deliver)) return;
+	}
+	if (before) f(before->time_ms, before->value);
+}
+
+std::vector<TelemetrySample> TelemetryStore::query(MetricId metric, int64_t from_ms, int64_t to_ms, size_t max_points,
+												   Downsample mode) const {
+	std::vector<TelemetrySample> samples;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		scan(metric, from_ms, to_ms, [&](int64_t t, int64_t v) {
+			if (t >= from_ms) samples.push_back({t, v});
+			return true;
+		});
+	}
+	if (max_points == 0 || samples.size() <= max_points || to_ms <= from_ms) return samples;
+
+	// Buckets are in time, not in sample count, so gaps in the data stay visible.
+	std::vector<TelemetrySample> buckets;
+	buckets.reserve(max_points);
+	double width = static_cast<double>(to_ms - from_ms) / max_points;
+	auto bucket_of = [&](const TelemetrySample& s) {
+		return std::min(max_points - 1, static_cast<size_t>((s.time_ms - from_ms) / width));
+	};
+	size_t i = 0;
+	while (i < samples.size()) {
+		size_t bucket = bucket_of(samples[i]);
+		int64_t sum = 0, lo = samples[i].value, hi = samples[i].value, last = samples[i].value;
+		size_t n = 0;
+		for (; i < samples.size() && bucket_of(samples[i]) == bucket; ++i, ++n) {
+			sum += samples[i].value;
+			lo = std::min(lo, samples[i].value);
+			hi = std::max(hi, samples[i].value);
+			last = samples[i].value;
+		}
+		int64_t value = last;
+		if (mode == Downsample::MEAN) value = (sum + static_cast<int64_t>(n) / 2) / static_cast<int64_t>(n);
+		if (mode == Downsample::MIN) value = lo;
+		if (mode == Downsample::MAX) value = hi;
+		buckets.push_back({from_ms + static_cast<int64_t>(bucket * width), value});
+	}
+	return buckets;
+}
+
+std::map<int64_t, int64_t> TelemetryStore::dwell_times(MetricId metric, int64_t from_ms, int64_t to_ms) const {
+	std::map<int64_t, int64_t> dwell;
+	std::optional<TelemetrySample> current;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	scan(metric, from_ms, to_ms, [&](int64_t t, int64_t v) {
+		if (current) dwell[current->value] += t - std::max(current->time_ms, from_ms);
+		current = TelemetrySample{t, v};
+		return true;
+	});
+	// The last value holds until the end of the range.
+	if (current && to_ms > std::max(current->time_ms, from_ms)) {
+		dwell[current->value] += to_ms - std::max(current->time_ms, from_ms);
+	}
+	return dwell;
+}
+
+size_t TelemetryStore::transitions(MetricId metric, int64_t from_ms, int64_t to_ms) const {
+	size_t changes = 0;
+	std::optional<int64_t> previous;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	scan(metric, from_ms, to_ms, [&](int64_t, int64_t v) {
+		if (previous && *previous != v) ++changes;
+		previous = v;
+		return true;
+	});
+	return changes;
+}
+
+void TelemetryStore::clear() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_series.clear();
+	m_segment_count = 0;
+}
+
+TelemetryStats TelemetryStore::stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	TelemetryStats s;
+	for (const auto& [id, series] : m_series) {
+		for (const auto& segment : series.segments) {
+			++s.segments;
+			s.encoded_bytes += segment->used;
+			s.samples += segment->count;
+		}
+	}
+	s.memory_bytes = s.segments * sizeof(Segment);
+	s.evicted_segments = m_evicted;
+	return s;
+}
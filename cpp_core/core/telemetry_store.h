@@ -0,0 +1,114 @@
+// cpp_core/core/telemetry_store.h
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using MetricId = uint16_t;
+
+// What the Device records on its own. Hosts may append their own metrics with
+// ids from USER upwards.
+namespace TelemetryMetrics {
+constexpr MetricId BATTERY_LEFT = 0;   // Percent
+constexpr MetricId BATTERY_RIGHT = 1;  // Percent
+constexpr MetricId BATTERY_CASE = 2;   // Percent
+constexpr MetricId ANC_MODE = 3;       // AncMode as int
+constexpr MetricId DUAL_CONNECT = 4;   // Low 16 bits of the playing (or connected) source's MAC, 0 for none
+constexpr MetricId LINK_RTT = 5;       // Units of 0.1 ms, so jitter stays within a one-byte delta
+
+constexpr MetricId USER = 64;
+} // namespace TelemetryMetrics
+
+struct TelemetrySample {
+  int64_t time_ms = 0;
+  int64_t value = 0;
+};
+
+enum class Downsample {
+  LAST, // Value in effect at the end of the bucket; right for modes and other steps
+  MEAN,
+  MIN,
+  MAX
+};
+
+struct TelemetryConfig {
+  // Oldest segments (across all metrics) are dropped beyond this.
+  size_t memory_cap = 1 << 20;
+};
+
+struct TelemetryStats {
+  size_t segments = 0;
+  size_t encoded_bytes = 0; // Bytes of samples actually written into segments
+  size_t memory_bytes = 0;  // What the segments occupy, counted against the cap
+  uint64_t samples = 0;     // Currently stored
+  uint64_t evicted_segments = 0;
+};
+
+// Append-only history of integer metrics, sized for a phone or a tray app.
+//
+// Each metric is a chain of fixed-size segments. A segment stores its first
+// sample in the clear and every later one as a delta-of-delta timestamp and a
+// delta value, zigzag varint encoded; any int64 value is accepted, huge jumps
+// just cost a few more bytes. Runs of identical samples at a steady
+// rate (a battery level holding still, a mode that didn't change) collapse
+// into a single run record. A week at 1 Hz of a battery or mode metric takes a
+// few kilobytes, and one of link RTTs a few hundred.
+//
+// Timestamps are milliseconds on whatever time base the caller picks. The Device
+// uses its clock's time_since_epoch(). They must not go backwards per metric;
+// late samples are stamped with the last time seen.
+//
+// Thread-safe: the Device appends from its reader threads while the UI queries.
+class TelemetryStore {
+ public:
+  static constexpr size_t SEGMENT_BYTES = 1024;
+
+  explicit TelemetryStore(TelemetryConfig config = {});
+  ~TelemetryStore();
+
+  TelemetryStore(const TelemetryStore&) = delete;
+  TelemetryStore& operator=(const TelemetryStore&) = delete;
+
+  void append(MetricId metric, int64_t time_ms, int64_t value);
+
+  // Samples with from_ms <= time < to_ms. With max_points set and more samples than
+  // that in range, the range is cut into max_points equal buckets, each reported
+  // once at its start time; empty buckets are left out.
+  std::vector<TelemetrySample> query(MetricId metric, int64_t from_ms, int64_t to_ms, size_t max_points = 0,
+                                     Downsample mode = Downsample::LAST) const;
+
+  // How long the metric held each value within [from_ms, to_ms), treating it as a
+  // step function (ANC mode dwell times, time on each dual-connect source).
+  std::map<int64_t, int64_t> dwell_times(MetricId metric, int64_t from_ms, int64_t to_ms) const;
+
+  // Value changes within the range (e.g. dual-connect source switches).
+  size_t transitions(MetricId metric, int64_t from_ms, int64_t to_ms) const;
+
+  void clear();
+  TelemetryStats stats() const;
+
+ private:
+  struct Segment;
+  struct Series {
+    std::deque<std::unique_ptr<Segment>> segments;
+  };
+
+  // Calls f(time_ms, value) for every sample of 'metric' from the last one before
+  // from_ms (if any) up to to_ms. Stops early when f returns false.
+  template <typename F>
+  void scan(MetricId metric, int64_t from_ms, int64_t to_ms, F&& f) const;
+  void evict_to_cap();
+
+  TelemetryConfig m_config;
+  mutable std::mutex m_mutex;
+  std::map<MetricId, Series> m_series;
+  size_t m_segment_count = 0;
+  uint64_t m_evicted = 0;
+};
@@ -0,0 +1,100 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+// Which pool (and which worker of it) the current thread belongs to, so post()
+// from inside a task can stay on the local deque.
+static thread_local const ThreadPool* t_pool = nullptr;
+static thread_local size_t t_worker_index = 0;
+
+ThreadPool::ThreadPool(size_t threads) {
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t i = 0; i < threads; ++i) {
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+	for (size_t i = 0; i < threads; ++i) {
+		m_workers[i]->thread = std::thread(&ThreadPool::run, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_stopping = true;
+	}
+	m_sleep_cond.notify_all();
+	for (auto& worker : m_workers) {
+		if (worker->thread.joinable()) worker->thread.join();
+	}
+}
+
+void ThreadPool::post(std::function<void()> task) { push(std::move(task), false); }
+
+void ThreadPool::post_fair(std::function<void()> task) { push(std::move(task), true); }
+
+void ThreadPool::push(std::function<void()> task, bool front) {
+	size_t index = (t_pool == this) ? t_worker_index : m_next.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+	{
+		std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+		auto& tasks = m_workers[index]->tasks;
+		if (front) {
+			tasks.push_front(std::move(task)); // Popped last locally, stolen first
+		} else {
+			tasks.push_back(std::move(task));
+		}
+	}
+	m_queued.fetch_add(1);
+	{
+		// Taking the lock orders us against a worker that is just about to sleep.
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+	}
+	m_sleep_cond.notify_one();
+}
+
+bool ThreadPool::try_pop(size_t index, std::function<void()>& task) {
+	Worker& worker = *m_workers[index];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty()) return false;
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	return true;
+}
+
+bool ThreadPool::try_steal(size_t thief, std::function<void()>& task) {
+	for (size_t i = 1; i < m_workers.size(); ++i) {
+		Worker& victim = *m_workers[(thief + i) % m_workers.size()];
+		std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+		if (!lock.owns_lock() || victim.tasks.empty()) continue;
+		task = std::move(victim.tasks.front());
+		victim.tasks.pop_front();
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::run(size_t index) {
+	t_pool = this;
+	t_worker_index = index;
+
+	std::function<void()> task;
+	while (true) {
+		if (try_pop(index, task) || try_steal(index, task)) {
+			m_queued.fetch_sub(1);
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
+		// A steal can miss a task while its owner holds the deque lock, so only
+		// sleep once the global count says there really is nothing left.
+		m_sleep_cond.wait(lock, [this] { return m_queued.load() > 0 || m_stopping; });
+		if (m_stopping && m_queued.load() == 0) break;
+	}
+}
+
+IExecutor& default_executor() {
+	// Deliberately leaked: joining worker threads from a static destructor can
+	// deadlock when the core is unloaded as a DLL.
+	static ThreadPool* pool = new ThreadPool();
+	return *pool;
+}
@@ -0,0 +1,52 @@
+// cpp_core/core/thread_pool.h
+
+#pragma once
+
+#include "core/executor.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker has its own deque: tasks posted from a worker go to the back of
+// that worker's deque and are popped LIFO (cache-warm), idle workers steal from
+// the front of their siblings' deques. Tasks posted from outside the pool are
+// spread round-robin. post_fair() puts a task at the front of the deque instead,
+// so its own worker gets to it last.
+class ThreadPool : public IExecutor {
+ public:
+  // 0 threads means one per core.
+  explicit ThreadPool(size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void post(std::function<void()> task) override;
+  void post_fair(std::function<void()> task) override;
+  size_t size() const { return m_workers.size(); }
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+  };
+
+  void push(std::function<void()> task, bool front);
+  void run(size_t index);
+  bool try_pop(size_t index, std::function<void()>& task);
+  bool try_steal(size_t thief, std::function<void()>& task);
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::atomic<size_t> m_queued{0};
+  std::atomic<size_t> m_next{0};
+
+  std::mutex m_sleep_mutex;
+  std::condition_variable m_sleep_cond;
+  bool m_stopping = false;
+};
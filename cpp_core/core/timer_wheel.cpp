@@ -0,0 +1,172 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+Timer::~Timer() {
+	if (m_wheel) m_wheel->cancel(*this);
+}
+
+TimerWheel::TimerWheel(IClock& clock) : m_clock(clock), m_start(clock.now()) {}
+
+TimerWheel::~TimerWheel() {
+	auto disarm = [](Timer* t) {
+		while (t) {
+			Timer* next = t->m_next;
+			t->m_prev = t->m_next = nullptr;
+			t->m_wheel = nullptr;
+			t = next;
+		}
+	};
+	for (auto& level : m_slots) {
+		for (Timer* head : level) disarm(head);
+	}
+	disarm(m_expiring);
+}
+
+// --- Arming ---
+
+uint64_t TimerWheel::tick_of(IClock::time_point t, bool round_up) const {
+	if (t <= m_start) return 0;
+	auto since = t - m_start;
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(since);
+	// Round deadlines up so a timer never fires early, and "now" down.
+	if (round_up && ms < since) ++ms;
+	return static_cast<uint64_t>(ms.count());
+}
+
+void TimerWheel::schedule(Timer& timer, std::chrono::milliseconds delay) { schedule_at(timer, m_clock.now() + delay); }
+
+void TimerWheel::schedule_at(Timer& timer, IClock::time_point when) {
+	if (timer.m_wheel) timer.m_wheel->cancel(timer);
+	timer.m_expires = tick_of(when, true);
+	timer.m_wheel = this;
+	++m_armed;
+	link(timer);
+}
+
+void TimerWheel::cancel(Timer& timer) {
+	if (timer.m_wheel != this) return;
+	unlink(timer);
+	timer.m_wheel = nullptr;
+	--m_armed;
+}
+
+// Picks the level by how far away the timer is, like the classic kernel wheel:
+// the first 256 ticks go on level 0, the next 256^2 on level 1, and so on.
+void TimerWheel::link(Timer& timer) {
+	uint64_t expires = std::max(timer.m_expires, m_now);
+	uint64_t delta = expires - m_now;
+
+	int level = 0;
+	while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) ++level;
+	if (level == LEVELS - 1) {
+		// Beyond the wheel's range: park it as far out as we can; it gets re-linked when it comes up.
+		uint64_t max_delta = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+		expires = m_now + std::min(delta, max_delta);
+	}
+
+	timer.m_level = static_cast<uint8_t>(level);
+	timer.m_slot = static_cast<uint8_t>((expires >> (SLOT_BITS * level)) & MASK);
+	Timer*& head = m_slots[level][timer.m_slot];
+	timer.m_prev = nullptr;
+	timer.m_next = head;
+	if (head) head->m_prev = &timer;
+	head = &timer;
+	++m_per_level[level];
+}
+
+void TimerWheel::unlink(Timer& timer) {
+	Timer*& head = timer.m_level == EXPIRING ? m_expiring : m_slots[timer.m_level][timer.m_slot];
+	if (timer.m_prev) timer.m_prev->m_next = timer.m_next;
+	else head = timer.m_next;
+	if (timer.m_next) timer.m_next->m_prev = timer.m_prev;
+	timer.m_prev = timer.m_next = nullptr;
+	if (timer.m_level != EXPIRING) --m_per_level[timer.m_level];
+}
+
+// --- Expiry ---
+
+void TimerWheel::cascade(int level) {
+	size_t slot = (m_now >> (SLOT_BITS * level)) & MASK;
+	Timer* t = m_slots[level][slot];
+	m_slots[level][slot] = nullptr;
+	while (t) {
+		Timer* next = t->m_next;
+		--m_per_level[level];
+		++m_cascaded;
+		link(*t); // Lands on a finer level now that it's closer
+		t = next;
+	}
+}
+
+size_t TimerWheel::fire_current_tick() {
+	uint64_t tick = m_now;
+	size_t slot = tick & MASK;
+
+	// Cascade coarse slots whose turn starts at this tick, coarsest first so
+	// timers can fall all the way down within the same tick.
+	if (slot == 0) {
+		for (int level = LEVELS - 1; level >= 1; --level) {
+			uint64_t span = uint64_t(1) << (SLOT_BITS * level);
+			if ((tick & (span - 1)) == 0) cascade(level);
+		}
+	}
+
+	// Detach the slot first: callbacks may arm timers for "now", which must go
+	// to the next tick instead of being picked up by this loop.
+	m_expiring = m_slots[0][slot];
+	m_slots[0][slot] = nullptr;
+	for (Timer* t = m_expiring; t; t = t->m_next) {
+		--m_per_level[0];
+		t->m_level = EXPIRING;
+	}
+	++m_now;
+	++m_ticks;
+
+	size_t fired = 0;
+	while (Timer* t = m_expiring) {
+		unlink(*t);
+		if (t->m_expires > tick) {
+			link(*t); // Was parked beyond the wheel's range
+			continue;
+		}
+		t->m_wheel = nullptr;
+		--m_armed;
+		++fired;
+		if (t->m_callback) t->m_callback(); // May re-arm or destroy 't'; we don't touch it after this
+	}
+	m_fired += fired;
+	return fired;
+}
+
+size_t TimerWheel::advance() {
+	uint64_t target = tick_of(m_clock.now(), false);
+	size_t fired = 0;
+	while (m_now <= target) {
+		if (m_armed == 0) {
+			m_now = target + 1; // Nothing to cascade or fire: skip the idle stretch
+			break;
+		}
+		fired += fire_current_tick();
+	}
+	return fired;
+}
+
+std::optional<std::chrono::milliseconds> TimerWheel::next_expiry() const {
+	if (m_armed == 0) return std::nullopt;
+	for (size_t i = 0; i < SLOTS; ++i) {
+		if (m_slots[0][(m_now + i) & MASK]) return std::chrono::milliseconds(i);
+		// Stop at the next cascade point: coarse timers may drop into level 0 there.
+		if (i > 0 && ((m_now + i) & MASK) == 0) return std::chrono::milliseconds(i);
+	}
+	return std::chrono::milliseconds(SLOTS);
+}
+
+TimerWheel::Load TimerWheel::load() const {
+	Load load;
+	load.armed = m_armed;
+	for (int level = 0; level < LEVELS; ++level) load.per_level[level] = m_per_level[level];
+	load.fired = m_fired;
+	load.cascaded = m_cascaded;
+	load.ticks = m_ticks;
+	return load;
+}
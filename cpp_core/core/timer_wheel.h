@@ -0,0 +1,109 @@
+// cpp_core/core/timer_wheel.h
+
+#pragma once
+
+#include "core/clock.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+class TimerWheel;
+
+// One timer. It lives wherever its owner puts it (a pending request, a
+// connection); the wheel only links it into a slot list, so arming, cancelling
+// and re-arming never allocate. A periodic timer simply re-arms itself from its
+// callback. Destroying an armed timer cancels it.
+class Timer {
+ public:
+  using Callback = std::function<void()>;
+
+  Timer() = default;
+  explicit Timer(Callback callback) : m_callback(std::move(callback)) {}
+  ~Timer();
+
+  Timer(const Timer&) = delete;
+  Timer& operator=(const Timer&) = delete;
+
+  void set_callback(Callback callback) { m_callback = std::move(callback); }
+  bool armed() const { return m_wheel != nullptr; }
+
+ private:
+  friend class TimerWheel;
+
+  Timer* m_prev = nullptr;
+  Timer* m_next = nullptr;
+  TimerWheel* m_wheel = nullptr;
+  uint64_t m_expires = 0; // Wheel tick
+  uint8_t m_level = 0;
+  uint8_t m_slot = 0;
+  Callback m_callback;
+};
+
+// Hierarchical timing wheel with a 1 ms tick (Varghese & Lauck): four levels of
+// 256 slots cover 2^32 ms. Arming and cancelling are O(1); a timer that lands on
+// a coarse level is cascaded down at most three times before it fires.
+//
+// Not thread-safe: a wheel belongs to one thread (a DeviceManager reactor) which
+// arms timers, cancels them and calls advance(). load() may be read from anywhere.
+class TimerWheel {
+ public:
+  static constexpr int LEVELS = 4;
+  static constexpr int SLOT_BITS = 8;
+  static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+
+  struct Load {
+    size_t armed = 0;
+    std::array<size_t, LEVELS> per_level{};
+    uint64_t fired = 0;
+    uint64_t cascaded = 0; // Timers moved down a level
+    uint64_t ticks = 0;    // Ticks processed one by one (idle stretches are skipped)
+  };
+
+  explicit TimerWheel(IClock& clock = steady_clock());
+  // Disarms whatever is still armed; the timers themselves belong to their owners.
+  ~TimerWheel();
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // (Re)arms 'timer'. It fires on the first advance() at or after the given time.
+  void schedule(Timer& timer, std::chrono::milliseconds delay);
+  void schedule_at(Timer& timer, IClock::time_point when);
+  void cancel(Timer& timer);
+
+  // Fires every timer that is due by clock.now(). Callbacks run right here and may
+  // arm or cancel any timer, including themselves. Returns how many fired.
+  size_t advance();
+
+  // How long the owner may sleep before it has to call advance() again; an upper
+  // bound when the next timer still sits on a coarse level. std::nullopt if nothing is armed.
+  std::optional<std::chrono::milliseconds> next_expiry() const;
+
+  Load load() const;
+  IClock& clock() const { return m_clock; }
+
+ private:
+  static constexpr uint8_t EXPIRING = 0xFF; // m_level of timers detached for firing
+  static constexpr size_t MASK = SLOTS - 1;
+
+  uint64_t tick_of(IClock::time_point t, bool round_up) const;
+  void link(Timer& timer);
+  void unlink(Timer& timer);
+  void cascade(int level);
+  size_t fire_current_tick();
+
+  IClock& m_clock;
+  const IClock::time_point m_start;
+  uint64_t m_now = 0; // Next tick to process
+  std::array<std::array<Timer*, SLOTS>, LEVELS> m_slots{};
+  Timer* m_expiring = nullptr;
+
+  std::atomic<size_t> m_armed{0};
+  std::array<std::atomic<size_t>, LEVELS> m_per_level{};
+  std::atomic<uint64_t> m_fired{0};
+  std::atomic<uint64_t> m_cascaded{0};
+  std::atomic<uint64_t> m_ticks{0};
+};
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <tuple>
 
 // --- Enums for Commands ---
 
@@ -110,4 +111,42 @@ struct EqualizerInfo {
 struct AncStatus {
     AncMode mode = AncMode::UNKNOWN;
     AncLevel level = AncLevel::UNKNOWN; // Only valid when mode is CANCELLATION or AWARENESS
-};
\ No newline at end of file
+};
+
+
+// --- Equality, so a re-read that returns the same value can be told from a change ---
+
+inline bool operator==(const BatteryInfo& a, const BatteryInfo& b) {
+    return std::tie(a.left, a.right, a.case_level, a.global, a.is_charging_case, a.is_charging_left, a.is_charging_right) ==
+           std::tie(b.left, b.right, b.case_level, b.global, b.is_charging_case, b.is_charging_left, b.is_charging_right);
+}
+inline bool operator==(const DeviceInfo& a, const DeviceInfo& b) {
+    return std::tie(a.model, a.sub_model, a.firmware_version, a.serial_number, a.left_serial, a.right_serial) ==
+           std::tie(b.model, b.sub_model, b.firmware_version, b.serial_number, b.left_serial, b.right_serial);
+}
+inline bool operator==(const DualConnectDevice& a, const DualConnectDevice& b) {
+    return std::tie(a.mac_address, a.name, a.is_connected, a.is_playing, a.is_preferred, a.can_auto_connect) ==
+           std::tie(b.mac_address, b.name, b.is_connected, b.is_playing, b.is_preferred, b.can_auto_connect);
+}
+inline bool operator==(const CustomEqPreset& a, const CustomEqPreset& b) {
+    return std::tie(a.id, a.name, a.values) == std::tie(b.id, b.name, b.values);
+}
+inline bool operator==(const GestureSettings& a, const GestureSettings& b) {
+    return std::tie(a.double_tap_left, a.double_tap_right, a.double_tap_incall, a.triple_tap_left, a.triple_tap_right,
+                    a.long_tap_left, a.long_tap_right, a.long_tap_anc_cycle_left, a.long_tap_anc_cycle_right, a.swipe_action) ==
+           std::tie(b.double_tap_left, b.double_tap_right, b.double_tap_incall, b.triple_tap_left, b.triple_tap_right,
+                    b.long_tap_left, b.long_tap_right, b.long_tap_anc_cycle_left, b.long_tap_anc_cycle_right, b.swipe_action);
+}
+inline bool operator==(const EqualizerInfo& a, const EqualizerInfo& b) {
+    return std::tie(a.current_preset_id, a.built_in_preset_ids, a.custom_presets) ==
+           std::tie(b.current_preset_id, b.built_in_preset_ids, b.custom_presets);
+}
+inline bool operator==(const AncStatus& a, const AncStatus& b) { return a.mode == b.mode && a.level == b.level; }
+
+inline bool operator!=(const BatteryInfo& a, const BatteryInfo& b) { return !(a == b); }
+inline bool operator!=(const DeviceInfo& a, const DeviceInfo& b) { return !(a == b); }
+inline bool operator!=(const DualConnectDevice& a, const DualConnectDevice& b) { return !(a == b); }
+inline bool operator!=(const CustomEqPreset& a, const CustomEqPreset& b) { return !(a == b); }
+inline bool operator!=(const GestureSettings& a, const GestureSettings& b) { return !(a == b); }
+inline bool operator!=(const EqualizerInfo& a, const EqualizerInfo& b) { return !(a == b); }
+inline bool operator!=(const AncStatus& a, const AncStatus& b) { return !(a == b); }
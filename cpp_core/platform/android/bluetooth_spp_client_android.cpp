@@ -108,6 +108,27 @@ std::vector<std::vector<uint8_t>> BluetoothSppClientAndroid::receive_all() {
     return all_packets;
 }
 
+std::vector<uint8_t> BluetoothSppClientAndroid::read_available() {
+    JNIEnv* env = get_env();
+    std::vector<uint8_t> bytes;
+
+    // BluetoothManager's receiver thread already reassembles whole packets,
+    // so a zero timeout just drains whatever is queued right now.
+    while(true) {
+        jbyteArray javaBytes = (jbyteArray)env->CallObjectMethod(m_bluetoothManagerJavaObject, m_receiveMethodId, (jlong)0);
+        if (javaBytes == nullptr) {
+            break;
+        }
+
+        jsize len = env->GetArrayLength(javaBytes);
+        size_t offset = bytes.size();
+        bytes.resize(offset + len);
+        env->GetByteArrayRegion(javaBytes, 0, len, reinterpret_cast<jbyte*>(bytes.data() + offset));
+        env->DeleteLocalRef(javaBytes);
+    }
+    return bytes;
+}
+
 bool BluetoothSppClientAndroid::is_connected() const {
     JNIEnv* env = const_cast<BluetoothSppClientAndroid*>(this)->get_env();
     bool result = env->CallBooleanMethod(m_bluetoothManagerJavaObject, m_isConnectedMethodId);
@@ -12,6 +12,7 @@ public:
     void disconnect() override;
     bool send(const std::vector<uint8_t>& data) override;
     std::vector<std::vector<uint8_t>> receive_all() override;
+    std::vector<uint8_t> read_available() override;
     bool is_connected() const override;
 
 private:
@@ -0,0 +1,76 @@
+#include "platform/android/device_discovery_android.h"
+#include <stdexcept>
+#include <android/log.h>
+
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, "BT_DISCOVERY", __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "BT_DISCOVERY", __VA_ARGS__)
+
+JNIEnv* DeviceDiscoveryAndroid::get_env() {
+    JNIEnv* env;
+    int status = m_vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6);
+    if (status == JNI_EDETACHED) {
+        status = m_vm->AttachCurrentThread(&env, nullptr);
+        if (status != JNI_OK) {
+            throw std::runtime_error("Failed to attach current thread to JVM");
+        }
+    } else if (status != JNI_OK) {
+        throw std::runtime_error("Failed to get JNI environment");
+    }
+    return env;
+}
+
+DeviceDiscoveryAndroid::DeviceDiscoveryAndroid(JavaVM* vm, jobject bluetoothManager)
+        : m_vm(vm) {
+    JNIEnv* env = get_env();
+    m_bluetoothManagerJavaObject = env->NewGlobalRef(bluetoothManager);
+    if (m_bluetoothManagerJavaObject == nullptr) {
+        throw std::runtime_error("Failed to create global reference for BluetoothManager");
+    }
+
+    jclass managerClass = env->GetObjectClass(m_bluetoothManagerJavaObject);
+    m_findDeviceMethodId = env->GetMethodID(managerClass, "findDeviceByName",
+                                            "(Ljava/lang/String;)Landroid/bluetooth/BluetoothDevice;");
+    env->DeleteLocalRef(managerClass);
+
+    jclass deviceClass = env->FindClass("android/bluetooth/BluetoothDevice");
+    if (deviceClass != nullptr) {
+        m_getAddressMethodId = env->GetMethodID(deviceClass, "getAddress", "()Ljava/lang/String;");
+        env->DeleteLocalRef(deviceClass);
+    }
+
+    if (!m_findDeviceMethodId || !m_getAddressMethodId) {
+        throw std::runtime_error("Failed to find the device lookup methods");
+    }
+}
+
+DeviceDiscoveryAndroid::~DeviceDiscoveryAndroid() {
+    JNIEnv* env = get_env();
+    if (m_bluetoothManagerJavaObject) {
+        env->DeleteGlobalRef(m_bluetoothManagerJavaObject);
+    }
+}
+
+std::optional<DiscoveredDevice> DeviceDiscoveryAndroid::find_by_name(const std::string& name) {
+    JNIEnv* env = get_env();
+    jstring javaName = env->NewStringUTF(name.c_str());
+    jobject device = env->CallObjectMethod(m_bluetoothManagerJavaObject, m_findDeviceMethodId, javaName);
+    env->DeleteLocalRef(javaName);
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        LOGE("findDeviceByName threw for %s", name.c_str());
+        return std::nullopt;
+    }
+    if (device == nullptr) return std::nullopt;
+
+    auto javaAddress = static_cast<jstring>(env->CallObjectMethod(device, m_getAddressMethodId));
+    env->DeleteLocalRef(device);
+    if (javaAddress == nullptr) return std::nullopt;
+    const char* addressChars = env->GetStringUTFChars(javaAddress, nullptr);
+    std::string address(addressChars);
+    env->ReleaseStringUTFChars(javaAddress, addressChars);
+    env->DeleteLocalRef(javaAddress);
+
+    LOGI("%s is paired as %s", name.c_str(), address.c_str());
+    // Channel 0: BluetoothManager looks the SPP service up itself.
+    return DiscoveredDevice{name, address, 0};
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "platform/device_discovery_interface.h"
+#include <jni.h>
+
+// BluetoothManager.findDeviceByName() (a scan of the bonded devices) behind
+// IDeviceDiscovery, for DiscoveryCache.
+class DeviceDiscoveryAndroid : public IDeviceDiscovery {
+public:
+    DeviceDiscoveryAndroid(JavaVM* vm, jobject bluetoothManager);
+    ~DeviceDiscoveryAndroid() override;
+
+    std::optional<DiscoveredDevice> find_by_name(const std::string& name) override;
+
+private:
+    JavaVM* m_vm;
+    jobject m_bluetoothManagerJavaObject; // Global reference
+    jmethodID m_findDeviceMethodId = nullptr;
+    jmethodID m_getAddressMethodId = nullptr;
+
+    JNIEnv* get_env();
+};
@@ -19,5 +19,9 @@ public:
     virtual void disconnect() = 0;
     virtual bool send(const std::vector<uint8_t>& data) = 0;
     virtual std::vector<std::vector<uint8_t>> receive_all() = 0;
+    // Non-blocking read used by the reactor in DeviceManager. Returns whatever raw
+    // bytes are already available (possibly empty) without waiting; framing is
+    // left to the caller's FrameDecoder.
+    virtual std::vector<uint8_t> read_available() = 0;
     virtual bool is_connected() const = 0;
 };
\ No newline at end of file
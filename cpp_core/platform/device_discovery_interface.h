@@ -0,0 +1,22 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+// A paired headset as the platform reports it.
+struct DiscoveredDevice {
+    std::string name;
+    std::string address; // "AA:BB:CC:DD:EE:FF"
+    int channel = 0;     // RFCOMM channel; 0 for the platform's default
+};
+
+// How a platform finds a paired headset by name. This is the slow part of a
+// connect (a WinRT enumeration on Windows, a bonded-device scan on Android),
+// so the core only calls it through a DiscoveryCache.
+class IDeviceDiscovery {
+public:
+    virtual ~IDeviceDiscovery() = default;
+
+    // The paired device called 'name', or nullopt if there is none.
+    virtual std::optional<DiscoveredDevice> find_by_name(const std::string& name) = 0;
+};
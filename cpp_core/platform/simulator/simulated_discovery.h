@@ -0,0 +1,53 @@
+#pragma once
+#include "core/clock.h"
+#include "platform/device_discovery_interface.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+// A pairing list for the simulator: find_by_name() answers from it after
+// 'lookup_time', the way a WinRT enumeration or a bonded-device scan would
+// take a while. Re-pair or unpair a name to play a headset that moved. The wait
+// runs on 'clock', so with a VirtualClock it costs no real time.
+class SimulatedDiscovery : public IDeviceDiscovery {
+public:
+    explicit SimulatedDiscovery(std::chrono::milliseconds lookup_time = std::chrono::milliseconds(300),
+                                IClock& clock = steady_clock())
+        : m_lookup_time(lookup_time), m_clock(clock) {}
+
+    void pair(const std::string& name, const std::string& address, int channel = 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paired[name] = DiscoveredDevice{name, address, channel};
+    }
+    void unpair(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paired.erase(name);
+    }
+
+    std::optional<DiscoveredDevice> find_by_name(const std::string& name) override {
+        ++m_lookups;
+        m_clock.sleep_for(m_lookup_time);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_paired.find(name);
+        if (it == m_paired.end()) return std::nullopt;
+        return it->second;
+    }
+
+    // Where 'name' really is now, for a simulated connect to check against.
+    std::optional<DiscoveredDevice> paired(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_paired.find(name);
+        if (it == m_paired.end()) return std::nullopt;
+        return it->second;
+    }
+
+    uint64_t lookups() const { return m_lookups; }
+
+private:
+    std::chrono::milliseconds m_lookup_time;
+    IClock& m_clock;
+    mutable std::mutex m_mutex;
+    std::map<std::string, DiscoveredDevice> m_paired;
+    std::atomic<uint64_t> m_lookups{0};
+};
@@ -0,0 +1,344 @@
+#include "simulated_spp_client.h"
+#include "protocol/huawei_commands.h"
+#include <algorithm>
+
+using namespace HuaweiCommands;
+
+static uint16_t id_of(const std::array<uint8_t, 2>& cmd) { return bytes_to_u16(cmd[0], cmd[1]); }
+
+static std::vector<uint8_t> mac_to_bytes(const std::string& mac) {
+	std::vector<uint8_t> bytes;
+	std::string hex;
+	for (char c : mac) {
+		if (c != ':') hex += c;
+	}
+	for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+		bytes.push_back(static_cast<uint8_t>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+	}
+	return bytes;
+}
+
+// =================================================================
+// SimulatedHeadset
+// =================================================================
+
+SimulatedHeadset::SimulatedHeadset() {
+	auto str = [](const std::string& s) { return std::vector<uint8_t>(s.begin(), s.end()); };
+
+	m_registers[id_of(CMD_DEVICE_INFO_READ)] = {
+		{7, str("1.0.0.168")},
+		{9, str("SIM0000000001")},
+		{10, str("T0018")},
+		{15, str("HUAWEI FreeBuds 6i")},
+	};
+	m_registers[id_of(CMD_BATTERY_READ)] = {{1, {80}}, {2, {80, 78, 60}}, {3, {0, 0, 0}}};
+	m_registers[id_of(CMD_ANC_READ)] = {{1, {0, 1}}}; // {level, mode}
+	m_registers[id_of(CMD_DUAL_TAP_READ)] = {{1, {1}}, {2, {1}}, {4, {0}}};
+	m_registers[id_of(CMD_TRIPLE_TAP_READ)] = {{1, {2}}, {2, {7}}};
+	m_registers[id_of(CMD_LONG_TAP_SPLIT_READ_BASE)] = {{1, {10}}, {2, {10}}};
+	m_registers[id_of(CMD_LONG_TAP_SPLIT_READ_ANC)] = {{1, {2}}, {2, {2}}};
+	m_registers[id_of(CMD_SWIPE_READ)] = {{1, {0}}};
+	m_registers[id_of(CMD_AUTO_PAUSE_READ)] = {{1, {1}}};
+	m_registers[id_of(CMD_SOUND_QUALITY_READ)] = {{2, {0}}};
+	m_registers[id_of(CMD_LOW_LATENCY_READ)] = {{2, {0}}};
+	m_registers[id_of(CMD_EQUALIZER_READ)] = {{2, {1}}, {3, {1, 2, 3, 9}}};
+	m_registers[id_of(CMD_DUAL_CONNECT_ENABLED_READ)] = {{1, {1}}};
+
+	DualConnectDevice phone;
+	phone.mac_address = "a1:b2:c3:d4:e5:f6";
+	phone.name = "Phone";
+	phone.is_connected = true;
+	phone.is_preferred = true;
+	phone.can_auto_connect = true;
+	DualConnectDevice laptop;
+	laptop.mac_address = "11:22:33:44:55:66";
+	laptop.name = "Laptop";
+	laptop.can_auto_connect = true;
+	m_paired = {phone, laptop};
+
+	rebuild_equalizer_blob();
+}
+
+std::vector<HuaweiSppPacket> SimulatedHeadset::handle(const HuaweiSppPacket& request) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint16_t cmd = request.command_id;
+
+	// A request whose parameters are all empty is a read.
+	bool is_read = std::all_of(request.parameters.begin(), request.parameters.end(),
+							   [](const auto& p) { return p.second.empty(); });
+
+	if (cmd == id_of(CMD_DUAL_CONNECT_ENUMERATE)) return enumerate_dual_connect();
+
+	if (is_read) {
+		auto it = m_registers.find(cmd);
+		if (it == m_registers.end()) return {}; // Unknown commands get no answer at all
+		HuaweiSppPacket response(cmd);
+		response.parameters = it->second;
+		return {response};
+	}
+
+	// Writes that map one-to-one onto a read register.
+	static const std::map<uint16_t, uint16_t> write_to_read = {
+		{id_of(CMD_DUAL_TAP_WRITE), id_of(CMD_DUAL_TAP_READ)},
+		{id_of(CMD_TRIPLE_TAP_WRITE), id_of(CMD_TRIPLE_TAP_READ)},
+		{id_of(CMD_LONG_TAP_SPLIT_WRITE_BASE), id_of(CMD_LONG_TAP_SPLIT_READ_BASE)},
+		{id_of(CMD_LONG_TAP_SPLIT_WRITE_ANC), id_of(CMD_LONG_TAP_SPLIT_READ_ANC)},
+		{id_of(CMD_SWIPE_WRITE), id_of(CMD_SWIPE_READ)},
+		{id_of(CMD_AUTO_PAUSE_WRITE), id_of(CMD_AUTO_PAUSE_READ)},
+		{id_of(CMD_DUAL_CONNECT_ENABLED_WRITE), id_of(CMD_DUAL_CONNECT_ENABLED_READ)},
+	};
+
+	if (auto it = write_to_read.find(cmd); it != write_to_read.end()) {
+		for (const auto& [key, value] : request.parameters) m_registers[it->second][key] = value;
+	} else if (cmd == id_of(CMD_SOUND_QUALITY_WRITE) || cmd == id_of(CMD_LOW_LATENCY_WRITE)) {
+		// Written through param 1, reported back through param 2.
+		if (auto p = request.get_param(1)) m_registers[cmd == id_of(CMD_SOUND_QUALITY_WRITE) ? id_of(CMD_SOUND_QUALITY_READ) : id_of(CMD_LOW_LATENCY_READ)][2] = *p;
+	} else if (cmd == id_of(CMD_ANC_WRITE)) {
+		handle_anc_write(request);
+	} else if (cmd == id_of(CMD_EQUALIZER_WRITE)) {
+		handle_equalizer_write(request);
+	} else if (cmd == id_of(CMD_DUAL_CONNECT_PREFERRED_WRITE) || cmd == id_of(CMD_DUAL_CONNECT_EXECUTE)) {
+		handle_dual_connect_write(request);
+	} else {
+		return {};
+	}
+	return {HuaweiSppPacket(cmd)};
+}
+
+HuaweiSppPacket SimulatedHeadset::set_battery(const BatteryInfo& info) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto level = [](int v) { return static_cast<uint8_t>(std::clamp(v, 0, 100)); };
+	auto& reg = m_registers[id_of(CMD_BATTERY_READ)];
+	reg[1] = {level(info.global)};
+	reg[2] = {level(info.left), level(info.right), level(info.case_level)};
+	reg[3] = {static_cast<uint8_t>(info.is_charging_case), static_cast<uint8_t>(info.is_charging_left),
+			  static_cast<uint8_t>(info.is_charging_right)};
+	HuaweiSppPacket notification(id_of(CMD_BATTERY_NOTIFY));
+	notification.parameters = reg;
+	return notification;
+}
+
+HuaweiSppPacket SimulatedHeadset::set_dual_connect(const std::string& mac_address, bool connected) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& dev : m_paired) {
+		if (dev.mac_address != mac_address) continue;
+		dev.is_connected = connected;
+		if (!connected) dev.is_playing = false;
+	}
+	HuaweiSppPacket event(id_of(CMD_DUAL_CONNECT_CHANGE_EVENT));
+	event.parameters[4] = mac_to_bytes(mac_address);
+	event.parameters[5] = {static_cast<uint8_t>(connected ? 1 : 0)};
+	return event;
+}
+
+void SimulatedHeadset::drop_support(const std::array<uint8_t, 2>& read_command) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_registers.erase(id_of(read_command));
+}
+
+void SimulatedHeadset::handle_anc_write(const HuaweiSppPacket& request) {
+	auto p = request.get_param(1);
+	if (!p || p->size() != 2) return;
+	uint8_t mode = (*p)[0];
+	uint8_t level = (*p)[1];
+	auto& reg = m_registers[id_of(CMD_ANC_READ)][1];
+	if (level == 0xFF) {
+		// Mode-only write keeps the level if the mode didn't change.
+		level = (reg.size() == 2 && reg[1] == mode) ? reg[0] : (mode == 2 ? 2 : 0);
+	}
+	reg = {level, mode};
+}
+
+void SimulatedHeadset::handle_equalizer_write(const HuaweiSppPacket& request) {
+	auto id = request.get_param(1);
+	if (!id || id->empty()) return;
+	auto action = request.get_param(5);
+	if (!action || action->empty()) {
+		m_registers[id_of(CMD_EQUALIZER_READ)][2] = {(*id)[0]};
+		return;
+	}
+
+	auto existing = std::find_if(m_custom_eq.begin(), m_custom_eq.end(),
+								 [&](const CustomEqPreset& p) { return p.id == (*id)[0]; });
+	if ((*action)[0] == 2) {
+		if (existing != m_custom_eq.end()) m_custom_eq.erase(existing);
+	} else {
+		CustomEqPreset preset;
+		preset.id = (*id)[0];
+		if (auto v = request.get_param(3)) preset.values.assign(v->begin(), v->end());
+		if (auto n = request.get_param(4)) preset.name.assign(n->begin(), n->end());
+		if (existing != m_custom_eq.end()) {
+			*existing = preset;
+		} else {
+			m_custom_eq.push_back(preset);
+		}
+		m_registers[id_of(CMD_EQUALIZER_READ)][2] = {preset.id};
+	}
+	rebuild_equalizer_blob();
+}
+
+void SimulatedHeadset::handle_dual_connect_write(const HuaweiSppPacket& request) {
+	if (request.parameters.empty()) return;
+	const auto& [key, mac] = *request.parameters.begin();
+	for (auto& dev : m_paired) {
+		if (mac_to_bytes(dev.mac_address) != mac) continue;
+		if (request.command_id == id_of(CMD_DUAL_CONNECT_PREFERRED_WRITE)) {
+			for (auto& other : m_paired) other.is_preferred = false;
+			dev.is_preferred = true;
+		} else if (key == 1) {
+			dev.is_connected = true;
+		} else if (key == 2) {
+			dev.is_connected = false;
+			dev.is_playing = false;
+		}
+	}
+	if (request.command_id == id_of(CMD_DUAL_CONNECT_EXECUTE) && key == 3) {
+		m_paired.erase(std::remove_if(m_paired.begin(), m_paired.end(),
+									  [&](const DualConnectDevice& d) { return mac_to_bytes(d.mac_address) == mac; }),
+					   m_paired.end());
+	}
+}
+
+void SimulatedHeadset::rebuild_equalizer_blob() {
+	std::vector<uint8_t> blob;
+	for (const auto& preset : m_custom_eq) {
+		blob.push_back(preset.id);
+		blob.push_back(static_cast<uint8_t>(preset.values.size()));
+		for (int8_t v : preset.values) blob.push_back(static_cast<uint8_t>(v));
+		blob.insert(blob.end(), preset.name.begin(), preset.name.end());
+		blob.push_back('\0');
+	}
+	m_registers[id_of(CMD_EQUALIZER_READ)][8] = blob;
+}
+
+std::vector<HuaweiSppPacket> SimulatedHeadset::enumerate_dual_connect() const {
+	std::vector<HuaweiSppPacket> frames;
+	for (const auto& dev : m_paired) {
+		HuaweiSppPacket frame(id_of(CMD_DUAL_CONNECT_ENUMERATE));
+		frame.parameters[4] = mac_to_bytes(dev.mac_address);
+		frame.parameters[5] = {static_cast<uint8_t>(dev.is_playing ? 9 : (dev.is_connected ? 1 : 0))};
+		frame.parameters[7] = {static_cast<uint8_t>(dev.is_preferred ? 1 : 0)};
+		frame.parameters[8] = {static_cast<uint8_t>(dev.can_auto_connect ? 1 : 0)};
+		frame.parameters[9] = std::vector<uint8_t>(dev.name.begin(), dev.name.end());
+		frames.push_back(frame);
+	}
+	return frames;
+}
+
+// =================================================================
+// SimulatedSppClient
+// =================================================================
+
+SimulatedSppClient::SimulatedSppClient(std::shared_ptr<SimulatedHeadset> headset, SimulatorConfig config, IClock& clock)
+	: m_headset(std::move(headset)), m_config(config), m_clock(clock), m_rng(config.seed) {}
+
+bool SimulatedSppClient::connect(const std::string& address, int port) {
+	if (m_config.connect_time.count() > 0) m_clock.sleep_for(m_config.connect_time);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_inbox.clear();
+	m_tx_decoder.reset();
+	if (!m_reachable) {
+		m_connected = false;
+		return false;
+	}
+	m_link_dead = false;
+	m_connected = true;
+	return true;
+}
+
+void SimulatedSppClient::disconnect() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_connected = false;
+	m_inbox.clear();
+	m_cond.notify_all();
+}
+
+void SimulatedSppClient::drop_link() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_link_dead = true;
+	m_inbox.clear();
+}
+
+void SimulatedSppClient::set_reachable(bool reachable) { m_reachable = reachable; }
+
+bool SimulatedSppClient::send(const std::vector<uint8_t>& data) {
+	if (!m_connected) return false;
+	m_bytes_sent += data.size();
+	if (m_link_dead) return true; // Swallowed, and we can't tell
+	auto now = m_clock.now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_tx_decoder.feed(data);
+	std::vector<uint8_t> frame;
+	while (m_tx_decoder.next_frame(frame)) {
+		++m_frames_sent;
+		auto request = HuaweiSppPacket::from_bytes(frame);
+		if (!request) continue;
+
+		for (const auto& response : m_headset->handle(*request)) {
+			if (m_config.loss_rate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(m_rng) < m_config.loss_rate) {
+				continue; // Lost on the air
+			}
+			auto delay = m_config.latency;
+			if (m_config.jitter.count() > 0) {
+				delay += std::chrono::microseconds(std::uniform_int_distribution<int64_t>(0, m_config.jitter.count())(m_rng));
+			}
+			schedule(response.to_bytes(), now + delay);
+		}
+	}
+	m_cond.notify_all();
+	return true;
+}
+
+void SimulatedSppClient::inject(const HuaweiSppPacket& packet) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_link_dead) return;
+	schedule(packet.to_bytes(), m_clock.now());
+	m_cond.notify_all();
+}
+
+void SimulatedSppClient::schedule(std::vector<uint8_t> bytes, Clock::time_point deliver_at) {
+	auto pos = std::upper_bound(m_inbox.begin(), m_inbox.end(), deliver_at,
+								[](const Clock::time_point& t, const InFlight& f) { return t < f.deliver_at; });
+	m_inbox.insert(pos, InFlight{deliver_at, std::move(bytes)});
+}
+
+std::vector<std::vector<uint8_t>> SimulatedSppClient::receive_all() {
+	std::vector<std::vector<uint8_t>> all_packets;
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// Same shape as the real clients: keep collecting frames until nothing new
+	// shows up within the receive timeout.
+	while (m_connected) {
+		auto now = m_clock.now();
+		while (!m_inbox.empty() && m_inbox.front().deliver_at <= now) {
+			m_bytes_received += m_inbox.front().bytes.size();
+			all_packets.push_back(std::move(m_inbox.front().bytes));
+			m_inbox.pop_front();
+			++m_frames_received;
+		}
+
+		auto give_up_at = now + m_config.receive_timeout;
+		if (!m_inbox.empty() && m_inbox.front().deliver_at <= give_up_at) {
+			m_clock.wait_until(lock, m_cond, m_inbox.front().deliver_at);
+			continue;
+		}
+		if (m_clock.wait_until(lock, m_cond, give_up_at) == std::cv_status::timeout) break;
+	}
+	return all_packets;
+}
+
+std::vector<uint8_t> SimulatedSppClient::read_available() {
+	std::vector<uint8_t> bytes;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto now = m_clock.now();
+	while (!m_inbox.empty() && m_inbox.front().deliver_at <= now) {
+		bytes.insert(bytes.end(), m_inbox.front().bytes.begin(), m_inbox.front().bytes.end());
+		m_bytes_received += m_inbox.front().bytes.size();
+		m_inbox.pop_front();
+		++m_frames_received;
+	}
+	return bytes;
+}
+
+bool SimulatedSppClient::is_connected() const { return m_connected; }
@@ -0,0 +1,127 @@
+#pragma once
+#include "platform/bluetooth_interface.h"
+#include "protocol/frame_decoder.h"
+#include "protocol/huawei_packet.h"
+#include "core/clock.h"
+#include "core/types.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+
+// Timing and link-quality knobs for the simulator.
+struct SimulatorConfig {
+  // Time between a request leaving us and its response being readable.
+  std::chrono::microseconds latency{std::chrono::milliseconds(15)};
+  // Uniform extra delay in [0, jitter] added per response frame.
+  std::chrono::microseconds jitter{0};
+  // Probability that a response frame is lost on the way back.
+  double loss_rate = 0.0;
+  // What receive_all() waits for more data before giving up, like SO_RCVTIMEO on Windows.
+  std::chrono::milliseconds receive_timeout{200};
+  // How long connect() blocks, like an RFCOMM connect does.
+  std::chrono::milliseconds connect_time{0};
+  uint32_t seed = 1;
+};
+
+// A protocol-level model of a FreeBuds headset.
+// It keeps the parameters the real device reports per read command and answers
+// requests the way the earbuds do: reads echo the stored parameters, writes
+// update them and are acknowledged with an empty frame of the same command.
+class SimulatedHeadset {
+ public:
+  SimulatedHeadset();
+
+  // Produces the frames the device would answer 'request' with.
+  std::vector<HuaweiSppPacket> handle(const HuaweiSppPacket& request);
+
+  // Scripted battery levels. Reads report them from now on; the returned
+  // CMD_BATTERY_NOTIFY is what the earbuds would push (hand it to inject()).
+  HuaweiSppPacket set_battery(const BatteryInfo& info);
+
+  // Connects or disconnects a paired device as if from the phone's side. The
+  // returned CMD_DUAL_CONNECT_CHANGE_EVENT (hand it to inject()) carries only the
+  // address and the new state, none of the enumerate frame's other parameters.
+  HuaweiSppPacket set_dual_connect(const std::string& mac_address, bool connected);
+
+  // Plays an older model: reads of 'read_command' go unanswered from now on.
+  void drop_support(const std::array<uint8_t, 2>& read_command);
+
+ private:
+  void handle_anc_write(const HuaweiSppPacket& request);
+  void handle_equalizer_write(const HuaweiSppPacket& request);
+  void handle_dual_connect_write(const HuaweiSppPacket& request);
+  void rebuild_equalizer_blob();
+  std::vector<HuaweiSppPacket> enumerate_dual_connect() const;
+
+  std::mutex m_mutex;
+  // Read command id -> parameters it reports.
+  std::map<uint16_t, std::map<uint8_t, std::vector<uint8_t>>> m_registers;
+  std::vector<CustomEqPreset> m_custom_eq;
+  std::vector<DualConnectDevice> m_paired;
+};
+
+// IBluetoothSPPClient backed by a SimulatedHeadset instead of a radio.
+// Responses become readable after the configured latency, and frames can be
+// dropped to model a lossy link.
+class SimulatedSppClient : public IBluetoothSPPClient {
+ public:
+  // Latencies and timeouts run on 'clock'; with a VirtualClock a whole scenario
+  // plays out without waiting in real time.
+  explicit SimulatedSppClient(std::shared_ptr<SimulatedHeadset> headset, SimulatorConfig config = {},
+                              IClock& clock = steady_clock());
+
+  bool connect(const std::string& address, int port) override;
+  void disconnect() override;
+  bool send(const std::vector<uint8_t>& data) override;
+  std::vector<std::vector<uint8_t>> receive_all() override;
+  std::vector<uint8_t> read_available() override;
+  bool is_connected() const override;
+
+  // Queues a frame as if the headset had sent it on its own (notifications).
+  void inject(const HuaweiSppPacket& packet);
+
+  // Scripted failures. drop_link() turns the link into a black hole without telling
+  // us, the way a real RFCOMM link looks until the stack's supervision timeout
+  // fires: is_connected() stays true, sends succeed, nothing ever comes back.
+  // The next connect() clears it, unless the headset is unreachable (out of range),
+  // in which case connects fail.
+  void drop_link();
+  void set_reachable(bool reachable);
+
+  uint64_t frames_sent() const { return m_frames_sent; }
+  uint64_t frames_received() const { return m_frames_received; }
+  // Raw bytes each way, framing included.
+  uint64_t bytes_sent() const { return m_bytes_sent; }
+  uint64_t bytes_received() const { return m_bytes_received; }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+  struct InFlight {
+    Clock::time_point deliver_at;
+    std::vector<uint8_t> bytes;
+  };
+  void schedule(std::vector<uint8_t> bytes, Clock::time_point deliver_at);
+
+  std::shared_ptr<SimulatedHeadset> m_headset;
+  SimulatorConfig m_config;
+  IClock& m_clock;
+  FrameDecoder m_tx_decoder;
+  std::mt19937 m_rng;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<InFlight> m_inbox; // Ordered by deliver_at
+  std::atomic<bool> m_connected{false};
+  std::atomic<bool> m_link_dead{false};
+  std::atomic<bool> m_reachable{true};
+  std::atomic<uint64_t> m_frames_sent{0};
+  std::atomic<uint64_t> m_frames_received{0};
+  std::atomic<uint64_t> m_bytes_sent{0};
+  std::atomic<uint64_t> m_bytes_received{0};
+};
@@ -86,11 +86,13 @@ bool BluetoothSPPClient::connect(const std::string &address, int port) {
 	}
 	bt_addr_sock.btAddr = bth_addr_native;
 
-	std::cout << "SPP_CLIENT: Refreshing device services cache..." << std::endl;
-	if (!refresh_device_record(bth_addr_native)) {
-		std::cout
-			<< "SPP_CLIENT: Could not refresh device record, but will attempt to connect anyway."
-			<< std::endl;
+	if (refresh_record) {
+		std::cout << "SPP_CLIENT: Refreshing device services cache..." << std::endl;
+		if (!refresh_device_record(bth_addr_native)) {
+			std::cout
+				<< "SPP_CLIENT: Could not refresh device record, but will attempt to connect anyway."
+				<< std::endl;
+		}
 	}
 
 	// --- START OF DETAILED LOGGING ---
@@ -212,6 +214,35 @@ std::vector<std::vector<uint8_t>> BluetoothSPPClient::receive_all() {
 	std::cout << "SPP_CLIENT: Exiting receive_all()." << std::endl;
 	return all_packets;
 }
+std::vector<uint8_t> BluetoothSPPClient::read_available() {
+	std::vector<uint8_t> bytes;
+	if (!connected) return bytes;
+
+	// FIONREAD tells us how much is already buffered, so recv() below never
+	// hits the SO_RCVTIMEO wait.
+	u_long available = 0;
+	if (ioctlsocket(sock, FIONREAD, &available) == SOCKET_ERROR) {
+		std::cerr << "SPP_CLIENT: ERROR - ioctlsocket(FIONREAD) failed with error: "
+				  << WSAGetLastError() << std::endl;
+		return bytes;
+	}
+	if (available == 0) return bytes;
+
+	bytes.resize(available);
+	int bytes_read = recv(sock, (char *)bytes.data(), (int)available, 0);
+	if (bytes_read == 0) {
+		std::cerr << "SPP_CLIENT: Connection closed by peer (recv returned 0)." << std::endl;
+		disconnect();
+		bytes.clear();
+	} else if (bytes_read == SOCKET_ERROR) {
+		std::cerr << "SPP_CLIENT: ERROR - recv() failed with Winsock error: " << WSAGetLastError() << std::endl;
+		bytes.clear();
+	} else {
+		bytes.resize(bytes_read);
+	}
+	return bytes;
+}
+
 bool BluetoothSPPClient::is_connected() const {
 	return connected;
 }
\ No newline at end of file
@@ -25,11 +25,18 @@ public:
     void disconnect() override;
     bool send(const std::vector<uint8_t>& data) override;
     std::vector<std::vector<uint8_t>> receive_all() override;
+    std::vector<uint8_t> read_available() override;
     bool is_connected() const override;
 
+    // Whether connect() first refreshes the device's service record, which costs
+    // about half a second. Worth it after a failure or for an address never connected
+    // to; not for one that connected fine last time.
+    void set_refresh_record(bool refresh) { refresh_record = refresh; }
+
 private:
     bool refresh_device_record(const BTH_ADDR& btAddr);
 
     SOCKET sock = INVALID_SOCKET;
     bool connected = false;
+    bool refresh_record = true;
 };
\ No newline at end of file
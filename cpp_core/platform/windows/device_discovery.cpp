@@ -1,4 +1,9 @@
 #include "device_discovery.h"
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -66,4 +71,16 @@ std::optional<std::string> find_first_device_by_name(const std::wstring& target_
 
     // If we get here, no device was found
     return std::nullopt;
-}
\ No newline at end of file
+}
+
+std::optional<DiscoveredDevice> WinRtDeviceDiscovery::find_by_name(const std::string& name) {
+    int size_including_null = MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, NULL, 0);
+    if (size_including_null <= 0) return std::nullopt;
+    std::wstring name_wide(size_including_null - 1, 0);
+    MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, &name_wide[0], size_including_null);
+
+    auto address = find_first_device_by_name(name_wide);
+    if (!address) return std::nullopt;
+    // Channel 0: the SPP client's default.
+    return DiscoveredDevice{name, *address, 0};
+}
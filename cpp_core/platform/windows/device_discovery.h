@@ -1,7 +1,14 @@
 #pragma once
+#include "platform/device_discovery_interface.h"
 #include <string>
 #include <optional>
 
 // This function will search for a paired Bluetooth device by its name.
 // It returns the MAC address string if found, otherwise std::nullopt.
-std::optional<std::string> find_first_device_by_name(const std::wstring& target_name);
\ No newline at end of file
+std::optional<std::string> find_first_device_by_name(const std::wstring& target_name);
+
+// The same WinRT lookup behind IDeviceDiscovery (names in UTF-8), for DiscoveryCache.
+class WinRtDeviceDiscovery : public IDeviceDiscovery {
+public:
+    std::optional<DiscoveredDevice> find_by_name(const std::string& name) override;
+};
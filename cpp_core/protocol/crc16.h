@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
 #include <cstdint>
+#include <cstddef>
 
 uint16_t crc16_xmodem(const uint8_t* data, size_t length);
\ No newline at end of file
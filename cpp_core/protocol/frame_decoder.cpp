@@ -0,0 +1,47 @@
+#include "frame_decoder.h"
+
+// Header is 5A <len_hi> <len_lo> 00, the CRC trails the body.
+static constexpr size_t HEADER_SIZE = 4;
+static constexpr size_t CRC_SIZE = 2;
+
+void FrameDecoder::feed(const uint8_t* data, size_t length) {
+	if (length == 0) return;
+	// Compact lazily so a long-lived connection doesn't keep growing the buffer.
+	if (m_read_pos > 0 && m_read_pos == m_buffer.size()) {
+		m_buffer.clear();
+		m_read_pos = 0;
+	} else if (m_read_pos > 4096) {
+		m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_read_pos);
+		m_read_pos = 0;
+	}
+	m_buffer.insert(m_buffer.end(), data, data + length);
+}
+
+bool FrameDecoder::next_frame(std::vector<uint8_t>& frame) {
+	while (buffered_bytes() >= HEADER_SIZE) {
+		const uint8_t* head = m_buffer.data() + m_read_pos;
+		if (head[0] != 0x5A || head[3] != 0x00) {
+			// Out of sync, drop one byte and look for the next frame start.
+			++m_read_pos;
+			continue;
+		}
+
+		uint16_t body_len_with_header = (static_cast<uint16_t>(head[1]) << 8) | head[2];
+		if (body_len_with_header == 0) {
+			++m_read_pos;
+			continue;
+		}
+		size_t frame_len = HEADER_SIZE + (body_len_with_header - 1) + CRC_SIZE;
+		if (buffered_bytes() < frame_len) return false; // Wait for the rest of the frame
+
+		frame.assign(head, head + frame_len);
+		m_read_pos += frame_len;
+		return true;
+	}
+	return false;
+}
+
+void FrameDecoder::reset() {
+	m_buffer.clear();
+	m_read_pos = 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Incremental decoder for the raw SPP byte stream.
+// Bytes can be fed in arbitrary chunks (whatever the socket happened to return);
+// complete frames of the form `5A len len 00 <body> <crc16>` are handed out in
+// arrival order. Garbage in front of a frame is skipped until the next 0x5A.
+class FrameDecoder {
+ public:
+  void feed(const uint8_t* data, size_t length);
+  void feed(const std::vector<uint8_t>& data) { feed(data.data(), data.size()); }
+
+  // Pops the next complete frame into 'frame'. Returns false if none is ready yet.
+  bool next_frame(std::vector<uint8_t>& frame);
+
+  size_t buffered_bytes() const { return m_buffer.size() - m_read_pos; }
+  void reset();
+
+ private:
+  std::vector<uint8_t> m_buffer;
+  size_t m_read_pos = 0;
+};
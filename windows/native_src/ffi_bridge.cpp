@@ -6,19 +6,34 @@
 #define FFI_EXPORT
 #endif
 
+#include "core/capability_table.h"
 #include "core/device.h"
+#include "core/discovery_cache.h"
+#include "core/eq_fit.h"
+#include "core/eq_response.h"
+#include "core/eq_slots.h"
+#include "core/state_json.h"
+#include "core/state_store.h"
 #include "core/types.h"
 #include "platform/windows/bluetooth_spp_client.h"
 #include "platform/windows/device_discovery.h"
+#include <algorithm>
 #include <iomanip>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <windows.h>
 #include <iostream>
 
+WinRtDeviceDiscovery g_discovery;
+std::unique_ptr<DiscoveryCache> g_discovery_cache;
+std::unique_ptr<CapabilityTable> g_capabilities; // Outlives g_device
+std::unique_ptr<StateStore> g_state_store;       // Same
 std::unique_ptr<Device> g_device;
+std::unique_ptr<EqSlots> g_eq_slots; // Over g_device, made on first use
+BluetoothSPPClient* g_bt_client = nullptr; // Owned by g_device
 static char json_buffer[4096];
 
 // --- Helper Functions ---
@@ -79,9 +94,13 @@ extern "C" {
 FFI_EXPORT void Initialize() {
 	if (g_device) return;
 	auto bt_client = std::make_unique<BluetoothSPPClient>();
+	g_bt_client = bt_client.get();
 	g_device = std::make_unique<Device>(std::move(bt_client));
 }
 
+// Resolves the name through the discovery cache: a name that connected before goes
+// straight to its address (no WinRT enumeration, no service record refresh), and
+// discovery only runs again if that fails.
 FFI_EXPORT bool Connect(const char* name_utf8) {
 	if (!g_device) Initialize();
 
@@ -91,47 +110,36 @@ FFI_EXPORT bool Connect(const char* name_utf8) {
 		std::cerr << "[FFI_BRIDGE] ERROR: Device name is null or empty. Aborting." << std::endl;
 		return false;
 	}
-
-	// --- START OF THE FIX ---
-
-	// 1. Calculate the required buffer size. This size INCLUDES the null terminator.
-	int size_including_null = MultiByteToWideChar(CP_UTF8, 0, name_utf8, -1, NULL, 0);
-	if (size_including_null <= 0) {
-		std::cerr << "[FFI_BRIDGE] ERROR: Could not calculate wide string size for conversion. Aborting." << std::endl;
-		return false;
-	}
-
-	// 2. Create a std::wstring with the correct length, EXCLUDING the null terminator.
-	std::wstring name_wide(size_including_null - 1, 0);
-
-	// 3. Perform the conversion into the buffer provided by the wstring.
-	//    The function will write the characters and the final null terminator.
-	MultiByteToWideChar(CP_UTF8, 0, name_utf8, -1, &name_wide[0], size_including_null);
-
-	// --- END OF THE FIX ---
-
-
-	std::wcout << L"[FFI_BRIDGE] Converted name to wide string (should be clean now): '" << name_wide << L"'" << std::endl;
-
-	std::cout << "[FFI_BRIDGE] Starting device discovery..." << std::endl;
-	auto addr = find_first_device_by_name(name_wide);
-
-	if (addr) {
-		std::cout << "[FFI_BRIDGE] SUCCESS: Device found! MAC Address: " << addr.value() << std::endl;
-	} else {
-		std::cerr << "[FFI_BRIDGE] ERROR: Device discovery failed. Could not find a paired device with that exact name." << std::endl;
+	if (!g_discovery_cache) g_discovery_cache = std::make_unique<DiscoveryCache>(g_discovery);
+
+	bool connected = g_discovery_cache->connect(name_utf8, [](const DiscoveredDevice& found, bool cached) {
+		std::cout << "[FFI_BRIDGE] Connecting to MAC " << found.address << (cached ? " (cached)" : "") << std::endl;
+		g_bt_client->set_refresh_record(!cached);
+		return g_device->connect(found.address, found.channel ? found.channel : 1);
+	});
+	if (!connected) {
+		std::cerr << "[FFI_BRIDGE] ERROR: Could not connect to a paired device with that exact name." << std::endl;
 		std::cerr << "[FFI_BRIDGE] Please check Windows Bluetooth settings to ensure the device is paired and the name matches EXACTLY." << std::endl;
-		return false;
 	}
+	return connected;
+}
 
-	std::cout << "[FFI_BRIDGE] Now passing MAC address to the C++ Device object to connect..." << std::endl;
-	return g_device->connect(addr.value(), 1);
+// Keeps what Connect() resolved names to in 'path', so the first connect after a
+// restart is fast too. Only takes effect before the first Connect().
+FFI_EXPORT void SetDiscoveryFile(const char* path_utf8) {
+	if (!path_utf8 || path_utf8[0] == '\0' || g_discovery_cache) return;
+	g_discovery_cache = std::make_unique<DiscoveryCache>(g_discovery, std::string(path_utf8));
 }
 
 FFI_EXPORT void Disconnect() {
 	if (g_device) g_device->disconnect();
 }
 
+// Called when a page goes away: drops its queued writes and unblocks its reads.
+FFI_EXPORT void CancelPendingRequests() {
+	if (g_device) g_device->cancel_pending();
+}
+
 FFI_EXPORT bool IsConnected() {
 	return g_device && g_device->is_connected();
 }
@@ -267,6 +275,67 @@ FFI_EXPORT void CreateFakePreset(int type, int id) {
 	}
 }
 
+// Custom curves through the slot manager: a curve the headset keeps already is
+// switched to with one byte instead of being saved again. Returns the preset id
+// it's under (no need to re-read the EQ info), -1 on failure.
+static bool curve_of(const char* name_utf8, const int* values, int len, CustomEqPreset& curve) {
+	if (!IsConnected() || len != 10) return false;
+	curve.name = std::string(name_utf8);
+	for (int i = 0; i < len; ++i) curve.values.push_back(static_cast<int8_t>(values[i]));
+	if (!g_eq_slots) g_eq_slots = std::make_unique<EqSlots>(*g_device);
+	return true;
+}
+FFI_EXPORT int SelectCustomEq(const char* name_utf8, const int* values, int len) {
+	CustomEqPreset curve;
+	if (!curve_of(name_utf8, values, len, curve)) return -1;
+	auto id = g_eq_slots->select(curve);
+	return id ? *id : -1;
+}
+// Saves a curve ahead of its first use, keeping the current preset playing.
+FFI_EXPORT int StageCustomEq(const char* name_utf8, const int* values, int len) {
+	CustomEqPreset curve;
+	if (!curve_of(name_utf8, values, len, curve) || g_eq_slots->stage({curve}) == 0) return -1;
+	auto id = g_eq_slots->find(curve);
+	return id ? *id : -1;
+}
+
+// The response of a curve (10 values, tenths of a dB) for drawing it: 'points'
+// dB values into 'db_out' and, if 'hz_out' isn't null, the frequencies they're
+// at (20 Hz to 20 kHz, log-spaced). Needs no connection. Returns the points written.
+FFI_EXPORT int GetEqResponse(const int* values, int len, int points, float* db_out, float* hz_out) {
+	static std::mutex mutex;
+	static std::shared_ptr<const EqResponse> engine;
+	if (len < 0 || points <= 0 || !db_out) return 0;
+	std::shared_ptr<const EqResponse> e;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!engine || engine->points() != static_cast<size_t>(points)) {
+			EqResponseConfig config;
+			config.points = static_cast<size_t>(points);
+			engine = std::make_shared<const EqResponse>(config);
+		}
+		e = engine;
+	}
+	std::vector<int8_t> v;
+	for (int i = 0; i < len; ++i) v.push_back(static_cast<int8_t>(values[i]));
+	e->evaluate(v, db_out);
+	if (hz_out) std::copy(e->frequencies().begin(), e->frequencies().end(), hz_out);
+	return points;
+}
+
+// Fits an AutoEQ CSV or GraphicEQ export to the ten bands: values_out gets ten
+// values for SelectCustomEq, rms_out (if given) the error left in dB.
+FFI_EXPORT bool FitCustomEq(const char* text, int* values_out, double* rms_out) {
+	static const EqFitter fitter;
+	if (!text || !values_out) return false;
+	auto target = EqTarget::parse(text);
+	if (!target) return false;
+	EqFitResult result = fitter.fit(*target);
+	for (size_t k = 0; k < result.values.size(); ++k) values_out[k] = result.values[k];
+	if (rms_out) *rms_out = result.rms_db;
+	return true;
+}
+
 // --- Dual Connect ---
 FFI_EXPORT const char* GetDualConnectDevices() {
 	if (!IsConnected()) { snprintf(json_buffer, sizeof(json_buffer), "[]"); return json_buffer; }
@@ -287,4 +356,63 @@ FFI_EXPORT void DualConnectAction(const char* mac_utf8, int code) {
 	}
 }
 
+// --- State deltas ---
+// Fields that changed after version 'since' (0 for all), as JSON with the new
+// version to pass next time. "pending" marks fields showing a write that isn't
+// acked yet; a rolled-back write shows up as a change back. Grows past
+// json_buffer with a few EQ presets.
+FFI_EXPORT const char* GetStateChanges(uint64_t since) {
+	static std::string json;
+	if (!g_device) Initialize();
+	json = delta_to_json(g_device->get_state_changes(since));
+	return json.c_str();
+}
+
+// --- Capabilities ---
+// Remembers in 'path' which commands the connected model doesn't answer, so
+// refreshes stop waiting on them. The first call picks the file.
+FFI_EXPORT void SetCapabilityFile(const char* path_utf8) {
+	if (!path_utf8 || path_utf8[0] == '\0') return;
+	if (!g_device) Initialize();
+	if (!g_capabilities) g_capabilities = std::make_unique<CapabilityTable>(std::string(path_utf8));
+	g_device->set_capabilities(g_capabilities.get());
+}
+
+// --- Last-known state ---
+// Keeps the state of every headset seen in 'path' and fills the state cache
+// from the one saved last, so GetStateChanges(0) has values to draw before
+// Connect() returns ("restored" marks them until the headset confirms them). The first
+// call picks the file. Returns false if there was nothing to restore.
+FFI_EXPORT bool SetStateFile(const char* path_utf8) {
+	if (!path_utf8 || path_utf8[0] == '\0') return false;
+	if (!g_device) Initialize();
+	if (!g_state_store) g_state_store = std::make_unique<StateStore>(std::string(path_utf8));
+	g_device->set_state_store(g_state_store.get());
+	return g_device->restore_state();
+}
+
+// --- Link Stats ---
+FFI_EXPORT const char* GetLinkStats() {
+	if (!IsConnected()) { snprintf(json_buffer, sizeof(json_buffer), "{}"); return json_buffer; }
+	auto write_stats = [](std::ostringstream& ss, const RttStats& s) {
+		ss << "{\"samples\":" << s.samples << ",\"srtt_ms\":" << s.srtt_ms << ",\"rttvar_ms\":" << s.rttvar_ms
+		   << ",\"timeout_ms\":" << s.timeout_ms << ",\"timeouts\":" << s.timeouts << ",\"retries\":" << s.retries << "}";
+	};
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(2) << "{\"link\":";
+	write_stats(ss, g_device->get_link_rtt_stats());
+	ss << ",\"commands\":{";
+	bool first = true;
+	for (const auto& [id, stats] : g_device->get_command_rtt_stats()) {
+		if (!first) ss << ",";
+		first = false;
+		ss << "\"0x" << std::hex << std::setw(4) << std::setfill('0') << id << std::dec << std::setfill(' ') << "\":";
+		write_stats(ss, stats);
+	}
+	WriteStats writes = g_device->get_write_stats();
+	ss << "},\"writes\":{\"sent\":" << writes.sent << ",\"elided\":" << writes.elided << "}}";
+	snprintf(json_buffer, sizeof(json_buffer), "%s", ss.str().c_str());
+	return json_buffer;
+}
+
 } // extern "C"
\ No newline at end of file